@@ -32,6 +32,7 @@
 #cmakedefine HAVE_INT32_T 1 
 #cmakedefine HAVE_INTTYPES_H 1 
 #cmakedefine HAVE_MEMORY_H 1 
+#cmakedefine HAVE_MMAP 1
 #cmakedefine HAVE_MKSTEMP 1 
 #cmakedefine HAVE_NDIR_H 1 
 #cmakedefine HAVE_POPEN 1 
@@ -42,6 +43,7 @@
 #cmakedefine HAVE_STRDUP 1 
 #cmakedefine HAVE_SYSCONF 1 
 #cmakedefine HAVE_SYSTEM 1 
+#cmakedefine HAVE_SYS_MMAN_H 1
 #cmakedefine HAVE_SYS_DIR_H 1 
 #cmakedefine HAVE_SYS_NDIR_H 1 
 #cmakedefine HAVE_SYS_STAT_H 1 
@@ -64,3 +66,6 @@
 #cmakedefine HAVE_SLEEP 1 
 #cmakedefine HAVE_CLOCK_GETTIME 1
 #cmakedefine HAVE_GETTIMEOFDAY 1
+#cmakedefine HAVE_PTHREAD 1
+#cmakedefine HAVE_THREAD_LOCAL 1
+#cmakedefine HAVE_ATOMIC_BUILTINS 1
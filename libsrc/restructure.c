@@ -240,3 +240,195 @@ void restructure_array(size_t ndims,    /* Dimension count */
   free(temp);
 }
 
+
+/* Edge of the square tiles used by restructure_array_copy(), in elements.
+ */
+#ifndef RESTRUCTURE_TILE
+#define RESTRUCTURE_TILE 32
+#endif
+
+/* Copy one tile of "nb" rows by "na" columns.  Destination columns are
+ * contiguous, source elements are "sa" apart along a row and "sb" apart
+ * from one row to the next; "db" is the destination row stride.
+ */
+#define TILE_COPY(type)                                                 \
+  {                                                                     \
+    for (ib = 0; ib < nb; ib++) {                                       \
+      type *d = (type *)(dst + ib * db);                                \
+      const type *s = (const type *)(src + ib * sb);                    \
+      for (ia = 0; ia < na; ia++) {                                     \
+        d[ia] = *(const type *)((const unsigned char *)s + ia * sa);    \
+      }                                                                 \
+    }                                                                   \
+  }
+
+static void
+copy_tile(unsigned char *dst,
+          const unsigned char *src,
+          size_t na, long sa,
+          size_t nb, long db, long sb,
+          size_t el_size)
+{
+  size_t ia, ib;
+
+  switch (el_size) {
+  case 1:
+    TILE_COPY(unsigned char);
+    break;
+  case 2:
+    TILE_COPY(unsigned short);
+    break;
+  case 4:
+    TILE_COPY(unsigned int);
+    break;
+  case 8:
+    TILE_COPY(unsigned long long);
+    break;
+  default:
+    for (ib = 0; ib < nb; ib++) {
+      for (ia = 0; ia < na; ia++) {
+        memcpy(dst + ib * db + ia * el_size, src + ib * sb + ia * sa, el_size);
+      }
+    }
+    break;
+  }
+}
+
+/** Out-of-place array dimension restructuring.
+ *
+ * Produces in "dst" exactly what restructure_array() would leave in
+ * "array" when called with "src" as its input, without modifying "src".
+ * The two buffers must not overlap.
+ *
+ * The destination is filled in order while the source is walked with
+ * precomputed (possibly negative) strides, so no index arithmetic is done
+ * per element.  The output's last dimension, which is contiguous in
+ * "dst", is copied in square tiles together with the dimension that is
+ * closest to contiguous in "src", so that both sides stay in cache when
+ * the reordering amounts to a transpose.  This covers 3D and 4D volumes
+ * as well as any other dimension count: whatever the dimension count,
+ * the copy is a tiled transpose of two dimensions under an odometer
+ * over the others, so a kernel for a fixed count would do the same loads
+ * and stores.
+ */
+void restructure_array_copy(size_t ndims,    /* Dimension count */
+                            unsigned char *dst, /* Output data */
+                            const unsigned char *src, /* Raw data */
+                            const size_t *lengths_perm, /* Permuted lengths */
+                            size_t el_size,  /* Element size, in bytes */
+                            const int *map, /* Mapping array */
+                            const int *dir) /* Direction array, in permuted order */
+{
+  size_t lengths[MAX_ARRAY_DIMS];    /* Raw (unpermuted) lengths */
+  long raw_stride[MAX_ARRAY_DIMS];   /* Raw strides, in bytes */
+  long src_stride[MAX_ARRAY_DIMS];   /* Source strides, in permuted order */
+  long dst_stride[MAX_ARRAY_DIMS];   /* Destination strides */
+  size_t index[MAX_ARRAY_DIMS];      /* Odometer over the outer dimensions */
+  size_t a, b;                       /* The two tiled dimensions */
+  size_t i;
+
+  if (ndims == 0) {
+    memcpy(dst, src, el_size);
+    return;
+  }
+
+  for (i = 0; i < ndims; i++) {
+    if (lengths_perm[i] == 0) {
+      return;
+    }
+    lengths[map[i]] = lengths_perm[i];
+  }
+
+  raw_stride[ndims - 1] = el_size;
+  dst_stride[ndims - 1] = el_size;
+  for (i = ndims - 1; i > 0; i--) {
+    raw_stride[i - 1] = raw_stride[i] * lengths[i];
+    dst_stride[i - 1] = dst_stride[i] * lengths_perm[i];
+  }
+
+  /**
+   * Walk the source backwards along flipped dimensions, starting from
+   * their last element.
+   **/
+  for (i = 0; i < ndims; i++) {
+    src_stride[i] = raw_stride[map[i]];
+    if (dir[i] < 0) {
+      src += (lengths_perm[i] - 1) * src_stride[i];
+      src_stride[i] = -src_stride[i];
+    }
+  }
+
+  /**
+   * Tile the last output dimension with whichever dimension has the
+   * smallest source stride.
+   **/
+  a = ndims - 1;
+  b = a;
+  for (i = 0; i < ndims; i++) {
+    if (labs(src_stride[i]) < labs(src_stride[b])) {
+      b = i;
+    }
+  }
+
+  for (i = 0; i < ndims; i++) {
+    index[i] = 0;
+  }
+
+  for (;;) {
+    const unsigned char *s = src;
+    unsigned char *d = dst;
+    size_t ta, tb;
+
+    for (i = 0; i < ndims; i++) {
+      if (i != a && i != b) {
+        s += index[i] * src_stride[i];
+        d += index[i] * dst_stride[i];
+      }
+    }
+
+    if (b == a) {
+      /**
+       * The output rows are also the most contiguous source rows.
+       **/
+      if (src_stride[a] == (long) el_size) {
+        memcpy(d, s, lengths_perm[a] * el_size);
+      } else {
+        copy_tile(d, s, lengths_perm[a], src_stride[a], 1, 0, 0, el_size);
+      }
+    } else {
+      for (tb = 0; tb < lengths_perm[b]; tb += RESTRUCTURE_TILE) {
+        size_t nb = lengths_perm[b] - tb;
+        if (nb > RESTRUCTURE_TILE) {
+          nb = RESTRUCTURE_TILE;
+        }
+        for (ta = 0; ta < lengths_perm[a]; ta += RESTRUCTURE_TILE) {
+          size_t na = lengths_perm[a] - ta;
+          if (na > RESTRUCTURE_TILE) {
+            na = RESTRUCTURE_TILE;
+          }
+          copy_tile(d + tb * dst_stride[b] + ta * el_size,
+                    s + tb * src_stride[b] + ta * src_stride[a],
+                    na, src_stride[a],
+                    nb, dst_stride[b], src_stride[b],
+                    el_size);
+        }
+      }
+    }
+
+    /**
+     * Advance the odometer over the remaining dimensions.
+     **/
+    for (i = ndims; i-- > 0; ) {
+      if (i == a || i == b) {
+        continue;
+      }
+      if (++index[i] < lengths_perm[i]) {
+        break;
+      }
+      index[i] = 0;
+    }
+    if (i == (size_t) -1) {
+      break;
+    }
+  }
+}
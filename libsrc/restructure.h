@@ -1,6 +1,7 @@
 /*
  * \file restructure.h
- * \brief Just declares the prototype of restructure_array().
+ * \brief Declares the prototypes of restructure_array() and
+ * restructure_array_copy().
  */
 extern void restructure_array(size_t ndims,
                               unsigned char *array, 
@@ -9,3 +10,10 @@ extern void restructure_array(size_t ndims,
                               const int *map,
                               const int *dir);
 
+extern void restructure_array_copy(size_t ndims,
+                                   unsigned char *dst,
+                                   const unsigned char *src,
+                                   const size_t *lengths_perm,
+                                   size_t el_size,
+                                   const int *map,
+                                   const int *dir);
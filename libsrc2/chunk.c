@@ -0,0 +1,821 @@
+/** \file chunk.c
+ * \brief MINC 2.0 parallel chunk I/O
+ *
+ * Reading or writing a whole compressed volume through HDF5 is limited
+ * by the speed of a single decompression stream.  When a volume handle has been
+ * given more than one I/O thread with miset_volume_io_threads(),
+ * hyperslab transfers which need no type conversion and make use of
+ * most of the chunks they touch bypass the HDF5 filter pipeline:
+ *
+ * - reads fetch the stored chunks with H5Dread_chunk() on the calling
+ *   thread, while a pool of workers decodes them and copies them into
+ *   the caller's buffer;
+ * - writes have the workers gather and encode every chunk which the
+ *   hyperslab covers completely, and the calling thread stores them
+ *   with H5Dwrite_chunk().  Chunks only partly covered go through
+ *   H5Dwrite as usual.
+ *
+ * The chunks are encoded by the codecs of codec.c exactly as the HDF5
+ * filters would do it, so the files are unchanged for existing readers.  The HDF5
+ * library is never called from the workers, so this also works with
+ * builds of HDF5 which are not thread-safe.
+ ************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <hdf5.h>
+#include "minc2.h"
+#include "minc2_private.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* Direct chunk reads and writes appeared in HDF5 1.10.3.
+ */
+#ifdef H5_VERSION_GE
+#if H5_VERSION_GE(1,10,3) && defined(HAVE_PTHREAD)
+#define MI2_PARALLEL_CHUNKS 1
+#endif
+#endif
+
+/** Upper limit for the number of I/O threads of a volume. */
+#define MI2_MAX_IO_THREADS 64
+
+/** Set the number of threads used to compress and decompress chunks
+ * when transferring hyperslabs of \a volume.  A value of 0 or 1 selects
+ * the ordinary serial I/O.
+ */
+int miset_volume_io_threads(mihandle_t volume, int nthreads)
+{
+  if (volume == NULL || nthreads < 0) {
+    return (MI_ERROR);
+  }
+  if (nthreads > MI2_MAX_IO_THREADS) {
+    nthreads = MI2_MAX_IO_THREADS;
+  }
+  volume->io_threads = nthreads;
+  return (MI_NOERROR);
+}
+
+/** Get the number of threads used to compress and decompress chunks
+ * when transferring hyperslabs of \a volume.
+ */
+int miget_volume_io_threads(mihandle_t volume, int *nthreads)
+{
+  if (volume == NULL || nthreads == NULL) {
+    return (MI_ERROR);
+  }
+  *nthreads = volume->io_threads;
+  return (MI_NOERROR);
+}
+
+#ifdef MI2_PARALLEL_CHUNKS
+
+/** \internal
+ * A chunk in its stored form.
+ */
+typedef struct {
+  hsize_t offset[MI2_MAX_VAR_DIMS]; /* Chunk origin in the dataset */
+  unsigned char *data;              /* Stored bytes of the chunk */
+  size_t size;                      /* Number of stored bytes */
+  uint32_t filter_mask;             /* Filters skipped for this chunk */
+} michunk_job_t;
+
+/** \internal
+ * Bounded queue of chunks passed between the calling thread and the
+ * workers.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  michunk_job_t *jobs;          /* Ring buffer of pending chunks */
+  int capacity;
+  int head;
+  int queued;
+  int finished;                 /* No more chunks will be queued */
+  int error;                    /* Some thread failed */
+} michunk_queue_t;
+
+/** \internal
+ * Geometry of a hyperslab transfer.
+ */
+typedef struct {
+  int ndims;
+  size_t el_size;
+  size_t chunk_bytes;           /* Size of an uncompressed chunk */
+  hsize_t chunk_dims[MI2_MAX_VAR_DIMS];
+  hsize_t dims[MI2_MAX_VAR_DIMS];  /* Extent of the dataset */
+  hsize_t start[MI2_MAX_VAR_DIMS];
+  hsize_t count[MI2_MAX_VAR_DIMS];
+  unsigned char *buffer;        /* Caller's buffer, hyperslab shaped */
+} michunk_slab_t;
+
+/** \internal
+ * State shared between the reading thread and the decoding workers.
+ */
+typedef struct {
+  michunk_queue_t queue;
+  michunk_slab_t slab;
+  micodec_pipeline_t pipeline;  /* Filters the chunks are stored with */
+} michunk_reader_t;
+
+/** \internal
+ * State shared between the writing thread and the encoding workers.
+ */
+typedef struct {
+  michunk_queue_t queue;        /* Encoded chunks ready to be stored */
+  michunk_slab_t slab;
+  micodec_pipeline_t pipeline;  /* Filters to store the chunks with */
+  hsize_t *offsets;             /* Origins of the chunks to encode */
+  size_t n_chunks;
+  size_t next;                  /* Next chunk to be claimed */
+  int active;                   /* Workers still running */
+} michunk_writer_t;
+
+static int michunk_queue_init(michunk_queue_t *queue, int capacity)
+{
+  memset(queue, 0, sizeof(*queue));
+  queue->capacity = capacity;
+  queue->jobs = (michunk_job_t *) malloc(capacity * sizeof(michunk_job_t));
+  if (queue->jobs == NULL) {
+    return (MI_LOG_ERROR(MI2_MSG_OUTOFMEM, capacity * sizeof(michunk_job_t)));
+  }
+  pthread_mutex_init(&queue->lock, NULL);
+  pthread_cond_init(&queue->not_empty, NULL);
+  pthread_cond_init(&queue->not_full, NULL);
+  return (MI_NOERROR);
+}
+
+static void michunk_queue_free(michunk_queue_t *queue)
+{
+  while (queue->queued > 0) {
+    free(queue->jobs[queue->head].data);
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->queued--;
+  }
+  pthread_cond_destroy(&queue->not_full);
+  pthread_cond_destroy(&queue->not_empty);
+  pthread_mutex_destroy(&queue->lock);
+  free(queue->jobs);
+}
+
+/** Queues a chunk, waiting while the queue is full.  Returns MI_ERROR,
+ * without queueing, once any thread has failed.
+ */
+static int michunk_push(michunk_queue_t *queue, const michunk_job_t *job)
+{
+  int result = MI_NOERROR;
+
+  pthread_mutex_lock(&queue->lock);
+  while (queue->queued == queue->capacity && !queue->error) {
+    pthread_cond_wait(&queue->not_full, &queue->lock);
+  }
+  if (queue->error) {
+    result = MI_ERROR;
+  } else {
+    int tail = (queue->head + queue->queued) % queue->capacity;
+    queue->jobs[tail] = *job;
+    queue->queued++;
+    pthread_cond_signal(&queue->not_empty);
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return (result);
+}
+
+/** Takes the next chunk off the queue, waiting while it is empty.
+ * Returns FALSE once the queue is finished and drained.
+ */
+static int michunk_pop(michunk_queue_t *queue, michunk_job_t *job)
+{
+  pthread_mutex_lock(&queue->lock);
+  while (queue->queued == 0 && !queue->finished) {
+    pthread_cond_wait(&queue->not_empty, &queue->lock);
+  }
+  if (queue->queued == 0) {
+    pthread_mutex_unlock(&queue->lock);
+    return (FALSE);
+  }
+  *job = queue->jobs[queue->head];
+  queue->head = (queue->head + 1) % queue->capacity;
+  queue->queued--;
+  pthread_cond_signal(&queue->not_full);
+  pthread_mutex_unlock(&queue->lock);
+  return (TRUE);
+}
+
+static void michunk_fail(michunk_queue_t *queue)
+{
+  pthread_mutex_lock(&queue->lock);
+  queue->error = TRUE;
+  pthread_cond_broadcast(&queue->not_full);
+  pthread_cond_broadcast(&queue->not_empty);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+/** Computes the part of the chunk at \a offset which lies inside the
+ * hyperslab, as the half-open ranges \a lo to \a hi in dataset
+ * coordinates.  Returns FALSE if they do not overlap.
+ */
+static int michunk_overlap(const michunk_slab_t *slab, const hsize_t offset[],
+                           hsize_t lo[], hsize_t hi[])
+{
+  int i;
+
+  for (i = 0; i < slab->ndims; i++) {
+    hsize_t c_end = offset[i] + slab->chunk_dims[i];
+    hsize_t s_end = slab->start[i] + slab->count[i];
+
+    lo[i] = (offset[i] > slab->start[i]) ? offset[i] : slab->start[i];
+    hi[i] = (c_end < s_end) ? c_end : s_end;
+    if (lo[i] >= hi[i]) {
+      return (FALSE);
+    }
+  }
+  return (TRUE);
+}
+
+/** Copies the part of an uncompressed chunk at \a offset which lies
+ * inside the hyperslab between the chunk and the caller's buffer, in
+ * the direction given by \a to_chunk.
+ */
+static void michunk_copy(const michunk_slab_t *slab, const hsize_t offset[],
+                         unsigned char *chunk, int to_chunk)
+{
+  hsize_t lo[MI2_MAX_VAR_DIMS];
+  hsize_t hi[MI2_MAX_VAR_DIMS];
+  hsize_t idx[MI2_MAX_VAR_DIMS];
+  int last = slab->ndims - 1;
+  size_t run;
+  int i;
+
+  if (!michunk_overlap(slab, offset, lo, hi)) {
+    return;
+  }
+  for (i = 0; i <= last; i++) {
+    idx[i] = lo[i];
+  }
+  run = (size_t)(hi[last] - lo[last]) * slab->el_size;
+
+  for (;;) {
+    size_t src = 0;
+    size_t dst = 0;
+
+    for (i = 0; i <= last; i++) {
+      src = src * slab->chunk_dims[i] + (idx[i] - offset[i]);
+      dst = dst * slab->count[i] + (idx[i] - slab->start[i]);
+    }
+    if (to_chunk) {
+      memcpy(chunk + src * slab->el_size,
+             slab->buffer + dst * slab->el_size, run);
+    } else {
+      memcpy(slab->buffer + dst * slab->el_size,
+             chunk + src * slab->el_size, run);
+    }
+
+    /* Advance the outer dimensions. */
+    for (i = last - 1; i >= 0; i--) {
+      if (++idx[i] < hi[i]) {
+        break;
+      }
+      idx[i] = lo[i];
+    }
+    if (i < 0) {
+      break;
+    }
+  }
+}
+
+/** Transfers the part of the hyperslab covered by the chunk at
+ * \a offset through the ordinary HDF5 calls.  Used for unallocated
+ * chunks when reading, so that the fill value is applied, and for
+ * chunks only partly covered when writing.  Called on the calling
+ * thread only.
+ */
+static int mirw_chunk_part(const michunk_slab_t *slab, int write,
+                           hid_t dset_id, hid_t type_id,
+                           const hsize_t offset[])
+{
+  hsize_t lo[MI2_MAX_VAR_DIMS];
+  hsize_t hi[MI2_MAX_VAR_DIMS];
+  hsize_t m_start[MI2_MAX_VAR_DIMS];
+  hsize_t n[MI2_MAX_VAR_DIMS];
+  hid_t fspc_id;
+  hid_t mspc_id;
+  herr_t status = -1;
+  int i;
+
+  if (!michunk_overlap(slab, offset, lo, hi)) {
+    return (MI_NOERROR);
+  }
+  for (i = 0; i < slab->ndims; i++) {
+    m_start[i] = lo[i] - slab->start[i];
+    n[i] = hi[i] - lo[i];
+  }
+
+  fspc_id = H5Dget_space(dset_id);
+  mspc_id = H5Screate_simple(slab->ndims, slab->count, NULL);
+  if (fspc_id >= 0 && mspc_id >= 0 &&
+      H5Sselect_hyperslab(fspc_id, H5S_SELECT_SET, lo, NULL, n, NULL) >= 0 &&
+      H5Sselect_hyperslab(mspc_id, H5S_SELECT_SET, m_start, NULL, n, NULL) >= 0) {
+    if (write) {
+      status = H5Dwrite(dset_id, type_id, mspc_id, fspc_id, H5P_DEFAULT,
+                        slab->buffer);
+    } else {
+      status = H5Dread(dset_id, type_id, mspc_id, fspc_id, H5P_DEFAULT,
+                       slab->buffer);
+    }
+  }
+  if (mspc_id >= 0) {
+    H5Sclose(mspc_id);
+  }
+  if (fspc_id >= 0) {
+    H5Sclose(fspc_id);
+  }
+  if (status < 0) {
+    return (MI_LOG_ERROR(MI2_MSG_HDF5, write ? "H5Dwrite" : "H5Dread"));
+  }
+  return (MI_NOERROR);
+}
+
+/** Fills in the geometry of a transfer.  Returns FALSE if the
+ * hyperslab is empty.
+ */
+static int michunk_slab_init(michunk_slab_t *slab, hid_t dset_id,
+                             hid_t type_id, int ndims,
+                             const hsize_t chunk_dims[],
+                             const hsize_t hdf_start[],
+                             const hsize_t hdf_count[], void *buffer)
+{
+  hid_t fspc_id;
+  int i;
+
+  memset(slab, 0, sizeof(*slab));
+  slab->ndims = ndims;
+  slab->el_size = H5Tget_size(type_id);
+  slab->chunk_bytes = slab->el_size;
+  slab->buffer = (unsigned char *) buffer;
+  for (i = 0; i < ndims; i++) {
+    if (hdf_count[i] == 0) {
+      return (FALSE);
+    }
+    slab->chunk_dims[i] = chunk_dims[i];
+    slab->start[i] = hdf_start[i];
+    slab->count[i] = hdf_count[i];
+    slab->chunk_bytes *= chunk_dims[i];
+  }
+  if ((fspc_id = H5Dget_space(dset_id)) >= 0) {
+    H5Sget_simple_extent_dims(fspc_id, slab->dims, NULL);
+    H5Sclose(fspc_id);
+  }
+  return (TRUE);
+}
+
+/** Steps \a grid through the chunks between \a first and \a last.
+ * Returns FALSE after the last one.
+ */
+static int michunk_next(int ndims, hsize_t grid[], const hsize_t first[],
+                        const hsize_t last[])
+{
+  int i;
+
+  for (i = ndims - 1; i >= 0; i--) {
+    if (++grid[i] <= last[i]) {
+      return (TRUE);
+    }
+    grid[i] = first[i];
+  }
+  return (FALSE);
+}
+
+/** Starts up to \a nthreads workers.  Returns the number started.
+ */
+static int michunk_start(pthread_t threads[], int nthreads,
+                         void *(*worker)(void *), void *arg)
+{
+  int started;
+
+  for (started = 0; started < nthreads; started++) {
+    if (pthread_create(&threads[started], NULL, worker, arg) != 0) {
+      break;
+    }
+  }
+  return (started);
+}
+
+/** Worker thread: decodes queued chunks until the queue is drained.
+ */
+static void *michunk_decoder(void *arg)
+{
+  michunk_reader_t *reader = (michunk_reader_t *) arg;
+  size_t chunk_bytes = reader->slab.chunk_bytes;
+  unsigned char *chunk = malloc(chunk_bytes);
+  unsigned char *scratch = malloc(chunk_bytes);
+  michunk_job_t job;
+
+  if (chunk == NULL || scratch == NULL) {
+    michunk_fail(&reader->queue);
+    free(chunk);
+    free(scratch);
+    return NULL;
+  }
+
+  while (michunk_pop(&reader->queue, &job)) {
+    if (micodec_decode(&reader->pipeline, job.filter_mask, job.data,
+                       job.size, chunk, scratch, chunk_bytes) == MI_NOERROR) {
+      michunk_copy(&reader->slab, job.offset, chunk, FALSE);
+    } else {
+      michunk_fail(&reader->queue);
+    }
+    free(job.data);
+  }
+
+  free(chunk);
+  free(scratch);
+  return NULL;
+}
+
+/** Worker thread: gathers and encodes chunks until none are left.
+ */
+static void *michunk_encoder(void *arg)
+{
+  michunk_writer_t *writer = (michunk_writer_t *) arg;
+  michunk_queue_t *queue = &writer->queue;
+  size_t chunk_bytes = writer->slab.chunk_bytes;
+  unsigned char *scratch = malloc(chunk_bytes);
+  int ndims = writer->slab.ndims;
+
+  if (scratch == NULL) {
+    michunk_fail(queue);
+  }
+
+  while (scratch != NULL) {
+    michunk_job_t job;
+    size_t index;
+    int i;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->error || writer->next == writer->n_chunks) {
+      pthread_mutex_unlock(&queue->lock);
+      break;
+    }
+    index = writer->next++;
+    pthread_mutex_unlock(&queue->lock);
+
+    for (i = 0; i < ndims; i++) {
+      job.offset[i] = writer->offsets[index * ndims + i];
+    }
+    job.filter_mask = 0;
+
+    /* Parts of edge chunks beyond the dataset hold the fill value. */
+    memset(scratch, 0, chunk_bytes);
+    michunk_copy(&writer->slab, job.offset, scratch, TRUE);
+
+    if (micodec_encode(&writer->pipeline, scratch, chunk_bytes,
+                       &job.data, &job.size) < 0) {
+      michunk_fail(queue);
+      break;
+    }
+
+    if (michunk_push(queue, &job) < 0) {
+      free(job.data);
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&queue->lock);
+  if (--writer->active == 0) {
+    queue->finished = TRUE;
+    pthread_cond_broadcast(&queue->not_empty);
+  }
+  pthread_mutex_unlock(&queue->lock);
+
+  free(scratch);
+  return NULL;
+}
+
+#endif /* MI2_PARALLEL_CHUNKS */
+
+/** "semiprivate" function deciding whether a hyperslab transfer between
+ * \a dset_id and a buffer of type \a type_id may use the parallel chunk
+ * code.  This requires more than one I/O thread, a chunked dataset
+ * whose filters are all known to the codecs, and a buffer type identical
+ * to the stored type so that no conversion is needed.  On success the
+ * chunk dimensions are returned in \a chunk_dims.
+ */
+int miuse_parallel_chunks(mihandle_t volume, hid_t dset_id, hid_t type_id,
+                          int ndims, hsize_t chunk_dims[])
+{
+#ifdef MI2_PARALLEL_CHUNKS
+  hid_t dcpl_id;
+  hid_t ftype_id;
+  int usable = FALSE;
+
+  if (volume->io_threads < 2 || ndims < 1) {
+    return (FALSE);
+  }
+
+  if ((dcpl_id = H5Dget_create_plist(dset_id)) < 0) {
+    return (FALSE);
+  }
+  if (H5Pget_layout(dcpl_id) == H5D_CHUNKED &&
+      H5Pget_chunk(dcpl_id, ndims, chunk_dims) == ndims) {
+    micodec_pipeline_t pipeline;
+
+    usable = micodec_get_pipeline(dcpl_id, &pipeline);
+  }
+  H5Pclose(dcpl_id);
+
+  if (usable) {
+    if ((ftype_id = H5Dget_type(dset_id)) < 0) {
+      return (FALSE);
+    }
+    usable = (H5Tequal(ftype_id, type_id) > 0);
+    H5Tclose(ftype_id);
+  }
+  return (usable);
+#else
+  return (FALSE);
+#endif
+}
+
+/** "semiprivate" function deciding whether the hyperslab \a hdf_start,
+ * \a hdf_count of \a dset_id is worth transferring with the parallel
+ * chunk code, once miuse_parallel_chunks() has allowed it.  The chunks
+ * are then decoded outside the HDF5 chunk cache, so a hyperslab touching
+ * fewer chunks than there are I/O threads, or using less than half of
+ * the voxels of the chunks it touches, goes through H5Dread() or
+ * H5Dwrite() instead: the chunk cache keeps the chunks decoded for the
+ * hyperslabs next to it, as when a volume is read slice by slice.
+ */
+int miuse_parallel_hyperslab(mihandle_t volume, hid_t dset_id, int ndims,
+                             const hsize_t chunk_dims[],
+                             const hsize_t hdf_start[],
+                             const hsize_t hdf_count[])
+{
+  hsize_t dims[MI2_MAX_VAR_DIMS];
+  hsize_t n_chunks = 1;
+  double slab_voxels = 1.0;
+  double chunk_voxels = 1.0;
+  hid_t fspc_id;
+  int i;
+
+  if ((fspc_id = H5Dget_space(dset_id)) < 0) {
+    return (FALSE);
+  }
+  H5Sget_simple_extent_dims(fspc_id, dims, NULL);
+  H5Sclose(fspc_id);
+
+  for (i = 0; i < ndims; i++) {
+    hsize_t first, last, end;
+
+    if (hdf_count[i] == 0) {
+      return (FALSE);
+    }
+    first = hdf_start[i] / chunk_dims[i];
+    last = (hdf_start[i] + hdf_count[i] - 1) / chunk_dims[i];
+    /* Parts of edge chunks beyond the dataset are never decoded to. */
+    end = (last + 1) * chunk_dims[i];
+    if (end > dims[i]) {
+      end = dims[i];
+    }
+    n_chunks *= last - first + 1;
+    slab_voxels *= (double) hdf_count[i];
+    chunk_voxels *= (double) (end - first * chunk_dims[i]);
+  }
+  return (n_chunks >= (hsize_t) volume->io_threads &&
+          slab_voxels * 2.0 >= chunk_voxels);
+}
+
+/** "semiprivate" function reading the hyperslab \a hdf_start,
+ * \a hdf_count of \a dset_id, in file order, with the chunks decoded
+ * in parallel.  Only valid when miuse_parallel_chunks() has returned
+ * TRUE for the same dataset and type.
+ */
+int miread_parallel_chunks(mihandle_t volume, hid_t dset_id, hid_t type_id,
+                           int ndims, const hsize_t chunk_dims[],
+                           const hsize_t hdf_start[],
+                           const hsize_t hdf_count[], void *buffer)
+{
+#ifdef MI2_PARALLEL_CHUNKS
+  michunk_reader_t reader;
+  pthread_t threads[MI2_MAX_IO_THREADS];
+  hsize_t first[MI2_MAX_VAR_DIMS];
+  hsize_t last[MI2_MAX_VAR_DIMS];
+  hsize_t grid[MI2_MAX_VAR_DIMS];
+  hid_t dcpl_id;
+  int started;
+  int result = MI_NOERROR;
+  int i;
+
+  if (!michunk_slab_init(&reader.slab, dset_id, type_id, ndims, chunk_dims,
+                         hdf_start, hdf_count, buffer)) {
+    return (MI_NOERROR);
+  }
+  for (i = 0; i < ndims; i++) {
+    first[i] = hdf_start[i] / chunk_dims[i];
+    last[i] = (hdf_start[i] + hdf_count[i] - 1) / chunk_dims[i];
+    grid[i] = first[i];
+  }
+
+  MI_CHECK_HDF_CALL_RET(dcpl_id = H5Dget_create_plist(dset_id),"H5Dget_create_plist");
+  micodec_get_pipeline(dcpl_id, &reader.pipeline);
+  H5Pclose(dcpl_id);
+
+  /* Enough queued chunks to keep every worker busy while the next ones
+   * are being read.
+   */
+  if (michunk_queue_init(&reader.queue, volume->io_threads * 4) < 0) {
+    return (MI_ERROR);
+  }
+
+  started = michunk_start(threads, volume->io_threads, michunk_decoder, &reader);
+  if (started == 0) {
+    result = MI_LOG_ERROR(MI2_MSG_GENERIC, "Unable to start I/O threads");
+  }
+
+  /* Walk the grid of chunks intersecting the hyperslab. */
+  while (result == MI_NOERROR) {
+    michunk_job_t job;
+    hsize_t size = 0;
+
+    for (i = 0; i < ndims; i++) {
+      job.offset[i] = grid[i] * chunk_dims[i];
+    }
+
+    H5E_BEGIN_TRY {
+      if (H5Dget_chunk_storage_size(dset_id, job.offset, &size) < 0) {
+        size = 0;
+      }
+    } H5E_END_TRY;
+
+    if (size == 0) {
+      /* Never written, so it holds the fill value. */
+      result = mirw_chunk_part(&reader.slab, FALSE, dset_id, type_id, job.offset);
+    } else {
+      job.size = (size_t) size;
+      job.data = (unsigned char *) malloc(job.size);
+      if (job.data == NULL) {
+        result = MI_LOG_ERROR(MI2_MSG_OUTOFMEM, job.size);
+      } else if (H5Dread_chunk(dset_id, H5P_DEFAULT, job.offset,
+                               &job.filter_mask, job.data) < 0) {
+        free(job.data);
+        result = MI_LOG_ERROR(MI2_MSG_HDF5, "H5Dread_chunk");
+      } else if (michunk_push(&reader.queue, &job) < 0) {
+        free(job.data);
+        result = MI_ERROR;
+      }
+    }
+
+    if (!michunk_next(ndims, grid, first, last)) {
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&reader.queue.lock);
+  reader.queue.finished = TRUE;
+  pthread_cond_broadcast(&reader.queue.not_empty);
+  pthread_mutex_unlock(&reader.queue.lock);
+
+  for (i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  /* Chunks left over mean the workers gave up early. */
+  if ((reader.queue.error || reader.queue.queued > 0) && result == MI_NOERROR) {
+    result = MI_LOG_ERROR(MI2_MSG_GENERIC, "Unable to decode chunk");
+  }
+  michunk_queue_free(&reader.queue);
+  return (result);
+#else
+  return (MI_LOG_ERROR(MI2_MSG_GENERIC, "Parallel chunk I/O is not available"));
+#endif
+}
+
+/** "semiprivate" function writing the hyperslab \a hdf_start,
+ * \a hdf_count of \a dset_id, in file order, with the chunks encoded
+ * in parallel.  Only valid when miuse_parallel_chunks() has returned
+ * TRUE for the same dataset and type.
+ */
+int miwrite_parallel_chunks(mihandle_t volume, hid_t dset_id, hid_t type_id,
+                            int ndims, const hsize_t chunk_dims[],
+                            const hsize_t hdf_start[],
+                            const hsize_t hdf_count[], const void *buffer)
+{
+#ifdef MI2_PARALLEL_CHUNKS
+  michunk_writer_t writer;
+  pthread_t threads[MI2_MAX_IO_THREADS];
+  hsize_t first[MI2_MAX_VAR_DIMS];
+  hsize_t last[MI2_MAX_VAR_DIMS];
+  hsize_t grid[MI2_MAX_VAR_DIMS];
+  michunk_job_t job;
+  size_t n_grid = 1;
+  hid_t dcpl_id;
+  int started;
+  int result = MI_NOERROR;
+  int i;
+
+  if (!michunk_slab_init(&writer.slab, dset_id, type_id, ndims, chunk_dims,
+                         hdf_start, hdf_count, (void *) buffer)) {
+    return (MI_NOERROR);
+  }
+  for (i = 0; i < ndims; i++) {
+    first[i] = hdf_start[i] / chunk_dims[i];
+    last[i] = (hdf_start[i] + hdf_count[i] - 1) / chunk_dims[i];
+    grid[i] = first[i];
+    n_grid *= last[i] - first[i] + 1;
+  }
+
+  /* Use the filters of the dataset with its own settings. */
+  MI_CHECK_HDF_CALL_RET(dcpl_id = H5Dget_create_plist(dset_id),"H5Dget_create_plist");
+  micodec_get_pipeline(dcpl_id, &writer.pipeline);
+  H5Pclose(dcpl_id);
+
+  writer.offsets = (hsize_t *) malloc(n_grid * ndims * sizeof(hsize_t));
+  if (writer.offsets == NULL) {
+    return (MI_LOG_ERROR(MI2_MSG_OUTOFMEM, n_grid * ndims * sizeof(hsize_t)));
+  }
+
+  /* Chunks which the hyperslab covers only in part must be merged with
+   * what is already stored, so HDF5 handles those.  The others are left
+   * to the workers.
+   */
+  writer.n_chunks = 0;
+  writer.next = 0;
+  do {
+    int whole = TRUE;
+
+    for (i = 0; i < ndims; i++) {
+      hsize_t c_end = (grid[i] + 1) * chunk_dims[i];
+
+      job.offset[i] = grid[i] * chunk_dims[i];
+      if (c_end > writer.slab.dims[i]) {
+        c_end = writer.slab.dims[i];
+      }
+      if (job.offset[i] < hdf_start[i] || c_end > hdf_start[i] + hdf_count[i]) {
+        whole = FALSE;
+      }
+    }
+    if (whole) {
+      memcpy(&writer.offsets[writer.n_chunks * ndims], job.offset,
+             ndims * sizeof(hsize_t));
+      writer.n_chunks++;
+    } else if (mirw_chunk_part(&writer.slab, TRUE, dset_id, type_id,
+                               job.offset) < 0) {
+      result = MI_ERROR;
+    }
+  } while (result == MI_NOERROR && michunk_next(ndims, grid, first, last));
+
+  if (result < 0 || writer.n_chunks == 0) {
+    free(writer.offsets);
+    return (result);
+  }
+
+  if (michunk_queue_init(&writer.queue, volume->io_threads * 4) < 0) {
+    free(writer.offsets);
+    return (MI_ERROR);
+  }
+  writer.active = volume->io_threads;
+
+  started = michunk_start(threads, volume->io_threads, michunk_encoder, &writer);
+  pthread_mutex_lock(&writer.queue.lock);
+  writer.active -= volume->io_threads - started;
+  if (writer.active == 0) {
+    writer.queue.finished = TRUE;
+  }
+  pthread_mutex_unlock(&writer.queue.lock);
+  if (started == 0) {
+    result = MI_LOG_ERROR(MI2_MSG_GENERIC, "Unable to start I/O threads");
+  }
+
+  /* Store the chunks as they come out of the workers. */
+  while (michunk_pop(&writer.queue, &job)) {
+    if (result == MI_NOERROR &&
+        H5Dwrite_chunk(dset_id, H5P_DEFAULT, job.filter_mask, job.offset,
+                       job.size, job.data) < 0) {
+      result = MI_LOG_ERROR(MI2_MSG_HDF5, "H5Dwrite_chunk");
+      michunk_fail(&writer.queue);
+    }
+    free(job.data);
+  }
+
+  for (i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  if (writer.queue.error && result == MI_NOERROR) {
+    result = MI_LOG_ERROR(MI2_MSG_GENERIC, "Unable to encode chunk");
+  }
+  michunk_queue_free(&writer.queue);
+  free(writer.offsets);
+  return (result);
+#else
+  return (MI_LOG_ERROR(MI2_MSG_GENERIC, "Parallel chunk I/O is not available"));
+#endif
+}
+
+// kate: indent-mode cstyle; indent-width 2; replace-tabs on;
@@ -0,0 +1,952 @@
+/** \file codec.c
+ * \brief MINC 2.0 compression codecs
+ *
+ * Each micompression_t value names a codec, a chain of HDF5 filters
+ * applied to the chunks of the image dataset.  Besides zlib, the codecs
+ * may byte-shuffle the voxels first (the HDF5 shuffle filter) and may
+ * compress with LZ4, which decompresses several times faster than zlib.
+ *
+ * LZ4 is built into libminc and registered with HDF5 as filter 32004,
+ * the identifier registered with The HDF Group for LZ4, using the same
+ * stored format as the reference HDF5 LZ4 plugin so that other tools
+ * with that plugin can read the files.
+ *
+ * Label volumes, which are mostly background, may instead be stored as
+ * runs of equal voxels by the run-length filter, also built into libminc.
+ *
+ * The codecs also encode and decode whole chunks outside of HDF5, for
+ * the parallel chunk I/O in chunk.c.
+ ************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <hdf5.h>
+#include <zlib.h>
+#include "minc2.h"
+#include "minc2_private.h"
+
+/** \internal
+ * A codec: an optional byte shuffle followed by a compression filter.
+ */
+typedef struct {
+  micompression_t compression_type;
+  int shuffle;                  /* Byte shuffle before compressing */
+  H5Z_filter_t filter_id;       /* Compression filter */
+} micodec_t;
+
+static const micodec_t micodecs[] = {
+  { MI_COMPRESS_NONE,         FALSE, H5Z_FILTER_NONE },
+  { MI_COMPRESS_ZLIB,         FALSE, H5Z_FILTER_DEFLATE },
+  { MI_COMPRESS_SHUFFLE_ZLIB, TRUE,  H5Z_FILTER_DEFLATE },
+  { MI_COMPRESS_LZ4,          FALSE, MI2_H5Z_FILTER_LZ4 },
+  { MI_COMPRESS_SHUFFLE_LZ4,  TRUE,  MI2_H5Z_FILTER_LZ4 },
+  { MI_COMPRESS_RLE,          FALSE, MI2_H5Z_FILTER_RLE }
+};
+
+#define MI2_N_CODECS (sizeof(micodecs) / sizeof(micodecs[0]))
+
+static const micodec_t *micodec_find(micompression_t compression_type)
+{
+  size_t i;
+
+  for (i = 0; i < MI2_N_CODECS; i++) {
+    if (micodecs[i].compression_type == compression_type) {
+      return (&micodecs[i]);
+    }
+  }
+  return (NULL);
+}
+
+/* LZ4 block format.
+ */
+#define MI2_LZ4_HASH_LOG      13
+#define MI2_LZ4_MIN_MATCH     4
+#define MI2_LZ4_MFLIMIT       12  /* No match may start closer to the end */
+#define MI2_LZ4_LAST_LITERALS 5   /* The last bytes are always literals */
+#define MI2_LZ4_MAX_OFFSET    65535
+#define MI2_LZ4_HEADER        12  /* Original size and block size */
+
+static uint32_t milz4_read32(const unsigned char *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static unsigned int milz4_hash(uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - MI2_LZ4_HASH_LOG);
+}
+
+static unsigned char *milz4_put_length(unsigned char *op, size_t length)
+{
+  while (length >= 255) {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = (unsigned char) length;
+  return op;
+}
+
+/** Emits one sequence of \a n_literals literals, followed by a match of
+ * \a match_length bytes at \a offset unless \a match_length is 0.
+ * Returns NULL if it does not fit before \a oend.
+ */
+static unsigned char *milz4_put_sequence(unsigned char *op,
+                                         const unsigned char *oend,
+                                         const unsigned char *literals,
+                                         size_t n_literals, size_t offset,
+                                         size_t match_length)
+{
+  unsigned char *token;
+
+  if ((size_t)(oend - op) < 1 + n_literals / 255 + 1 + n_literals +
+      2 + match_length / 255 + 1) {
+    return (NULL);
+  }
+  token = op++;
+  if (n_literals >= 15) {
+    *token = 15 << 4;
+    op = milz4_put_length(op, n_literals - 15);
+  } else {
+    *token = (unsigned char)(n_literals << 4);
+  }
+  memcpy(op, literals, n_literals);
+  op += n_literals;
+
+  if (match_length != 0) {
+    size_t code = match_length - MI2_LZ4_MIN_MATCH;
+
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    if (code >= 15) {
+      *token |= 15;
+      op = milz4_put_length(op, code - 15);
+    } else {
+      *token |= (unsigned char) code;
+    }
+  }
+  return (op);
+}
+
+/** Compresses \a n bytes into an LZ4 block of at most \a capacity
+ * bytes.  Returns the size of the block, or 0 if it does not fit.
+ */
+static size_t milz4_compress_block(const unsigned char *src, size_t n,
+                                   unsigned char *dst, size_t capacity)
+{
+  uint32_t table[1 << MI2_LZ4_HASH_LOG]; /* Position + 1, 0 if empty */
+  const unsigned char *oend = dst + capacity;
+  unsigned char *op = dst;
+  size_t anchor = 0;
+  size_t ip = 0;
+
+  memset(table, 0, sizeof(table));
+
+  if (n > MI2_LZ4_MFLIMIT) {
+    size_t limit = n - MI2_LZ4_MFLIMIT;
+    size_t match_limit = n - MI2_LZ4_LAST_LITERALS;
+
+    while (ip <= limit) {
+      uint32_t sequence = milz4_read32(src + ip);
+      unsigned int h = milz4_hash(sequence);
+      size_t ref = table[h];
+
+      table[h] = (uint32_t)(ip + 1);
+      if (ref != 0 && ip - (ref - 1) <= MI2_LZ4_MAX_OFFSET &&
+          milz4_read32(src + ref - 1) == sequence) {
+        size_t match = ref - 1;
+        size_t length = MI2_LZ4_MIN_MATCH;
+
+        while (ip + length < match_limit && src[match + length] == src[ip + length]) {
+          length++;
+        }
+        op = milz4_put_sequence(op, oend, src + anchor, ip - anchor,
+                                ip - match, length);
+        if (op == NULL) {
+          return (0);
+        }
+        ip += length;
+        anchor = ip;
+      } else {
+        /* Skip faster through data which does not compress. */
+        ip += 1 + ((ip - anchor) >> 6);
+      }
+    }
+  }
+
+  op = milz4_put_sequence(op, oend, src + anchor, n - anchor, 0, 0);
+  return (op == NULL ? 0 : (size_t)(op - dst));
+}
+
+/** Decompresses an LZ4 block of \a n bytes which must expand to exactly
+ * \a out_n bytes.
+ */
+static int milz4_decompress_block(const unsigned char *src, size_t n,
+                                  unsigned char *dst, size_t out_n)
+{
+  const unsigned char *ip = src;
+  const unsigned char *iend = src + n;
+  unsigned char *op = dst;
+  unsigned char *oend = dst + out_n;
+
+  while (ip < iend) {
+    unsigned int token = *ip++;
+    size_t length = token >> 4;
+    size_t offset;
+    unsigned char *match;
+
+    if (length == 15) {
+      unsigned int b;
+      do {
+        if (ip >= iend) {
+          return (MI_ERROR);
+        }
+        b = *ip++;
+        length += b;
+      } while (b == 255);
+    }
+    if (length > (size_t)(iend - ip) || length > (size_t)(oend - op)) {
+      return (MI_ERROR);
+    }
+    memcpy(op, ip, length);
+    ip += length;
+    op += length;
+    if (ip == iend) {
+      break;                    /* The last sequence has no match. */
+    }
+
+    if (iend - ip < 2) {
+      return (MI_ERROR);
+    }
+    offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > (size_t)(op - dst)) {
+      return (MI_ERROR);
+    }
+    length = token & 15;
+    if (length == 15) {
+      unsigned int b;
+      do {
+        if (ip >= iend) {
+          return (MI_ERROR);
+        }
+        b = *ip++;
+        length += b;
+      } while (b == 255);
+    }
+    length += MI2_LZ4_MIN_MATCH;
+    if (length > (size_t)(oend - op)) {
+      return (MI_ERROR);
+    }
+    /* An overlapping match repeats its first offset bytes; copy them
+     * in doubling runs rather than byte by byte.
+     */
+    match = op - offset;
+    while (length > 0) {
+      size_t n = (size_t)(op - match);
+
+      if (n > length) {
+        n = length;
+      }
+      memcpy(op, match, n);
+      op += n;
+      length -= n;
+    }
+  }
+  return (op == oend ? MI_NOERROR : MI_ERROR);
+}
+
+static void milz4_put_be(unsigned char *p, unsigned long long v, int n)
+{
+  int i;
+
+  for (i = n - 1; i >= 0; i--) {
+    p[i] = (unsigned char)(v & 0xff);
+    v >>= 8;
+  }
+}
+
+static unsigned long long milz4_get_be(const unsigned char *p, int n)
+{
+  unsigned long long v = 0;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    v = (v << 8) | p[i];
+  }
+  return (v);
+}
+
+/** Largest size of the stored form of \a n bytes.
+ */
+static size_t milz4_bound(size_t n, size_t block_size)
+{
+  size_t n_blocks = (n == 0) ? 0 : (n - 1) / block_size + 1;
+
+  return (MI2_LZ4_HEADER + n_blocks * 4 + n);
+}
+
+/** Encodes \a n bytes as the LZ4 filter stores them: the original size
+ * and the block size, then each block preceded by its size.  A block
+ * which does not compress is stored as is.  Returns the stored size.
+ */
+static size_t milz4_encode(const unsigned char *src, size_t n,
+                           size_t block_size, unsigned char *dst)
+{
+  unsigned char *op = dst + MI2_LZ4_HEADER;
+  size_t done = 0;
+
+  if (block_size == 0 || block_size > n) {
+    block_size = n;
+  }
+  milz4_put_be(dst, n, 8);
+  milz4_put_be(dst + 8, block_size, 4);
+
+  while (done < n) {
+    size_t length = (n - done < block_size) ? n - done : block_size;
+    size_t packed = milz4_compress_block(src + done, length, op + 4, length - 1);
+
+    if (packed == 0) {
+      milz4_put_be(op, length, 4);
+      memcpy(op + 4, src + done, length);
+      packed = length;
+    } else {
+      milz4_put_be(op, packed, 4);
+    }
+    op += 4 + packed;
+    done += length;
+  }
+  return ((size_t)(op - dst));
+}
+
+/** Decodes the stored form of \a n bytes, which must expand to exactly
+ * \a out_n bytes.
+ */
+static int milz4_decode(const unsigned char *src, size_t n,
+                        unsigned char *dst, size_t out_n)
+{
+  const unsigned char *ip = src + MI2_LZ4_HEADER;
+  const unsigned char *iend = src + n;
+  size_t block_size;
+  size_t done = 0;
+
+  if (n < MI2_LZ4_HEADER || milz4_get_be(src, 8) != out_n) {
+    return (MI_ERROR);
+  }
+  block_size = (size_t) milz4_get_be(src + 8, 4);
+
+  while (done < out_n) {
+    size_t length = (out_n - done < block_size) ? out_n - done : block_size;
+    size_t packed;
+
+    if (iend - ip < 4) {
+      return (MI_ERROR);
+    }
+    packed = (size_t) milz4_get_be(ip, 4);
+    ip += 4;
+    if (packed > (size_t)(iend - ip)) {
+      return (MI_ERROR);
+    }
+    if (packed == length) {
+      memcpy(dst + done, ip, length);
+    } else if (milz4_decompress_block(ip, packed, dst + done, length) < 0) {
+      return (MI_ERROR);
+    }
+    ip += packed;
+    done += length;
+  }
+  return (MI_NOERROR);
+}
+
+/** HDF5 filter callback for LZ4.  The optional client value is the
+ * block size; without it each chunk is a single block.
+ */
+static size_t miH5Z_filter_lz4(unsigned int flags, size_t cd_nelmts,
+                               const unsigned int cd_values[], size_t nbytes,
+                               size_t *buf_size, void **buf)
+{
+  const unsigned char *src = (const unsigned char *) *buf;
+  unsigned char *out;
+  size_t out_size;
+
+  if (flags & H5Z_FLAG_REVERSE) {
+    if (nbytes < MI2_LZ4_HEADER) {
+      return (0);
+    }
+    out_size = (size_t) milz4_get_be(src, 8);
+    out = (unsigned char *) H5allocate_memory(out_size, FALSE);
+    if (out == NULL) {
+      return (0);
+    }
+    if (milz4_decode(src, nbytes, out, out_size) < 0) {
+      H5free_memory(out);
+      return (0);
+    }
+  } else {
+    size_t block_size = (cd_nelmts > 0) ? cd_values[0] : 0;
+
+    out = (unsigned char *) H5allocate_memory(milz4_bound(nbytes, block_size ? block_size : nbytes), FALSE);
+    if (out == NULL) {
+      return (0);
+    }
+    out_size = milz4_encode(src, nbytes, block_size, out);
+  }
+
+  H5free_memory(*buf);
+  *buf = out;
+  *buf_size = out_size;
+  return (out_size);
+}
+
+/* Run-length format: the original size, then each run as its length, in
+ * 7 bit groups with the high bit set on all but the last one, followed
+ * by the element repeated.  Bytes past the last whole element are stored
+ * as they are.
+ */
+#define MI2_RLE_HEADER 8
+
+/** Largest size of the run-length form of \a n bytes.
+ */
+static size_t mirle_bound(size_t n, size_t el_size)
+{
+  return (MI2_RLE_HEADER + n + ((el_size > 0) ? n / el_size : n));
+}
+
+/** Encodes \a n bytes of elements of \a el_size bytes as runs.  Returns
+ * the stored size.
+ */
+static size_t mirle_encode(const unsigned char *src, size_t n,
+                           size_t el_size, unsigned char *dst)
+{
+  size_t n_elements;
+  unsigned char *op = dst + MI2_RLE_HEADER;
+  size_t i = 0;
+
+  if (el_size == 0) {
+    el_size = 1;
+  }
+  n_elements = n / el_size;
+  milz4_put_be(dst, n, 8);
+
+  while (i < n_elements) {
+    const unsigned char *element = src + i * el_size;
+    size_t run = 1;
+
+    while (i + run < n_elements &&
+           memcmp(element, element + run * el_size, el_size) == 0) {
+      run++;
+    }
+    i += run;
+    while (run >= 0x80) {
+      *op++ = (unsigned char) (run | 0x80);
+      run >>= 7;
+    }
+    *op++ = (unsigned char) run;
+    memcpy(op, element, el_size);
+    op += el_size;
+  }
+  memcpy(op, src + n_elements * el_size, n - n_elements * el_size);
+  op += n - n_elements * el_size;
+  return ((size_t) (op - dst));
+}
+
+/** Decodes the run-length form of \a n bytes, which must expand to
+ * exactly \a out_n bytes.
+ */
+static int mirle_decode(const unsigned char *src, size_t n, size_t el_size,
+                        unsigned char *dst, size_t out_n)
+{
+  const unsigned char *ip = src + MI2_RLE_HEADER;
+  const unsigned char *iend = src + n;
+  unsigned char *op = dst;
+  unsigned char *oend;
+  size_t leftover;
+
+  if (el_size == 0) {
+    el_size = 1;
+  }
+  if (n < MI2_RLE_HEADER || milz4_get_be(src, 8) != out_n) {
+    return (MI_ERROR);
+  }
+  leftover = out_n % el_size;
+  oend = dst + out_n - leftover;
+
+  while (op < oend) {
+    size_t run = 0;
+    int shift = 0;
+    unsigned int b;
+
+    do {
+      if (ip >= iend || shift > (int) (sizeof(size_t) * 8 - 7)) {
+        return (MI_ERROR);
+      }
+      b = *ip++;
+      run |= (size_t) (b & 0x7f) << shift;
+      shift += 7;
+    } while (b & 0x80);
+    if (run == 0 || (size_t) (iend - ip) < el_size ||
+        run > (size_t) (oend - op) / el_size) {
+      return (MI_ERROR);
+    }
+    if (el_size == 1) {
+      memset(op, *ip, run);
+      op += run;
+    } else {
+      /* Copy the element in doubling runs, as for an LZ4 match. */
+      size_t length = run * el_size;
+      size_t done = el_size;
+
+      memcpy(op, ip, el_size);
+      while (done < length) {
+        size_t m = (done < length - done) ? done : length - done;
+        memcpy(op + done, op, m);
+        done += m;
+      }
+      op += length;
+    }
+    ip += el_size;
+  }
+  if ((size_t) (iend - ip) != leftover) {
+    return (MI_ERROR);
+  }
+  memcpy(op, ip, leftover);
+  return (MI_NOERROR);
+}
+
+/** HDF5 filter callback for the run-length filter.  The client values
+ * are the size of the elements and the size of a chunk, set from the
+ * dataset when it is created.  A stored chunk claiming to expand past
+ * the chunk size is rejected before anything is allocated for it.
+ * Chunks which do not get smaller are left to HDF5 to store as they are.
+ */
+static size_t miH5Z_filter_rle(unsigned int flags, size_t cd_nelmts,
+                               const unsigned int cd_values[], size_t nbytes,
+                               size_t *buf_size, void **buf)
+{
+  const unsigned char *src = (const unsigned char *) *buf;
+  size_t el_size = (cd_nelmts > 0) ? cd_values[0] : 1;
+  unsigned char *out;
+  size_t out_size;
+
+  if (flags & H5Z_FLAG_REVERSE) {
+    if (nbytes < MI2_RLE_HEADER) {
+      return (0);
+    }
+    out_size = (size_t) milz4_get_be(src, 8);
+    /* HDF5 chunks are under 4 GiB, whatever the client values. */
+    if (out_size > ((cd_nelmts > 1) ? cd_values[1] : 0xffffffffU)) {
+      return (0);
+    }
+    out = (unsigned char *) H5allocate_memory(out_size, FALSE);
+    if (out == NULL) {
+      return (0);
+    }
+    if (mirle_decode(src, nbytes, el_size, out, out_size) < 0) {
+      H5free_memory(out);
+      return (0);
+    }
+  } else {
+    out = (unsigned char *) H5allocate_memory(mirle_bound(nbytes, el_size), FALSE);
+    if (out == NULL) {
+      return (0);
+    }
+    out_size = mirle_encode(src, nbytes, el_size, out);
+    if (out_size >= nbytes) {
+      H5free_memory(out);
+      return (0);
+    }
+  }
+
+  H5free_memory(*buf);
+  *buf = out;
+  *buf_size = out_size;
+  return (out_size);
+}
+
+/** HDF5 callback setting the element size and the chunk size of the
+ * run-length filter from the type and the chunking of the dataset being
+ * created.
+ */
+static herr_t miH5Z_set_local_rle(hid_t dcpl_id, hid_t type_id, hid_t space_id)
+{
+  unsigned int flags;
+  unsigned int values[2];
+  size_t cd_nelmts = 0;
+  hsize_t dims[MI2_MAX_VAR_DIMS];
+  hsize_t chunk_bytes;
+  int ndims;
+  int i;
+
+  values[0] = (unsigned int) H5Tget_size(type_id);
+  ndims = H5Pget_chunk(dcpl_id, MI2_MAX_VAR_DIMS, dims);
+  if (H5Pget_filter_by_id2(dcpl_id, MI2_H5Z_FILTER_RLE, &flags, &cd_nelmts,
+                           NULL, 0, NULL, NULL) < 0 || ndims <= 0) {
+    return (-1);
+  }
+  chunk_bytes = values[0];
+  for (i = 0; i < ndims; i++) {
+    chunk_bytes *= dims[i];
+  }
+  if (chunk_bytes > 0xffffffffU) {
+    return (-1);
+  }
+  values[1] = (unsigned int) chunk_bytes;
+  return (H5Pmodify_filter(dcpl_id, MI2_H5Z_FILTER_RLE, flags, 2, values));
+}
+
+/** Shuffles (or with \a reverse, unshuffles) the bytes of \a n bytes of
+ * elements of \a el_size bytes, exactly as the HDF5 shuffle filter.
+ */
+static void mishuffle(const unsigned char *src, unsigned char *dst,
+                      size_t n, size_t el_size, int reverse)
+{
+  size_t n_elements = (el_size > 0) ? n / el_size : 0;
+  size_t leftover;
+  size_t i, j;
+
+  if (el_size <= 1 || n_elements <= 1) {
+    memcpy(dst, src, n);
+    return;
+  }
+  for (i = 0; i < el_size; i++) {
+    for (j = 0; j < n_elements; j++) {
+      if (reverse) {
+        dst[j * el_size + i] = src[i * n_elements + j];
+      } else {
+        dst[i * n_elements + j] = src[j * el_size + i];
+      }
+    }
+  }
+  leftover = n % el_size;
+  memcpy(dst + n - leftover, src + n - leftover, leftover);
+}
+
+/** "semiprivate" function registering the codec filters built into
+ * libminc with HDF5.
+ */
+void micodec_init(void)
+{
+  static const H5Z_class2_t lz4_class = {
+    H5Z_CLASS_T_VERS,
+    (H5Z_filter_t) MI2_H5Z_FILTER_LZ4,
+    1, 1,
+    "lz4",
+    NULL,
+    NULL,
+    (H5Z_func_t) miH5Z_filter_lz4
+  };
+  static const H5Z_class2_t rle_class = {
+    H5Z_CLASS_T_VERS,
+    (H5Z_filter_t) MI2_H5Z_FILTER_RLE,
+    1, 1,
+    "minc-rle",
+    NULL,
+    (H5Z_set_local_func_t) miH5Z_set_local_rle,
+    (H5Z_func_t) miH5Z_filter_rle
+  };
+  htri_t available = FALSE;
+
+  /* An LZ4 plugin already loaded by HDF5 reads the same format. */
+  H5E_BEGIN_TRY {
+    available = H5Zfilter_avail(MI2_H5Z_FILTER_LZ4);
+  } H5E_END_TRY;
+  if (available <= 0) {
+    MI_CHECK_HDF_CALL(H5Zregister(&lz4_class),"H5Zregister");
+  }
+  H5E_BEGIN_TRY {
+    available = H5Zfilter_avail(MI2_H5Z_FILTER_RLE);
+  } H5E_END_TRY;
+  if (available <= 0) {
+    MI_CHECK_HDF_CALL(H5Zregister(&rle_class),"H5Zregister");
+  }
+}
+
+/** "semiprivate" function returning TRUE if \a compression_type names a
+ * known codec.
+ */
+int micodec_supported(micompression_t compression_type)
+{
+  return (micodec_find(compression_type) != NULL);
+}
+
+/** "semiprivate" function adding the filters of a codec to the dataset
+ * creation property list \a dcpl_id.
+ */
+int micodec_set_filters(hid_t dcpl_id, micompression_t compression_type,
+                        int zlib_level)
+{
+  const micodec_t *codec = micodec_find(compression_type);
+  herr_t stat = 0;
+
+  if (codec == NULL) {
+    return (MI_LOG_ERROR(MI2_MSG_BADTYPE, compression_type));
+  }
+  if (codec->shuffle) {
+    MI_CHECK_HDF_CALL_RET(stat = H5Pset_shuffle(dcpl_id),"H5Pset_shuffle")
+  }
+  switch (codec->filter_id) {
+  case H5Z_FILTER_DEFLATE:
+    MI_CHECK_HDF_CALL_RET(stat = H5Pset_deflate(dcpl_id, zlib_level),"H5Pset_deflate")
+    break;
+  case MI2_H5Z_FILTER_LZ4:
+    micodec_init();
+    MI_CHECK_HDF_CALL_RET(stat = H5Pset_filter(dcpl_id, MI2_H5Z_FILTER_LZ4,
+                                               H5Z_FLAG_OPTIONAL, 0, NULL),"H5Pset_filter")
+    break;
+  case MI2_H5Z_FILTER_RLE:
+    micodec_init();
+    MI_CHECK_HDF_CALL_RET(stat = H5Pset_filter(dcpl_id, MI2_H5Z_FILTER_RLE,
+                                               H5Z_FLAG_OPTIONAL, 0, NULL),"H5Pset_filter")
+    break;
+  default:
+    break;
+  }
+  return (MI_NOERROR);
+}
+
+/** "semiprivate" function identifying the codec used by the dataset
+ * creation property list \a dcpl_id.  Pipelines which are not one of the
+ * codecs are reported as zlib if they deflate, as no compression
+ * otherwise.
+ */
+micompression_t micodec_detect(hid_t dcpl_id, int *zlib_level)
+{
+  int nfilters = H5Pget_nfilters(dcpl_id);
+  int shuffle = FALSE;
+  H5Z_filter_t filter_id = H5Z_FILTER_NONE;
+  int deflate = FALSE;
+  size_t i;
+  int f;
+
+  *zlib_level = 0;
+  for (f = 0; f < nfilters; f++) {
+    unsigned int flags;
+    unsigned int cd_values[1] = { 0 };
+    size_t cd_nelmts = 1;
+    H5Z_filter_t id = H5Pget_filter2(dcpl_id, f, &flags, &cd_nelmts,
+                                     cd_values, 0, NULL, NULL);
+
+    switch (id) {
+    case H5Z_FILTER_SHUFFLE:
+      shuffle = (filter_id == H5Z_FILTER_NONE);
+      break;
+    case H5Z_FILTER_DEFLATE:
+      *zlib_level = cd_values[0];
+      deflate = TRUE;
+      /* fall through */
+    default:
+      filter_id = (filter_id == H5Z_FILTER_NONE) ? id : -1;
+      break;
+    }
+  }
+
+  for (i = 0; i < MI2_N_CODECS; i++) {
+    if (micodecs[i].filter_id == filter_id && micodecs[i].shuffle == shuffle) {
+      return (micodecs[i].compression_type);
+    }
+  }
+  return (deflate ? MI_COMPRESS_ZLIB : MI_COMPRESS_NONE);
+}
+
+/** "semiprivate" function checking that every filter used by the
+ * dataset creation property list \a dcpl_id can decode, so that a
+ * volume compressed with a codec this build lacks is reported by name
+ * when it is opened.  The header of such a volume remains readable.
+ */
+int micodec_check_filters(hid_t dcpl_id)
+{
+  int nfilters = H5Pget_nfilters(dcpl_id);
+  int f;
+
+  for (f = 0; f < nfilters; f++) {
+    unsigned int flags;
+    unsigned int config = 0;
+    size_t cd_nelmts = 0;
+    char name[64] = "";
+    H5Z_filter_t id = H5Pget_filter2(dcpl_id, f, &flags, &cd_nelmts, NULL,
+                                     sizeof(name), name, NULL);
+
+    if (id < 0 || H5Zfilter_avail(id) <= 0 ||
+        H5Zget_filter_info(id, &config) < 0 ||
+        !(config & H5Z_FILTER_CONFIG_DECODE_ENABLED)) {
+      return (MI_LOG_ERROR(MI2_MSG_NOFILTER, (int) id, name));
+    }
+  }
+  return (MI_NOERROR);
+}
+
+/** "semiprivate" function reading the filter pipeline of \a dcpl_id.
+ * Returns TRUE if the chunk codecs can apply all of its filters.
+ */
+int micodec_get_pipeline(hid_t dcpl_id, micodec_pipeline_t *pipeline)
+{
+  int nfilters = H5Pget_nfilters(dcpl_id);
+  int f;
+
+  if (nfilters < 0 || nfilters > MI2_MAX_CODEC_FILTERS) {
+    return (FALSE);
+  }
+  pipeline->nfilters = nfilters;
+  for (f = 0; f < nfilters; f++) {
+    unsigned int flags;
+    unsigned int cd_values[1] = { 0 };
+    size_t cd_nelmts = 1;
+    H5Z_filter_t id = H5Pget_filter2(dcpl_id, f, &flags, &cd_nelmts,
+                                     cd_values, 0, NULL, NULL);
+
+    if (id != H5Z_FILTER_SHUFFLE && id != H5Z_FILTER_DEFLATE &&
+        id != MI2_H5Z_FILTER_LZ4 && id != MI2_H5Z_FILTER_RLE) {
+      return (FALSE);
+    }
+    pipeline->filter_ids[f] = id;
+    pipeline->params[f] = (cd_nelmts > 0) ? cd_values[0] : 0;
+  }
+  return (TRUE);
+}
+
+/** "semiprivate" function applying the filters of \a pipeline to the
+ * \a nbytes of an uncompressed chunk.  On success \a data receives a
+ * newly allocated buffer with the \a size stored bytes, to be stored
+ * with an empty filter mask.
+ */
+int micodec_encode(const micodec_pipeline_t *pipeline,
+                   const unsigned char *chunk, size_t nbytes,
+                   unsigned char **data, size_t *size)
+{
+  const unsigned char *current = chunk;
+  unsigned char *owned = NULL;
+  size_t current_size = nbytes;
+  int f;
+
+  for (f = 0; f < pipeline->nfilters; f++) {
+    unsigned int param = pipeline->params[f];
+    unsigned char *out = NULL;
+    size_t out_size = 0;
+
+    switch (pipeline->filter_ids[f]) {
+    case H5Z_FILTER_SHUFFLE:
+      out_size = current_size;
+      if ((out = (unsigned char *) malloc(out_size)) != NULL) {
+        mishuffle(current, out, current_size, param, FALSE);
+      }
+      break;
+    case H5Z_FILTER_DEFLATE: {
+      uLongf length = compressBound(current_size);
+
+      if ((out = (unsigned char *) malloc(length)) != NULL &&
+          compress2(out, &length, current, current_size, param) != Z_OK) {
+        free(out);
+        out = NULL;
+      }
+      out_size = length;
+      break;
+    }
+    case MI2_H5Z_FILTER_LZ4:
+      if ((out = (unsigned char *) malloc(milz4_bound(current_size, param ? param : current_size))) != NULL) {
+        out_size = milz4_encode(current, current_size, param, out);
+      }
+      break;
+    case MI2_H5Z_FILTER_RLE:
+      if ((out = (unsigned char *) malloc(mirle_bound(current_size, param))) != NULL) {
+        out_size = mirle_encode(current, current_size, param, out);
+      }
+      break;
+    }
+    free(owned);
+    if (out == NULL) {
+      return (MI_ERROR);
+    }
+    owned = out;
+    current = out;
+    current_size = out_size;
+  }
+
+  if (owned == NULL) {
+    if ((owned = (unsigned char *) malloc(nbytes)) == NULL) {
+      return (MI_ERROR);
+    }
+    memcpy(owned, chunk, nbytes);
+  }
+  *data = owned;
+  *size = current_size;
+  return (MI_NOERROR);
+}
+
+/** "semiprivate" function reversing the filters of \a pipeline, except
+ * those flagged in \a filter_mask, on the \a size stored bytes of a
+ * chunk.  The \a nbytes of the uncompressed chunk are written to
+ * \a chunk; \a scratch must hold \a nbytes as well.
+ */
+int micodec_decode(const micodec_pipeline_t *pipeline, uint32_t filter_mask,
+                   const unsigned char *data, size_t size,
+                   unsigned char *chunk, unsigned char *scratch,
+                   size_t nbytes)
+{
+  const unsigned char *current = data;
+  size_t current_size = size;
+  int remaining = 0;
+  int f;
+
+  for (f = 0; f < pipeline->nfilters; f++) {
+    if (!(filter_mask & (1u << f))) {
+      remaining++;
+    }
+  }
+  if (remaining == 0) {
+    if (size < nbytes) {
+      return (MI_ERROR);
+    }
+    memcpy(chunk, data, nbytes);
+    return (MI_NOERROR);
+  }
+
+  for (f = pipeline->nfilters - 1; f >= 0; f--) {
+    unsigned char *out;
+
+    if (filter_mask & (1u << f)) {
+      continue;
+    }
+    /* Alternate buffers so that the last filter lands in the chunk. */
+    out = (--remaining % 2 == 0) ? chunk : scratch;
+
+    switch (pipeline->filter_ids[f]) {
+    case H5Z_FILTER_SHUFFLE:
+      if (current_size != nbytes) {
+        return (MI_ERROR);
+      }
+      mishuffle(current, out, nbytes, pipeline->params[f], TRUE);
+      break;
+    case H5Z_FILTER_DEFLATE: {
+      uLongf length = nbytes;
+
+      if (uncompress(out, &length, current, current_size) != Z_OK ||
+          length != nbytes) {
+        return (MI_ERROR);
+      }
+      break;
+    }
+    case MI2_H5Z_FILTER_LZ4:
+      if (milz4_decode(current, current_size, out, nbytes) < 0) {
+        return (MI_ERROR);
+      }
+      break;
+    case MI2_H5Z_FILTER_RLE:
+      if (mirle_decode(current, current_size, pipeline->params[f], out,
+                       nbytes) < 0) {
+        return (MI_ERROR);
+      }
+      break;
+    default:
+      return (MI_ERROR);
+    }
+    current = out;
+    current_size = nbytes;
+  }
+  return (MI_NOERROR);
+}
+
+// kate: indent-mode cstyle; indent-width 2; replace-tabs on;
@@ -47,6 +47,10 @@ int miconvert_real_to_voxel(mihandle_t volume,
     double voxel_range, voxel_offset;
     double real_range, real_offset;
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     /* get valid min/max, image min/max 
      */
     miget_volume_valid_range(volume, &valid_max, &valid_min);
@@ -98,6 +102,10 @@ int miconvert_voxel_to_real(mihandle_t volume,
     double voxel_range, voxel_offset;
     double real_range, real_offset;
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     /* get valid min/max, image min/max 
      */
     miget_volume_valid_range(volume, &valid_max, &valid_min);
@@ -172,6 +180,10 @@ int miconvert_voxel_to_world(mihandle_t volume,
 {
     double temp[MI2_3D];
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     mireorder_voxel_to_xyz(volume, voxel, temp, MI_DIMCLASS_SPATIAL);
     mitransform_coord(world, volume->v2w_transform, temp);
     return (MI_NOERROR);
@@ -194,6 +206,10 @@ int miconvert_world_to_voxel(mihandle_t volume,
     double temp[MI2_3D];
     int i;
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     for (i = 0; i < volume->number_of_dims; i++) {
         voxel[i] = 0.0;
     }
@@ -222,6 +238,10 @@ int miget_real_value(mihandle_t volume,
     double voxel;
     int result;
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     result = miget_voxel_value(volume, coords, ndims, &voxel);
     if (result != MI_NOERROR) {
         return (result);
@@ -248,6 +268,10 @@ int miset_real_value(mihandle_t volume,
 {
     double voxel;
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     if ((volume->mode & MI2_OPEN_RDWR) == 0) {
         //TODO: report that file is not open properly
         return (MI_ERROR);
@@ -420,6 +444,10 @@ int miset_world_origin(mihandle_t volume, /**< A volume handle */
     double starts[MI2_3D];
     int i;
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     convert_transform_origin_to_starts(volume, world, starts);
     for (i = 0; i < volume->number_of_dims; i++) {
         midimhandle_t hdim = volume->dim_handles[i];
@@ -450,6 +478,10 @@ int
 miset_spatial_frequency_origin(mihandle_t volume,
                                double world[3])
 {
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     if ((volume->mode & MI2_OPEN_RDWR) == 0) {
         return (MI_ERROR);
     }
@@ -473,6 +505,10 @@ int miget_voxel_value(mihandle_t volume,
     misize_t count[MI2_MAX_VAR_DIMS];
     int i;
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     for (i = 0; i < volume->number_of_dims; i++) {
         count[i] = 1;
     }
@@ -496,6 +532,10 @@ int miset_voxel_value(mihandle_t volume,
     misize_t count[MI2_MAX_VAR_DIMS];
     int i;
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
     if ((volume->mode & MI2_OPEN_RDWR) == 0) {
         return (MI_ERROR);
     }
@@ -517,6 +557,29 @@ int miget_volume_real_range(mihandle_t volume, double real_range[])
     double *buffer;
     int i;
 
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
+
+    /* The ranges of slice scaled volumes are cached. */
+    if (volume->has_slice_scaling && miload_slice_ranges(volume) == MI_NOERROR) {
+        n = 1;
+        for (i = 0; i < volume->range_rank; i++) {
+            n *= (int) volume->range_dims[i];
+        }
+        real_range[0] = FLT_MAX;
+        real_range[1] = FLT_MIN;
+        for (i = 0; i < n; i++) {
+            if (volume->range_min[i] < real_range[0]) {
+                real_range[0] = volume->range_min[i];
+            }
+            if (volume->range_max[i] > real_range[1]) {
+                real_range[1] = volume->range_max[i];
+            }
+        }
+        return (MI_NOERROR);
+    }
+
     /* First find the real minimum.
      */
     spc_id = H5Dget_space(volume->imin_id);
@@ -11,6 +11,9 @@
  */
 int miget_data_class ( mihandle_t volume, miclass_t *volume_class )
 {
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
   *volume_class = volume->volume_class;
   return ( MI_NOERROR );
 }
@@ -19,6 +22,9 @@ int miget_data_class ( mihandle_t volume, miclass_t *volume_class )
  */
 int miget_data_type ( mihandle_t volume, mitype_t *data_type )
 {
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
   *data_type = volume->volume_type;
   return ( MI_NOERROR );
 }
@@ -388,6 +388,9 @@ int miget_volume_dimensions ( mihandle_t volume, midimclass_t class, midimattr_t
   if ( volume == NULL ) {
     return ( MI_ERROR );
   }
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
 
   /* make sure the user has set the apparernt order before
    *  calling this function with MI_DIMORDER_APPARENT
@@ -452,6 +455,9 @@ int miset_apparent_dimension_order ( mihandle_t volume, int array_length,
   if ( volume == NULL || array_length <= 0 ) {
     return ( MI_ERROR );
   }
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
 
   /* If array_length was more than the number of dimensions
     the rest of the given dimensions will be ignored.
@@ -526,6 +532,9 @@ int miset_apparent_dimension_order_by_name ( mihandle_t volume, int array_length
   if ( volume == NULL ) {
     return ( MI_ERROR );
   }
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
 
   if ( names == NULL || array_length <= 0 ) {
     /* Reset the dimension ordering */
@@ -617,6 +626,9 @@ int miset_apparent_record_dimension_flag ( mihandle_t volume, int record_flag )
   if ( volume == NULL ) {
     return ( MI_ERROR );
   }
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
 
   /* Allocate space for the dimension
    */
@@ -6,6 +6,9 @@
  * Functions to manipulate attributes and groups.
  ************************************************************************/
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <hdf5.h>
 
 #ifdef HAVE_CONFIG_H
@@ -669,91 +672,17 @@ cleanup:
  */
 int micopy_attr ( mihandle_t vol, const char *path, mihandle_t new_vol )
 {
-  milisthandle_t hlist = NULL;
-  mitype_t data_type = MI_TYPE_UNKNOWN;
-  char namebuf[256];
-  char pathbuf[256];
-  char valstr[128];
-  int r;
-  size_t length;
-
-  /*TODO: make sure path size does not exceed 256 somehow*/
-  r = milist_start ( vol, path, 1, &hlist );
-
-  if ( r == MI_NOERROR ) {
-    while ( milist_attr_next ( vol, hlist, pathbuf, sizeof ( pathbuf ),
-                               namebuf, sizeof ( namebuf ) ) == MI_NOERROR ) {
-      /*TODO: Add error checking here*/
-      miget_attr_type ( vol, pathbuf, namebuf, &data_type );
-      miget_attr_length ( vol, pathbuf, namebuf, &length );
-    
-      switch ( data_type ) {
-
-      case MI_TYPE_STRING:
-        if(length<sizeof(valstr))
-        {
-          miget_attr_values ( vol, MI_TYPE_STRING, pathbuf, namebuf, length, valstr );
-          miset_attr_values ( new_vol, MI_TYPE_STRING, pathbuf, namebuf, length, valstr );
-        } else {
-          char *tmp_str=malloc(length+1); /*make sure we have space for terminating zero*/
-          miget_attr_values ( vol, MI_TYPE_STRING, pathbuf, namebuf, length+1, tmp_str );
-          miset_attr_values ( new_vol, MI_TYPE_STRING, pathbuf, namebuf, length+1, tmp_str );
-          free(tmp_str);
-        }
-        break;
-
-      case MI_TYPE_FLOAT:
-        if(length==1)
-        {
-          float valflt;
-          miget_attr_values ( vol, MI_TYPE_FLOAT, pathbuf, namebuf, 1, &valflt );
-          miset_attr_values ( new_vol, MI_TYPE_FLOAT, pathbuf, namebuf, 1, &valflt );
-        } else {
-          float *tmp=malloc(length*sizeof(float));
-          miget_attr_values ( vol, MI_TYPE_FLOAT, pathbuf, namebuf, length, tmp );
-          miset_attr_values ( new_vol, MI_TYPE_FLOAT, pathbuf, namebuf, length, tmp );
-          free(tmp);
-        }
-        break;
-        
-      case MI_TYPE_DOUBLE:
-        if(length==1)
-        {
-          float valdbl;
-          miget_attr_values ( vol, MI_TYPE_DOUBLE, pathbuf, namebuf, 1, &valdbl );
-          miset_attr_values ( new_vol, MI_TYPE_DOUBLE, pathbuf, namebuf, 1, &valdbl );
-        } else {
-          double *tmp=malloc(length*sizeof(double));
-          miget_attr_values ( vol, MI_TYPE_DOUBLE, pathbuf, namebuf, length, tmp );
-          miset_attr_values ( new_vol, MI_TYPE_DOUBLE, pathbuf, namebuf, length, tmp );
-          free(tmp);
-        }
-        break;
+  miattrsnapshot_t snapshot;
+  int result;
 
-      case MI_TYPE_INT:
-        if(length==1)
-        {
-          long  vallng;
-          miget_attr_values ( vol, MI_TYPE_INT, pathbuf, namebuf, 1, &vallng );
-          miset_attr_values ( new_vol, MI_TYPE_INT, pathbuf, namebuf, 1, &vallng );
-        } else {
-          long *tmp=malloc(length*sizeof(long));
-          miget_attr_values ( vol, MI_TYPE_INT, pathbuf, namebuf, length, tmp );
-          miset_attr_values ( new_vol, MI_TYPE_INT, pathbuf, namebuf, length, tmp );
-          free(tmp);
-        }
-        break;
-      default:
-        return MI_LOG_ERROR(MI2_MSG_GENERIC,"Unsupported attribute type");
-      }
-    }
-  } else {
-    MI_LOG_ERROR(MI2_MSG_GENERIC,"milist_start failed");
+  if ( miget_attr_snapshot ( vol, path, &snapshot ) < 0 ) {
+    MI_LOG_ERROR(MI2_MSG_GENERIC,"Can't read the attributes to copy");
+    return ( MI_NOERROR );
   }
 
-  milist_finish ( hlist );
-
-  return ( MI_NOERROR );
+  result = miset_attr_snapshot ( new_vol, snapshot );
+  mifree_attr_snapshot ( snapshot );
+  return ( result );
 }
 
 /** Get the values of an attribute.
@@ -892,28 +821,18 @@ cleanup:
   return status;
 }
 
-/** Set the values of an attribute.
+/** Open the group or dataset holding the attributes at \a path, creating
+ * the dataset if it does not exist yet.  The returned identifier must be
+ * closed with miclose_attr_location().
  */
-int miset_attr_values ( mihandle_t vol, mitype_t data_type, const char *path,
-                    const char *name, size_t length, const void *values )
+static hid_t miopen_attr_location ( hid_t hdf_file, const char *path,
+                                    const char *name )
 {
-  hid_t hdf_file=-1;
-  hid_t hdf_grp=-1;
-  int result;
   char fullpath[256];
   hid_t tmp_id;
   char *std_name;
   char *pch;
   size_t i, slength;
-  int status = MI_ERROR;      /* Guilty until proven innocent */
-
-  /* Get a handle to the actual HDF file
-   */
-  hdf_file = vol->hdf_id;
-
-  if ( hdf_file < 0 ) {
-    return MI_LOG_ERROR(MI2_MSG_GENERIC,"HDF file is not open");
-  }
 
   if ( (!strcmp ( name, "history" ) || !strcmp(name,"ident") || !strcmp(name,"minc_version")) && ( *path==0 || !strcmp(path,"/")) ) {
     strncpy ( fullpath, MI_ROOT_PATH "/" , sizeof ( fullpath ) );
@@ -976,7 +895,42 @@ int miset_attr_values ( mihandle_t vol, mitype_t data_type, const char *path,
 
   /* Search through the path, descending into each group encountered.
    */
-  hdf_grp = midescend_path ( hdf_file, fullpath );
+  return midescend_path ( hdf_file, fullpath );
+}
+
+static void miclose_attr_location ( hid_t hdf_grp )
+{
+  /* added the following instead H5Gclose(hdf_grp) */
+  if ( hdf_grp >= 0 ) {
+    /* The hdf_loc identifier could be a group or a dataset.
+    */
+    if ( H5Iget_type ( hdf_grp ) == H5I_GROUP ) {
+      H5Gclose ( hdf_grp );
+    } else {
+      H5Dclose ( hdf_grp );
+    }
+  }
+}
+
+/** Set the values of an attribute.
+ */
+int miset_attr_values ( mihandle_t vol, mitype_t data_type, const char *path,
+                    const char *name, size_t length, const void *values )
+{
+  hid_t hdf_file=-1;
+  hid_t hdf_grp=-1;
+  int result;
+  int status = MI_ERROR;      /* Guilty until proven innocent */
+
+  /* Get a handle to the actual HDF file
+   */
+  hdf_file = vol->hdf_id;
+
+  if ( hdf_file < 0 ) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"HDF file is not open");
+  }
+
+  hdf_grp = miopen_attr_location ( hdf_file, path, name );
 
   if ( hdf_grp < 0 ) {
     goto cleanup;
@@ -991,17 +945,7 @@ int miset_attr_values ( mihandle_t vol, mitype_t data_type, const char *path,
   status=MI_NOERROR;
 
 cleanup:
-  
-  /* added the following instead H5Gclose(hdf_grp) */
-  if ( hdf_grp >= 0 ) {
-    /* The hdf_loc identifier could be a group or a dataset.
-    */
-    if ( H5Iget_type ( hdf_grp ) == H5I_GROUP ) {
-      H5Gclose ( hdf_grp );
-    } else {
-      H5Dclose ( hdf_grp );
-    }
-  }
+  miclose_attr_location ( hdf_grp );
   return status;
 }
 
@@ -1047,4 +991,661 @@ int miadd_history_attr ( mihandle_t vol, size_t length, const void *values )
 
 }
 
+/* Attribute snapshots.
+ *
+ * A snapshot holds every attribute found under a path in a single
+ * traversal.  Names, paths and values are copied into an arena of large
+ * blocks which is released in one go, and a hash table over the path and
+ * name of each attribute serves the lookups.
+ */
+#define MISNAP_BLOCK_SIZE 65536
+
+struct misnapblock {
+  struct misnapblock *next;
+  size_t used;
+  size_t size;
+  double data[1];               /* Aligned for any attribute value */
+};
+
+struct misnapattr {
+  const char *path;             /* Shared by the attributes of an object */
+  const char *name;
+  mitype_t data_type;
+  size_t length;                /* Values, or bytes for a string */
+  const void *values;
+  unsigned int hash;
+};
+
+struct miattrsnapshot {
+  struct misnapblock *blocks;
+  struct misnapattr *attrs;
+  int n_attrs;
+  int max_attrs;
+  int *table;                   /* Index + 1 of an attribute, or 0 */
+  unsigned int table_mask;
+};
+
+struct misnapctx {
+  struct miattrsnapshot *snapshot;
+  const char *path;
+  int status;
+};
+
+static void *misnap_alloc ( struct miattrsnapshot *snapshot, size_t n )
+{
+  struct misnapblock *block = snapshot->blocks;
+
+  n = ( n + sizeof ( double ) - 1 ) & ~ ( sizeof ( double ) - 1 );
+
+  if ( block == NULL || block->used + n > block->size ) {
+    size_t size = ( n > MISNAP_BLOCK_SIZE ) ? n : MISNAP_BLOCK_SIZE;
+
+    block = ( struct misnapblock * ) malloc ( sizeof ( struct misnapblock ) + size );
+
+    if ( block == NULL ) {
+      return ( NULL );
+    }
+    block->next = snapshot->blocks;
+    block->used = 0;
+    block->size = size;
+    snapshot->blocks = block;
+  }
+  block->used += n;
+  return ( ( char * ) block->data + block->used - n );
+}
+
+static char *misnap_strdup ( struct miattrsnapshot *snapshot, const char *str )
+{
+  size_t n = strlen ( str ) + 1;
+  char *copy = ( char * ) misnap_alloc ( snapshot, n );
+
+  if ( copy != NULL ) {
+    memcpy ( copy, str, n );
+  }
+  return ( copy );
+}
+
+/* Hash of a path, ignoring leading slashes, and an attribute name. */
+static unsigned int misnap_hash ( const char *path, const char *name )
+{
+  unsigned int h = 2166136261u;
+
+  while ( *path == '/' ) {
+    path++;
+  }
+  for ( ; *path != '\0'; path++ ) {
+    h = ( h ^ ( unsigned char ) *path ) * 16777619u;
+  }
+  h = ( h ^ '/' ) * 16777619u;
+  for ( ; *name != '\0'; name++ ) {
+    h = ( h ^ ( unsigned char ) *name ) * 16777619u;
+  }
+  return ( h );
+}
+
+static int misnap_same_path ( const char *a, const char *b )
+{
+  while ( *a == '/' ) {
+    a++;
+  }
+  while ( *b == '/' ) {
+    b++;
+  }
+  return ( !strcmp ( a, b ) );
+}
+
+/* Read one attribute into the snapshot.  Attributes which can't be
+ * represented by the MINC attribute functions are skipped.
+ */
+static herr_t misnap_attr_op ( hid_t loc_id, const char *attr_name,
+                               const H5A_info_t *ainfo, void *op_data )
+{
+  struct misnapctx *ctx = ( struct misnapctx * ) op_data;
+  struct miattrsnapshot *snapshot = ctx->snapshot;
+  struct misnapattr *attr;
+  hid_t hdf_attr = -1;
+  hid_t hdf_type = -1;
+  hid_t hdf_space = -1;
+  hid_t mtyp_id = -1;
+  mitype_t data_type;
+  size_t length;
+  size_t nbytes;
+  void *values;
+  herr_t result = 0;
+  (void)ainfo;
+
+  if ( ( hdf_attr = H5Aopen ( loc_id, attr_name, H5P_DEFAULT ) ) < 0 ||
+       ( hdf_type = H5Aget_type ( hdf_attr ) ) < 0 ||
+       ( hdf_space = H5Aget_space ( hdf_attr ) ) < 0 ) {
+    goto cleanup;
+  }
+  if ( H5Sget_simple_extent_ndims ( hdf_space ) > 1 ) {
+    goto cleanup;
+  }
+  length = ( size_t ) H5Sget_simple_extent_npoints ( hdf_space );
+
+  switch ( H5Tget_class ( hdf_type ) ) {
+  case H5T_FLOAT:
+    if ( H5Tget_size ( hdf_type ) == sizeof ( float ) ) {
+      data_type = MI_TYPE_FLOAT;
+      mtyp_id = H5Tcopy ( H5T_NATIVE_FLOAT );
+      nbytes = length * sizeof ( float );
+    } else {
+      data_type = MI_TYPE_DOUBLE;
+      mtyp_id = H5Tcopy ( H5T_NATIVE_DOUBLE );
+      nbytes = length * sizeof ( double );
+    }
+    break;
+  case H5T_INTEGER:
+    data_type = MI_TYPE_INT;
+    mtyp_id = H5Tcopy ( H5T_NATIVE_INT );
+    nbytes = length * sizeof ( int );
+    break;
+  case H5T_STRING:
+    if ( length != 1 || H5Tis_variable_str ( hdf_type ) > 0 ) {
+      goto cleanup;
+    }
+    data_type = MI_TYPE_STRING;
+    length = H5Tget_size ( hdf_type );
+    mtyp_id = H5Tcopy ( H5T_C_S1 );
+    H5Tset_size ( mtyp_id, length );
+    nbytes = length + 1;        /* Always zero terminated */
+    break;
+  default:
+    goto cleanup;
+  }
+
+  if ( snapshot->n_attrs == snapshot->max_attrs ) {
+    int max_attrs = ( snapshot->max_attrs == 0 ) ? 64 : 2 * snapshot->max_attrs;
+    struct misnapattr *attrs = ( struct misnapattr * )
+      realloc ( snapshot->attrs, max_attrs * sizeof ( struct misnapattr ) );
+
+    if ( attrs == NULL ) {
+      result = -1;
+      goto cleanup;
+    }
+    snapshot->attrs = attrs;
+    snapshot->max_attrs = max_attrs;
+  }
+  attr = &snapshot->attrs[snapshot->n_attrs];
+  values = misnap_alloc ( snapshot, nbytes );
+  attr->name = misnap_strdup ( snapshot, attr_name );
+
+  if ( values == NULL || attr->name == NULL ) {
+    result = -1;
+    goto cleanup;
+  }
+  if ( H5Aread ( hdf_attr, mtyp_id, values ) < 0 ) {
+    goto cleanup;
+  }
+  if ( data_type == MI_TYPE_STRING ) {
+    ( ( char * ) values ) [length] = '\0';
+  }
+  attr->path = ctx->path;
+  attr->data_type = data_type;
+  attr->length = length;
+  attr->values = values;
+  attr->hash = misnap_hash ( attr->path, attr->name );
+  snapshot->n_attrs++;
+
+cleanup:
+  if ( mtyp_id >= 0 ) H5Tclose ( mtyp_id );
+  if ( hdf_space >= 0 ) H5Sclose ( hdf_space );
+  if ( hdf_type >= 0 ) H5Tclose ( hdf_type );
+  if ( hdf_attr >= 0 ) H5Aclose ( hdf_attr );
+  if ( result < 0 ) {
+    ctx->status = MI_ERROR;
+  }
+  return ( result );
+}
+
+static int misnap_object ( struct miattrsnapshot *snapshot, hid_t obj_id,
+                           const char *path );
+
+static herr_t misnap_link_op ( hid_t grp_id, const char *name,
+                               const H5L_info_t *info, void *op_data )
+{
+  struct misnapctx *ctx = ( struct misnapctx * ) op_data;
+  char path[MILIST_MAX_PATH];
+  size_t l = strlen ( ctx->path );
+  hid_t obj_id;
+  int result;
+
+  if ( info->type != H5L_TYPE_HARD ) {
+    return ( 0 );
+  }
+  if ( l + strlen ( name ) + 2 > sizeof ( path ) ) {
+    return ( 0 );
+  }
+  strcpy ( path, ctx->path );
+  if ( l > 0 && path[l - 1] != '/' ) {
+    strcat ( path, "/" );
+  }
+  strcat ( path, name );
+
+  H5E_BEGIN_TRY {
+    obj_id = H5Oopen ( grp_id, name, H5P_DEFAULT );
+  } H5E_END_TRY;
+
+  if ( obj_id < 0 ) {
+    return ( 0 );
+  }
+  result = misnap_object ( ctx->snapshot, obj_id, path );
+  H5Oclose ( obj_id );
+  return ( result < 0 ) ? -1 : 0;
+}
+
+/* Add the attributes of an object, then those of its children if it is
+ * a group, so that the attributes of each object are contiguous.
+ */
+static int misnap_object ( struct miattrsnapshot *snapshot, hid_t obj_id,
+                           const char *path )
+{
+  struct misnapctx ctx;
+  H5I_type_t obj_type = H5Iget_type ( obj_id );
+
+  ctx.snapshot = snapshot;
+  ctx.status = MI_NOERROR;
+  ctx.path = misnap_strdup ( snapshot, path );
+
+  if ( ctx.path == NULL ) {
+    return ( MI_ERROR );
+  }
+
+  H5E_BEGIN_TRY {
+    H5Aiterate2 ( obj_id, H5_INDEX_NAME, H5_ITER_INC, NULL,
+                  misnap_attr_op, &ctx );
+
+    if ( ctx.status == MI_NOERROR && obj_type == H5I_GROUP ) {
+      H5Literate ( obj_id, H5_INDEX_NAME, H5_ITER_INC, NULL,
+                   misnap_link_op, &ctx );
+    }
+  } H5E_END_TRY;
+
+  return ( ctx.status );
+}
+
+/** Read all the attributes of the group or dataset at \a path, and of
+ * every group and dataset below it, into a snapshot.
+ */
+int miget_attr_snapshot ( mihandle_t vol, const char *path,
+                          miattrsnapshot_t *snapshot )
+{
+  struct miattrsnapshot *snap;
+  char fullpath[256];
+  hid_t obj_id;
+  unsigned int table_size;
+  int result;
+  int i;
+
+  if ( vol == NULL || path == NULL || snapshot == NULL ) {
+    return ( MI_ERROR );
+  }
+
+  strncpy ( fullpath, MI_ROOT_PATH "/" MI_INFO_NAME, sizeof ( fullpath ) );
+
+  if ( *path != '/' && *path!=0 ) {
+    strncat ( fullpath, "/", sizeof ( fullpath ) - strlen ( fullpath ) - 1 );
+  }
+
+  strncat ( fullpath, path, sizeof ( fullpath ) - strlen ( fullpath ) - 1);
+
+  obj_id = midescend_path ( vol->hdf_id, fullpath );
+
+  if ( obj_id < 0 ) {
+    return ( MI_ERROR );
+  }
+
+  snap = ( struct miattrsnapshot * ) calloc ( 1, sizeof ( struct miattrsnapshot ) );
+
+  if ( snap == NULL ) {
+    miclose_attr_location ( obj_id );
+    return MI_LOG_ERROR(MI2_MSG_OUTOFMEM, sizeof ( struct miattrsnapshot ));
+  }
+
+  result = misnap_object ( snap, obj_id, path );
+  miclose_attr_location ( obj_id );
+
+  /* Open addressing, with the table at most half full. */
+  for ( table_size = 16; table_size < 2 * ( unsigned int ) snap->n_attrs; table_size *= 2 )
+    ;
+  snap->table = ( int * ) calloc ( table_size, sizeof ( int ) );
+  snap->table_mask = table_size - 1;
+
+  if ( result < 0 || snap->table == NULL ) {
+    mifree_attr_snapshot ( snap );
+    return ( MI_ERROR );
+  }
+
+  for ( i = 0; i < snap->n_attrs; i++ ) {
+    unsigned int slot = snap->attrs[i].hash & snap->table_mask;
+
+    while ( snap->table[slot] != 0 ) {
+      slot = ( slot + 1 ) & snap->table_mask;
+    }
+    snap->table[slot] = i + 1;
+  }
+
+  *snapshot = snap;
+  return ( MI_NOERROR );
+}
+
+/** Free a snapshot and every string and value it holds.
+ */
+int mifree_attr_snapshot ( miattrsnapshot_t snapshot )
+{
+  struct misnapblock *block;
+
+  if ( snapshot == NULL ) {
+    return ( MI_ERROR );
+  }
+  while ( ( block = snapshot->blocks ) != NULL ) {
+    snapshot->blocks = block->next;
+    free ( block );
+  }
+  free ( snapshot->attrs );
+  free ( snapshot->table );
+  free ( snapshot );
+  return ( MI_NOERROR );
+}
+
+/** Get the number of attributes in a snapshot.
+ */
+int miget_snapshot_attr_count ( miattrsnapshot_t snapshot, int *count )
+{
+  if ( snapshot == NULL || count == NULL ) {
+    return ( MI_ERROR );
+  }
+  *count = snapshot->n_attrs;
+  return ( MI_NOERROR );
+}
+
+/** Get an attribute of a snapshot by its index.  The attributes of an
+ * object come before those of its children.  The path, name and values
+ * belong to the snapshot; the \a length is the number of values, or the
+ * size in bytes of a string, which is always zero terminated.
+ */
+int miget_snapshot_attr ( miattrsnapshot_t snapshot, int index,
+                          const char **path, const char **name,
+                          mitype_t *data_type, size_t *length,
+                          const void **values )
+{
+  struct misnapattr *attr;
+
+  if ( snapshot == NULL || index < 0 || index >= snapshot->n_attrs ) {
+    return ( MI_ERROR );
+  }
+  attr = &snapshot->attrs[index];
+
+  if ( path != NULL ) {
+    *path = attr->path;
+  }
+  if ( name != NULL ) {
+    *name = attr->name;
+  }
+  if ( data_type != NULL ) {
+    *data_type = attr->data_type;
+  }
+  if ( length != NULL ) {
+    *length = attr->length;
+  }
+  if ( values != NULL ) {
+    *values = attr->values;
+  }
+  return ( MI_NOERROR );
+}
+
+/** Find the index of the attribute \a name at \a path in a snapshot.
+ */
+int mifind_snapshot_attr ( miattrsnapshot_t snapshot, const char *path,
+                           const char *name, int *index )
+{
+  unsigned int hash;
+  unsigned int slot;
+
+  if ( snapshot == NULL || path == NULL || name == NULL || index == NULL ) {
+    return ( MI_ERROR );
+  }
+  hash = misnap_hash ( path, name );
+
+  for ( slot = hash & snapshot->table_mask; snapshot->table[slot] != 0;
+        slot = ( slot + 1 ) & snapshot->table_mask ) {
+    struct misnapattr *attr = &snapshot->attrs[snapshot->table[slot] - 1];
+
+    if ( attr->hash == hash && !strcmp ( attr->name, name ) &&
+         misnap_same_path ( attr->path, path ) ) {
+      *index = snapshot->table[slot] - 1;
+      return ( MI_NOERROR );
+    }
+  }
+  return ( MI_ERROR );
+}
+
+/** Write every attribute of a snapshot to \a vol, at the same paths.
+ * Each group or dataset is opened once for all of its attributes.
+ */
+int miset_attr_snapshot ( mihandle_t vol, miattrsnapshot_t snapshot )
+{
+  hid_t hdf_grp = -1;
+  const char *grp_path = NULL;
+  int status = MI_NOERROR;
+  int i;
+
+  if ( vol == NULL || snapshot == NULL ) {
+    return ( MI_ERROR );
+  }
+  if ( vol->hdf_id < 0 ) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"HDF file is not open");
+  }
+
+  for ( i = 0; i < snapshot->n_attrs; i++ ) {
+    struct misnapattr *attr = &snapshot->attrs[i];
+
+    /* The global attributes are found by their name. */
+    if ( attr->path != grp_path ||
+         !strcmp ( attr->name, "history" ) || !strcmp ( attr->name, "ident" ) ||
+         !strcmp ( attr->name, "minc_version" ) ) {
+      miclose_attr_location ( hdf_grp );
+      hdf_grp = miopen_attr_location ( vol->hdf_id, attr->path, attr->name );
+      grp_path = attr->path;
+    }
+    if ( hdf_grp < 0 ||
+         miset_attr_at_loc ( hdf_grp, attr->name, attr->data_type,
+                             attr->length, attr->values ) < 0 ) {
+      status = MI_ERROR;
+    }
+  }
+  miclose_attr_location ( hdf_grp );
+  return ( status );
+}
+
+struct misnapjson {
+  char *buf;
+  size_t len;
+  size_t size;
+  int failed;
+};
+
+static void misnap_json_append ( struct misnapjson *js, const char *str,
+                                 size_t n )
+{
+  if ( js->len + n + 1 > js->size ) {
+    size_t size = ( js->size == 0 ) ? 4096 : js->size;
+    char *buf;
+
+    while ( js->len + n + 1 > size ) {
+      size *= 2;
+    }
+    if ( ( buf = ( char * ) realloc ( js->buf, size ) ) == NULL ) {
+      js->failed = TRUE;
+      return;
+    }
+    js->buf = buf;
+    js->size = size;
+  }
+  memcpy ( js->buf + js->len, str, n );
+  js->len += n;
+  js->buf[js->len] = '\0';
+}
+
+static void misnap_json_puts ( struct misnapjson *js, const char *str )
+{
+  misnap_json_append ( js, str, strlen ( str ) );
+}
+
+static void misnap_json_string ( struct misnapjson *js, const char *str,
+                                 size_t n )
+{
+  size_t i, start = 0;
+  char esc[8];
+
+  misnap_json_append ( js, "\"", 1 );
+  for ( i = 0; i < n && str[i] != '\0'; i++ ) {
+    unsigned char c = ( unsigned char ) str[i];
+
+    if ( c < 0x20 || c == '"' || c == '\\' ) {
+      misnap_json_append ( js, str + start, i - start );
+      switch ( c ) {
+      case '"': strcpy ( esc, "\\\"" ); break;
+      case '\\': strcpy ( esc, "\\\\" ); break;
+      case '\n': strcpy ( esc, "\\n" ); break;
+      case '\t': strcpy ( esc, "\\t" ); break;
+      case '\r': strcpy ( esc, "\\r" ); break;
+      default: sprintf ( esc, "\\u%04x", c ); break;
+      }
+      misnap_json_puts ( js, esc );
+      start = i + 1;
+    }
+  }
+  misnap_json_append ( js, str + start, i - start );
+  misnap_json_append ( js, "\"", 1 );
+}
+
+static void misnap_json_number ( struct misnapjson *js, double value,
+                                 int digits )
+{
+  char num[32];
+
+  if ( value != value || value == HUGE_VAL || value == -HUGE_VAL ) {
+    misnap_json_puts ( js, "null" );
+  } else {
+    sprintf ( num, "%.*g", digits, value );
+    misnap_json_puts ( js, num );
+  }
+}
+
+/* Length of the first component of a path, after its leading slashes. */
+static size_t misnap_component ( const char **path )
+{
+  while ( **path == '/' ) {
+    ( *path ) ++;
+  }
+  return ( strcspn ( *path, "/" ) );
+}
+
+/** Serialize a snapshot as a JSON object, with a nested object for each
+ * group or dataset and a number, array or string for each attribute.
+ * The string returned in \a json must be freed by the caller.
+ */
+int miget_snapshot_json ( miattrsnapshot_t snapshot, char **json )
+{
+  struct misnapjson js;
+  const char *open_path = "";
+  int depth = 0;
+  int first = TRUE;
+  int i;
+
+  if ( snapshot == NULL || json == NULL ) {
+    return ( MI_ERROR );
+  }
+  memset ( &js, 0, sizeof ( js ) );
+  misnap_json_puts ( &js, "{" );
+
+  for ( i = 0; i < snapshot->n_attrs; i++ ) {
+    struct misnapattr *attr = &snapshot->attrs[i];
+    const char *p = open_path;
+    const char *q = attr->path;
+    int common = 0;
+    int k;
+    size_t n;
+
+    /* Close the objects which are not shared with the attribute's path,
+     * then open the rest of its path.
+     */
+    for ( ;; ) {
+      size_t np = misnap_component ( &p );
+      size_t nq = misnap_component ( &q );
+
+      if ( np == 0 || np != nq || strncmp ( p, q, np ) != 0 ) {
+        break;
+      }
+      p += np;
+      q += nq;
+      common++;
+    }
+    for ( k = depth; k > common; k-- ) {
+      misnap_json_puts ( &js, "}" );
+      first = FALSE;
+    }
+    depth = common;
+    while ( ( n = misnap_component ( &q ) ) > 0 ) {
+      if ( !first ) {
+        misnap_json_puts ( &js, "," );
+      }
+      misnap_json_string ( &js, q, n );
+      misnap_json_puts ( &js, ":{" );
+      first = TRUE;
+      q += n;
+      depth++;
+    }
+    open_path = attr->path;
+
+    if ( !first ) {
+      misnap_json_puts ( &js, "," );
+    }
+    first = FALSE;
+    misnap_json_string ( &js, attr->name, strlen ( attr->name ) );
+    misnap_json_puts ( &js, ":" );
+
+    if ( attr->data_type == MI_TYPE_STRING ) {
+      misnap_json_string ( &js, ( const char * ) attr->values, attr->length );
+    } else {
+      size_t j;
+
+      if ( attr->length != 1 ) {
+        misnap_json_puts ( &js, "[" );
+      }
+      for ( j = 0; j < attr->length; j++ ) {
+        if ( j > 0 ) {
+          misnap_json_puts ( &js, "," );
+        }
+        switch ( attr->data_type ) {
+        case MI_TYPE_INT:
+          misnap_json_number ( &js, ( ( const int * ) attr->values ) [j], 10 );
+          break;
+        case MI_TYPE_FLOAT:
+          misnap_json_number ( &js, ( ( const float * ) attr->values ) [j], 9 );
+          break;
+        default:
+          misnap_json_number ( &js, ( ( const double * ) attr->values ) [j], 17 );
+          break;
+        }
+      }
+      if ( attr->length != 1 ) {
+        misnap_json_puts ( &js, "]" );
+      }
+    }
+  }
+  for ( ; depth >= 0; depth-- ) {
+    misnap_json_puts ( &js, "}" );
+  }
+
+  if ( js.failed ) {
+    free ( js.buf );
+    return MI_LOG_ERROR(MI2_MSG_OUTOFMEM, js.size);
+  }
+  *json = js.buf;
+  return ( MI_NOERROR );
+}
+
 // kate: indent-mode cstyle; indent-width 2; replace-tabs on; 
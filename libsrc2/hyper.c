@@ -138,6 +138,290 @@ int mitranslate_hyperslab_origin(mihandle_t volume,
   return (n_different);
 }
 
+/** Map a numeric mitype_t onto its slot in the buffer type cache,
+ * or -1 if the type is not cached.
+ */
+static int mitype_cache_slot(mitype_t mitype)
+{
+  switch (mitype) {
+  case MI_TYPE_BYTE:     return 0;
+  case MI_TYPE_SHORT:    return 1;
+  case MI_TYPE_INT:      return 2;
+  case MI_TYPE_FLOAT:    return 3;
+  case MI_TYPE_DOUBLE:   return 4;
+  case MI_TYPE_UBYTE:    return 5;
+  case MI_TYPE_USHORT:   return 6;
+  case MI_TYPE_UINT:     return 7;
+  case MI_TYPE_SCOMPLEX: return 8;
+  case MI_TYPE_ICOMPLEX: return 9;
+  case MI_TYPE_FCOMPLEX: return 10;
+  case MI_TYPE_DCOMPLEX: return 11;
+  default:               return -1;
+  }
+}
+
+/** "semiprivate" function returning the image dataset of the selected
+ * resolution together with its file dataspace. Both handles are owned
+ * by the volume and stay open until mifree_hyperslab_cache() is called,
+ * so the caller must not close them.
+ */
+int miget_image_dataset(mihandle_t volume, hid_t *dset_id, hid_t *fspc_id)
+{
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
+  if (volume->image_id < 0) {
+    char path[MI2_MAX_PATH];
+
+    sprintf(path, MI_ROOT_PATH "/image/%d/image", volume->selected_resolution);
+    MI_CHECK_HDF_CALL(volume->image_id = H5Dopen1(volume->hdf_id, path),"H5Dopen1");
+    if (volume->image_id < 0) {
+      return (MI_ERROR);
+    }
+  }
+
+  if (volume->image_fspc_id < 0) {
+    MI_CHECK_HDF_CALL(volume->image_fspc_id = H5Dget_space(volume->image_id),"H5Dget_space");
+    if (volume->image_fspc_id < 0) {
+      return (MI_ERROR);
+    }
+  }
+
+  *dset_id = volume->image_id;
+  *fspc_id = volume->image_fspc_id;
+  return (MI_NOERROR);
+}
+
+/** "semiprivate" function returning the native HDF5 type used for a
+ * memory buffer of type \a mitype. MI_TYPE_UNKNOWN maps onto the memory
+ * type of the volume itself. The returned type is owned by the volume
+ * and must not be closed by the caller.
+ */
+hid_t miget_buffer_type(mihandle_t volume, mitype_t mitype)
+{
+  int slot;
+
+  if (mitype == MI_TYPE_UNKNOWN) {
+    return (volume->mtype_id);
+  }
+
+  slot = mitype_cache_slot(mitype);
+  if (slot < 0) {
+    MI_LOG_ERROR(MI2_MSG_BADTYPE, mitype);
+    return (MI_ERROR);
+  }
+
+  if (volume->buffer_type_ids[slot] < 0) {
+    volume->buffer_type_ids[slot] = mitype_to_hdftype(mitype, TRUE);
+  }
+  return (volume->buffer_type_ids[slot]);
+}
+
+/** Returns the memory dataspace used for a hyperslab of \a hdf_count,
+ * reshaping the one cached on the volume instead of creating a new one.
+ */
+static hid_t miget_hyperslab_mspc(mihandle_t volume, int ndims,
+                                  const hsize_t hdf_count[])
+{
+  if (volume->image_mspc_id < 0) {
+    if (ndims == 0) {
+      /* A scalar volume is possible but extremely unlikely, not to
+       * mention useless!
+       */
+      MI_CHECK_HDF_CALL(volume->image_mspc_id = H5Screate(H5S_SCALAR),"H5Screate");
+    } else {
+      MI_CHECK_HDF_CALL(volume->image_mspc_id = H5Screate_simple(ndims, hdf_count, NULL),"H5Screate_simple");
+    }
+    return (volume->image_mspc_id);
+  }
+
+  if (ndims != 0 &&
+      H5Sset_extent_simple(volume->image_mspc_id, ndims, hdf_count, NULL) < 0) {
+    MI_LOG_ERROR(MI2_MSG_HDF5, "H5Sset_extent_simple");
+    return (MI_ERROR);
+  }
+  return (volume->image_mspc_id);
+}
+
+/** "semiprivate" function releasing the dataspaces and datatypes cached
+ * by the hyperslab functions. Must be called whenever the image dataset
+ * of the volume changes, and before the volume is closed.
+ */
+void mifree_hyperslab_cache(mihandle_t volume)
+{
+  int i;
+
+  if (volume->image_fspc_id >= 0) {
+    H5Sclose(volume->image_fspc_id);
+    volume->image_fspc_id = -1;
+  }
+  if (volume->image_mspc_id >= 0) {
+    H5Sclose(volume->image_mspc_id);
+    volume->image_mspc_id = -1;
+  }
+  for (i = 0; i < MI2_TYPE_CACHE_SLOTS; i++) {
+    if (volume->buffer_type_ids[i] >= 0) {
+      H5Tclose(volume->buffer_type_ids[i]);
+      volume->buffer_type_ids[i] = -1;
+    }
+  }
+}
+
+/** Size of the bounce buffer used when reading a flipped hyperslab. */
+#define MI2_FLIP_BLOCK_SIZE (1 << 20)
+
+/** Returns TRUE if the apparent dimension order of the volume differs
+ * from the file order.
+ */
+static int mihas_permutation(mihandle_t volume)
+{
+  int i;
+
+  if (volume->dim_indices == NULL) {
+    return (FALSE);
+  }
+  for (i = 0; i < volume->number_of_dims; i++) {
+    if (volume->dim_indices[i] != i) {
+      return (TRUE);
+    }
+  }
+  return (FALSE);
+}
+
+/** Reads a hyperslab in file order, decoding the chunks on the volume's
+ * I/O threads when the dataset allows it and the hyperslab is large
+ * enough.
+ */
+static int miread_hyperslab_data(mihandle_t volume, hid_t dset_id,
+                                 hid_t type_id, hid_t mspc_id, hid_t fspc_id,
+                                 int ndims, const hsize_t hdf_start[],
+                                 const hsize_t hdf_count[], void *buffer)
+{
+  hsize_t chunk_dims[MI2_MAX_VAR_DIMS];
+  int result;
+
+  if (miuse_parallel_chunks(volume, dset_id, type_id, ndims, chunk_dims) &&
+      miuse_parallel_hyperslab(volume, dset_id, ndims, chunk_dims,
+                               hdf_start, hdf_count)) {
+    return (miread_parallel_chunks(volume, dset_id, type_id, ndims, chunk_dims,
+                                   hdf_start, hdf_count, buffer));
+  }
+  MI_CHECK_HDF_CALL(result = H5Dread(dset_id, type_id, mspc_id, fspc_id,
+                                     H5P_DEFAULT, buffer),"H5Dread");
+  return (result);
+}
+
+/** Writes a hyperslab in file order, encoding the chunks on the volume's
+ * I/O threads when the dataset allows it and the hyperslab is large
+ * enough.
+ */
+static int miwrite_hyperslab_data(mihandle_t volume, hid_t dset_id,
+                                  hid_t type_id, hid_t mspc_id, hid_t fspc_id,
+                                  int ndims, const hsize_t hdf_start[],
+                                  const hsize_t hdf_count[], const void *buffer)
+{
+  hsize_t chunk_dims[MI2_MAX_VAR_DIMS];
+  int result;
+
+  if (miuse_parallel_chunks(volume, dset_id, type_id, ndims, chunk_dims) &&
+      miuse_parallel_hyperslab(volume, dset_id, ndims, chunk_dims,
+                               hdf_start, hdf_count)) {
+    return (miwrite_parallel_chunks(volume, dset_id, type_id, ndims, chunk_dims,
+                                    hdf_start, hdf_count, buffer));
+  }
+  MI_CHECK_HDF_CALL(result = H5Dwrite(dset_id, type_id, mspc_id, fspc_id,
+                                      H5P_DEFAULT, buffer),"H5Dwrite");
+  return (result);
+}
+
+/** Reads a hyperslab whose dimensions are in file order but may be
+ * flipped. The slab is read in blocks of whole rows of the slowest
+ * varying dimension into a small bounce buffer, and each block is
+ * reversed directly into its place in the caller's buffer, so the
+ * hyperslab is never held in file order at full size.
+ */
+static int miread_flipped_hyperslab(mihandle_t volume, hid_t dset_id,
+                                    hid_t fspc_id, hid_t type_id, int ndims,
+                                    const hsize_t hdf_start[],
+                                    const hsize_t hdf_count[],
+                                    const int dir[], void *buffer)
+{
+  hsize_t block_start[MI2_MAX_VAR_DIMS];
+  hsize_t block_count[MI2_MAX_VAR_DIMS];
+  size_t lengths[MI2_MAX_VAR_DIMS];
+  int map[MI2_MAX_VAR_DIMS];
+  size_t el_size = H5Tget_size(type_id);
+  size_t row_bytes = el_size;
+  size_t rows_per_block;
+  hsize_t row;
+  hid_t mspc_id;
+  unsigned char *bounce;
+  int result = MI_NOERROR;
+  int i;
+
+  for (i = 0; i < ndims; i++) {
+    block_start[i] = hdf_start[i];
+    block_count[i] = hdf_count[i];
+    lengths[i] = hdf_count[i];
+    map[i] = i;
+    if (i > 0) {
+      row_bytes *= hdf_count[i];
+    }
+  }
+  if (hdf_count[0] == 0 || row_bytes == 0) {
+    return (MI_NOERROR);
+  }
+
+  rows_per_block = MI2_FLIP_BLOCK_SIZE / row_bytes;
+  if (rows_per_block == 0) {
+    rows_per_block = 1;
+  }
+  if (rows_per_block > hdf_count[0]) {
+    rows_per_block = hdf_count[0];
+  }
+
+  bounce = malloc(rows_per_block * row_bytes);
+  if (bounce == NULL) {
+    return (MI_LOG_ERROR(MI2_MSG_OUTOFMEM, rows_per_block * row_bytes));
+  }
+
+  for (row = 0; row < hdf_count[0]; row += rows_per_block) {
+    hsize_t n_rows = hdf_count[0] - row;
+    hsize_t dst_row;
+
+    if (n_rows > rows_per_block) {
+      n_rows = rows_per_block;
+    }
+    block_start[0] = hdf_start[0] + row;
+    block_count[0] = n_rows;
+    lengths[0] = n_rows;
+
+    if ((mspc_id = miget_hyperslab_mspc(volume, ndims, block_count)) < 0) {
+      result = MI_ERROR;
+      break;
+    }
+    MI_CHECK_HDF_CALL(result = H5Sselect_hyperslab(fspc_id, H5S_SELECT_SET,
+                                                   block_start, NULL,
+                                                   block_count, NULL),"H5Sselect_hyperslab");
+    if (result < 0) {
+      break;
+    }
+    MI_CHECK_HDF_CALL(result = H5Dread(dset_id, type_id, mspc_id, fspc_id,
+                                       H5P_DEFAULT, bounce),"H5Dread");
+    if (result < 0) {
+      break;
+    }
+
+    /* Rows of a flipped slowest dimension land at the far end. */
+    dst_row = (dir[0] < 0) ? hdf_count[0] - row - n_rows : row;
+    restructure_array_copy(ndims, (unsigned char *) buffer + dst_row * row_bytes,
+                           bounce, lengths, el_size, map, dir);
+  }
+
+  free(bounce);
+  return (result);
+}
+
 /** Read/write a hyperslab of data.  This is the simplified function
  * which performs no value conversion.  It is much more efficient than
  * mirw_hyperslab_icv()
@@ -161,7 +445,6 @@ static int mirw_hyperslab_raw(int opcode,
   int n_different = 0;
   misize_t buffer_size;
   void *temp_buffer=NULL;
-  char path[MI2_MAX_PATH];
   size_t icount[MI2_MAX_VAR_DIMS];
 
   /* Disallow write operations to anything but the highest resolution.
@@ -170,48 +453,22 @@ static int mirw_hyperslab_raw(int opcode,
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to write to a volume thumbnail");
   }
 
-  sprintf(path, MI_ROOT_PATH "/image/%d/image", volume->selected_resolution);
-  /*printf("Using:%s\n",path);*/
-  
-  /* Open the dataset with the specified path
-  */
-  MI_CHECK_HDF_CALL(dset_id = H5Dopen1(volume->hdf_id, path),"H5Dopen1");
-  if (dset_id < 0) {
+  if (miget_image_dataset(volume, &dset_id, &fspc_id) < 0) {
     return (MI_ERROR);
   }
 
-  MI_CHECK_HDF_CALL(fspc_id = H5Dget_space(dset_id),"H5Dget_space");
-  if (fspc_id < 0) {
-    /*TODO: report can't get dataset*/
-    goto cleanup;
-  }
-
-  MI_CHECK_HDF_CALL(fspc_id = H5Dget_space(dset_id),"H5Dget_space");
-  if (fspc_id < 0) {
-    goto cleanup;
-  }
-
-  if (midatatype == MI_TYPE_UNKNOWN) {
-    type_id = H5Tcopy(volume->mtype_id);
-  } else {
-    type_id = mitype_to_hdftype(midatatype, TRUE);
+  if ((type_id = miget_buffer_type(volume, midatatype)) < 0) {
+    return (MI_ERROR);
   }
 
   ndims = volume->number_of_dims;
 
-  if (ndims == 0) {
-    /* A scalar volume is possible but extremely unlikely, not to
-     * mention useless!
-     */
-    mspc_id = H5Screate(H5S_SCALAR);
-  } else {
-
+  if (ndims != 0) {
     n_different = mitranslate_hyperslab_origin(volume, start, count, hdf_start, hdf_count, dir);
+  }
 
-    MI_CHECK_HDF_CALL(mspc_id = H5Screate_simple(ndims, hdf_count, NULL),"H5Screate_simple");
-    if (mspc_id < 0) {
-      goto cleanup;
-    }
+  if ((mspc_id = miget_hyperslab_mspc(volume, ndims, hdf_count)) < 0) {
+    return (MI_ERROR);
   }
 
   MI_CHECK_HDF_CALL(result = H5Sselect_hyperslab(fspc_id, H5S_SELECT_SET, hdf_start, NULL,
@@ -224,25 +481,52 @@ static int mirw_hyperslab_raw(int opcode,
   
   
   if (opcode == MIRW_OP_READ) {
-    MI_CHECK_HDF_CALL(result = H5Dread(dset_id, type_id, mspc_id, fspc_id, H5P_DEFAULT,buffer),"H5Dread");
-    
-    /* Restructure the array after reading the data in file orientation.
+    /* With I/O threads the whole slab is decoded in parallel and then
+     * restructured, rather than read block by block.
      */
-    if (n_different != 0) {
+    if (n_different != 0 && !mihas_permutation(volume) &&
+        volume->io_threads < 2) {
+      result = miread_flipped_hyperslab(volume, dset_id, fspc_id, type_id, ndims,
+                                        hdf_start, hdf_count, dir, buffer);
+    } else if (n_different != 0) {
       int i;
 
+      /* Read the data in file orientation, then restructure it straight
+       * into the caller's buffer.
+       */
+      temp_buffer=malloc(buffer_size);
+      if(temp_buffer==NULL)
+      {
+        result=MI_LOG_ERROR(MI2_MSG_OUTOFMEM,buffer_size);
+        goto cleanup;
+      }
+
+      result = miread_hyperslab_data(volume, dset_id, type_id, mspc_id, fspc_id,
+                                     ndims, hdf_start, hdf_count, temp_buffer);
+      if (result < 0) {
+        goto cleanup;
+      }
+
       for (i = 0; i < ndims; i++) {
         icount[i] = count[i];
       }
-      restructure_array(ndims, buffer, icount, H5Tget_size(type_id),
-                        volume->dim_indices, dir);
+      restructure_array_copy(ndims, buffer, temp_buffer, icount, H5Tget_size(type_id),
+                             volume->dim_indices, dir);
+    } else {
+      result = miread_hyperslab_data(volume, dset_id, type_id, mspc_id, fspc_id,
+                                     ndims, hdf_start, hdf_count, buffer);
     }
   } else {
 
     volume->is_dirty = TRUE; /* Mark as modified. */
+    mifree_label_index(volume); /* The labels present may differ. */
+    volume->label_index_stale = TRUE;
+    if (ndims > 0 && volume->selected_resolution == 0) {
+      minc_mark_stale_thumbnails(volume, hdf_start[0], hdf_count[0]);
+    }
 
-    /* Restructure array before writing to file.
-     * TODO: use temporary buffer for that!
+    /* Restructure array into a temporary buffer before writing to file,
+     * preserving the input data.
      */
 
     if (n_different != 0) {
@@ -261,42 +545,26 @@ static int mirw_hyperslab_raw(int opcode,
 
       }
 
-      /*Use temporary array to preserve input data*/
       temp_buffer=malloc(buffer_size);
       if(temp_buffer==NULL)
       {
-        /*TODO: report memory error*/
-        result=MI_ERROR;
+        result=MI_LOG_ERROR(MI2_MSG_OUTOFMEM,buffer_size);
         goto cleanup;
       }
       
-      memcpy(temp_buffer,buffer,buffer_size);
-      
-      restructure_array(ndims, temp_buffer, icount, H5Tget_size(type_id),
-                        imap, idir);
-      MI_CHECK_HDF_CALL(result = H5Dwrite(dset_id, type_id, mspc_id, fspc_id, H5P_DEFAULT,
-                      temp_buffer),"H5Dwrite");
+      restructure_array_copy(ndims, temp_buffer, buffer, icount, H5Tget_size(type_id),
+                             imap, idir);
+      result = miwrite_hyperslab_data(volume, dset_id, type_id, mspc_id, fspc_id,
+                                      ndims, hdf_start, hdf_count, temp_buffer);
     } else {
-      MI_CHECK_HDF_CALL(result = H5Dwrite(dset_id, type_id, mspc_id, fspc_id, H5P_DEFAULT,
-                        buffer),"H5Dwrite");
+      result = miwrite_hyperslab_data(volume, dset_id, type_id, mspc_id, fspc_id,
+                                      ndims, hdf_start, hdf_count, buffer);
     }
 
   }
 
 cleanup:
 
-  if (type_id >= 0) {
-    H5Tclose(type_id);
-  }
-  if (mspc_id >= 0) {
-    H5Sclose(mspc_id);
-  }
-  if (fspc_id >= 0) {
-    H5Sclose(fspc_id);
-  }
-  if ( dset_id >=0 ) {
-    H5Dclose(dset_id);
-  }
   if ( temp_buffer!= NULL) {
     free( temp_buffer );
   }
@@ -341,6 +609,173 @@ cleanup:
     }\
   }
 
+#define APPLY_DESCALING_NORM(type_out,buffer_in,buffer_out,voxel_count,slice_min,slice_max,voxel_min,voxel_max,data_min,data_max,norm_min,norm_max) \
+  { \
+    hsize_t _i;\
+    double voxel_offset=voxel_min;\
+    double voxel_range=voxel_max-voxel_min;\
+    double norm_offset=norm_min;\
+    double norm_range=(double)norm_max-(double)norm_min;\
+    double data_offset=data_min;\
+    double data_range=(double)data_max-(double)data_min;\
+    type_out *_buffer_out=(type_out *)buffer_out;\
+    const double *_buffer_in=(const double *)buffer_in; \
+    for(_i=0;_i<voxel_count;_i++)\
+      {\
+        double _temp=(( _buffer_in[_i] - voxel_offset) / voxel_range)*(slice_max-slice_min) + slice_min ;\
+        _temp=(_temp-data_offset)/data_range;\
+        _temp=(_temp<0.0)?norm_min:(_temp>=1.0)?norm_max:(rint(_temp*norm_range)+norm_offset); \
+        _buffer_out[_i]=(type_out)(_temp);\
+      }\
+  }
+
+/** Number of voxels converted at a time by miconvert_voxel_slices(). */
+#define MI2_CONVERT_BLOCK 1024
+
+/** Convert \a total_number_of_slices slices of \a image_slice_length
+ * voxels of type \a voxel_type into \a buffer, applying the per-slice
+ * real range in the same pass.  With \a normalize the real values are
+ * further mapped from data_min..data_max onto the full range of
+ * \a buffer_data_type, otherwise \a buffer_data_type must be
+ * MI_TYPE_FLOAT or MI_TYPE_DOUBLE.
+ *
+ * The work goes through small blocks that stay in cache, so no
+ * hyperslab sized intermediate is needed.  \a voxels may be the same
+ * memory as \a buffer as long as the buffer elements are at least as
+ * large as the voxels: blocks are converted from the end towards the
+ * start, so no voxel is overwritten before it has been read.
+ */
+static int miconvert_voxel_slices(mitype_t voxel_type, const void *voxels,
+                                  mitype_t buffer_data_type, void *buffer,
+                                  hsize_t total_number_of_slices,
+                                  hsize_t image_slice_length,
+                                  const double *image_slice_min_buffer,
+                                  const double *image_slice_max_buffer,
+                                  double voxel_min, double voxel_max,
+                                  int scaling_needed, int normalize,
+                                  double data_min, double data_max)
+{
+  double block_real[MI2_CONVERT_BLOCK];
+  double block_voxels[MI2_CONVERT_BLOCK]; /* Widest voxel type is double. */
+  size_t voxel_size = mitype_len(voxel_type);
+  size_t buffer_size = mitype_len(buffer_data_type);
+  hsize_t end = total_number_of_slices * image_slice_length;
+
+  while (end > 0) {
+    hsize_t slice = (end - 1) / image_slice_length;
+    hsize_t begin = slice * image_slice_length;
+    size_t n;
+    unsigned char *out;
+    double scale = 1.0;
+    double offset = 0.0;
+
+    if (end - begin > MI2_CONVERT_BLOCK) {
+      begin = end - MI2_CONVERT_BLOCK;
+    }
+    n = (size_t)(end - begin);
+    out = (unsigned char *) buffer + begin * buffer_size;
+
+    if (scaling_needed && !normalize) {
+      scale = (image_slice_max_buffer[slice] - image_slice_min_buffer[slice]) / (voxel_max - voxel_min);
+      offset = image_slice_min_buffer[slice] - voxel_min * scale;
+    }
+
+    memcpy(block_voxels, (const unsigned char *) voxels + begin * voxel_size, n * voxel_size);
+
+    if (!normalize) {
+      if (miscale_to_real(voxel_type, block_voxels, buffer_data_type, out, n, scale, offset) < 0) {
+        return (MI_ERROR);
+      }
+    } else {
+      double slice_min = image_slice_min_buffer[slice];
+      double slice_max = image_slice_max_buffer[slice];
+
+      /* Only widen here: normalized reads keep their own order of
+       * operations so that values on rounding boundaries don't move.
+       */
+      if (miscale_to_real(voxel_type, block_voxels, MI_TYPE_DOUBLE, block_real, n, 1.0, 0.0) < 0) {
+        return (MI_ERROR);
+      }
+      /*WARNING: floating point types will be normalized between 0.0 and 1.0*/
+      switch (buffer_data_type) {
+        case MI_TYPE_FLOAT:
+          APPLY_DESCALING_NORM(float,block_real,out,n,slice_min,slice_max,voxel_min,voxel_max,data_min,data_max,0.0f,1.0f);
+          break;
+        case MI_TYPE_DOUBLE:
+          APPLY_DESCALING_NORM(double,block_real,out,n,slice_min,slice_max,voxel_min,voxel_max,data_min,data_max,0.0,1.0);
+          break;
+        case MI_TYPE_INT:
+          APPLY_DESCALING_NORM(int,block_real,out,n,slice_min,slice_max,voxel_min,voxel_max,data_min,data_max,INT_MIN,INT_MAX);
+          break;
+        case MI_TYPE_UINT:
+          APPLY_DESCALING_NORM(unsigned int,block_real,out,n,slice_min,slice_max,voxel_min,voxel_max,data_min,data_max,0,UINT_MAX);
+          break;
+        case MI_TYPE_SHORT:
+          APPLY_DESCALING_NORM(short,block_real,out,n,slice_min,slice_max,voxel_min,voxel_max,data_min,data_max,SHRT_MIN,SHRT_MAX);
+          break;
+        case MI_TYPE_USHORT:
+          APPLY_DESCALING_NORM(unsigned short,block_real,out,n,slice_min,slice_max,voxel_min,voxel_max,data_min,data_max,0,USHRT_MAX);
+          break;
+        case MI_TYPE_BYTE:
+          APPLY_DESCALING_NORM(char,block_real,out,n,slice_min,slice_max,voxel_min,voxel_max,data_min,data_max,SCHAR_MIN,SCHAR_MAX);
+          break;
+        case MI_TYPE_UBYTE:
+          APPLY_DESCALING_NORM(unsigned char,block_real,out,n,slice_min,slice_max,voxel_min,voxel_max,data_min,data_max,0,UCHAR_MAX);
+          break;
+        default:
+          return MI_LOG_ERROR(MI2_MSG_BADTYPE, buffer_data_type);
+      }
+    }
+    end = begin;
+  }
+  return (MI_NOERROR);
+}
+
+/** Convert the real valued \a buffer of type \a buffer_data_type,
+ * slice by slice, into voxels of the volume type and write them to the
+ * selected hyperslab.
+ */
+static int miwrite_real_slices(mihandle_t volume,
+                               hid_t dset_id, hid_t mspc_id, hid_t fspc_id,
+                               int ndims, const hsize_t hdf_start[],
+                               const hsize_t hdf_count[],
+                               mitype_t buffer_data_type, const void *buffer,
+                               hsize_t total_number_of_slices,
+                               hsize_t image_slice_length,
+                               const double *image_slice_min_buffer,
+                               const double *image_slice_max_buffer,
+                               double voxel_min, double voxel_max)
+{
+  size_t voxel_size = H5Tget_size(volume->mtype_id);
+  size_t real_size = mitype_len(buffer_data_type);
+  unsigned char *voxels;
+  hsize_t i;
+  int result = MI_NOERROR;
+
+  voxels = malloc(total_number_of_slices * image_slice_length * voxel_size);
+  if (voxels == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_OUTOFMEM, total_number_of_slices * image_slice_length * voxel_size);
+  }
+
+  for (i = 0; result >= 0 && i < total_number_of_slices; i++) {
+    double scale = (voxel_max - voxel_min) / (image_slice_max_buffer[i] - image_slice_min_buffer[i]);
+    double offset = voxel_min - image_slice_min_buffer[i] * scale;
+
+    result = miscale_from_real(buffer_data_type,
+                               (const unsigned char *) buffer + i * image_slice_length * real_size,
+                               volume->volume_type,
+                               voxels + i * image_slice_length * voxel_size,
+                               image_slice_length, scale, offset);
+  }
+
+  if (result >= 0) {
+    result = miwrite_hyperslab_data(volume, dset_id, volume->mtype_id, mspc_id, fspc_id,
+                                    ndims, hdf_start, hdf_count, voxels);
+  }
+  free(voxels);
+  return (result < 0 ? MI_ERROR : MI_NOERROR);
+}
+
 /** Read/write a hyperslab of data, performing dimension remapping
  * and data rescaling as needed.
  */
@@ -371,7 +806,7 @@ static int mirw_hyperslab_icv(int opcode,
   double *image_slice_max_buffer=NULL;
   double *image_slice_min_buffer=NULL;
   int scaling_needed=0;
-  char path[MI2_MAX_PATH];
+  int use_kernels=0;
   
   hsize_t image_slice_start[MI2_MAX_VAR_DIMS];
   hsize_t image_slice_count[MI2_MAX_VAR_DIMS];
@@ -387,46 +822,24 @@ static int mirw_hyperslab_icv(int opcode,
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to write to a volume thumbnail");
   }
   
-  sprintf(path, MI_ROOT_PATH "/image/%d/image", volume->selected_resolution);
-  /*printf("Using:%s\n",path);*/
-  
-  /* Open the dataset with the specified path
-  */
-  MI_CHECK_HDF_CALL(dset_id = H5Dopen1(volume->hdf_id, path),"H5Dopen1");
-  if (dset_id < 0) {
+  if (miget_image_dataset(volume, &dset_id, &fspc_id) < 0) {
     return (MI_ERROR);
   }
 
-  MI_CHECK_HDF_CALL(fspc_id = H5Dget_space(dset_id),"H5Dget_space");
-  if (fspc_id < 0) {
-    goto cleanup;
+  if ((buffer_type_id = miget_buffer_type(volume, buffer_data_type)) < 0) {
+    return (MI_ERROR);
   }
 
- 
-  buffer_type_id = mitype_to_hdftype(buffer_data_type, TRUE);
-  if(buffer_type_id<0)
-  {
-    goto cleanup;
-  }
-  
   ndims = volume->number_of_dims;
   
   if (ndims == 0) {
-    /* A scalar volume is possible but extremely unlikely, not to
-     * mention useless!
-     */
-    mspc_id = H5Screate(H5S_SCALAR);
     hdf_count[0]=1; 
   } else {
-
     n_different = mitranslate_hyperslab_origin(volume, start, count, hdf_start, hdf_count, dir);
+  }
 
-    mspc_id = H5Screate_simple(ndims, hdf_count, NULL);
-    
-    if (mspc_id < 0) {
-      fprintf(stderr,"H5Screate_simple: Fail %s:%d\n",__FILE__,__LINE__);
-      goto cleanup;
-    }
+  if ((mspc_id = miget_hyperslab_mspc(volume, ndims, hdf_count)) < 0) {
+    return (MI_ERROR);
   }
   
   miget_hyperslab_size_hdf(buffer_type_id, ndims, hdf_count, &buffer_size);
@@ -448,28 +861,15 @@ static int mirw_hyperslab_icv(int opcode,
   
   if(volume->has_slice_scaling)
   {
-    hid_t image_max_fspc_id;
-    hid_t image_min_fspc_id;
-    hid_t scaling_mspc_id;
     total_number_of_slices=1;
     image_slice_length=1;
     scaling_needed=1;
 
-    image_max_fspc_id=H5Dget_space(volume->imax_id);
-    image_min_fspc_id=H5Dget_space(volume->imin_id);
-
-    if ( image_max_fspc_id < 0 ) {
-      /*Report error that image-max is not found!*/
-      return ( MI_ERROR );
-    }
-
-    slice_ndims = H5Sget_simple_extent_ndims ( image_max_fspc_id );
-    if(slice_ndims<0)
-    {
-      /*TODO: report read error somehow*/
-      fprintf(stderr,"H5Sget_simple_extent_ndims: Fail %s:%d\n",__FILE__,__LINE__);
+    if ( miload_slice_ranges ( volume ) < 0 ) {
+      result = MI_ERROR;
       goto cleanup;
     }
+    slice_ndims = volume->range_rank;
 
     if ( (hsize_t)slice_ndims > ndims ) { /*Can this really happen?*/
       slice_ndims = ndims;
@@ -508,34 +908,12 @@ static int mirw_hyperslab_icv(int opcode,
       goto cleanup;
     }
     
-    scaling_mspc_id = H5Screate_simple(slice_ndims, image_slice_count, NULL);
-    
-    if( (result=H5Sselect_hyperslab(image_max_fspc_id, H5S_SELECT_SET, image_slice_start, NULL, image_slice_count, NULL))>=0 )
-    {
-      if((result=H5Dread(volume->imax_id, H5T_NATIVE_DOUBLE, scaling_mspc_id, image_max_fspc_id, H5P_DEFAULT,image_slice_max_buffer))<0)
-      {
-        MI_LOG_ERROR(MI2_MSG_HDF5,"H5Dread");
-        goto cleanup;
-      }
-    } else {
-      MI_LOG_ERROR(MI2_MSG_HDF5,"H5Sselect_hyperslab");
-      goto cleanup;
-    }
-    
-    if((result=H5Sselect_hyperslab(image_min_fspc_id, H5S_SELECT_SET, image_slice_start, NULL, image_slice_count, NULL))>=0 )
-    {
-      if((result=H5Dread(volume->imin_id, H5T_NATIVE_DOUBLE, scaling_mspc_id, image_min_fspc_id, H5P_DEFAULT,image_slice_min_buffer))<0)
-      {
-        MI_LOG_ERROR(MI2_MSG_HDF5,"H5Dread");
-        goto cleanup;
-      }
-    } else {
-      /*TODO: report read error somehow*/
-      MI_LOG_ERROR(MI2_MSG_HDF5,"H5Sselect_hyperslab");
+    if ((result = miget_cached_slice_ranges(volume, image_slice_start,
+                                            image_slice_count,
+                                            image_slice_max_buffer,
+                                            image_slice_min_buffer)) < 0) {
       goto cleanup;
     }
-    H5Sclose(scaling_mspc_id);
-    H5Sclose(image_max_fspc_id);
   } else {
     slice_ndims=0;
     total_number_of_slices=1;
@@ -559,13 +937,39 @@ static int mirw_hyperslab_icv(int opcode,
   {
     scaling_needed=0;
   } 
+
+  /* Real valued buffers over integer voxels are converted by the
+   * scaling kernels straight from the stored values.
+   */
+  use_kernels = (buffer_data_type == MI_TYPE_FLOAT || buffer_data_type == MI_TYPE_DOUBLE) &&
+                (volume->volume_class == MI_CLASS_REAL || volume->volume_class == MI_CLASS_INT) &&
+                miscale_supported(volume->volume_type) &&
+                volume->volume_type != MI_TYPE_FLOAT && volume->volume_type != MI_TYPE_DOUBLE;
 #ifdef _DEBUG  
   printf("mirw_hyperslab_icv:Slice_ndim:%d total_number_of_slices:%d image_slice_length:%d scaling_needed:%d\n",slice_ndims,total_number_of_slices,image_slice_length,scaling_needed);
 #endif
 
   if (opcode == MIRW_OP_READ) 
   {
-    MI_CHECK_HDF_CALL(result = H5Dread(dset_id, buffer_type_id, mspc_id, fspc_id, H5P_DEFAULT, buffer),"H5Dread");
+    if (use_kernels) {
+      /* Read the stored voxels straight into the caller's buffer, which
+       * is at least as wide, and scale them there in a single pass.
+       */
+      result = miread_hyperslab_data(volume, dset_id, volume->mtype_id, mspc_id, fspc_id,
+                                     ndims, hdf_start, hdf_count, buffer);
+      if (result >= 0) {
+        result = miconvert_voxel_slices(volume->volume_type, buffer,
+                                        buffer_data_type, buffer,
+                                        total_number_of_slices, image_slice_length,
+                                        image_slice_min_buffer, image_slice_max_buffer,
+                                        volume_valid_min, volume_valid_max,
+                                        scaling_needed, FALSE, 0.0, 0.0);
+      }
+      scaling_needed = 0; /* Already applied. */
+    } else {
+      result = miread_hyperslab_data(volume, dset_id, buffer_type_id, mspc_id, fspc_id,
+                                     ndims, hdf_start, hdf_count, buffer);
+    }
     if(result<0)
     {
       goto cleanup;
@@ -645,6 +1049,11 @@ static int mirw_hyperslab_icv(int opcode,
   } else { /*opcode != MIRW_OP_READ*/
 
     volume->is_dirty = TRUE; /* Mark as modified. */
+    mifree_label_index(volume); /* The labels present may differ. */
+    volume->label_index_stale = TRUE;
+    if (ndims > 0 && volume->selected_resolution == 0) {
+      minc_mark_stale_thumbnails(volume, hdf_start[0], hdf_count[0]);
+    }
     
     if (n_different != 0 ) {
       /* Invert before calling */
@@ -656,7 +1065,31 @@ static int mirw_hyperslab_icv(int opcode,
 
       }
     }
-    if(scaling_needed || n_different != 0) 
+    if (use_kernels && scaling_needed)
+    {
+      const void *input_buffer = buffer;
+
+      if (n_different != 0 )
+      {
+        /*create temporary copy, to be destroyed*/
+        temp_buffer=malloc(buffer_size);
+        if(!temp_buffer)
+        {
+          MI_LOG_ERROR(MI2_MSG_OUTOFMEM,buffer_size);
+          result=MI_ERROR;
+          goto cleanup;
+        }
+        restructure_array_copy(ndims, temp_buffer, buffer, icount, H5Tget_size(buffer_type_id), imap, idir);
+        input_buffer = temp_buffer;
+      }
+      result = miwrite_real_slices(volume, dset_id, mspc_id, fspc_id,
+                                   ndims, hdf_start, hdf_count,
+                                   buffer_data_type, input_buffer,
+                                   total_number_of_slices, image_slice_length,
+                                   image_slice_min_buffer, image_slice_max_buffer,
+                                   volume_valid_min, volume_valid_max);
+    }
+    else if(scaling_needed || n_different != 0) 
     {
       /*create temporary copy, to be destroyed*/
       temp_buffer=malloc(buffer_size);
@@ -666,10 +1099,10 @@ static int mirw_hyperslab_icv(int opcode,
         result=MI_ERROR; /*TODO: error code?*/
         goto cleanup;
       }
-      memcpy(temp_buffer,buffer,buffer_size);
-
       if (n_different != 0 )
-        restructure_array(ndims, temp_buffer, icount, H5Tget_size(buffer_type_id), imap, idir);
+        restructure_array_copy(ndims, temp_buffer, buffer, icount, H5Tget_size(buffer_type_id), imap, idir);
+      else
+        memcpy(temp_buffer,buffer,buffer_size);
 
       if(scaling_needed)
       {
@@ -729,9 +1162,11 @@ static int mirw_hyperslab_icv(int opcode,
             goto cleanup;
         }
       }
-      MI_CHECK_HDF_CALL(result = H5Dwrite(dset_id, buffer_type_id, mspc_id, fspc_id, H5P_DEFAULT, temp_buffer),"H5Dwrite");
+      result = miwrite_hyperslab_data(volume, dset_id, buffer_type_id, mspc_id, fspc_id,
+                                      ndims, hdf_start, hdf_count, temp_buffer);
     } else {
-      MI_CHECK_HDF_CALL(result = H5Dwrite(dset_id, buffer_type_id, mspc_id, fspc_id, H5P_DEFAULT, buffer),"H5Dwrite");
+      result = miwrite_hyperslab_data(volume, dset_id, buffer_type_id, mspc_id, fspc_id,
+                                      ndims, hdf_start, hdf_count, buffer);
     }
     
     if(result<0)
@@ -742,19 +1177,6 @@ static int mirw_hyperslab_icv(int opcode,
       
 cleanup:
 
-  if (buffer_type_id >= 0) {
-    H5Tclose(buffer_type_id);
-  }
-  if (mspc_id >= 0) {
-    H5Sclose(mspc_id);
-  }
-  if (fspc_id >= 0) {
-    H5Sclose(fspc_id);
-  }
-  if ( dset_id >=0 ) {
-    H5Dclose(dset_id);
-  }
-  
   if(temp_buffer!=NULL)
   {
     free(temp_buffer);
@@ -770,30 +1192,6 @@ cleanup:
   return (result);
 }
 
-#define APPLY_DESCALING_NORM(type_out,buffer_in,buffer_out,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,voxel_min,voxel_max,data_min,data_max,norm_min,norm_max) \
-  { \
-    hsize_t _i,_j;\
-    double voxel_offset=voxel_min;\
-    double voxel_range=voxel_max-voxel_min;\
-    double norm_offset=norm_min;\
-    double norm_range=(double)norm_max-(double)norm_min;\
-    double data_offset=data_min;\
-    double data_range=(double)data_max-(double)data_min;\
-    type_out *_buffer_out=(type_out *)buffer_out;\
-    double *_buffer_in=(double *)buffer_in; \
-    for(_i=0;_i<total_number_of_slices;_i++)\
-      for(_j=0;_j<image_slice_length;_j++)\
-      {\
-        double _temp=(( (*_buffer_in) - voxel_offset) / voxel_range)*(image_slice_max_buffer[_i]-image_slice_min_buffer[_i]) + image_slice_min_buffer[_i] ;\
-        _temp=(_temp-data_offset)/data_range;\
-        _temp=(_temp<0.0)?norm_min:(_temp>=1.0)?norm_max:(rint(_temp*norm_range)+norm_offset); \
-        *_buffer_out=(type_out)(_temp);\
-        _buffer_in++;\
-        _buffer_out++;\
-      }\
-  }
-
-
 #define APPLY_SCALING_NORM(type_in,buffer_in,buffer_out,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,voxel_min,voxel_max,data_min,data_max,norm_min,norm_max) \
   { \
     hsize_t _i,_j;\
@@ -852,8 +1250,6 @@ static int mirw_hyperslab_normalized(int opcode,
   int imap[MI2_MAX_VAR_DIMS];
   double *image_slice_max_buffer=NULL;
   double *image_slice_min_buffer=NULL;
-
-  char path[MI2_MAX_PATH];
   
   hsize_t image_slice_start[MI2_MAX_VAR_DIMS];
   hsize_t image_slice_count[MI2_MAX_VAR_DIMS];
@@ -870,49 +1266,26 @@ static int mirw_hyperslab_normalized(int opcode,
     return (MI_ERROR);
   }
   
-  sprintf(path, MI_ROOT_PATH "/image/%d/image", volume->selected_resolution);
-
-  /* Open the dataset with the specified path
-  */
-  MI_CHECK_HDF_CALL(dset_id = H5Dopen1(volume->hdf_id, path),"H5Dopen1");
-  if (dset_id < 0) {
+  if (miget_image_dataset(volume, &dset_id, &fspc_id) < 0) {
     return (MI_ERROR);
   }
 
-  MI_CHECK_HDF_CALL(fspc_id = H5Dget_space(dset_id),"H5Dget_space");
-  if (fspc_id < 0) {
-    /*TODO: report can't get dataset*/
-    goto cleanup;
-  }
-  buffer_type_id = mitype_to_hdftype(buffer_data_type,TRUE);
-  if(buffer_type_id<0)
-  {
-    goto cleanup;
+  if ((buffer_type_id = miget_buffer_type(volume, buffer_data_type)) < 0) {
+    return (MI_ERROR);
   }
-  
-  MI_CHECK_HDF_CALL(volume_type_id = H5Tcopy ( H5T_NATIVE_DOUBLE ),"H5Tcopy");
-  if(volume_type_id<0)
-  {
-    fprintf(stderr,"H5Tcopy: Fail %s:%d\n",__FILE__,__LINE__);
-    goto cleanup;
+
+  if ((volume_type_id = miget_buffer_type(volume, MI_TYPE_DOUBLE)) < 0) {
+    return (MI_ERROR);
   }
   
   ndims = volume->number_of_dims;
   
-  if (ndims == 0) {
-    /* A scalar volume is possible but extremely unlikely, not to
-     * mention useless!
-     */
-    mspc_id = H5Screate(H5S_SCALAR);
-  } else {
-
+  if (ndims != 0) {
     n_different = mitranslate_hyperslab_origin(volume,start,count, hdf_start,hdf_count,dir);
+  }
 
-    MI_CHECK_HDF_CALL(mspc_id = H5Screate_simple(ndims, hdf_count, NULL),"H5Screate_simple");
-    
-    if (mspc_id < 0) {
-      goto cleanup;
-    }
+  if ((mspc_id = miget_hyperslab_mspc(volume, ndims, hdf_count)) < 0) {
+    return (MI_ERROR);
   }
   
   miget_hyperslab_size_hdf(volume_type_id,ndims,hdf_count,&buffer_size);
@@ -934,25 +1307,14 @@ static int mirw_hyperslab_normalized(int opcode,
     !(volume->volume_type==MI_TYPE_FLOAT    || volume->volume_type==MI_TYPE_DOUBLE || 
       volume->volume_type==MI_TYPE_FCOMPLEX || volume->volume_type==MI_TYPE_DCOMPLEX) )
   {
-    hid_t image_max_fspc_id;
-    hid_t image_min_fspc_id;
-    hid_t scaling_mspc_id;
     total_number_of_slices=1;
     image_slice_length=1;
 
-    MI_CHECK_HDF_CALL(image_max_fspc_id=H5Dget_space(volume->imax_id),"H5Dget_space");
-    MI_CHECK_HDF_CALL(image_min_fspc_id=H5Dget_space(volume->imin_id),"H5Dget_space");
-
-    if ( image_max_fspc_id < 0 || image_min_fspc_id<0 ) {
-      result=MI_ERROR;
-      goto cleanup;
-    }
-
-    MI_CHECK_HDF_CALL(slice_ndims = H5Sget_simple_extent_ndims ( image_max_fspc_id ),"H5Sget_simple_extent_ndims");
-    if(slice_ndims<0)
-    {
+    if ( miload_slice_ranges ( volume ) < 0 ) {
+      result = MI_ERROR;
       goto cleanup;
     }
+    slice_ndims = volume->range_rank;
 
     if ( (hsize_t)slice_ndims > ndims ) { /*Can this really happen?*/
       slice_ndims = ndims;
@@ -978,34 +1340,13 @@ static int mirw_hyperslab_normalized(int opcode,
     image_slice_min_buffer=malloc(total_number_of_slices*sizeof(double));
     /*TODO check for allocation failure ?*/
     
-    MI_CHECK_HDF_CALL(scaling_mspc_id = H5Screate_simple(slice_ndims, image_slice_count, NULL),"H5Screate_simple");
-    
-    if( (result=H5Sselect_hyperslab(image_max_fspc_id, H5S_SELECT_SET, image_slice_start, NULL, image_slice_count, NULL))>=0 )
-    {
-      if( ( result=H5Dread(volume->imax_id, H5T_NATIVE_DOUBLE, scaling_mspc_id, image_max_fspc_id, H5P_DEFAULT,image_slice_max_buffer))<0)
-      {
-        MI_LOG_ERROR(MI2_MSG_HDF5,"H5Dread");
-        goto cleanup;
-      }
-    } else {
-      MI_LOG_ERROR(MI2_MSG_HDF5,"H5Sselect_hyperslab");
+    if ((result = miget_cached_slice_ranges(volume, image_slice_start,
+                                            image_slice_count,
+                                            image_slice_max_buffer,
+                                            image_slice_min_buffer)) < 0) {
       goto cleanup;
     }
     
-    if( (result=H5Sselect_hyperslab(image_min_fspc_id, H5S_SELECT_SET, image_slice_start, NULL, image_slice_count, NULL))>=0 )
-    {
-      if( (result=H5Dread(volume->imin_id, H5T_NATIVE_DOUBLE, scaling_mspc_id, image_min_fspc_id, H5P_DEFAULT,image_slice_min_buffer))<0)
-      {
-        MI_LOG_ERROR(MI2_MSG_HDF5,"H5Dread");
-        goto cleanup;
-      }
-    } else {
-      MI_LOG_ERROR(MI2_MSG_HDF5,"H5Sselect_hyperslab");
-      goto cleanup;
-    }
-    H5Sclose(scaling_mspc_id);
-    H5Sclose(image_max_fspc_id);
-    
   } else {
     slice_ndims=0;
     total_number_of_slices=1;
@@ -1026,54 +1367,54 @@ static int mirw_hyperslab_normalized(int opcode,
   printf("mirw_hyperslab_normalized:data min:%f data max:%f buffer_data_type:%d\n",data_min,data_max,buffer_data_type);
 #endif
 
-  /*Allocate temporary Buffer*/
-  temp_buffer=(double*)malloc(buffer_size);
-  if(!temp_buffer)
-  {
-    MI_LOG_ERROR(MI2_MSG_OUTOFMEM,buffer_size);
-    result=MI_ERROR;
-    goto cleanup;
-  }
-  
   if (opcode == MIRW_OP_READ) 
   {
-    MI_CHECK_HDF_CALL(result = H5Dread(dset_id, volume_type_id, mspc_id, fspc_id, H5P_DEFAULT, temp_buffer),"H5Dread");
+    mitype_t voxel_type = volume->volume_type;
+    hid_t voxel_type_id = volume->mtype_id;
+    void *voxels = buffer;
+
+    /* Let HDF5 widen the voxels to double only for types the scaling
+     * kernels don't handle.
+     */
+    if (!miscale_supported(volume->volume_type) ||
+        (volume->volume_class != MI_CLASS_REAL && volume->volume_class != MI_CLASS_INT)) {
+      voxel_type = MI_TYPE_DOUBLE;
+      voxel_type_id = volume_type_id;
+    }
+
+    /* Voxels are read in place when the caller's buffer is wide enough,
+     * otherwise into a buffer of the stored type.
+     */
+    if (H5Tget_size(voxel_type_id) > H5Tget_size(buffer_type_id)) {
+      misize_t voxels_size;
+
+      miget_hyperslab_size_hdf(voxel_type_id,ndims,hdf_count,&voxels_size);
+      temp_buffer=malloc(voxels_size);
+      if(!temp_buffer)
+      {
+        MI_LOG_ERROR(MI2_MSG_OUTOFMEM,voxels_size);
+        result=MI_ERROR;
+        goto cleanup;
+      }
+      voxels = temp_buffer;
+    }
+
+    result = miread_hyperslab_data(volume, dset_id, voxel_type_id, mspc_id, fspc_id,
+                                   ndims, hdf_start, hdf_count, voxels);
     if(result<0)
     {
       goto cleanup;
     }
-    
-    /*WARNING: floating point types will be normalized between 0.0 and 1.0*/
-    switch(buffer_data_type)
+
+    result = miconvert_voxel_slices(voxel_type, voxels,
+                                    buffer_data_type, buffer,
+                                    total_number_of_slices, image_slice_length,
+                                    image_slice_min_buffer, image_slice_max_buffer,
+                                    volume_valid_min, volume_valid_max,
+                                    TRUE, TRUE, data_min, data_max);
+    if(result<0)
     {
-      case MI_TYPE_FLOAT:
-        APPLY_DESCALING_NORM(float,temp_buffer,buffer,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,volume_valid_min,volume_valid_max,data_min,data_max,0.0f,1.0f);
-        break;
-      case MI_TYPE_DOUBLE:
-        APPLY_DESCALING_NORM(double,temp_buffer,buffer,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,volume_valid_min,volume_valid_max,data_min,data_max,0.0,1.0);
-        break;
-      case MI_TYPE_INT:
-        APPLY_DESCALING_NORM(int,temp_buffer,buffer,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,volume_valid_min,volume_valid_max,data_min,data_max,INT_MIN,INT_MAX);
-        break;
-      case MI_TYPE_UINT:
-        APPLY_DESCALING_NORM(unsigned int,temp_buffer,buffer,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,volume_valid_min,volume_valid_max,data_min,data_max,0,UINT_MAX);
-        break;
-      case MI_TYPE_SHORT:
-        APPLY_DESCALING_NORM(short,temp_buffer,buffer,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,volume_valid_min,volume_valid_max,data_min,data_max,SHRT_MIN,SHRT_MAX);
-        break;
-      case MI_TYPE_USHORT:
-        APPLY_DESCALING_NORM(unsigned short,temp_buffer,buffer,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,volume_valid_min,volume_valid_max,data_min,data_max,0,USHRT_MAX);
-        break;
-      case MI_TYPE_BYTE:
-        APPLY_DESCALING_NORM(char,temp_buffer,buffer,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,volume_valid_min,volume_valid_max,data_min,data_max,SCHAR_MIN,SCHAR_MAX);
-        break;
-      case MI_TYPE_UBYTE:
-        APPLY_DESCALING_NORM(unsigned char,temp_buffer,buffer,image_slice_length,total_number_of_slices,image_slice_min_buffer,image_slice_max_buffer,volume_valid_min,volume_valid_max,data_min,data_max,0,UCHAR_MAX);
-        break;
-      default:
-        /*TODO: report unsupported conversion*/
-        result=MI_ERROR;
-        goto cleanup;
+      goto cleanup;
     }
     
     if (n_different != 0 ) {
@@ -1087,6 +1428,20 @@ static int mirw_hyperslab_normalized(int opcode,
   } else { /*opcode != MIRW_OP_READ*/
     void *temp_buffer2;
     volume->is_dirty = TRUE; /* Mark as modified. */
+    mifree_label_index(volume); /* The labels present may differ. */
+    volume->label_index_stale = TRUE;
+    if (ndims > 0 && volume->selected_resolution == 0) {
+      minc_mark_stale_thumbnails(volume, hdf_start[0], hdf_count[0]);
+    }
+
+    /*Allocate temporary Buffer*/
+    temp_buffer=(double*)malloc(buffer_size);
+    if(!temp_buffer)
+    {
+      MI_LOG_ERROR(MI2_MSG_OUTOFMEM,buffer_size);
+      result=MI_ERROR;
+      goto cleanup;
+    }
     
     if (n_different != 0 ) {
       /* Invert before calling */
@@ -1107,10 +1462,10 @@ static int mirw_hyperslab_normalized(int opcode,
       result=MI_ERROR; /*TODO: error code?*/
       goto cleanup;
     }
-    memcpy(temp_buffer2,buffer,input_buffer_size);
-    
     if (n_different != 0 ) 
-      restructure_array(ndims, temp_buffer2, icount, H5Tget_size(buffer_type_id), imap, idir);
+      restructure_array_copy(ndims, temp_buffer2, buffer, icount, H5Tget_size(buffer_type_id), imap, idir);
+    else
+      memcpy(temp_buffer2,buffer,input_buffer_size);
     
     switch(buffer_data_type)
     {
@@ -1146,7 +1501,8 @@ static int mirw_hyperslab_normalized(int opcode,
     }
     free(temp_buffer2);
     
-    MI_CHECK_HDF_CALL(result = H5Dwrite(dset_id, volume_type_id, mspc_id, fspc_id, H5P_DEFAULT, temp_buffer),"H5Dwrite");
+    result = miwrite_hyperslab_data(volume, dset_id, volume_type_id, mspc_id, fspc_id,
+                                    ndims, hdf_start, hdf_count, temp_buffer);
     if(result<0)
     {
       goto cleanup;
@@ -1155,21 +1511,6 @@ static int mirw_hyperslab_normalized(int opcode,
       
 cleanup:
 
-  if (volume_type_id >= 0) {
-    H5Tclose(volume_type_id);
-  }
-  if (buffer_type_id >= 0) {
-    H5Tclose(buffer_type_id);
-  }
-  if (mspc_id >= 0) {
-    H5Sclose(mspc_id);
-  }
-  if (fspc_id >= 0) {
-    H5Sclose(fspc_id);
-  }
-  if ( dset_id >=0 ) {
-    H5Dclose(dset_id);
-  }
   if(temp_buffer!=NULL)
   {
     free(temp_buffer);
@@ -40,6 +40,191 @@ static int miswap4(unsigned int tmp)
     return (tmp);
 }
 
+/** \internal
+ * Dictionary of the labels of a volume, built from its enumerated type
+ * when first needed, with hash tables from values and from names to the
+ * index of each label.
+ */
+struct milabeldict {
+  int n_labels;
+  int *values;                  /* In the order of the enumerated type */
+  char **names;
+  int *by_value;                /* Index + 1 of a label, or 0 */
+  int *by_name;
+  unsigned int mask;
+};
+
+static unsigned int milabel_hash_value(int value)
+{
+  return ((unsigned int) value * 2654435761u);
+}
+
+static unsigned int milabel_hash_name(const char *name)
+{
+  unsigned int h = 2166136261u;
+
+  for (; *name != '\0'; name++) {
+    h = (h ^ (unsigned char) *name) * 16777619u;
+  }
+  return (h);
+}
+
+/** \internal
+ * Frees the label dictionary of a volume, which is built again when
+ * next needed.
+ */
+void mifree_label_dictionary(mihandle_t volume)
+{
+  struct milabeldict *dict = volume->label_dict;
+  int i;
+
+  if (dict == NULL) {
+    return;
+  }
+  for (i = 0; i < dict->n_labels; i++) {
+    free(dict->names[i]);
+  }
+  free(dict->values);
+  free(dict->names);
+  free(dict->by_value);
+  free(dict->by_name);
+  free(dict);
+  volume->label_dict = NULL;
+}
+
+/** \internal
+ * Returns the label dictionary of a volume, reading the members of its
+ * enumerated type the first time.
+ */
+static struct milabeldict *miget_label_dictionary(mihandle_t volume)
+{
+  struct milabeldict *dict;
+  hid_t base_id;
+  size_t base_size;
+  H5T_sign_t sign;
+  unsigned int table_size;
+  int n;
+  int i;
+
+  if (volume->label_dict != NULL) {
+    return (volume->label_dict);
+  }
+  if (volume->volume_class != MI_CLASS_LABEL || volume->mtype_id <= 0) {
+    return (NULL);
+  }
+
+  H5E_BEGIN_TRY {
+    n = H5Tget_nmembers(volume->mtype_id);
+  } H5E_END_TRY;
+  if (n < 0) {
+    return (NULL);
+  }
+
+  dict = (struct milabeldict *) calloc(1, sizeof(struct milabeldict));
+  if (dict == NULL) {
+    MI_LOG_ERROR(MI2_MSG_OUTOFMEM, sizeof(struct milabeldict));
+    return (NULL);
+  }
+  for (table_size = 16; table_size < 2 * (unsigned int) n; table_size *= 2)
+    ;
+  dict->mask = table_size - 1;
+  dict->values = (int *) malloc((n + 1) * sizeof(int));
+  dict->names = (char **) calloc(n + 1, sizeof(char *));
+  dict->by_value = (int *) calloc(table_size, sizeof(int));
+  dict->by_name = (int *) calloc(table_size, sizeof(int));
+  volume->label_dict = dict;
+  if (dict->values == NULL || dict->names == NULL ||
+      dict->by_value == NULL || dict->by_name == NULL) {
+    mifree_label_dictionary(volume);
+    MI_LOG_ERROR(MI2_MSG_OUTOFMEM, table_size * sizeof(int));
+    return (NULL);
+  }
+
+  /* The member values have the size and sign of the base type. */
+  base_id = H5Tget_super(volume->mtype_id);
+  base_size = H5Tget_size(base_id);
+  sign = H5Tget_sign(base_id);
+  H5Tclose(base_id);
+
+  for (i = 0; i < n; i++) {
+    unsigned char raw[sizeof(long long)];
+    char *name;
+    unsigned int slot;
+    int value;
+
+    if (H5Tget_member_value(volume->mtype_id, i, raw) < 0 ||
+        (name = H5Tget_member_name(volume->mtype_id, i)) == NULL) {
+      mifree_label_dictionary(volume);
+      return (NULL);
+    }
+    switch (base_size) {
+    case 1:
+      value = (sign == H5T_SGN_2) ? *(signed char *) raw : *(unsigned char *) raw;
+      break;
+    case 2:
+      value = (sign == H5T_SGN_2) ? *(short *) raw : *(unsigned short *) raw;
+      break;
+    default:
+      value = *(int *) raw;
+      break;
+    }
+
+    /* The names come from the HDF5 library, which may use its own
+     * allocator, so they are copied.
+     */
+    dict->names[i] = strdup(name);
+    H5free_memory(name);
+    if (dict->names[i] == NULL) {
+      mifree_label_dictionary(volume);
+      return (NULL);
+    }
+    dict->values[i] = value;
+    dict->n_labels = i + 1;
+
+    for (slot = milabel_hash_value(value) & dict->mask; dict->by_value[slot] != 0;
+         slot = (slot + 1) & dict->mask)
+      ;
+    dict->by_value[slot] = i + 1;
+    for (slot = milabel_hash_name(dict->names[i]) & dict->mask; dict->by_name[slot] != 0;
+         slot = (slot + 1) & dict->mask)
+      ;
+    dict->by_name[slot] = i + 1;
+  }
+  return (dict);
+}
+
+/** \internal
+ * Finds the index of the label with the given value, or -1.
+ */
+static int mifind_label_value(struct milabeldict *dict, int value)
+{
+  unsigned int slot;
+
+  for (slot = milabel_hash_value(value) & dict->mask; dict->by_value[slot] != 0;
+       slot = (slot + 1) & dict->mask) {
+    if (dict->values[dict->by_value[slot] - 1] == value) {
+      return (dict->by_value[slot] - 1);
+    }
+  }
+  return (-1);
+}
+
+/** \internal
+ * Finds the index of the label with the given name, or -1.
+ */
+static int mifind_label_name(struct milabeldict *dict, const char *name)
+{
+  unsigned int slot;
+
+  for (slot = milabel_hash_name(name) & dict->mask; dict->by_name[slot] != 0;
+       slot = (slot + 1) & dict->mask) {
+    if (!strcmp(dict->names[dict->by_name[slot] - 1], name)) {
+      return (dict->by_name[slot] - 1);
+    }
+  }
+  return (-1);
+}
+
 /**
  * This function associates a label name with an integer value for the given
  * volume. Functions which read and write voxel values will read/write 
@@ -53,6 +238,9 @@ int  midefine_label(mihandle_t volume, int value, const char *name)
     if (volume == NULL || name == NULL) {
         return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to use null volume or variable");
     }
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
 
     if (strlen(name) > MI_LABEL_MAX) {
         return MI_LOG_ERROR(MI2_MSG_GENERIC,"Label name is too long");
@@ -67,6 +255,7 @@ int  midefine_label(mihandle_t volume, int value, const char *name)
     }
 
     MI_CHECK_HDF_CALL_RET(result = H5Tenum_insert(volume->mtype_id, name, &value),"H5Tenum_insert");
+    mifree_label_dictionary(volume);
 
     /* We might have to swap these values before adding them to
      * the file type.
@@ -96,28 +285,35 @@ int  midefine_label(mihandle_t volume, int value, const char *name)
 */
 int miget_label_name(mihandle_t volume, int value, char **name)
 {
-    int result;
+    struct milabeldict *dict;
+    int idx;
 
     if (volume == NULL || name == NULL) {
        return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to use null volume or variable");
     }
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
 
     if (volume->volume_class != MI_CLASS_LABEL) {
-         MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume class is not label");
+        return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume class is not label");
     }
     if (volume->mtype_id <= 0) {
-         MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume is not initialized");
+        return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume is not initialized");
     }
-    *name = malloc(MI_LABEL_MAX);
-    if (*name == NULL) {
-        return MI_LOG_ERROR(MI2_MSG_OUTOFMEM,MI_LABEL_MAX);
+    if ((dict = miget_label_dictionary(volume)) == NULL) {
+        return MI_LOG_ERROR(MI2_MSG_GENERIC,"Can't read the labels of the volume");
+    }
+    if ((idx = mifind_label_value(dict, value)) < 0) {
+        return MI_LOG_ERROR(MI2_MSG_GENERIC,"No label with this value");
     }
 
-    H5E_BEGIN_TRY {
-        result = H5Tenum_nameof(volume->mtype_id, &value, *name, MI_LABEL_MAX);
-    } H5E_END_TRY;
-
-    MI_CHECK_HDF_CALL_RET(result,"H5Tenum_nameof");
+    *name = malloc(MI_LABEL_MAX + 1);
+    if (*name == NULL) {
+        return MI_LOG_ERROR(MI2_MSG_OUTOFMEM,MI_LABEL_MAX + 1);
+    }
+    strncpy(*name, dict->names[idx], MI_LABEL_MAX);
+    (*name)[MI_LABEL_MAX] = '\0';
     return (MI_NOERROR);
 }
 
@@ -127,11 +323,15 @@ int miget_label_name(mihandle_t volume, int value, char **name)
 */
 int miget_label_value(mihandle_t volume, const char *name, int *value_ptr)
 {
-    int result;
+    struct milabeldict *dict;
+    int idx;
 
     if (volume == NULL || name == NULL || value_ptr == NULL) {
         return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to use null volume or variable");
     }
+    if (miload_volume_image(volume) < 0) {
+        return (MI_ERROR);
+    }
 
     if (volume->volume_class != MI_CLASS_LABEL) {
         return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume class is not label");
@@ -140,12 +340,14 @@ int miget_label_value(mihandle_t volume, const char *name, int *value_ptr)
     if (volume->mtype_id <= 0) {
         return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume is not initialized");
     }
+    if ((dict = miget_label_dictionary(volume)) == NULL) {
+        return MI_LOG_ERROR(MI2_MSG_GENERIC,"Can't read the labels of the volume");
+    }
+    if ((idx = mifind_label_name(dict, name)) < 0) {
+        return MI_LOG_ERROR(MI2_MSG_GENERIC,"No label with this name");
+    }
 
-    H5E_BEGIN_TRY {
-        result = H5Tenum_valueof(volume->mtype_id, name, value_ptr);
-    } H5E_END_TRY;
-
-    MI_CHECK_HDF_CALL_RET(result,"H5Tenum_valueof");
+    *value_ptr = dict->values[idx];
     return (MI_NOERROR);
 }
 
@@ -154,11 +356,14 @@ int miget_label_value(mihandle_t volume, const char *name, int *value_ptr)
 */
 int miget_number_of_defined_labels(mihandle_t volume, int *number_of_labels)
 {
-  int result;
+  struct milabeldict *dict;
  
   if (volume == NULL) {
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to use null volume");
   }
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
   if (volume->volume_class != MI_CLASS_LABEL) {
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume class is not label");
   }
@@ -166,14 +371,11 @@ int miget_number_of_defined_labels(mihandle_t volume, int *number_of_labels)
   if (volume->mtype_id <= 0) {
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume is not initialized");
   }
-
-  H5E_BEGIN_TRY {
-    result = H5Tget_nmembers(volume->mtype_id);
-  } H5E_END_TRY;
-
-  MI_CHECK_HDF_CALL_RET(result,"H5Tget_nmembers");
+  if ((dict = miget_label_dictionary(volume)) == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Can't read the labels of the volume");
+  }
   
-  *number_of_labels = result;
+  *number_of_labels = dict->n_labels;
     
   return (MI_NOERROR);
 }
@@ -183,10 +385,14 @@ int miget_number_of_defined_labels(mihandle_t volume, int *number_of_labels)
 */
 int miget_label_value_by_index(mihandle_t volume, int idx, int *value)
 {
-  int result;
+  struct milabeldict *dict;
+
   if (volume == NULL) {
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to use null volume");
   }
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
   if (volume->volume_class != MI_CLASS_LABEL) {
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume class is not label");
   }
@@ -194,13 +400,636 @@ int miget_label_value_by_index(mihandle_t volume, int idx, int *value)
   if (volume->mtype_id <= 0) {
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume is not initialized");
   }
+  if ((dict = miget_label_dictionary(volume)) == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Can't read the labels of the volume");
+  }
+  if (idx < 0 || idx >= dict->n_labels) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Label index out of range");
+  }
+
+  *value = dict->values[idx];
+
+  return (MI_NOERROR);
+}
+
+/** \internal
+ * Finds the native integer type of the labels of a volume: its size, its
+ * sign and the matching MINC type. Reading the labels in this type goes
+ * through the null enum conversion, where the enumerated memory type
+ * would have HDF5 match every voxel by name.
+ */
+static int miget_label_base_type(mihandle_t volume, size_t *size,
+                                 H5T_sign_t *sign, mitype_t *type)
+{
+  hid_t base_id;
+
+  base_id = H5Tget_super(volume->mtype_id);
+  if (base_id < 0) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume type is not an enumerated type");
+  }
+  *size = H5Tget_size(base_id);
+  *sign = H5Tget_sign(base_id);
+  H5Tclose(base_id);
+
+  switch (*size * 2 + (*sign == H5T_SGN_2)) {
+  case 2:
+    *type = MI_TYPE_UBYTE;
+    break;
+  case 3:
+    *type = MI_TYPE_BYTE;
+    break;
+  case 4:
+    *type = MI_TYPE_USHORT;
+    break;
+  case 5:
+    *type = MI_TYPE_SHORT;
+    break;
+  case 8:
+    *type = MI_TYPE_UINT;
+    break;
+  case 9:
+    *type = MI_TYPE_INT;
+    break;
+  default:
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Unsupported label type size");
+  }
+  return (MI_NOERROR);
+}
+
+/** \internal
+ * Widens \a n labels of \a size bytes at the start of \a buffer to int,
+ * replacing each label l with 0 <= l < \a lut_length by lut[l]. Labels
+ * are widened from the last one, so that none is overwritten before it
+ * is read.
+ */
+static void miwiden_labels(int *buffer, misize_t n, size_t size,
+                           H5T_sign_t sign, const int *lut, int lut_length)
+{
+  misize_t i;
+
+  switch (size * 2 + (sign == H5T_SGN_2)) {
+  case 2:
+    for (i = n; i-- > 0; ) {
+      int label = ((const unsigned char *) buffer)[i];
+      buffer[i] = (label < lut_length) ? lut[label] : label;
+    }
+    break;
+  case 3:
+    for (i = n; i-- > 0; ) {
+      int label = ((const signed char *) buffer)[i];
+      buffer[i] = (label >= 0 && label < lut_length) ? lut[label] : label;
+    }
+    break;
+  case 4:
+    for (i = n; i-- > 0; ) {
+      int label = ((const unsigned short *) buffer)[i];
+      buffer[i] = (label < lut_length) ? lut[label] : label;
+    }
+    break;
+  case 5:
+    for (i = n; i-- > 0; ) {
+      int label = ((const short *) buffer)[i];
+      buffer[i] = (label >= 0 && label < lut_length) ? lut[label] : label;
+    }
+    break;
+  default:
+    if (lut_length > 0) {
+      for (i = 0; i < n; i++) {
+        unsigned int label = (unsigned int) buffer[i];
+        if (label < (unsigned int) lut_length) {
+          buffer[i] = lut[label];
+        }
+      }
+    }
+    break;
+  }
+}
+
+/**
+ * Reads a hyperslab of a label volume as native integer labels, in the
+ * order of the dimensions set by miset_apparent_dimension_order().
+ *
+ * The voxels are read in the integer type of the volume and widened to
+ * int in the buffer itself, so HDF5 does no type conversion. If \a lut
+ * is not NULL, each label l with 0 <= l < \a lut_length is replaced by
+ * lut[l] in the same pass, and other labels are left as they are.
+ *
+ * \param volume A label volume handle
+ * \param start Index of the first voxel along each dimension
+ * \param count Number of voxels along each dimension
+ * \param lut Lookup table applied to the labels, or NULL
+ * \param lut_length Number of entries of the lookup table
+ * \param buffer Labels read, one int per voxel
+ */
+int miget_label_hyperslab(mihandle_t volume, const misize_t start[],
+                          const misize_t count[], const int *lut,
+                          int lut_length, int *buffer)
+{
+  size_t size;
+  H5T_sign_t sign;
+  mitype_t type;
+  misize_t n_voxels = 1;
+  int d;
+
+  if (volume == NULL || start == NULL || count == NULL || buffer == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to use null volume or variable");
+  }
+  if (lut == NULL) {
+    lut_length = 0;
+  }
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
+  if (volume->volume_class != MI_CLASS_LABEL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume class is not label");
+  }
+  if (volume->mtype_id <= 0) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume is not initialized");
+  }
+  if (miget_label_base_type(volume, &size, &sign, &type) < 0) {
+    return (MI_ERROR);
+  }
+  if (miget_voxel_value_hyperslab(volume, type, start, count, buffer) < 0) {
+    return (MI_ERROR);
+  }
+
+  for (d = 0; d < volume->number_of_dims; d++) {
+    n_voxels *= count[d];
+  }
+  miwiden_labels(buffer, n_voxels, size, sign, lut, lut_length);
+  return (MI_NOERROR);
+}
 
+/** \internal
+ * Index of the labels present in the image of a label volume: for each
+ * label, sorted by value, the value, the number of voxels and the first
+ * and last voxel indices of its bounding box along each dimension, in
+ * file order.
+ */
+struct milabelindex {
+  int n_labels;
+  int ndims;
+  mi_i64_t *entries;            /* n_labels rows of MI2_LABEL_INDEX_ROW */
+};
+
+#define MI2_LABEL_INDEX_PATH MI_FULLIMAGE_PATH "/label-index"
+#define MI2_LABEL_INDEX_ROW(ndims) (2 + 2 * (ndims))
+
+/* Voxels read at a time when the image is scanned. */
+#define MI2_LABEL_SCAN_VOXELS (1 << 20)
+
+/** \internal
+ * Frees the label index of a volume.
+ */
+void mifree_label_index(mihandle_t volume)
+{
+  if (volume->label_index != NULL) {
+    free(volume->label_index->entries);
+    free(volume->label_index);
+    volume->label_index = NULL;
+  }
+}
+
+static int micompare_label_entries(const void *a, const void *b)
+{
+  mi_i64_t va = *(const mi_i64_t *) a;
+  mi_i64_t vb = *(const mi_i64_t *) b;
+
+  return ((va > vb) - (va < vb));
+}
+
+/** \internal
+ * Adds a run of \a length voxels of label \a value, starting at
+ * \a coords, to the index under construction. The table maps values to
+ * entry indices + 1 and is grown with the entries.
+ */
+static int miadd_label_run(struct milabelindex *index, int **table,
+                           int *table_size, int *capacity, int value,
+                           const hsize_t coords[], hsize_t length)
+{
+  int row = MI2_LABEL_INDEX_ROW(index->ndims);
+  int ndims = index->ndims;
+  unsigned int slot;
+  mi_i64_t *entry;
+  int d;
+
+  for (slot = milabel_hash_value(value) & (*table_size - 1); (*table)[slot] != 0;
+       slot = (slot + 1) & (*table_size - 1)) {
+    if (index->entries[((*table)[slot] - 1) * row] == value) {
+      break;
+    }
+  }
+
+  if ((*table)[slot] == 0) {
+    if (index->n_labels == *capacity) {
+      mi_i64_t *entries = (mi_i64_t *) realloc(index->entries,
+                                               2 * *capacity * row * sizeof(mi_i64_t));
+      if (entries == NULL) {
+        return (MI_ERROR);
+      }
+      index->entries = entries;
+      *capacity *= 2;
+    }
+    /* The table is kept at most half full. */
+    if (2 * (index->n_labels + 1) > *table_size) {
+      int *grown = (int *) calloc(2 * *table_size, sizeof(int));
+      int i;
+
+      if (grown == NULL) {
+        return (MI_ERROR);
+      }
+      for (i = 0; i < index->n_labels; i++) {
+        unsigned int s;
+        for (s = milabel_hash_value((int) index->entries[i * row]) & (2 * *table_size - 1);
+             grown[s] != 0; s = (s + 1) & (2 * *table_size - 1))
+          ;
+        grown[s] = i + 1;
+      }
+      free(*table);
+      *table = grown;
+      *table_size *= 2;
+      for (slot = milabel_hash_value(value) & (*table_size - 1); (*table)[slot] != 0;
+           slot = (slot + 1) & (*table_size - 1))
+        ;
+    }
+    entry = &index->entries[index->n_labels * row];
+    entry[0] = value;
+    entry[1] = 0;
+    for (d = 0; d < ndims; d++) {
+      entry[2 + d] = coords[d];
+      entry[2 + ndims + d] = coords[d];
+    }
+    (*table)[slot] = ++index->n_labels;
+  }
+
+  entry = &index->entries[((*table)[slot] - 1) * row];
+  entry[1] += length;
+  for (d = 0; d < ndims; d++) {
+    hsize_t last = (d == ndims - 1) ? coords[d] + length - 1 : coords[d];
+
+    if ((mi_i64_t) coords[d] < entry[2 + d]) {
+      entry[2 + d] = coords[d];
+    }
+    if ((mi_i64_t) last > entry[2 + ndims + d]) {
+      entry[2 + ndims + d] = last;
+    }
+  }
+  return (MI_NOERROR);
+}
+
+/** \internal
+ * Builds the label index of a volume by scanning its full resolution
+ * image, a few slices at a time, run by run along the last dimension.
+ */
+static struct milabelindex *miscan_label_index(mihandle_t volume)
+{
+  struct milabelindex *index = NULL;
+  hsize_t dims[MI2_MAX_VAR_DIMS];
+  hsize_t start[MI2_MAX_VAR_DIMS];
+  hsize_t count[MI2_MAX_VAR_DIMS];
+  hsize_t coords[MI2_MAX_VAR_DIMS];
+  hid_t dset_id = -1, fspc_id = -1, mspc_id = -1, base_id = -1;
+  hsize_t slice_voxels = 1;
+  hsize_t rows_per_read;
+  size_t size;
+  H5T_sign_t sign;
+  mitype_t type;
+  int *buffer = NULL;
+  int *table = NULL;
+  int table_size = 64;
+  int capacity = 16;
+  int ndims;
+  int result = MI_ERROR;
+  int d;
+
+  if (miget_label_base_type(volume, &size, &sign, &type) < 0) {
+    return (NULL);
+  }
+  MI_CHECK_HDF_CALL(dset_id = H5Dopen1(volume->hdf_id, MI_FULLIMAGE_PATH "/image"),"H5Dopen1");
+  if (dset_id < 0) {
+    return (NULL);
+  }
+  fspc_id = H5Dget_space(dset_id);
+  ndims = H5Sget_simple_extent_dims(fspc_id, dims, NULL);
+  base_id = H5Tget_super(volume->mtype_id);
+
+  index = (struct milabelindex *) calloc(1, sizeof(struct milabelindex));
+  if (index == NULL || ndims < 0) {
+    goto cleanup;
+  }
+  index->ndims = (ndims > 0) ? ndims : 1;
+  if (ndims == 0) {
+    dims[0] = 1;
+  }
+  for (d = 1; d < index->ndims; d++) {
+    slice_voxels *= dims[d];
+  }
+  /* The lines of a one dimensional image can't be split across reads. */
+  rows_per_read = (index->ndims > 1) ? MI2_LABEL_SCAN_VOXELS / slice_voxels : dims[0];
+  if (rows_per_read < 1) {
+    rows_per_read = 1;
+  }
+  if (rows_per_read > dims[0]) {
+    rows_per_read = dims[0];
+  }
+  index->entries = (mi_i64_t *) malloc(capacity * MI2_LABEL_INDEX_ROW(index->ndims) *
+                                       sizeof(mi_i64_t));
+  table = (int *) calloc(table_size, sizeof(int));
+  buffer = (int *) malloc(rows_per_read * slice_voxels * sizeof(int));
+  if (index->entries == NULL || table == NULL || buffer == NULL) {
+    MI_LOG_ERROR(MI2_MSG_OUTOFMEM, rows_per_read * slice_voxels * sizeof(int));
+    goto cleanup;
+  }
+
+  for (d = 0; d < index->ndims; d++) {
+    start[d] = 0;
+    count[d] = dims[d];
+  }
+  for (start[0] = 0; start[0] < dims[0]; start[0] += count[0]) {
+    hsize_t n_voxels;
+    hsize_t line = dims[index->ndims - 1];
+    hsize_t i;
+
+    count[0] = (dims[0] - start[0] < rows_per_read) ? dims[0] - start[0] : rows_per_read;
+    n_voxels = count[0] * slice_voxels;
+    if (ndims > 0) {
+      H5Sselect_hyperslab(fspc_id, H5S_SELECT_SET, start, NULL, count, NULL);
+    }
+    if (mspc_id >= 0) {
+      H5Sclose(mspc_id);
+    }
+    mspc_id = H5Screate_simple(1, &n_voxels, NULL);
+    if (H5Dread(dset_id, base_id, mspc_id, fspc_id, H5P_DEFAULT, buffer) < 0) {
+      MI_LOG_ERROR(MI2_MSG_HDF5,"H5Dread");
+      goto cleanup;
+    }
+    miwiden_labels(buffer, n_voxels, size, sign, NULL, 0);
+
+    /* Each line along the last dimension is taken run by run. */
+    for (i = 0; i < n_voxels; i += line) {
+      hsize_t rest = (start[0] * slice_voxels + i) / line;
+      hsize_t x = 0;
+
+      for (d = index->ndims - 2; d >= 0; d--) {
+        coords[d] = rest % dims[d];
+        rest /= dims[d];
+      }
+      while (x < line) {
+        hsize_t run = 1;
+        int value = buffer[i + x];
+
+        while (x + run < line && buffer[i + x + run] == value) {
+          run++;
+        }
+        coords[index->ndims - 1] = x;
+        if (miadd_label_run(index, &table, &table_size, &capacity, value,
+                            coords, run) < 0) {
+          MI_LOG_ERROR(MI2_MSG_OUTOFMEM, capacity);
+          goto cleanup;
+        }
+        x += run;
+      }
+    }
+  }
+  qsort(index->entries, index->n_labels,
+        MI2_LABEL_INDEX_ROW(index->ndims) * sizeof(mi_i64_t),
+        micompare_label_entries);
+  result = MI_NOERROR;
+
+cleanup:
+  if (result < 0 && index != NULL) {
+    free(index->entries);
+    free(index);
+    index = NULL;
+  }
+  free(buffer);
+  free(table);
+  if (mspc_id >= 0) {
+    H5Sclose(mspc_id);
+  }
+  H5Sclose(fspc_id);
+  H5Tclose(base_id);
+  H5Dclose(dset_id);
+  return (index);
+}
+
+/** \internal
+ * Reads the label index saved with the image, if there is one.
+ */
+static struct milabelindex *miread_label_index(mihandle_t volume)
+{
+  struct milabelindex *index;
+  hsize_t dims[2];
+  hid_t dset_id, fspc_id;
+  int ndims;
+  int image_ndims = (volume->number_of_dims > 0) ? volume->number_of_dims : 1;
+
+  H5E_BEGIN_TRY {
+    dset_id = H5Dopen1(volume->hdf_id, MI2_LABEL_INDEX_PATH);
+  } H5E_END_TRY;
+  if (dset_id < 0) {
+    return (NULL);
+  }
+  fspc_id = H5Dget_space(dset_id);
+  ndims = H5Sget_simple_extent_dims(fspc_id, dims, NULL);
+  H5Sclose(fspc_id);
+
+  /* An index of a different number of dimensions is not of this image. */
+  index = (struct milabelindex *) calloc(1, sizeof(struct milabelindex));
+  if (index == NULL || ndims != 2 ||
+      dims[1] != MI2_LABEL_INDEX_ROW((hsize_t) image_ndims)) {
+    free(index);
+    H5Dclose(dset_id);
+    return (NULL);
+  }
+  index->n_labels = (int) dims[0];
+  index->ndims = image_ndims;
+  index->entries = (mi_i64_t *) malloc((dims[0] * dims[1] + 1) * sizeof(mi_i64_t));
+  if (index->entries == NULL ||
+      H5Dread(dset_id, H5T_NATIVE_LLONG, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+              index->entries) < 0) {
+    free(index->entries);
+    free(index);
+    index = NULL;
+  }
+  H5Dclose(dset_id);
+  return (index);
+}
+
+/** \internal
+ * Returns the label index of a volume: the one cached on the handle, the
+ * one saved with the image, or one built by scanning the image. Writing
+ * voxels discards the cached index, and the saved one stays out of date
+ * until the volume is closed, so the image is scanned again after each
+ * write.
+ */
+static struct milabelindex *miget_label_index(mihandle_t volume)
+{
+  if (volume->label_index != NULL) {
+    return (volume->label_index);
+  }
+  if (!volume->label_index_stale) {
+    volume->label_index = miread_label_index(volume);
+    if (volume->label_index != NULL) {
+      return (volume->label_index);
+    }
+  }
+  volume->label_index = miscan_label_index(volume);
+  return (volume->label_index);
+}
+
+/** \internal
+ * Returns TRUE if the image of a volume is stored run-length encoded.
+ */
+static int miis_sparse_label_volume(mihandle_t volume)
+{
+  unsigned int flags;
+  size_t cd_nelmts = 0;
+  hid_t dset_id, dcpl_id;
+  herr_t found = -1;
+
+  if (volume->volume_class != MI_CLASS_LABEL) {
+    return (FALSE);
+  }
   H5E_BEGIN_TRY {
-    result = H5Tget_member_value(volume->mtype_id,idx,value);
+    dset_id = H5Dopen1(volume->hdf_id, MI_FULLIMAGE_PATH "/image");
+    if (dset_id >= 0) {
+      dcpl_id = H5Dget_create_plist(dset_id);
+      found = H5Pget_filter_by_id2(dcpl_id, MI2_H5Z_FILTER_RLE, &flags,
+                                   &cd_nelmts, NULL, 0, NULL, NULL);
+      H5Pclose(dcpl_id);
+      H5Dclose(dset_id);
+    }
   } H5E_END_TRY;
+  return (found >= 0);
+}
 
-  MI_CHECK_HDF_CALL_RET(result,"H5Tget_member_value");
+/** \internal
+ * Saves the label index of a run-length encoded label volume whose voxels
+ * have changed with its image, so that its labels can be queried without
+ * reading the image.
+ */
+int misave_label_index(mihandle_t volume)
+{
+  struct milabelindex *index;
+  hsize_t dims[2];
+  hid_t fspc_id, dset_id;
+  int result = MI_NOERROR;
 
+  if (!volume->label_index_stale || !miis_sparse_label_volume(volume)) {
+    return (MI_NOERROR);
+  }
+  if ((index = miget_label_index(volume)) == NULL) {
+    return (MI_ERROR);
+  }
+
+  H5E_BEGIN_TRY {
+    H5Ldelete(volume->hdf_id, MI2_LABEL_INDEX_PATH, H5P_DEFAULT);
+  } H5E_END_TRY;
+  dims[0] = index->n_labels;
+  dims[1] = MI2_LABEL_INDEX_ROW(index->ndims);
+  fspc_id = H5Screate_simple(2, dims, NULL);
+  dset_id = H5Dcreate2(volume->hdf_id, MI2_LABEL_INDEX_PATH, H5T_STD_I64LE,
+                       fspc_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  if (dset_id < 0 ||
+      (index->n_labels > 0 &&
+       H5Dwrite(dset_id, H5T_NATIVE_LLONG, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                index->entries) < 0)) {
+    result = MI_LOG_ERROR(MI2_MSG_HDF5,"H5Dwrite");
+  } else {
+    volume->label_index_stale = FALSE;
+  }
+  H5Dclose(dset_id);
+  H5Sclose(fspc_id);
+  return (result);
+}
+
+/**
+ * Lists the labels present in the image of a label volume, in
+ * increasing order. Run-length encoded label volumes save the labels
+ * present with their image, so that this doesn't read the image; other
+ * label volumes are scanned once.
+ *
+ * \param volume A label volume handle
+ * \param max_labels Number of labels \a values can hold
+ * \param values Labels present, or NULL to count them only
+ * \param n_labels Number of labels present, which may be more than
+ * \a max_labels
+ */
+int miget_present_labels(mihandle_t volume, int max_labels, int values[],
+                         int *n_labels)
+{
+  struct milabelindex *index;
+  int i;
+
+  if (volume == NULL || n_labels == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to use null volume or variable");
+  }
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
+  if (volume->volume_class != MI_CLASS_LABEL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume class is not label");
+  }
+  if ((index = miget_label_index(volume)) == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Can't index the labels of the volume");
+  }
+  for (i = 0; values != NULL && i < index->n_labels && i < max_labels; i++) {
+    values[i] = (int) index->entries[i * MI2_LABEL_INDEX_ROW(index->ndims)];
+  }
+  *n_labels = index->n_labels;
+  return (MI_NOERROR);
+}
+
+/**
+ * Gets the number of voxels with a label and their bounding box, as the
+ * index of the first voxel and the number of voxels along each dimension
+ * in file order. A label absent from the image has no voxels and an
+ * empty box. Like miget_present_labels(), this doesn't read the image of
+ * a run-length encoded label volume.
+ *
+ * \param volume A label volume handle
+ * \param value The label
+ * \param voxel_count Number of voxels with the label
+ * \param start First voxel of the bounding box, or NULL
+ * \param count Size of the bounding box, or NULL
+ */
+int miget_label_extent(mihandle_t volume, int value, misize_t *voxel_count,
+                       misize_t start[], misize_t count[])
+{
+  struct milabelindex *index;
+  mi_i64_t key = value;
+  const mi_i64_t *entry;
+  int ndims;
+  int d;
+
+  if (volume == NULL || voxel_count == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to use null volume or variable");
+  }
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
+  if (volume->volume_class != MI_CLASS_LABEL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Volume class is not label");
+  }
+  if ((index = miget_label_index(volume)) == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Can't index the labels of the volume");
+  }
+
+  ndims = index->ndims;
+  entry = (const mi_i64_t *) bsearch(&key, index->entries, index->n_labels,
+                                     MI2_LABEL_INDEX_ROW(ndims) * sizeof(mi_i64_t),
+                                     micompare_label_entries);
+  *voxel_count = (entry != NULL) ? (misize_t) entry[1] : 0;
+  for (d = 0; d < volume->number_of_dims; d++) {
+    if (start != NULL) {
+      start[d] = (entry != NULL && d < ndims) ? (misize_t) entry[2 + d] : 0;
+    }
+    if (count != NULL) {
+      count[d] = (entry != NULL && d < ndims) ?
+                 (misize_t) (entry[2 + ndims + d] - entry[2 + d] + 1) : 0;
+    }
+  }
   return (MI_NOERROR);
 }
 
@@ -1341,6 +1341,8 @@ void miinit ( void )
 
   MI_CHECK_HDF_CALL(H5Tregister ( H5T_PERS_SOFT, "d2i", H5T_NATIVE_DOUBLE, H5T_NATIVE_INT,
                 mi2_dbl_to_int ),"H5Tregister")
+
+  micodec_init();
 }
 
 /** HDF5 type conversion function for converting an arbitrary integer type to
@@ -1389,478 +1391,6 @@ void miinit_enum ( hid_t type_id )
                 mi2_int_to_dbl );
 }
 
-int minc_create_thumbnail ( mihandle_t volume, int grp )
-{
-  char path[MI2_MAX_PATH];
-  hid_t grp_id;
-  
-  /* Don't handle negative or overly large numbers!
-  */
-  if ( grp <= 0 || grp > MI2_MAX_RESOLUTION_GROUP ) {
-    return ( MI_ERROR );
-  }
-
-  sprintf ( path, MI_ROOT_PATH "/image/%d", grp );
-  grp_id = H5Gcreate2 ( volume->hdf_id, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
-
-  if ( grp_id < 0 ) {
-    return ( MI_ERROR );
-  }
-
-  H5Gclose ( grp_id );
-  return ( MI_NOERROR );
-}
-
-/** Function to downsample a single slice of an image.
-* \param in_ptr the 3D input slice, scale x isize[1] x isize[2]
-* \param out_ptr the 2D output slice, osize[1] x osize[2]
-*/
-static void midownsample_slice ( double *in_ptr, double *out_ptr, hsize_t isize[],
-                                 hsize_t osize[], int scale )
-{
-  hsize_t j, k;
-  int x, y, z;
-  double d;
-  double total;
-
-  total = (double) scale * (double) scale * (double) scale;
-
-  /* These two loops iterate over all of the voxels in the 2D output
-  * image.
-  */
-  for ( j = 0; j < osize[1]; j++ ) {
-    for ( k = 0; k < osize[2]; k++ ) {
-      /* The three inner loops iterate all scale^3
-      * voxels in the input image which will be averaged
-      * to form the output image.
-      */
-      d = 0;
-
-      for ( x = 0; x < scale; x++ ) {
-        for ( y = 0; y < scale; y++ ) {
-          for ( z = 0; z < scale; z++ ) {
-            size_t x1, y1, z1;
-            double t;
-            x1 = x;
-            y1 = y + ( j * scale );
-            z1 = z + ( k * scale );
-            t = in_ptr[ ( ( x1 * isize[1] ) + y1 ) * isize[2] + z1];
-            d += t;
-          }
-        }
-      }
-
-      d /= total;
-      out_ptr[ ( j * osize[2] ) + k] = d;
-    }
-  }
-}
-
-/** Convert the hyperslab from real to voxel values, calculating and
-* returning the minimum and maximum real values for the slab.  This
-* could form the basis for a public function one day, but for now it
-* is considered private.
-*/
-static void miconvert_hyperslab_to_voxel ( mihandle_t volume, hsize_t start[],
-    hsize_t count[], double *slab_ptr,
-    double *max_ptr, double *min_ptr )
-{
-  /* This code is not intended to be a general hyperslab-to-voxel
-  * converter yet.  That is why it is not public.
-  */
-  double real_min, real_max;  /* Minimum and maximum values */
-  hsize_t index;
-  hsize_t total;
-  double voxel_range, voxel_offset;
-  double real_range, real_offset;
-  int i;
-  double tmp_val;
-
-  real_min = DBL_MAX;
-  real_max = -DBL_MAX;
-
-  total = 1;
-
-  for ( i = 0; i < volume->number_of_dims; i++ ) {
-    total *= count[i];
-  }
-
-  /* Find the global minimum and maximum for this hyperslab.
-  */
-  for ( index = 0; index < total; index++ ) {
-    tmp_val = slab_ptr[index];
-
-    if ( tmp_val > real_max ) {
-      real_max = tmp_val;
-    }
-
-    if ( tmp_val < real_min ) {
-      real_min = tmp_val;
-    }
-  }
-
-  voxel_range = volume->valid_max - volume->valid_min;
-  voxel_offset = volume->valid_min;
-  real_range = real_max - real_min;
-  real_offset = real_min;
-
-  for ( index = 0; index < total; index++ ) {
-    tmp_val = slab_ptr[index];
-    tmp_val = ( tmp_val - real_offset ) / real_range;
-    tmp_val = ( tmp_val * voxel_range ) + voxel_offset;
-    slab_ptr[index] = rint ( tmp_val );
-  }
-
-  if ( min_ptr != NULL ) {
-    *min_ptr = real_min;
-  }
-
-  if ( max_ptr != NULL ) {
-    *max_ptr = real_max;
-  }
-}
-
-/** Convert the hyperslab from voxel to real values.  This could form
-* the basis for a public function one day, but for now it is
-* considered private.
-*/
-static void miconvert_hyperslab_to_real ( mihandle_t volume, hsize_t start[],
-    hsize_t count[], double *slab_ptr )
-{
-  /* This code is not intended to be a general hyperslab-to-real
-  * converter yet.  That is why it is not public.
-  */
-  double real_min, real_max;  /* Minimum and maximum values */
-  hsize_t index;
-  hsize_t total;
-  double voxel_range, voxel_offset;
-  double real_range, real_offset;
-  int i;
-  double tmp_val;
-  misize_t pos[MI2_MAX_VAR_DIMS];
-  int r;
-
-  total = 1;
-
-  for ( i = 0; i < volume->number_of_dims; i++ ) {
-    total *= count[i];
-    pos[i] = start[i];
-  }
-
-  voxel_offset = volume->valid_min;
-  voxel_range = volume->valid_max - volume->valid_min;
-
-  /* Get the initial real minimum & maximum.
-  */
-  r = miget_slice_range ( volume, pos, volume->number_of_dims,
-                          &real_max, &real_min );
-
-  if ( r == MI_ERROR ) {
-    fprintf ( stderr, "Oops - failed to get slice range\n" );
-  }
-
-  real_offset = real_min;
-  real_range = real_max - real_min;
-
-
-  for ( index = 0; index < total; index++ ) {
-    /* Since this calculation may cross slice boundaries, I need to
-    * grab the correct real minimum and maximum for the coordinates
-    * I happen to be in at the time.
-    *
-    * This next loop attempts to keep track of the current position,
-    * and reloads the minimum and maximum whenever we change any other
-    * than the fastest-varying dimension.
-    */
-    for ( i = volume->number_of_dims - 1; i >= 0; i-- ) {
-      pos[i]++;
-
-      if ( pos[i] >= count[i] ) {
-        pos[i] = start[i];
-        r = miget_slice_range ( volume, pos, volume->number_of_dims,
-                                &real_max, &real_min );
-
-        if ( r == MI_ERROR ) {
-          fprintf ( stderr, "Oops - failed to get slice range\n" );
-        }
-
-        real_offset = real_min;
-        real_range = real_max - real_min;
-      } else {
-        break;
-      }
-    }
-
-    tmp_val = ( slab_ptr[index] - voxel_offset ) / voxel_range;
-    slab_ptr[index] = ( tmp_val * real_range ) + real_offset;
-  }
-}
-
-/** Update an individual thumbnail for the \a volume.  Updates group
-* number \a ogrp from source group \a igrp.  The whole image tree must
-* be rooted at \a loc_id.
-*/
-int
-minc_update_thumbnail ( mihandle_t volume, hid_t loc_id, int igrp, int ogrp )
-{
-  hsize_t isize[MI2_MAX_VAR_DIMS];
-  hsize_t osize[MI2_MAX_VAR_DIMS];
-  hsize_t count[MI2_MAX_VAR_DIMS];
-  hsize_t start[MI2_MAX_VAR_DIMS];
-  hid_t idst_id=-1;              /* Input dataset */
-  hid_t odst_id=-1;              /* Output dataset */
-  hid_t ifspc_id=-1;             /* Input "file" dataspace */
-  hid_t ofspc_id=-1;             /* Output "file" dataspace */
-  hid_t typ_id=-1;               /* Type ID */
-  hid_t imspc_id=-1;             /* Input memory dataspace */
-  hid_t omspc_id=-1;             /* Output memory dataspace */
-  char path[MI2_MAX_PATH];
-  int ndims;                  /* Number of dimensions in the image */
-  int scale;
-  int i;                      /* Generic loop counter */
-  double *in_ptr;
-  double *out_ptr;
-  hsize_t slice;
-  size_t in_bytes;
-  size_t out_bytes;
-  double smax, smin;          /* Slice minimum and maximum */
-  hid_t omax_id=-1;              /* Output image-max dataset */
-  hid_t omin_id=-1;              /* Output image-min dataset */
-  hid_t tfspc_id=-1;             /* Dimensionality of image-max/image-min */
-  hid_t tmspc_id=-1;
-  hid_t dcpl_id=-1;              /* Dataset creation property list */
-  herr_t result=0;               /* return value for various functions*/
-
-  miinit();
-
-  /* Check arguments for basic validity. */
-  if ( ogrp <= igrp ) {
-    return ( MI_ERROR );
-  }
-
-  /* Calculate scale factor (always a power of 2) */
-  for ( i = igrp, scale = 1; i < ogrp; i++, scale <<= 1 )
-    ;
-
-  /* Open the input path.
-  */
-  sprintf ( path, "%d/image", igrp );
-  idst_id = H5Dopen1 ( loc_id, path );
-
-  if ( idst_id < 0 ) {
-    return ( MI_ERROR );
-  }
-
-  /* Get the input type.
-  */
-  typ_id = H5Dget_type ( idst_id );
-
-  /* Get the input dataspace.
-  */
-  ifspc_id = H5Dget_space ( idst_id );
-
-  /* Get the input dataset creation property list
-  */
-  dcpl_id = H5Dget_create_plist ( idst_id );
-
-  ndims = H5Sget_simple_extent_ndims ( ifspc_id );
-  H5Sget_simple_extent_dims ( ifspc_id, isize, NULL );
-
-  /* Calculate the size of the new thumbnail.
-  */
-  for ( i = 0; i < ndims; i++ ) {
-    osize[i] = isize[i] / scale;
-
-    if ( osize[i] == 0 ) { /* Too small? */
-      return ( MI_ERROR );
-    }
-  }
-
-  /* Create dataspace for new resolution
-  */
-  ofspc_id = H5Screate_simple ( ndims, osize, NULL );
-
-  sprintf ( path, "%d/image", ogrp );
-
-  H5E_BEGIN_TRY {
-    odst_id = H5Dcreate1 ( loc_id, path, typ_id, ofspc_id, H5P_DEFAULT );
-  } H5E_END_TRY;
-
-  if ( odst_id < 0 ) {
-    odst_id = H5Dopen1 ( loc_id, path );
-
-    if ( odst_id < 0 ) {
-      return ( MI_ERROR );
-    }
-  }
-
-  H5Pclose ( dcpl_id );       /* No longer needed. */
-
-  if ( volume->volume_class == MI_CLASS_REAL ) {
-    /* TODO: This is a bit of a hack - I need a better way to get the
-    * dimensionality of the source image-min and image-max.
-    */
-
-    tfspc_id = H5Screate_simple ( 1, &osize[0], NULL );
-
-    /* Create a simple scalar dataspace. */
-    tmspc_id = H5Screate ( H5S_SCALAR );
-
-    sprintf ( path, "%d/image-max", ogrp );
-    H5E_BEGIN_TRY {
-      omax_id = H5Dcreate1 ( loc_id, path, H5T_IEEE_F64LE, tfspc_id,
-      H5P_DEFAULT );
-    } H5E_END_TRY;
-
-    if ( omax_id < 0 ) {
-      omax_id = H5Dopen1 ( loc_id, path );
-    }
-
-    sprintf ( path, "%d/image-min", ogrp );
-    H5E_BEGIN_TRY {
-      omin_id = H5Dcreate1 ( loc_id, path, H5T_IEEE_F64LE, tfspc_id,
-      H5P_DEFAULT );
-    } H5E_END_TRY;
-
-    if ( omin_id < 0 ) {
-      omin_id = H5Dopen1 ( loc_id, path );
-    }
-  }
-
-  /* Calculate the input buffer size - scale slices.
-  */
-  in_bytes = scale * isize[1] * isize[2] * sizeof ( double );
-  in_ptr = malloc ( in_bytes );
-
-  out_bytes = osize[1] * osize[2] * sizeof ( double );
-  out_ptr = malloc ( out_bytes );
-
-  count[0] = scale;
-  count[1] = isize[1];
-  count[2] = isize[2];
-  imspc_id = H5Screate_simple ( ndims, count, NULL );
-
-  count[0] = 1;
-  count[1] = osize[1];
-  count[2] = osize[2];
-  omspc_id = H5Screate_simple ( ndims, count, NULL );
-
-  /*
-  * read image & TODO: convert to "real" range.
-  */
-  for ( slice = 0; slice < osize[0]; slice++ ) {
-
-    start[0] = slice * scale;
-    start[1] = 0;
-    start[2] = 0;
-    count[0] = scale;
-    count[1] = isize[1];
-    count[2] = isize[2];
-
-    MI_CHECK_HDF_CALL(result=H5Sselect_hyperslab ( ifspc_id, H5S_SELECT_SET, start, NULL, count,
-                          NULL ),"H5Sselect_hyperslab");
-    if(result>=0)
-    {
-      MI_CHECK_HDF_CALL(H5Dread ( idst_id, H5T_NATIVE_DOUBLE, imspc_id, ifspc_id, H5P_DEFAULT,
-                in_ptr ),"H5Dread");
-
-      /* Scale slice from voxel to real values. */
-
-      miconvert_hyperslab_to_real ( volume, start, count, in_ptr );
-
-      midownsample_slice ( in_ptr, out_ptr, isize, osize, scale );
-    }
-    
-    start[0] = slice;
-    start[1] = 0;
-    start[2] = 0;
-    count[0] = 1;
-    count[1] = osize[1];
-    count[2] = osize[2];
-    
-    MI_CHECK_HDF_CALL(result=H5Sselect_hyperslab ( ofspc_id, H5S_SELECT_SET, start, NULL, count,
-                                           NULL ),"H5Sselect_hyperslab");
-    if(result>=0)
-    {
-      miconvert_hyperslab_to_voxel ( volume, start, count, out_ptr,
-                                     &smax, &smin );
-
-      MI_CHECK_HDF_CALL(H5Dwrite ( odst_id, H5T_NATIVE_DOUBLE, omspc_id, ofspc_id, H5P_DEFAULT,
-                                  out_ptr ),"H5Dwrite");
-    }
-    
-    if ( volume->volume_class == MI_CLASS_REAL ) {
-      /* Select the right point in tfspc_id */
-      H5Sselect_elements ( tfspc_id, H5S_SELECT_SET, 1, &start[0] );
-
-      H5Dwrite ( omax_id, H5T_NATIVE_DOUBLE, tmspc_id, tfspc_id,
-                 H5P_DEFAULT, &smax );
-
-      H5Dwrite ( omin_id, H5T_NATIVE_DOUBLE, tmspc_id, tfspc_id,
-                 H5P_DEFAULT, &smin );
-    }
-  }
-
-  free ( in_ptr );
-  free ( out_ptr );
-
-  if(omax_id>0)  H5Dclose ( omax_id );
-  if(omin_id>0)  H5Dclose ( omin_id );
-  if(tfspc_id>0) H5Sclose ( tfspc_id );
-  if(tmspc_id>0) H5Sclose ( tmspc_id );
-
-  if(omspc_id>0) H5Sclose ( omspc_id );
-  if(imspc_id>0) H5Sclose ( imspc_id );
-  if(odst_id>0)  H5Dclose ( odst_id );
-  if(typ_id>0)   H5Tclose ( typ_id );
-  H5Sclose ( ofspc_id );
-  H5Sclose ( ifspc_id );
-
-  return ( MI_NOERROR );
-}
-
-/** Cycle through and update each of the lower-resolution images in
-* the file.
-*/
-int
-minc_update_thumbnails ( mihandle_t volume )
-{
-  int grp_no, prv_grp_no;
-  hid_t grp_id;
-  hsize_t n;
-  hsize_t i;
-  char name[MI2_MAX_PATH];
-
-  grp_id = H5Gopen1 ( volume->hdf_id, MI_ROOT_PATH "/image" );
-
-  if ( grp_id < 0 ) {
-    return ( MI_ERROR );    /* Error opening group. */
-  }
-
-  if ( H5Gget_num_objs ( grp_id, &n ) < 0 ) {
-    return ( MI_ERROR );    /* Error getting object count. */
-  }
-
-  grp_no = -1;
-
-  for ( i = 0; i < n; i++ ) {
-    if ( H5Gget_objname_by_idx ( grp_id, i, name, MI2_MAX_PATH ) < 0 ) {
-      return ( MI_ERROR );
-    }
-
-    prv_grp_no = grp_no;
-    grp_no = atoi ( name );
-
-    if ( grp_no != 0 ) {
-      minc_update_thumbnail ( volume, grp_id, prv_grp_no, grp_no );
-    }
-  }
-
-  H5Gclose ( grp_id );
-  return ( MI_NOERROR );
-
-}
-
 double *
 alloc1d ( int n )
 {
@@ -87,6 +87,46 @@ int miset_attr_values(mihandle_t vol, mitype_t data_type,
  */
 int miadd_history_attr(mihandle_t vol, size_t length, const void *values);
 
+/** Read every attribute at and below a path in one pass
+ * \ingroup mi2Group
+ */
+int miget_attr_snapshot(mihandle_t vol, const char *path,
+                        miattrsnapshot_t *snapshot);
+
+/** Free an attribute snapshot
+ * \ingroup mi2Group
+ */
+int mifree_attr_snapshot(miattrsnapshot_t snapshot);
+
+/** Get the number of attributes in a snapshot
+ * \ingroup mi2Group
+ */
+int miget_snapshot_attr_count(miattrsnapshot_t snapshot, int *count);
+
+/** Get the path, name, type, length and values of a snapshot attribute
+ * \ingroup mi2Group
+ */
+int miget_snapshot_attr(miattrsnapshot_t snapshot, int index,
+                        const char **path, const char **name,
+                        mitype_t *data_type, size_t *length,
+                        const void **values);
+
+/** Find a snapshot attribute by its path and name
+ * \ingroup mi2Group
+ */
+int mifind_snapshot_attr(miattrsnapshot_t snapshot, const char *path,
+                         const char *name, int *index);
+
+/** Write the attributes of a snapshot to a volume
+ * \ingroup mi2Group
+ */
+int miset_attr_snapshot(mihandle_t vol, miattrsnapshot_t snapshot);
+
+/** Serialize a snapshot as JSON, the string should be freed after use
+ * \ingroup mi2Group
+ */
+int miget_snapshot_json(miattrsnapshot_t snapshot, char **json);
+
 /** \defgroup mi2Memory FREE FUNCTIONS */
 
 /**
@@ -736,6 +776,9 @@ int miget_volume_voxel_count(mihandle_t volume, misize_t *number_of_voxels);
 
 /** Opens an existing MINC volume for read-only access if mode argument is
   * MI2_OPEN_READ, or read-write access if mode argument is MI2_OPEN_RDWR.
+  * Adding MI2_OPEN_HEADER to the mode opens only the file, so that its
+  * attributes can be read quickly; the dimensions, the image dataset and
+  * its type are set up when they are first needed.
   * \ingroup mi2Vol
 */
 int miopen_volume(const char *filename, int mode, mihandle_t *volume);
@@ -758,6 +801,42 @@ int miget_slice_scaling_flag(mihandle_t volume,
 int miset_slice_scaling_flag(mihandle_t volume, 
                                     miboolean_t slice_scaling_flag);
 
+/** Set the number of threads used to compress and decompress chunks
+ * when reading or writing hyperslabs of a compressed volume. 0 or 1
+ * (the default) transfers the data serially.
+ */
+int miset_volume_io_threads(mihandle_t volume, int nthreads);
+
+/** Get the number of threads used to compress and decompress chunks
+ * when reading or writing hyperslabs of a volume.
+ */
+int miget_volume_io_threads(mihandle_t volume, int *nthreads);
+
+/** Set the size, number of hash slots and preemption policy of the HDF5
+ * chunk cache used for the image of a volume.  Zero sizes and a negative
+ * preemption keep the defaults, which may be set with the
+ * MINC_CHUNK_CACHE_KB, MINC_CHUNK_CACHE_SLOTS and MINC_CHUNK_CACHE_W0
+ * environment variables.
+ */
+int miset_volume_chunk_cache(mihandle_t volume, size_t cache_size,
+                             size_t cache_slots, double preemption);
+
+/** Get the HDF5 chunk cache settings used for the image of a volume.
+ */
+int miget_volume_chunk_cache(mihandle_t volume, size_t *cache_size,
+                             size_t *cache_slots, double *preemption);
+
+/** Map a contiguous, uncompressed image into memory for reading without
+ * copies.  Returns the first voxel and, optionally, the byte stride of
+ * each dimension in file order.  Fails if the image can't be mapped.
+ */
+int miget_volume_mapping(mihandle_t volume, const void **data,
+                         misize_t strides[]);
+
+/** Release the mapping made by miget_volume_mapping().
+ */
+int mirelease_volume_mapping(mihandle_t volume);
+
 /** \defgroup mi2VPrp VOLUME PROPERTIES FUNCTIONS */
 
 /** Create a volume property list.  The new list will be returned in the
@@ -815,8 +894,24 @@ int miset_props_multi_resolution(mivolumeprops_t props, miboolean_t enable_flag,
 int miget_props_multi_resolution(mivolumeprops_t props, miboolean_t *enable_flag,
                                         int *depth);
 
+/** Set the filter used to compute the lower resolution images.
+ * \param props A volume property list handle
+ * \param filter MI_FILTER_BOX, MI_FILTER_GAUSSIAN, MI_FILTER_MODE, or
+ * MI_FILTER_DEFAULT for the box filter, or the mode for label volumes.
+ * \ingroup mi2VPrp
+ */
+int miset_props_resolution_filter(mivolumeprops_t props, mifilter_t filter);
 
-/** Select a different resolution from a multi-resolution image.
+/** Get the filter used to compute the lower resolution images.
+ * \param props A volume property list handle
+ * \param filter Pointer to the filter
+ * \ingroup mi2VPrp
+ */
+int miget_props_resolution_filter(mivolumeprops_t props, mifilter_t *filter);
+
+
+/** Select a different resolution from a multi-resolution image,
+ * computing it first where it is missing or stale.
  * \ingroup mi2VPrp
  */
 int miselect_resolution(mihandle_t volume, int depth);
@@ -828,13 +923,26 @@ int miselect_resolution(mihandle_t volume, int depth);
  */
 int miflush_from_resolution(mihandle_t volume, int depth);
 
+/** Choose whether the lower resolution images are computed when they are
+ * selected rather than when the volume is closed.
+ * \ingroup mi2VPrp
+ */
+int miset_volume_lazy_resolution(mihandle_t volume, miboolean_t lazy);
+
+/** Get whether the lower resolution images are computed when they are
+ * selected rather than when the volume is closed.
+ * \ingroup mi2VPrp
+ */
+int miget_volume_lazy_resolution(mihandle_t volume, miboolean_t *lazy);
+
 
 /** Set compression type for a volume property list
  * Note that enabling compression will automatically 
  * enable blocking with default parameters. 
  * \param props A volume properties list
- * \param compression_type The type of compression to use (MI_COMPRESS_NONE
- * or MI_COMPRESS_ZLIB)
+ * \param compression_type The type of compression to use (MI_COMPRESS_NONE,
+ * MI_COMPRESS_ZLIB, MI_COMPRESS_SHUFFLE_ZLIB, MI_COMPRESS_LZ4,
+ * MI_COMPRESS_SHUFFLE_LZ4 or MI_COMPRESS_RLE)
  * \ingroup mi2VPrp
  */
 int miset_props_compression_type(mivolumeprops_t props, micompression_t compression_type);
@@ -890,6 +998,35 @@ int miget_props_blocking(mivolumeprops_t props, int *edge_count, int *edge_lengt
                                 int max_lengths);
 
 
+/** Choose the blocking structure and chunk cache size of a volume from
+ * the way it will be read.
+ * \param props A volume property list handle
+ * \param pattern The expected access pattern
+ * \param dimension_name The dimension slices are taken along, or the
+ * dimension of the time series; NULL selects the first dimension, or the
+ * time dimension for MI_ACCESS_TIMESERIES
+ * \param ndims The number of dimensions of the volume
+ * \param dimensions The dimensions of the volume, in file order
+ * \param volume_type The voxel type of the volume
+ * \ingroup mi2VPrp
+ */
+int miset_props_access_pattern(mivolumeprops_t props, miaccess_pattern_t pattern,
+                               const char *dimension_name, int ndims,
+                               const midimhandle_t dimensions[],
+                               mitype_t volume_type);
+
+
+/** Get the chunk cache size chosen by miset_props_access_pattern().
+ * Zero values mean the HDF5 defaults.
+ * \param props A volume property list handle
+ * \param cache_size Returns the size of the chunk cache in bytes
+ * \param cache_slots Returns the number of hash slots of the cache
+ * \ingroup mi2VPrp
+ */
+int miget_props_chunk_cache(mivolumeprops_t props, size_t *cache_size,
+                            size_t *cache_slots);
+
+
 /** Set properties for uniform/nonuniform record dimension
  * \ingroup mi2VPrp
  */
@@ -986,6 +1123,37 @@ int miset_slice_range(mihandle_t volume,
                              size_t array_length, double slice_max,
                              double slice_min);
 
+/**
+ * This function gets the maximum and minimum real values of all the
+ * slices of the hyperslab given by \a start and \a count, with one
+ * value for each slice, in the order of the hyperslab.
+ * \ingroup mi2Slice
+ */
+int miget_slice_ranges(mihandle_t volume, const misize_t start[],
+                              const misize_t count[], double slice_max[],
+                              double slice_min[]);
+
+/**
+ * This function sets the maximum and minimum real values of all the
+ * slices of the hyperslab given by \a start and \a count, with one
+ * value for each slice, in the order of the hyperslab.
+ * \ingroup mi2Slice
+ */
+int miset_slice_ranges(mihandle_t volume, const misize_t start[],
+                              const misize_t count[], const double slice_max[],
+                              const double slice_min[]);
+
+/**
+ * This function sets the range of each slice of the hyperslab given by
+ * \a start and \a count to the range of the real values in \a buffer.
+ * \ingroup mi2Slice
+ */
+int miset_slice_ranges_from_hyperslab(mihandle_t volume,
+                                             mitype_t buffer_data_type,
+                                             const misize_t start[],
+                                             const misize_t count[],
+                                             const void *buffer);
+
 /**
  * This function returns the maximum real value of
  * voxels in the entire \a volume.  If per-slice scaling is enabled, this
@@ -1153,6 +1321,34 @@ int miset_voxel_value_hyperslab(mihandle_t volume,
                                        void *buffer);
 
 
+/** Start reading the image of a volume as a sequence of slabs of the
+ * shape \a slab_count, converted as given by \a mode.  With a \a prefetch
+ * depth above zero the next slabs are read in the background.
+ * \ingroup mi2Hyper
+ */
+int mistart_slab_iterator(mihandle_t volume, mislabmode_t mode,
+                          mitype_t buffer_data_type,
+                          const misize_t slab_count[],
+                          double min, double max, int prefetch,
+                          mislabiter_t *iterator);
+
+/** Get the next slab of an iterator, or a NULL \a buffer at the end.
+ * \ingroup mi2Hyper
+ */
+int minext_slab(mislabiter_t iterator, misize_t start[], misize_t count[],
+                void **buffer);
+
+/** Get the total number of slabs of an iterator.
+ * \ingroup mi2Hyper
+ */
+int miget_slab_count(mislabiter_t iterator, misize_t *n_slabs);
+
+/** Stop a slab iterator and free its buffers.
+ * \ingroup mi2Hyper
+ */
+int mifree_slab_iterator(mislabiter_t iterator);
+
+
 /** \defgroup mi2Cvt CONVERT FUNCTIONS */
 
 /** Convert values between real (scaled) values and voxel (unscaled)
@@ -1447,6 +1643,34 @@ int miget_number_of_defined_labels(mihandle_t volume, int *number_of_labels);
 */
 int miget_label_value_by_index(mihandle_t volume, int idx, int *value);
 
+/**
+ * Reads a hyperslab of a label volume as native integer labels, with no
+ * HDF5 type conversion. If \a lut is not NULL, each label l with
+ * 0 <= l < \a lut_length is replaced by lut[l] in the same pass.
+ * \ingroup mi2Label
+*/
+int miget_label_hyperslab(mihandle_t volume, const misize_t start[],
+                          const misize_t count[], const int *lut,
+                          int lut_length, int *buffer);
+
+/**
+ * Lists the labels present in the image of a label volume, in increasing
+ * order. \a n_labels receives their number, which may exceed
+ * \a max_labels.
+ * \ingroup mi2Label
+*/
+int miget_present_labels(mihandle_t volume, int max_labels, int values[],
+                         int *n_labels);
+
+/**
+ * Gets the number of voxels with a label and their bounding box, in file
+ * order. Volumes stored with MI_COMPRESS_RLE save these with their image,
+ * so that they are found without reading it.
+ * \ingroup mi2Label
+*/
+int miget_label_extent(mihandle_t volume, int value, misize_t *voxel_count,
+                       misize_t start[], misize_t count[]);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus defined */
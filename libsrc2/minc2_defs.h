@@ -319,6 +319,7 @@ image dimensions */
 
 #define MI2_OPEN_READ 0x0001
 #define MI2_OPEN_RDWR 0x0002
+#define MI2_OPEN_HEADER 0x0004 /* Defer the image until it is accessed */
 
 #define MI_VERSION_2_0 "MINC Version    2.0"
 
@@ -425,6 +426,9 @@ image dimensions */
 #define MICFG_LOGLEVEL "MINC_LOGLEVEL"
 #define MICFG_MAXBUF   "MINC_MAX_FILE_BUFFER_KB"
 #define MICFG_MAXMEM   "MINC_MAX_MEMORY_KB"
+#define MICFG_CHUNK_CACHE "MINC_CHUNK_CACHE_KB"
+#define MICFG_CHUNK_SLOTS "MINC_CHUNK_CACHE_SLOTS"
+#define MICFG_CHUNK_W0    "MINC_CHUNK_CACHE_W0"
 
 
 /* DUMMY rootvariable ID */
@@ -161,6 +161,7 @@ static struct mierror_entry mierror_table[] = {
   { MI2_MSG_ERROR, "Illegal variable access operation" }, /* MI2_MSG_BADOP */
   { MI2_MSG_ERROR, "HDF5 function %s failed" } , /*MI2_MSG_HDF5*/
   { MI2_MSG_ERROR, "Error: %s"} , /*MI2_MSG_GENERIC*/
+  { MI2_MSG_WARNING, "Image uses HDF5 filter %d (%s), which is not available"} , /*MI2_MSG_NOFILTER*/
 };
 
 int MI2_save_routine_name ( char *name )
@@ -279,7 +280,7 @@ static int mi2read_cfg(const char *name, char *buffer, int maxlen)
     return (result);
 }
 
-static int mi2get_cfg_int(const char *name)
+int mi2get_cfg_int(const char *name)
 {
     char buffer[128];
     char *var_ptr;
@@ -295,7 +296,7 @@ static int mi2get_cfg_int(const char *name)
     return (atoi(buffer));
 }
 
-static char * mi2get_cfg_str(const char *name)
+char * mi2get_cfg_str(const char *name)
 {
     char buffer[256];
     char *var_ptr;
@@ -98,7 +98,8 @@ typedef enum mi2msgcode {
     MI2_MSG_ICVCOORDS,
     MI2_MSG_BADOP,
     MI2_MSG_HDF5,
-    MI2_MSG_GENERIC
+    MI2_MSG_GENERIC,
+    MI2_MSG_NOFILTER
 } mi2msgcode_t;
 
 int  mi2log_message(const char *file,int line, mi2msgcode_t code, ...);
@@ -109,6 +110,8 @@ void MI2_log_pkg_error2(int p1, char *p2);
 void MI2_log_pkg_error3(int p1, char *p2, char *p3);
 void MI2_log_sys_error1(char *p1);
 void mi2log_init(const char *name);
+int mi2get_cfg_int(const char *name);
+char *mi2get_cfg_str(const char *name);
 int mi2log_set_verbosity ( int lvl );
 
 #define MI_LOG_ERROR(code,...) mi2log_message(__FILE__,__LINE__,code , ##__VA_ARGS__ )
@@ -52,12 +52,49 @@ typedef long long mi_i64_t;
  */
 #define MI_FULLDIMENSIONS_PATH MI_ROOT_PATH "/dimensions"
 
+/** \internal
+ * Instruction sets used by the voxel scaling kernels
+ */
+#define MI2_SIMD_SCALAR 0
+#define MI2_SIMD_SSE2   1
+#define MI2_SIMD_AVX2   2
+
+/** \internal
+ * Registered HDF5 filter identifier of the LZ4 filter, which libminc
+ * provides itself.
+ */
+#define MI2_H5Z_FILTER_LZ4 32004
+
+/** \internal
+ * HDF5 filter identifier of the run-length filter, which libminc
+ * provides itself.  It is not registered with The HDF Group, so it is
+ * taken from the range 32768 to 65535 HDF5 leaves to applications, not
+ * from 256 to 511, which is reserved for testing; files written with it
+ * can only be read through libminc.
+ */
+#define MI2_H5Z_FILTER_RLE 52553
+
+/** \internal
+ * Most filters in an image pipeline handled by the chunk codecs.
+ */
+#define MI2_MAX_CODEC_FILTERS 4
+
+/** \internal
+ * Filter pipeline of a chunked dataset, as applied by the chunk codecs.
+ */
+typedef struct {
+  int nfilters;
+  H5Z_filter_t filter_ids[MI2_MAX_CODEC_FILTERS];
+  unsigned int params[MI2_MAX_CODEC_FILTERS]; /* First client value */
+} micodec_pipeline_t;
+
 /** \internal
  * Volume properties  
  */
 struct mivolprops {
     miboolean_t enable_flag;    /* enable multi-res */
     int depth;                  /* multi-res depth */
+    mifilter_t resolution_filter; /* multi-res downsampling filter */
     micompression_t compression_type;
     int zlib_level; 
     int edge_count;             /* how many chunks */
@@ -66,6 +103,8 @@ struct mivolprops {
     misize_t record_length;
     char *record_name;
     int  template_flag;
+    size_t cache_size;          /* chunk cache bytes, 0 for default */
+    size_t cache_slots;         /* chunk cache hash slots */
 }; 
 
 /** \internal
@@ -89,6 +128,12 @@ struct midimension {
   short world_index;            /* -1, MI2_X, MI2_Y, or MI2_Z */
 };
 
+/** \internal
+ * Number of buffer datatypes which may be cached on a volume handle,
+ * one slot per numeric mitype_t.
+ */
+#define MI2_TYPE_CACHE_SLOTS 12
+
 /** \internal
  * Volume handle  
  */
@@ -116,6 +161,31 @@ struct mivolume {
   double scale_min;             /* Global minimum */
   double scale_max;             /* Global maximum */
   miboolean_t is_dirty;         /* TRUE if data has been modified. */
+  hid_t image_fspc_id;          /* Cached file dataspace of image */
+  hid_t image_mspc_id;          /* Cached memory dataspace for hyperslabs */
+  hid_t buffer_type_ids[MI2_TYPE_CACHE_SLOTS]; /* Cached buffer types */
+  int io_threads;               /* Threads for parallel chunk I/O */
+  hsize_t stale_first[MI2_MAX_RESOLUTION_GROUP + 1]; /* Source slices */
+  hsize_t stale_end[MI2_MAX_RESOLUTION_GROUP + 1];   /* changed since each
+                                                        level was built */
+  miboolean_t lazy_resolution;  /* Build levels when selected, not on close */
+  mifilter_t resolution_filter; /* Filter used to build the levels */
+  double *range_max;            /* Cached image-max of slice scaled volumes */
+  double *range_min;            /* Cached image-min */
+  hsize_t range_dims[MI2_MAX_VAR_DIMS]; /* Dimensions of the cached ranges */
+  int range_rank;               /* Number of dimensions of the ranges */
+  miboolean_t range_dirty;      /* TRUE if the cache must be written back */
+  hid_t thumb_file_id;          /* In-memory levels of a read-only volume */
+  miboolean_t header_only;      /* TRUE until the image of a volume opened
+                                   with MI2_OPEN_HEADER is set up */
+  void *map_base;               /* Read-only mapping of the image, or NULL */
+  size_t map_length;            /* Length of the mapping in bytes */
+  const void *map_data;         /* First voxel of the mapped image */
+  int map_resolution;           /* Resolution the mapping belongs to */
+  struct milabeldict *label_dict; /* Cached labels of a label volume */
+  struct milabelindex *label_index; /* Labels present in the image */
+  miboolean_t label_index_stale; /* TRUE if the saved label index is out
+                                    of date with the image */
 };
 
 /**
@@ -161,12 +231,6 @@ void miinit_enum(hid_t);
 int miget_scalar(hid_t loc_id, hid_t type_id, const char *path, 
                         void *data);
 
-int minc_create_thumbnail(mihandle_t volume, int grp);
-
-int minc_update_thumbnail(mihandle_t volume, hid_t loc_id, int igrp, int ogrp);
-
-int minc_update_thumbnails(mihandle_t volume);
-
 int scaled_maximal_pivoting_gaussian_elimination(int   n,
                                                   int   row[],
                                                   double **a,
@@ -190,6 +254,41 @@ int add_minimal_minc_attributes(hid_t hdf_file, hid_t dset_id);
 int add_standard_minc_attributes(hid_t hdf_file, hid_t dset_id);
 
 
+/* From codec.c */
+void micodec_init(void);
+int micodec_supported(micompression_t compression_type);
+int micodec_set_filters(hid_t dcpl_id, micompression_t compression_type,
+                        int zlib_level);
+micompression_t micodec_detect(hid_t dcpl_id, int *zlib_level);
+int micodec_check_filters(hid_t dcpl_id);
+int micodec_get_pipeline(hid_t dcpl_id, micodec_pipeline_t *pipeline);
+int micodec_encode(const micodec_pipeline_t *pipeline,
+                   const unsigned char *chunk, size_t nbytes,
+                   unsigned char **data, size_t *size);
+int micodec_decode(const micodec_pipeline_t *pipeline, uint32_t filter_mask,
+                   const unsigned char *data, size_t size,
+                   unsigned char *chunk, unsigned char *scratch,
+                   size_t nbytes);
+
+/* From chunk.c */
+int miuse_parallel_chunks(mihandle_t volume, hid_t dset_id, hid_t type_id,
+                          int ndims, hsize_t chunk_dims[]);
+
+int miuse_parallel_hyperslab(mihandle_t volume, hid_t dset_id, int ndims,
+                             const hsize_t chunk_dims[],
+                             const hsize_t hdf_start[],
+                             const hsize_t hdf_count[]);
+
+int miread_parallel_chunks(mihandle_t volume, hid_t dset_id, hid_t type_id,
+                           int ndims, const hsize_t chunk_dims[],
+                           const hsize_t hdf_start[],
+                           const hsize_t hdf_count[], void *buffer);
+
+int miwrite_parallel_chunks(mihandle_t volume, hid_t dset_id, hid_t type_id,
+                            int ndims, const hsize_t chunk_dims[],
+                            const hsize_t hdf_start[],
+                            const hsize_t hdf_count[], const void *buffer);
+
 /* From hyper.c */
 int mitranslate_hyperslab_origin(mihandle_t volume, 
                                 const misize_t* start, 
@@ -197,8 +296,58 @@ int mitranslate_hyperslab_origin(mihandle_t volume,
                                 hsize_t* hdf_start,
                                 hsize_t* hdf_count,
                                 int* dir);
+int miget_image_dataset(mihandle_t volume, hid_t *dset_id, hid_t *fspc_id);
+hid_t miget_buffer_type(mihandle_t volume, mitype_t mitype);
+void mifree_hyperslab_cache(mihandle_t volume);
+
+/* From slice.c */
+int miload_slice_ranges(mihandle_t volume);
+int miget_cached_slice_ranges(mihandle_t volume, const hsize_t hdf_start[],
+                              const hsize_t hdf_count[], double *slice_max,
+                              double *slice_min);
+int miflush_slice_ranges(mihandle_t volume);
+void mifree_slice_ranges(mihandle_t volume);
+
+/* From label.c */
+void mifree_label_dictionary(mihandle_t volume);
+void mifree_label_index(mihandle_t volume);
+int misave_label_index(mihandle_t volume);
+
+/* From pyramid.c */
+int minc_create_thumbnail(mihandle_t volume, int grp);
+
+int minc_update_thumbnail(mihandle_t volume, hid_t loc_id, int igrp, int ogrp);
+
+int minc_update_thumbnails(mihandle_t volume);
+
+void minc_mark_stale_thumbnails(mihandle_t volume, hsize_t first,
+                                hsize_t count);
+
+hid_t minc_select_thumbnail(mihandle_t volume, int depth);
+
+void minc_load_thumbnail_state(mihandle_t volume);
+
+int minc_save_thumbnail_state(mihandle_t volume);
+
+int minc_save_resolution_filter(mihandle_t volume);
+
+/* From scale.c */
+int miscale_supported(mitype_t mitype);
+int miscale_get_isa(void);
+int miscale_set_isa(int isa);
+const char *miscale_isa_name(int isa);
+int miscale_to_real(mitype_t src_type, const void *src,
+                    mitype_t dst_type, void *dst, size_t n,
+                    double scale, double offset);
+int miscale_from_real(mitype_t src_type, const void *src,
+                      mitype_t dst_type, void *dst, size_t n,
+                      double scale, double offset);
+int miscale_minmax(mitype_t type, const void *src, size_t n,
+                   double *min, double *max);
+
 /* From volume.c */
 void misave_valid_range(mihandle_t volume);
+int miload_volume_image(mihandle_t volume);
 
 /* From valid.c*/
 void miinit_default_range(mitype_t mitype, double *valid_max, double *valid_min);
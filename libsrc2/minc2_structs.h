@@ -39,6 +39,18 @@ typedef struct mivolume *mihandle_t;
  */
 typedef void *milisthandle_t;
 
+/** \typedef miattrsnapshot_t
+ * The miattrsnapshot_t is an opaque type that holds a copy of the
+ * attributes found under a path of a MINC file.
+ */
+typedef struct miattrsnapshot *miattrsnapshot_t;
+
+/** \typedef mislabiter_t
+ * The mislabiter_t is an opaque type that represents an iterator over
+ * the slabs of the image of a volume.
+ */
+typedef struct mislabiter *mislabiter_t;
+
 /**
  * This typedef used to represent the type of an individual voxel <b>as
  * stored</b> by MINC 2.0. 
@@ -140,9 +152,44 @@ typedef enum {
  */
 typedef enum {
   MI_COMPRESS_NONE = 0,         /**< No compression */
-  MI_COMPRESS_ZLIB = 1          /**< GZIP compression */
+  MI_COMPRESS_ZLIB = 1,         /**< GZIP compression */
+  MI_COMPRESS_SHUFFLE_ZLIB = 2, /**< Byte shuffle, then GZIP compression */
+  MI_COMPRESS_LZ4 = 3,          /**< LZ4 compression */
+  MI_COMPRESS_SHUFFLE_LZ4 = 4,  /**< Byte shuffle, then LZ4 compression */
+  MI_COMPRESS_RLE = 5           /**< Run-length encoding, for label volumes */
 } micompression_t;
 
+/** \typedef miaccess_pattern_t
+ * The way a volume is expected to be read, used to choose its chunk
+ * shape and chunk cache size.
+ */
+typedef enum {
+  MI_ACCESS_VOLUME = 0,         /**< Whole volume at once */
+  MI_ACCESS_SLICES = 1,         /**< Slice by slice along one dimension */
+  MI_ACCESS_PATCHES = 2,        /**< Small 3D patches anywhere in the volume */
+  MI_ACCESS_TIMESERIES = 3      /**< Every value of single voxels along one dimension */
+} miaccess_pattern_t;
+
+/** \typedef mifilter_t
+ * Filter used to compute the lower resolution images of a
+ * multi-resolution volume.
+ */
+typedef enum {
+  MI_FILTER_DEFAULT = 0,        /**< Box, or mode for label volumes */
+  MI_FILTER_BOX = 1,            /**< Mean of each 2x2x2 block */
+  MI_FILTER_GAUSSIAN = 2,       /**< Binomial [1 3 3 1]/8 kernel */
+  MI_FILTER_MODE = 3            /**< Most frequent value of each 2x2x2 block */
+} mifilter_t;
+
+/** \typedef mislabmode_t
+ * Conversion applied by a slab iterator to the voxels of each slab.
+ */
+typedef enum {
+  MI_SLAB_VOXEL = 0,            /**< As miget_voxel_value_hyperslab() */
+  MI_SLAB_REAL = 1,             /**< As miget_real_value_hyperslab() */
+  MI_SLAB_NORMALIZED = 2        /**< As miget_hyperslab_normalized() */
+} mislabmode_t;
+
 /** \typedef miboolean_t
  * Boolean value
  */
@@ -0,0 +1,1550 @@
+/** \file pyramid.c
+ * \brief MINC 2.0 multi-resolution images
+ *
+ * The lower resolution images of a volume ("thumbnails") are stored in
+ * the groups 1, 2, ... next to the full resolution image in group 0,
+ * each one half the size of the previous one along every dimension.
+ *
+ * All of them are computed in a single pass over the source image.
+ * Blocks of source slices (along the slowest varying dimension) are read
+ * in the stored voxel type, and each level filters the slices of the
+ * level above as they become available and passes its own slices on to
+ * the next level, so only a few slices of every level are ever held in
+ * memory and the source image is read only once.  With more than one
+ * I/O thread (miset_volume_io_threads()) the slices of a block, and the
+ * output slices they complete, are filtered in parallel.
+ *
+ * The filter is chosen with miset_props_resolution_filter():
+ * - box: the mean of each 2x2x... block of voxels;
+ * - Gaussian: the binomial kernel [1 3 3 1]/8 along every dimension,
+ *   which aliases less than the box;
+ * - mode: the most frequent value of each block, for label volumes.
+ *
+ * When the image is scaled by a single real range the filters work on
+ * voxel values and every level keeps that range.  When it has slice
+ * scaling they work on real values, and each slice of a lower resolution
+ * image is quantized to the valid range with its own real range.
+ ************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <hdf5.h>
+#include "minc2.h"
+#include "minc2_private.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/** Approximate size of the blocks of source slices, as real values. */
+#define MI2_PYRAMID_BLOCK_BYTES (16 << 20)
+
+/** Upper limit for the number of threads, as in miset_volume_io_threads(). */
+#define MI2_PYRAMID_MAX_THREADS 64
+
+/** The mode filter looks at 2^ndims voxels for each voxel it computes. */
+#define MI2_MODE_MAX_DIMS 8
+
+#define MI2_MAX_TAPS 4
+
+/** Stale range covering every slice of the full resolution image. */
+#define MI2_ALL_SLICES ((hsize_t) -1)
+
+/** Attribute of a resolution group holding its stale source slices. */
+#define MI2_STALE_ATTR "stale-slices"
+
+/** Attribute of the image group naming the filter of its levels. */
+#define MI2_FILTER_ATTR "resolution-filter"
+
+/** Names of the filters in MI2_FILTER_ATTR, indexed by mifilter_t. */
+static const char *mifilter_names[] = { "default", "box", "gaussian", "mode" };
+
+/** \internal
+ * A separable filter.  Along each dimension, voxel j of a level is the
+ * weighted sum of voxels 2j+first ... 2j+first+taps-1 of the level
+ * above, with the indices clamped to its extent.
+ */
+typedef struct {
+  int taps;
+  int first;
+  double weights[MI2_MAX_TAPS];
+} mikernel_t;
+
+static const mikernel_t mibox_kernel = {
+  2, 0, { 0.5, 0.5 }
+};
+
+static const mikernel_t migaussian_kernel = {
+  4, -1, { 0.125, 0.375, 0.375, 0.125 }
+};
+
+/** \internal
+ * One level of the pyramid.  Level 0 is the image the others are built
+ * from; only its size is used.
+ */
+typedef struct {
+  hsize_t size[MI2_MAX_VAR_DIMS]; /* Extent of the level */
+  size_t slice_n;               /* Voxels in one slice */
+  size_t stage_n;               /* Voxels in one staged input slice */
+  hsize_t first;                /* Slices computed, first ... end-1 */
+  hsize_t end;
+  double *ring;                 /* Input slices, by index modulo n_ring */
+  int n_ring;
+  double *out;                  /* Slices computed but not yet passed on */
+  int n_out_max;
+  hsize_t n_in;                 /* Input slices staged so far */
+  hsize_t n_out;                /* Slices computed so far */
+  int write;                    /* Store this level in the file */
+  hid_t dset_id;
+  hid_t fspc_id;
+  hid_t mspc_id;                /* One slice in memory */
+  hid_t imax_id;
+  hid_t imin_id;
+  hid_t rfspc_id;               /* Dataspace of image-max and image-min */
+  hid_t rmspc_id;               /* Ranges of one slice in memory */
+  int range_rank;
+  size_t n_ranges;              /* Real ranges in one slice */
+  double *ranges;               /* n_ranges maxima followed by the minima */
+  void *voxels;                 /* One slice in the stored type */
+} milevel_t;
+
+/** \internal
+ * State of a pyramid build.
+ */
+typedef struct {
+  mihandle_t volume;
+  int ndims;
+  const mikernel_t *kernel;     /* NULL for the mode filter */
+  mitype_t mem_type;            /* Voxel type read and written */
+  hid_t mem_type_id;
+  size_t mem_size;
+  int nthreads;
+  int has_ranges;               /* Write image-max and image-min */
+  int real_domain;              /* Filter real values (slice scaling) */
+  double real_min, real_max;    /* Single real range otherwise */
+  double *src_max;              /* Source slice ranges when real_domain */
+  double *src_min;
+  size_t src_n_ranges;          /* Source ranges per slice */
+  int src_range_rank;
+  int n_levels;                 /* Levels built after the source */
+  milevel_t level[MI2_MAX_RESOLUTION_GROUP + 1];
+  volatile int failed;          /* Set by a task which ran out of memory */
+} mipyramid_t;
+
+/** \internal
+ * Runs \a task for the indices 0 ... \a n - 1, on up to \a nthreads
+ * threads.
+ */
+typedef void (*mitask_t)(void *arg, size_t index);
+
+#ifdef HAVE_PTHREAD
+typedef struct {
+  mitask_t task;
+  void *arg;
+  size_t n;
+  size_t next;
+  pthread_mutex_t lock;
+} mitask_pool_t;
+
+static void *mitask_worker(void *arg)
+{
+  mitask_pool_t *pool = (mitask_pool_t *) arg;
+  size_t index;
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    index = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+    if (index >= pool->n) {
+      break;
+    }
+    pool->task(pool->arg, index);
+  }
+  return NULL;
+}
+#endif /*HAVE_PTHREAD*/
+
+static void miparallel_for(int nthreads, size_t n, mitask_t task, void *arg)
+{
+  size_t i;
+
+#ifdef HAVE_PTHREAD
+  if (nthreads > 1 && n > 1) {
+    pthread_t threads[MI2_PYRAMID_MAX_THREADS];
+    mitask_pool_t pool;
+    int started;
+
+    if (nthreads > MI2_PYRAMID_MAX_THREADS) {
+      nthreads = MI2_PYRAMID_MAX_THREADS;
+    }
+    if ((size_t) nthreads > n) {
+      nthreads = (int) n;
+    }
+    pool.task = task;
+    pool.arg = arg;
+    pool.n = n;
+    pool.next = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+
+    /* The calling thread is one of the workers. */
+    for (started = 0; started < nthreads - 1; started++) {
+      if (pthread_create(&threads[started], NULL, mitask_worker, &pool) != 0) {
+        break;
+      }
+    }
+    mitask_worker(&pool);
+    while (started > 0) {
+      pthread_join(threads[--started], NULL);
+    }
+    pthread_mutex_destroy(&pool.lock);
+    return;
+  }
+#endif /*HAVE_PTHREAD*/
+  for (i = 0; i < n; i++) {
+    task(arg, i);
+  }
+}
+
+/** Applies \a kernel along one dimension of \a in, which has \a n_in
+ * voxels along it, \a outer blocks before it and \a inner voxels after.
+ */
+static void mireduce_dim(const mikernel_t *kernel, const double *in,
+                         double *out, size_t outer, hsize_t n_in,
+                         hsize_t n_out, size_t inner)
+{
+  long index[MI2_MAX_TAPS];
+  size_t o, i;
+  hsize_t j;
+  int t;
+
+  for (o = 0; o < outer; o++) {
+    const double *src = in + o * n_in * inner;
+    double *dst = out + o * n_out * inner;
+
+    for (j = 0; j < n_out; j++, dst += inner) {
+      for (t = 0; t < kernel->taps; t++) {
+        long k = (long) (2 * j) + kernel->first + t;
+
+        if (k < 0) {
+          k = 0;
+        } else if (k >= (long) n_in) {
+          k = (long) n_in - 1;
+        }
+        index[t] = k;
+      }
+
+      if (inner == 1) {
+        double sum = 0.0;
+
+        for (t = 0; t < kernel->taps; t++) {
+          sum += kernel->weights[t] * src[index[t]];
+        }
+        *dst = sum;
+      } else {
+        for (i = 0; i < inner; i++) {
+          dst[i] = kernel->weights[0] * src[index[0] * inner + i];
+        }
+        for (t = 1; t < kernel->taps; t++) {
+          const double *s = src + index[t] * inner;
+          double w = kernel->weights[t];
+
+          for (i = 0; i < inner; i++) {
+            dst[i] += w * s[i];
+          }
+        }
+      }
+    }
+  }
+}
+
+/** Filters one slice \a in, of extent \a n_in along dimensions
+ * 1 ... ndims-1, to the extent \a n_out.  \a tmp must hold as many
+ * values as the input slice.
+ */
+static void mireduce_slice(const mikernel_t *kernel, int ndims,
+                           const hsize_t n_in[], const hsize_t n_out[],
+                           const double *in, double *out, double *tmp)
+{
+  hsize_t shape[MI2_MAX_VAR_DIMS];
+  const double *src = in;
+  size_t n_slice = 1;
+  int d, i;
+
+  if (ndims < 2) {
+    out[0] = in[0];
+    return;
+  }
+
+  for (d = 1; d < ndims; d++) {
+    shape[d] = n_in[d];
+    n_slice *= n_in[d];
+  }
+
+  /* Fastest varying dimension first, alternating between the two halves
+   * of the temporary buffer.
+   */
+  for (d = ndims - 1; d >= 1; d--) {
+    double *dst = (d == 1) ? out : tmp + ((d & 1) ? 0 : n_slice / 2 + 1);
+    size_t outer = 1, inner = 1;
+
+    for (i = 1; i < d; i++) {
+      outer *= shape[i];
+    }
+    for (i = d + 1; i < ndims; i++) {
+      inner *= shape[i];
+    }
+    mireduce_dim(kernel, src, dst, outer, shape[d], n_out[d], inner);
+    shape[d] = n_out[d];
+    src = dst;
+  }
+}
+
+/** Sets \a out to the mode of each 2x2x... block of the two input slices
+ * \a in0 and \a in1.  Ties go to the smallest value.
+ */
+static void mimode_slice(int ndims, const hsize_t n_in[],
+                         const hsize_t n_out[], const double *in0,
+                         const double *in1, double *out)
+{
+  size_t offsets[1 << (MI2_MODE_MAX_DIMS - 1)];
+  double values[1 << MI2_MODE_MAX_DIMS];
+  size_t stride[MI2_MAX_VAR_DIMS];
+  hsize_t pos[MI2_MAX_VAR_DIMS];
+  size_t n_corners = (size_t) 1 << (ndims - 1);
+  size_t n_total = 1;
+  size_t c, i, base;
+  int d;
+
+  stride[ndims - 1] = 1;
+  for (d = ndims - 2; d >= 1; d--) {
+    stride[d] = stride[d + 1] * n_in[d + 1];
+  }
+  for (c = 0; c < n_corners; c++) {
+    offsets[c] = 0;
+    for (d = 1; d < ndims; d++) {
+      if (c & ((size_t) 1 << (d - 1))) {
+        offsets[c] += stride[d];
+      }
+    }
+  }
+  for (d = 1; d < ndims; d++) {
+    n_total *= n_out[d];
+    pos[d] = 0;
+  }
+
+  for (i = 0; i < n_total; i++) {
+    size_t n_values = 2 * n_corners;
+    size_t best = 0, best_count = 0, run;
+
+    base = 0;
+    for (d = 1; d < ndims; d++) {
+      base += 2 * pos[d] * stride[d];
+    }
+    for (c = 0; c < n_corners; c++) {
+      values[c] = in0[base + offsets[c]];
+      values[n_corners + c] = in1[base + offsets[c]];
+    }
+
+    /* Insertion sort, then the longest run. */
+    for (c = 1; c < n_values; c++) {
+      double v = values[c];
+      size_t k = c;
+
+      while (k > 0 && values[k - 1] > v) {
+        values[k] = values[k - 1];
+        k--;
+      }
+      values[k] = v;
+    }
+    for (c = 0; c < n_values; c += run) {
+      for (run = 1; c + run < n_values && values[c + run] == values[c]; run++)
+        ;
+      if (run > best_count) {
+        best_count = run;
+        best = c;
+      }
+    }
+    out[i] = values[best];
+
+    for (d = ndims - 1; d >= 1; d--) {
+      if (++pos[d] < n_out[d]) {
+        break;
+      }
+      pos[d] = 0;
+    }
+  }
+}
+
+/** Converts source slice \a slice from stored voxels to the values the
+ * filters work on.
+ */
+static void miconvert_source(const mipyramid_t *pyramid, hsize_t slice,
+                             const void *src, double *dst)
+{
+  const milevel_t *source = &pyramid->level[0];
+  mihandle_t volume = pyramid->volume;
+  size_t n_seg, q;
+
+  if (!pyramid->real_domain) {
+    miscale_to_real(pyramid->mem_type, src, MI_TYPE_DOUBLE, dst,
+                    source->slice_n, 1.0, 0.0);
+    return;
+  }
+
+  n_seg = source->slice_n / pyramid->src_n_ranges;
+  for (q = 0; q < pyramid->src_n_ranges; q++) {
+    size_t r = (size_t) slice * pyramid->src_n_ranges + q;
+    double valid_range = volume->valid_max - volume->valid_min;
+    double scale, offset;
+
+    if (valid_range == 0.0) {
+      scale = 0.0;
+    } else {
+      scale = (pyramid->src_max[r] - pyramid->src_min[r]) / valid_range;
+    }
+    offset = pyramid->src_min[r] - volume->valid_min * scale;
+    miscale_to_real(pyramid->mem_type,
+                    (const char *) src + q * n_seg * pyramid->mem_size,
+                    MI_TYPE_DOUBLE, dst + q * n_seg, n_seg, scale, offset);
+  }
+}
+
+/** Stores input slice \a index of level \a lvl, filtering it within the
+ * slice unless the mode filter is used.  \a src holds stored voxels of
+ * the source if \a lvl is 1, the values of level \a lvl - 1 otherwise.
+ */
+static void mistage_slice(mipyramid_t *pyramid, int lvl, hsize_t index,
+                          const void *src)
+{
+  milevel_t *level = &pyramid->level[lvl];
+  const milevel_t *above = &pyramid->level[lvl - 1];
+  double *dst = level->ring + (index % level->n_ring) * level->stage_n;
+  const double *values = (const double *) src;
+  double *tmp = NULL;
+
+  if (pyramid->kernel != NULL) {
+    size_t n_tmp = above->slice_n * ((lvl == 1) ? 2 : 1);
+
+    if ((tmp = (double *) malloc((n_tmp + 2) * sizeof(double))) == NULL) {
+      pyramid->failed = TRUE;
+      return;
+    }
+  }
+  if (lvl == 1) {
+    double *converted = (pyramid->kernel != NULL) ? tmp + above->slice_n + 2 : dst;
+
+    miconvert_source(pyramid, index, src, converted);
+    values = converted;
+  }
+
+  if (pyramid->kernel != NULL) {
+    mireduce_slice(pyramid->kernel, pyramid->ndims, above->size, level->size,
+                   values, dst, tmp);
+    free(tmp);
+  } else if (values != dst) {
+    memcpy(dst, values, level->stage_n * sizeof(double));
+  }
+}
+
+/** Index of the last input slice needed by slice \a j of level \a lvl. */
+static hsize_t milast_input(const mipyramid_t *pyramid, int lvl, hsize_t j)
+{
+  hsize_t n_in = pyramid->level[lvl - 1].size[0];
+  long k;
+
+  if (pyramid->kernel == NULL) {
+    return 2 * j + 1;
+  }
+  k = (long) (2 * j) + pyramid->kernel->first + pyramid->kernel->taps - 1;
+  return (k >= (long) n_in) ? n_in - 1 : (hsize_t) k;
+}
+
+/** Computes slice \a j of level \a lvl from its staged input slices. */
+static void mifilter_slice(const mipyramid_t *pyramid, int lvl, hsize_t j,
+                           double *dst)
+{
+  const milevel_t *level = &pyramid->level[lvl];
+  const milevel_t *above = &pyramid->level[lvl - 1];
+  const mikernel_t *kernel = pyramid->kernel;
+  size_t i;
+  int t;
+
+  if (kernel == NULL) {
+    mimode_slice(pyramid->ndims, above->size, level->size,
+                 level->ring + ((2 * j) % level->n_ring) * level->stage_n,
+                 level->ring + ((2 * j + 1) % level->n_ring) * level->stage_n,
+                 dst);
+    return;
+  }
+
+  for (t = 0; t < kernel->taps; t++) {
+    long k = (long) (2 * j) + kernel->first + t;
+    const double *src;
+    double w = kernel->weights[t];
+
+    if (k < 0) {
+      k = 0;
+    } else if (k >= (long) above->size[0]) {
+      k = (long) above->size[0] - 1;
+    }
+    src = level->ring + ((hsize_t) k % level->n_ring) * level->stage_n;
+    if (t == 0) {
+      for (i = 0; i < level->slice_n; i++) {
+        dst[i] = w * src[i];
+      }
+    } else {
+      for (i = 0; i < level->slice_n; i++) {
+        dst[i] += w * src[i];
+      }
+    }
+  }
+}
+
+/** \internal
+ * Arguments of the parallel staging and filtering tasks.
+ */
+typedef struct {
+  mipyramid_t *pyramid;
+  int lvl;
+  hsize_t first;
+  const char *src;
+} mitask_args_t;
+
+static void mistage_task(void *arg, size_t i)
+{
+  mitask_args_t *args = (mitask_args_t *) arg;
+  mipyramid_t *pyramid = args->pyramid;
+
+  mistage_slice(pyramid, args->lvl, args->first + i,
+                args->src + i * pyramid->level[0].slice_n * pyramid->mem_size);
+}
+
+static void mifilter_task(void *arg, size_t i)
+{
+  mitask_args_t *args = (mitask_args_t *) arg;
+  milevel_t *level = &args->pyramid->level[args->lvl];
+
+  mifilter_slice(args->pyramid, args->lvl, args->first + i,
+                 level->out + i * level->slice_n);
+}
+
+/** Writes slice \a j of level \a lvl, with its real ranges. */
+static int mistore_slice(mipyramid_t *pyramid, int lvl, hsize_t j,
+                         const double *values)
+{
+  milevel_t *level = &pyramid->level[lvl];
+  mihandle_t volume = pyramid->volume;
+  hsize_t start[MI2_MAX_VAR_DIMS];
+  hsize_t count[MI2_MAX_VAR_DIMS];
+  size_t n_seg = level->slice_n / level->n_ranges;
+  size_t q;
+  int d;
+
+  for (q = 0; q < level->n_ranges; q++) {
+    const double *seg = values + q * n_seg;
+    char *voxels = (char *) level->voxels + q * n_seg * pyramid->mem_size;
+    double scale = 1.0, offset = 0.0;
+    double smin, smax;
+
+    if (pyramid->real_domain) {
+      miscale_minmax(MI_TYPE_DOUBLE, seg, n_seg, &smin, &smax);
+      if (smin > smax) {
+        /* Only NaNs; keep the ranges and the offset finite. */
+        smin = DBL_MAX;
+        smax = -DBL_MAX;
+      }
+      if (smax > smin) {
+        scale = (volume->valid_max - volume->valid_min) / (smax - smin);
+      } else {
+        scale = 0.0;
+      }
+      offset = volume->valid_min - smin * scale;
+    } else {
+      smin = pyramid->real_min;
+      smax = pyramid->real_max;
+    }
+    miscale_from_real(MI_TYPE_DOUBLE, seg, pyramid->mem_type, voxels, n_seg,
+                      scale, offset);
+    level->ranges[q] = smax;
+    level->ranges[level->n_ranges + q] = smin;
+  }
+
+  start[0] = j;
+  count[0] = 1;
+  for (d = 1; d < pyramid->ndims; d++) {
+    start[d] = 0;
+    count[d] = level->size[d];
+  }
+  MI_CHECK_HDF_CALL_RET(H5Sselect_hyperslab(level->fspc_id, H5S_SELECT_SET,
+                                            start, NULL, count, NULL),
+                        "H5Sselect_hyperslab");
+  MI_CHECK_HDF_CALL_RET(H5Dwrite(level->dset_id, pyramid->mem_type_id,
+                                 level->mspc_id, level->fspc_id, H5P_DEFAULT,
+                                 level->voxels),
+                        "H5Dwrite");
+
+  if (level->imax_id >= 0) {
+    MI_CHECK_HDF_CALL_RET(H5Sselect_hyperslab(level->rfspc_id, H5S_SELECT_SET,
+                                              start, NULL, count, NULL),
+                          "H5Sselect_hyperslab");
+    MI_CHECK_HDF_CALL_RET(H5Dwrite(level->imax_id, H5T_NATIVE_DOUBLE,
+                                   level->rmspc_id, level->rfspc_id,
+                                   H5P_DEFAULT, level->ranges),
+                          "H5Dwrite");
+    MI_CHECK_HDF_CALL_RET(H5Dwrite(level->imin_id, H5T_NATIVE_DOUBLE,
+                                   level->rmspc_id, level->rfspc_id,
+                                   H5P_DEFAULT,
+                                   level->ranges + level->n_ranges),
+                          "H5Dwrite");
+  }
+  return (MI_NOERROR);
+}
+
+static int miadvance_level(mipyramid_t *pyramid, int lvl);
+
+/** Passes slice \a j of level \a lvl to the file and to the next level. */
+static int miemit_slice(mipyramid_t *pyramid, int lvl, hsize_t j,
+                        const double *values)
+{
+  if (pyramid->level[lvl].write &&
+      mistore_slice(pyramid, lvl, j, values) < 0) {
+    return (MI_ERROR);
+  }
+  if (lvl < pyramid->n_levels) {
+    milevel_t *next = &pyramid->level[lvl + 1];
+
+    mistage_slice(pyramid, lvl + 1, next->n_in, values);
+    next->n_in++;
+    if (pyramid->failed) {
+      return (MI_LOG_ERROR(MI2_MSG_OUTOFMEM, "pyramid slice"));
+    }
+    return (miadvance_level(pyramid, lvl + 1));
+  }
+  return (MI_NOERROR);
+}
+
+/** Computes every slice of level \a lvl whose input slices are staged. */
+static int miadvance_level(mipyramid_t *pyramid, int lvl)
+{
+  milevel_t *level = &pyramid->level[lvl];
+
+  for (;;) {
+    mitask_args_t args;
+    hsize_t j_end = level->n_out;
+    hsize_t j;
+
+    while (j_end < level->end &&
+           j_end - level->n_out < (hsize_t) level->n_out_max &&
+           milast_input(pyramid, lvl, j_end) < level->n_in) {
+      j_end++;
+    }
+    if (j_end == level->n_out) {
+      return (MI_NOERROR);
+    }
+
+    args.pyramid = pyramid;
+    args.lvl = lvl;
+    args.first = level->n_out;
+    args.src = NULL;
+    miparallel_for(pyramid->nthreads, (size_t) (j_end - level->n_out),
+                   mifilter_task, &args);
+
+    for (j = level->n_out; j < j_end; j++) {
+      if (miemit_slice(pyramid, lvl, j,
+                       level->out + (j - level->n_out) * level->slice_n) < 0) {
+        return (MI_ERROR);
+      }
+    }
+    level->n_out = j_end;
+  }
+}
+
+/** Opens \a name in \a loc_id, creating it if it does not exist yet. */
+static hid_t micreate_or_open(hid_t loc_id, const char *name, hid_t type_id,
+                              hid_t fspc_id)
+{
+  hid_t dset_id;
+
+  H5E_BEGIN_TRY {
+    dset_id = H5Dopen2(loc_id, name, H5P_DEFAULT);
+  } H5E_END_TRY;
+  if (dset_id < 0) {
+    dset_id = H5Dcreate2(loc_id, name, type_id, fspc_id, H5P_DEFAULT,
+                         H5P_DEFAULT, H5P_DEFAULT);
+  }
+  return dset_id;
+}
+
+/** Opens or creates the datasets of level \a lvl, group \a grp. */
+static int miopen_level(mipyramid_t *pyramid, hid_t loc_id, int lvl, int grp,
+                        hid_t ftype_id)
+{
+  milevel_t *level = &pyramid->level[lvl];
+  hsize_t dims[MI2_MAX_VAR_DIMS];
+  char path[MI2_MAX_PATH];
+  int d;
+
+  MI_CHECK_HDF_CALL_RET(level->fspc_id = H5Screate_simple(pyramid->ndims,
+                                                          level->size, NULL),
+                        "H5Screate_simple");
+  dims[0] = 1;
+  for (d = 1; d < pyramid->ndims; d++) {
+    dims[d] = level->size[d];
+  }
+  MI_CHECK_HDF_CALL_RET(level->mspc_id = H5Screate_simple(pyramid->ndims,
+                                                          dims, NULL),
+                        "H5Screate_simple");
+
+  sprintf(path, "%d/image", grp);
+  MI_CHECK_HDF_CALL_RET(level->dset_id = micreate_or_open(loc_id, path,
+                                                          ftype_id,
+                                                          level->fspc_id),
+                        "H5Dcreate2");
+
+  level->voxels = malloc(level->slice_n * pyramid->mem_size);
+  level->ranges = (double *) malloc(2 * level->n_ranges * sizeof(double));
+  if (level->voxels == NULL || level->ranges == NULL) {
+    return (MI_LOG_ERROR(MI2_MSG_OUTOFMEM, "pyramid level"));
+  }
+
+  if (pyramid->has_ranges) {
+    dims[0] = level->n_ranges;
+    MI_CHECK_HDF_CALL_RET(level->rfspc_id = H5Screate_simple(level->range_rank,
+                                                             level->size, NULL),
+                          "H5Screate_simple");
+    MI_CHECK_HDF_CALL_RET(level->rmspc_id = H5Screate_simple(1, dims, NULL),
+                          "H5Screate_simple");
+
+    sprintf(path, "%d/image-max", grp);
+    MI_CHECK_HDF_CALL_RET(level->imax_id = micreate_or_open(loc_id, path,
+                                                            H5T_IEEE_F64LE,
+                                                            level->rfspc_id),
+                          "H5Dcreate2");
+    sprintf(path, "%d/image-min", grp);
+    MI_CHECK_HDF_CALL_RET(level->imin_id = micreate_or_open(loc_id, path,
+                                                            H5T_IEEE_F64LE,
+                                                            level->rfspc_id),
+                          "H5Dcreate2");
+  }
+  return (MI_NOERROR);
+}
+
+/** Reads the real ranges of the source image in group \a igrp. */
+static int miread_source_ranges(mipyramid_t *pyramid, hid_t loc_id, int igrp)
+{
+  const milevel_t *source = &pyramid->level[0];
+  hsize_t dims[MI2_MAX_VAR_DIMS];
+  char path[MI2_MAX_PATH];
+  hid_t imax_id, imin_id, fspc_id;
+  size_t n_total = 1;
+  int rank, d;
+  int result = MI_NOERROR;
+
+  sprintf(path, "%d/image-max", igrp);
+  H5E_BEGIN_TRY {
+    imax_id = H5Dopen2(loc_id, path, H5P_DEFAULT);
+  } H5E_END_TRY;
+  if (imax_id < 0) {
+    return (MI_NOERROR);        /* Voxel values only. */
+  }
+  sprintf(path, "%d/image-min", igrp);
+  if ((imin_id = H5Dopen2(loc_id, path, H5P_DEFAULT)) < 0) {
+    H5Dclose(imax_id);
+    return (MI_ERROR);
+  }
+
+  fspc_id = H5Dget_space(imax_id);
+  rank = H5Sget_simple_extent_ndims(fspc_id);
+  H5Sget_simple_extent_dims(fspc_id, dims, NULL);
+  H5Sclose(fspc_id);
+
+  pyramid->has_ranges = TRUE;
+  if (rank <= 0) {
+    /* A single range for the whole image. */
+    if (H5Dread(imax_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                &pyramid->real_max) < 0 ||
+        H5Dread(imin_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                &pyramid->real_min) < 0) {
+      result = MI_ERROR;
+    }
+  } else if (rank >= pyramid->ndims) {
+    result = MI_LOG_ERROR(MI2_MSG_GENERIC, "Unexpected image-max dimensions");
+  } else {
+    pyramid->real_domain = TRUE;
+    pyramid->src_range_rank = rank;
+    pyramid->src_n_ranges = 1;
+    for (d = 0; d < rank; d++) {
+      if (dims[d] != source->size[d]) {
+        result = MI_LOG_ERROR(MI2_MSG_GENERIC,
+                              "Unexpected image-max dimensions");
+      }
+      n_total *= dims[d];
+      if (d > 0) {
+        pyramid->src_n_ranges *= dims[d];
+      }
+    }
+    if (result == MI_NOERROR) {
+      pyramid->src_max = (double *) malloc(n_total * sizeof(double));
+      pyramid->src_min = (double *) malloc(n_total * sizeof(double));
+      if (pyramid->src_max == NULL || pyramid->src_min == NULL) {
+        result = MI_LOG_ERROR(MI2_MSG_OUTOFMEM, "image ranges");
+      } else if (H5Dread(imax_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL,
+                         H5P_DEFAULT, pyramid->src_max) < 0 ||
+                 H5Dread(imin_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL,
+                         H5P_DEFAULT, pyramid->src_min) < 0) {
+        result = MI_ERROR;
+      }
+    }
+  }
+
+  H5Dclose(imax_id);
+  H5Dclose(imin_id);
+  return (result);
+}
+
+/** Releases everything held by \a pyramid. */
+static void mifree_pyramid(mipyramid_t *pyramid)
+{
+  int lvl;
+
+  for (lvl = 1; lvl <= pyramid->n_levels; lvl++) {
+    milevel_t *level = &pyramid->level[lvl];
+
+    free(level->ring);
+    free(level->out);
+    free(level->voxels);
+    free(level->ranges);
+    if (level->dset_id >= 0) H5Dclose(level->dset_id);
+    if (level->imax_id >= 0) H5Dclose(level->imax_id);
+    if (level->imin_id >= 0) H5Dclose(level->imin_id);
+    if (level->fspc_id >= 0) H5Sclose(level->fspc_id);
+    if (level->mspc_id >= 0) H5Sclose(level->mspc_id);
+    if (level->rfspc_id >= 0) H5Sclose(level->rfspc_id);
+    if (level->rmspc_id >= 0) H5Sclose(level->rmspc_id);
+  }
+  if (pyramid->mem_type_id >= 0) {
+    H5Tclose(pyramid->mem_type_id);
+  }
+  free(pyramid->src_max);
+  free(pyramid->src_min);
+}
+
+/** Narrows slices \a first ... \a end - 1 of level \a lvl - 1 to the
+ * slices of level \a lvl which depend on them.
+ */
+static void miaffected_slices(const mipyramid_t *pyramid, int lvl,
+                              hsize_t *first, hsize_t *end)
+{
+  hsize_t size = pyramid->level[lvl].size[0];
+  hsize_t lo, hi;
+
+  if (*first >= *end) {
+    return;
+  }
+  if (pyramid->kernel == NULL) {
+    lo = *first / 2;
+    hi = (*end - 1) / 2 + 1;
+  } else {
+    long k = (long) *first - pyramid->kernel->first - pyramid->kernel->taps + 1;
+
+    lo = (k <= 0) ? 0 : (hsize_t) (k + 1) / 2;
+    hi = (*end - 1 - pyramid->kernel->first) / 2 + 1;
+  }
+  *first = lo;
+  *end = (hi > size) ? size : hi;
+  if (*first > *end) {
+    *first = *end;
+  }
+}
+
+/** Widens slices \a first ... \a end - 1 of level \a lvl to the slices
+ * of level \a lvl - 1 needed to compute them.
+ */
+static void mineeded_slices(const mipyramid_t *pyramid, int lvl,
+                            hsize_t *first, hsize_t *end)
+{
+  hsize_t size = pyramid->level[lvl - 1].size[0];
+  long lo, hi;
+
+  if (pyramid->kernel == NULL) {
+    lo = 2 * (long) *first;
+    hi = 2 * (long) *end;
+  } else {
+    lo = 2 * (long) *first + pyramid->kernel->first;
+    hi = 2 * ((long) *end - 1) + pyramid->kernel->first + pyramid->kernel->taps;
+  }
+  *first = (lo < 0) ? 0 : (hsize_t) lo;
+  *end = ((hsize_t) hi > size) ? size : (hsize_t) hi;
+}
+
+/** Brings the lower resolution images of \a volume in \a dst_loc up to
+ * date with the one in group \a igrp of \a src_loc.  Level \a lvl,
+ * from 1 to \a n_levels, is stored in group \a igrp + \a lvl and is
+ * recomputed where it depends on the source slices \a stale_first[lvl]
+ * ... \a stale_end[lvl] - 1; levels with no stale slices are only
+ * computed as far as the others need them.  The stale ranges of the
+ * levels brought up to date are cleared.  Fails if a level with stale
+ * slices is too small to exist.
+ */
+static int mibuild_pyramid(mihandle_t volume, hid_t src_loc, int igrp,
+                           hid_t dst_loc, int n_levels,
+                           hsize_t stale_first[], hsize_t stale_end[])
+{
+  mipyramid_t pyramid;
+  milevel_t *source = &pyramid.level[0];
+  hsize_t chunk_dims[MI2_MAX_VAR_DIMS];
+  hsize_t start[MI2_MAX_VAR_DIMS];
+  hsize_t count[MI2_MAX_VAR_DIMS];
+  char path[MI2_MAX_PATH];
+  hid_t dset_id = -1;
+  hid_t fspc_id = -1;
+  hid_t ftype_id = -1;
+  void *block = NULL;
+  hsize_t block_n, b0;
+  mifilter_t filter;
+  int parallel_read;
+  int result = MI_ERROR;
+  int lvl, d, top;
+
+  if (n_levels <= 0 || igrp + n_levels > MI2_MAX_RESOLUTION_GROUP) {
+    return (MI_ERROR);
+  }
+
+  /* The source ranges are read from the file, and the levels written
+   * may be the one whose ranges are cached.
+   */
+  if (miflush_slice_ranges(volume) < 0) {
+    return (MI_ERROR);
+  }
+  if (volume->selected_resolution != 0) {
+    mifree_slice_ranges(volume);
+  }
+
+  memset(&pyramid, 0, sizeof(pyramid));
+  pyramid.volume = volume;
+  pyramid.mem_type_id = -1;
+  pyramid.nthreads = volume->io_threads;
+  for (lvl = 0; lvl <= MI2_MAX_RESOLUTION_GROUP; lvl++) {
+    milevel_t *level = &pyramid.level[lvl];
+
+    level->dset_id = level->fspc_id = level->mspc_id = -1;
+    level->imax_id = level->imin_id = -1;
+    level->rfspc_id = level->rmspc_id = -1;
+  }
+
+  filter = volume->resolution_filter;
+  if (filter == MI_FILTER_DEFAULT) {
+    filter = (volume->volume_class == MI_CLASS_LABEL) ?
+             MI_FILTER_MODE : MI_FILTER_BOX;
+  }
+  switch (filter) {
+  case MI_FILTER_GAUSSIAN:
+    pyramid.kernel = &migaussian_kernel;
+    break;
+  case MI_FILTER_MODE:
+    pyramid.kernel = NULL;
+    break;
+  default:
+    pyramid.kernel = &mibox_kernel;
+    break;
+  }
+
+  /* Voxels are read and written in their own type when the scaling
+   * kernels handle it.  Labels and other types go through doubles.
+   */
+  if (volume->volume_class != MI_CLASS_LABEL &&
+      miscale_supported(volume->volume_type)) {
+    pyramid.mem_type = volume->volume_type;
+    pyramid.mem_type_id = mitype_to_hdftype(volume->volume_type, TRUE);
+  } else {
+    pyramid.mem_type = MI_TYPE_DOUBLE;
+    pyramid.mem_type_id = H5Tcopy(H5T_NATIVE_DOUBLE);
+  }
+  pyramid.mem_size = H5Tget_size(pyramid.mem_type_id);
+
+  sprintf(path, "%d/image", igrp);
+  MI_CHECK_HDF_CALL(dset_id = H5Dopen2(src_loc, path, H5P_DEFAULT), "H5Dopen2");
+  if (dset_id < 0) {
+    goto cleanup;
+  }
+  ftype_id = H5Dget_type(dset_id);
+  fspc_id = H5Dget_space(dset_id);
+  pyramid.ndims = H5Sget_simple_extent_ndims(fspc_id);
+  H5Sget_simple_extent_dims(fspc_id, source->size, NULL);
+  if (pyramid.ndims < 1 ||
+      (pyramid.kernel == NULL && pyramid.ndims > MI2_MODE_MAX_DIMS)) {
+    MI_LOG_ERROR(MI2_MSG_GENERIC, "Unsupported number of dimensions");
+    goto cleanup;
+  }
+  source->slice_n = 1;
+  for (d = 1; d < pyramid.ndims; d++) {
+    source->slice_n *= source->size[d];
+  }
+
+  /* Sizes of the levels. */
+  for (lvl = 1; lvl <= n_levels; lvl++) {
+    milevel_t *level = &pyramid.level[lvl];
+    int too_small = FALSE;
+
+    level->slice_n = 1;
+    for (d = 0; d < pyramid.ndims; d++) {
+      level->size[d] = pyramid.level[lvl - 1].size[d] / 2;
+      too_small |= (level->size[d] == 0);
+      if (d > 0) {
+        level->slice_n *= level->size[d];
+      }
+    }
+    if (too_small) {
+      break;
+    }
+    pyramid.n_levels = lvl;
+  }
+
+  /* The slices of each level which depend on its stale source slices,
+   * widened to what the levels above it need.
+   */
+  top = 0;
+  for (lvl = 1; lvl <= n_levels; lvl++) {
+    milevel_t *level = &pyramid.level[lvl];
+    int k;
+
+    level->first = stale_first[lvl];
+    level->end = (stale_end[lvl] > source->size[0]) ? source->size[0] :
+                 stale_end[lvl];
+    if (level->first >= level->end) {
+      level->first = level->end = 0;
+      continue;
+    }
+    if (lvl > pyramid.n_levels) {
+      MI_LOG_ERROR(MI2_MSG_GENERIC, "Image too small for resolution level");
+      goto cleanup;
+    }
+    for (k = 1; k <= lvl; k++) {
+      miaffected_slices(&pyramid, k, &level->first, &level->end);
+    }
+    level->write = TRUE;
+    top = lvl;
+  }
+  if (top == 0) {
+    result = MI_NOERROR;        /* Nothing is stale. */
+    goto cleanup;
+  }
+  pyramid.n_levels = top;
+  for (lvl = top; lvl >= 1; lvl--) {
+    milevel_t *level = &pyramid.level[lvl];
+    milevel_t *above = &pyramid.level[lvl - 1];
+    hsize_t first = level->first;
+    hsize_t end = level->end;
+
+    mineeded_slices(&pyramid, lvl, &first, &end);
+    if (lvl == 1 || above->first >= above->end) {
+      above->first = first;
+      above->end = end;
+    } else {
+      if (first < above->first) {
+        above->first = first;
+      }
+      if (end > above->end) {
+        above->end = end;
+      }
+    }
+  }
+
+  if (volume->volume_class == MI_CLASS_REAL &&
+      miread_source_ranges(&pyramid, src_loc, igrp) < 0) {
+    goto cleanup;
+  }
+
+  /* The source slices are read in blocks along the first dimension,
+   * whole chunks at a time if the image is chunked.
+   */
+  parallel_read = miuse_parallel_chunks(volume, dset_id, pyramid.mem_type_id,
+                                        pyramid.ndims, chunk_dims);
+  block_n = MI2_PYRAMID_BLOCK_BYTES / (source->slice_n * sizeof(double));
+  if (block_n < 2) {
+    block_n = 2;
+  }
+  {
+    hid_t dcpl_id = H5Dget_create_plist(dset_id);
+
+    if (dcpl_id >= 0) {
+      if (H5Pget_layout(dcpl_id) == H5D_CHUNKED &&
+          H5Pget_chunk(dcpl_id, pyramid.ndims, chunk_dims) == pyramid.ndims &&
+          chunk_dims[0] > 0) {
+        block_n = (block_n + chunk_dims[0] - 1) / chunk_dims[0] * chunk_dims[0];
+      }
+      H5Pclose(dcpl_id);
+    }
+  }
+  if (block_n > source->end - source->first) {
+    block_n = source->end - source->first;
+  }
+
+  for (lvl = 1; lvl <= pyramid.n_levels; lvl++) {
+    milevel_t *level = &pyramid.level[lvl];
+    int batch = (lvl == 1) ? (int) block_n : 1;
+
+    level->stage_n = (pyramid.kernel != NULL) ?
+                     level->slice_n : pyramid.level[lvl - 1].slice_n;
+    level->n_ring = batch + MI2_MAX_TAPS;
+    level->n_out_max = batch / 2 + MI2_MAX_TAPS;
+    level->n_in = pyramid.level[lvl - 1].first;
+    level->n_out = level->first;
+    level->ring = (double *) malloc((size_t) level->n_ring * level->stage_n *
+                                    sizeof(double));
+    level->out = (double *) malloc((size_t) level->n_out_max * level->slice_n *
+                                   sizeof(double));
+    if (level->ring == NULL || level->out == NULL) {
+      MI_LOG_ERROR(MI2_MSG_OUTOFMEM, "pyramid level");
+      goto cleanup;
+    }
+
+    /* Ranges per slice, or along as many dimensions as the source's. */
+    level->range_rank = 1;
+    level->n_ranges = 1;
+    if (pyramid.real_domain) {
+      level->range_rank = pyramid.src_range_rank;
+      for (d = 1; d < level->range_rank; d++) {
+        level->n_ranges *= level->size[d];
+      }
+    }
+    if (level->write &&
+        miopen_level(&pyramid, dst_loc, lvl, igrp + lvl, ftype_id) < 0) {
+      goto cleanup;
+    }
+  }
+
+  if ((block = malloc(block_n * source->slice_n * pyramid.mem_size)) == NULL) {
+    MI_LOG_ERROR(MI2_MSG_OUTOFMEM, "pyramid block");
+    goto cleanup;
+  }
+
+  for (b0 = source->first; b0 < source->end; b0 += block_n) {
+    milevel_t *first = &pyramid.level[1];
+    hsize_t n = source->end - b0;
+    mitask_args_t args;
+
+    if (n > block_n) {
+      n = block_n;
+    }
+    start[0] = b0;
+    count[0] = n;
+    for (d = 1; d < pyramid.ndims; d++) {
+      start[d] = 0;
+      count[d] = source->size[d];
+    }
+
+    if (parallel_read) {
+      if (miread_parallel_chunks(volume, dset_id, pyramid.mem_type_id,
+                                 pyramid.ndims, chunk_dims, start, count,
+                                 block) < 0) {
+        goto cleanup;
+      }
+    } else {
+      hid_t mspc_id;
+      herr_t r;
+
+      MI_CHECK_HDF_CALL(r = H5Sselect_hyperslab(fspc_id, H5S_SELECT_SET,
+                                                start, NULL, count, NULL),
+                        "H5Sselect_hyperslab");
+      if (r < 0) {
+        goto cleanup;
+      }
+      mspc_id = H5Screate_simple(pyramid.ndims, count, NULL);
+      MI_CHECK_HDF_CALL(r = H5Dread(dset_id, pyramid.mem_type_id, mspc_id,
+                                    fspc_id, H5P_DEFAULT, block),
+                        "H5Dread");
+      H5Sclose(mspc_id);
+      if (r < 0) {
+        goto cleanup;
+      }
+    }
+
+    args.pyramid = &pyramid;
+    args.lvl = 1;
+    args.first = b0;
+    args.src = (const char *) block;
+    miparallel_for(pyramid.nthreads, (size_t) n, mistage_task, &args);
+    if (pyramid.failed) {
+      MI_LOG_ERROR(MI2_MSG_OUTOFMEM, "pyramid slice");
+      goto cleanup;
+    }
+    first->n_in += n;
+
+    if (miadvance_level(&pyramid, 1) < 0) {
+      goto cleanup;
+    }
+  }
+
+  for (lvl = 1; lvl <= top; lvl++) {
+    if (pyramid.level[lvl].write) {
+      stale_first[lvl] = stale_end[lvl] = 0;
+    }
+  }
+  result = MI_NOERROR;
+
+ cleanup:
+  free(block);
+  mifree_pyramid(&pyramid);
+  if (ftype_id >= 0) H5Tclose(ftype_id);
+  if (fspc_id >= 0) H5Sclose(fspc_id);
+  if (dset_id >= 0) H5Dclose(dset_id);
+  return (result);
+}
+
+/** Create the group for the lower resolution image \a grp of \a volume.
+ */
+int minc_create_thumbnail ( mihandle_t volume, int grp )
+{
+  char path[MI2_MAX_PATH];
+  hid_t grp_id;
+
+  /* Don't handle negative or overly large numbers!
+  */
+  if ( grp <= 0 || grp > MI2_MAX_RESOLUTION_GROUP ) {
+    return ( MI_ERROR );
+  }
+
+  sprintf ( path, MI_ROOT_PATH "/image/%d", grp );
+  grp_id = H5Gcreate2 ( volume->hdf_id, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+
+  if ( grp_id < 0 ) {
+    return ( MI_ERROR );
+  }
+
+  H5Gclose ( grp_id );
+  return ( MI_NOERROR );
+}
+
+/** Update an individual thumbnail for the \a volume.  Updates group
+* number \a ogrp from source group \a igrp.  The whole image tree must
+* be rooted at \a loc_id.  The intermediate levels are computed on the
+* way but not stored.
+*/
+int minc_update_thumbnail ( mihandle_t volume, hid_t loc_id, int igrp, int ogrp )
+{
+  hsize_t stale_first[MI2_MAX_RESOLUTION_GROUP + 1];
+  hsize_t stale_end[MI2_MAX_RESOLUTION_GROUP + 1];
+
+  miinit();
+
+  if ( ogrp <= igrp || ogrp > MI2_MAX_RESOLUTION_GROUP ) {
+    return ( MI_ERROR );
+  }
+
+  memset ( stale_first, 0, sizeof ( stale_first ) );
+  memset ( stale_end, 0, sizeof ( stale_end ) );
+  stale_end[ogrp - igrp] = MI2_ALL_SLICES;
+
+  return mibuild_pyramid ( volume, loc_id, igrp, loc_id, ogrp - igrp,
+                           stale_first, stale_end );
+}
+
+/** Update the stale parts of all the lower-resolution images in the
+* file, in a single pass over the full resolution image.
+*/
+int minc_update_thumbnails ( mihandle_t volume )
+{
+  char name[MI2_MAX_PATH];
+  hid_t grp_id;
+  int depth;
+  int result = MI_NOERROR;
+
+  miinit();
+
+  grp_id = H5Gopen2 ( volume->hdf_id, MI_ROOT_PATH "/image", H5P_DEFAULT );
+
+  if ( grp_id < 0 ) {
+    return ( MI_ERROR );    /* Error opening group. */
+  }
+
+  for ( depth = 0; depth < MI2_MAX_RESOLUTION_GROUP; depth++ ) {
+    sprintf ( name, "%d", depth + 1 );
+    if ( H5Lexists ( grp_id, name, H5P_DEFAULT ) <= 0 ) {
+      break;
+    }
+  }
+
+  if ( depth > 0 ) {
+    result = mibuild_pyramid ( volume, grp_id, 0, grp_id, depth,
+                               volume->stale_first, volume->stale_end );
+  }
+
+  H5Gclose ( grp_id );
+  return ( result );
+}
+
+/** Record that slices \a first ... \a first + \a count - 1, along the
+* first dimension in file order, of the full resolution image of \a
+* volume have been modified, so every resolution level is stale there.
+*/
+void minc_mark_stale_thumbnails ( mihandle_t volume, hsize_t first,
+                                  hsize_t count )
+{
+  int i;
+
+  if ( count == 0 ) {
+    return;
+  }
+  for ( i = 1; i <= MI2_MAX_RESOLUTION_GROUP; i++ ) {
+    if ( volume->stale_first[i] >= volume->stale_end[i] ) {
+      volume->stale_first[i] = first;
+      volume->stale_end[i] = first + count;
+    } else {
+      if ( first < volume->stale_first[i] ) {
+        volume->stale_first[i] = first;
+      }
+      if ( first + count > volume->stale_end[i] ) {
+        volume->stale_end[i] = first + count;
+      }
+    }
+  }
+}
+
+/** Open the image group holding an up to date resolution level \a
+* depth of \a volume, computing the missing or stale parts of it first.
+* Writable volumes store the level in the file.  The levels of
+* read-only volumes which are missing or stale in the file are computed
+* into an in-memory file attached to the handle.
+*/
+hid_t minc_select_thumbnail ( mihandle_t volume, int depth )
+{
+  hsize_t stale_first[MI2_MAX_RESOLUTION_GROUP + 1];
+  hsize_t stale_end[MI2_MAX_RESOLUTION_GROUP + 1];
+  char name[MI2_MAX_PATH];
+  hid_t grp_id;
+  hid_t dst_id;
+  int exists;
+
+  miinit();
+
+  if ( depth <= 0 || depth > MI2_MAX_RESOLUTION_GROUP ) {
+    return ( MI_ERROR );
+  }
+
+  MI_CHECK_HDF_CALL_RET ( grp_id = H5Gopen2 ( volume->hdf_id,
+                                              MI_ROOT_PATH "/image",
+                                              H5P_DEFAULT ),
+                          "H5Gopen2" );
+
+  sprintf ( name, "%d/image", depth );
+  H5E_BEGIN_TRY {
+    exists = ( H5Lexists ( grp_id, name, H5P_DEFAULT ) > 0 );
+  } H5E_END_TRY;
+
+  if ( volume->mode & MI2_OPEN_RDWR ) {
+    if ( !exists ) {
+      sprintf ( name, "%d", depth );
+      if ( H5Lexists ( grp_id, name, H5P_DEFAULT ) <= 0 &&
+           minc_create_thumbnail ( volume, depth ) < 0 ) {
+        H5Gclose ( grp_id );
+        return ( MI_ERROR );
+      }
+      volume->stale_first[depth] = 0;
+      volume->stale_end[depth] = MI2_ALL_SLICES;
+    }
+    if ( volume->stale_first[depth] < volume->stale_end[depth] ) {
+      memset ( stale_first, 0, sizeof ( stale_first ) );
+      memset ( stale_end, 0, sizeof ( stale_end ) );
+      stale_first[depth] = volume->stale_first[depth];
+      stale_end[depth] = volume->stale_end[depth];
+      if ( mibuild_pyramid ( volume, grp_id, 0, grp_id, depth,
+                             stale_first, stale_end ) < 0 ) {
+        H5Gclose ( grp_id );
+        return ( MI_ERROR );
+      }
+      volume->stale_first[depth] = volume->stale_end[depth] = 0;
+    }
+    return ( grp_id );
+  }
+
+  if ( exists && volume->stale_first[depth] >= volume->stale_end[depth] ) {
+    return ( grp_id );
+  }
+
+  /* Read-only and not usable from the file. */
+  if ( volume->thumb_file_id < 0 ) {
+    hid_t fapl_id = H5Pcreate ( H5P_FILE_ACCESS );
+
+    sprintf ( name, "minc-thumbnails-%p", ( void * ) volume );
+    H5Pset_fapl_core ( fapl_id, 1 << 20, FALSE );
+    volume->thumb_file_id = H5Fcreate ( name, H5F_ACC_TRUNC, H5P_DEFAULT,
+                                        fapl_id );
+    H5Pclose ( fapl_id );
+    if ( volume->thumb_file_id < 0 ) {
+      H5Gclose ( grp_id );
+      return ( MI_LOG_ERROR ( MI2_MSG_HDF5, "H5Fcreate" ) );
+    }
+  }
+  MI_CHECK_HDF_CALL_RET ( dst_id = H5Gopen2 ( volume->thumb_file_id, "/",
+                                              H5P_DEFAULT ),
+                          "H5Gopen2" );
+
+  sprintf ( name, "%d", depth );
+  if ( H5Lexists ( dst_id, name, H5P_DEFAULT ) <= 0 ) {
+    hid_t level_id = H5Gcreate2 ( dst_id, name, H5P_DEFAULT, H5P_DEFAULT,
+                                  H5P_DEFAULT );
+
+    memset ( stale_first, 0, sizeof ( stale_first ) );
+    memset ( stale_end, 0, sizeof ( stale_end ) );
+    stale_end[depth] = MI2_ALL_SLICES;
+    if ( level_id < 0 ||
+         mibuild_pyramid ( volume, grp_id, 0, dst_id, depth,
+                           stale_first, stale_end ) < 0 ) {
+      if ( level_id >= 0 ) {
+        H5Gclose ( level_id );
+        H5Ldelete ( dst_id, name, H5P_DEFAULT );
+      }
+      H5Gclose ( dst_id );
+      H5Gclose ( grp_id );
+      return ( MI_ERROR );
+    }
+    H5Gclose ( level_id );
+  }
+  H5Gclose ( grp_id );
+  return ( dst_id );
+}
+
+/** Read the stale slices of each resolution level of \a volume, saved
+* by minc_save_thumbnail_state().  Levels whose image is missing are
+* entirely stale.
+*/
+void minc_load_thumbnail_state ( mihandle_t volume )
+{
+  char name[MI2_MAX_PATH];
+  hid_t grp_id;
+  int i;
+
+  H5E_BEGIN_TRY {
+    grp_id = H5Gopen2 ( volume->hdf_id, MI_ROOT_PATH "/image", H5P_DEFAULT );
+  } H5E_END_TRY;
+  if ( grp_id < 0 ) {
+    return;
+  }
+
+  if ( H5Aexists ( grp_id, MI2_FILTER_ATTR ) > 0 ) {
+    char filter[MI2_CHAR_LENGTH];
+
+    if ( miget_attribute ( volume, MI_ROOT_PATH "/image", MI2_FILTER_ATTR,
+                           MI_TYPE_STRING, sizeof ( filter ), filter ) >= 0 ) {
+      for ( i = MI_FILTER_BOX; i <= MI_FILTER_MODE; i++ ) {
+        if ( !strcmp ( filter, mifilter_names[i] ) ) {
+          volume->resolution_filter = ( mifilter_t ) i;
+        }
+      }
+    }
+  }
+
+  for ( i = 1; i <= MI2_MAX_RESOLUTION_GROUP; i++ ) {
+    unsigned long long range[2];
+    hid_t level_id;
+    hid_t attr_id;
+
+    sprintf ( name, "%d", i );
+    if ( H5Lexists ( grp_id, name, H5P_DEFAULT ) <= 0 ) {
+      break;
+    }
+    level_id = H5Gopen2 ( grp_id, name, H5P_DEFAULT );
+    if ( level_id < 0 ) {
+      break;
+    }
+    if ( H5Lexists ( level_id, "image", H5P_DEFAULT ) <= 0 ) {
+      volume->stale_first[i] = 0;
+      volume->stale_end[i] = MI2_ALL_SLICES;
+    } else if ( H5Aexists ( level_id, MI2_STALE_ATTR ) > 0 ) {
+      attr_id = H5Aopen ( level_id, MI2_STALE_ATTR, H5P_DEFAULT );
+      if ( attr_id >= 0 &&
+           H5Aread ( attr_id, H5T_NATIVE_ULLONG, range ) >= 0 ) {
+        volume->stale_first[i] = ( hsize_t ) range[0];
+        volume->stale_end[i] = ( hsize_t ) range[1];
+      }
+      if ( attr_id >= 0 ) {
+        H5Aclose ( attr_id );
+      }
+    }
+    H5Gclose ( level_id );
+  }
+  H5Gclose ( grp_id );
+}
+
+/** Save the stale slices of each resolution level of \a volume as an
+* attribute of its group, or remove the attribute if the level is up to
+* date.
+*/
+int minc_save_thumbnail_state ( mihandle_t volume )
+{
+  char name[MI2_MAX_PATH];
+  hid_t grp_id;
+  int result = MI_NOERROR;
+  int i;
+
+  H5E_BEGIN_TRY {
+    grp_id = H5Gopen2 ( volume->hdf_id, MI_ROOT_PATH "/image", H5P_DEFAULT );
+  } H5E_END_TRY;
+  if ( grp_id < 0 ) {
+    return ( MI_NOERROR );
+  }
+
+  for ( i = 1; i <= MI2_MAX_RESOLUTION_GROUP; i++ ) {
+    hid_t level_id;
+    int has_attr;
+
+    sprintf ( name, "%d", i );
+    if ( H5Lexists ( grp_id, name, H5P_DEFAULT ) <= 0 ) {
+      break;
+    }
+    if ( ( level_id = H5Gopen2 ( grp_id, name, H5P_DEFAULT ) ) < 0 ) {
+      result = MI_ERROR;
+      break;
+    }
+    has_attr = ( H5Aexists ( level_id, MI2_STALE_ATTR ) > 0 );
+    if ( volume->stale_first[i] < volume->stale_end[i] ) {
+      unsigned long long range[2];
+      hsize_t two = 2;
+      hid_t spc_id = H5Screate_simple ( 1, &two, NULL );
+      hid_t attr_id;
+
+      range[0] = volume->stale_first[i];
+      range[1] = volume->stale_end[i];
+      if ( has_attr ) {
+        attr_id = H5Aopen ( level_id, MI2_STALE_ATTR, H5P_DEFAULT );
+      } else {
+        attr_id = H5Acreate2 ( level_id, MI2_STALE_ATTR, H5T_STD_U64LE,
+                               spc_id, H5P_DEFAULT, H5P_DEFAULT );
+      }
+      if ( attr_id < 0 ||
+           H5Awrite ( attr_id, H5T_NATIVE_ULLONG, range ) < 0 ) {
+        result = MI_ERROR;
+      }
+      if ( attr_id >= 0 ) {
+        H5Aclose ( attr_id );
+      }
+      H5Sclose ( spc_id );
+    } else if ( has_attr ) {
+      H5Adelete ( level_id, MI2_STALE_ATTR );
+    }
+    H5Gclose ( level_id );
+  }
+  H5Gclose ( grp_id );
+  return ( result );
+}
+
+/** Record the filter used to build the resolution levels of \a volume
+* in the file, so the levels are built the same way after it is opened
+* again.  Nothing is recorded for the default filter.
+*/
+int minc_save_resolution_filter ( mihandle_t volume )
+{
+  const char *name;
+
+  if ( volume->resolution_filter == MI_FILTER_DEFAULT ) {
+    return ( MI_NOERROR );
+  }
+  name = mifilter_names[volume->resolution_filter];
+  return ( miset_attribute ( volume, MI_ROOT_PATH "/image", MI2_FILTER_ATTR,
+                             MI_TYPE_STRING, strlen ( name ), name ) );
+}
@@ -0,0 +1,784 @@
+/** \file scale.c
+ * \brief MINC 2.0 voxel scaling kernels
+ *
+ * These functions convert between stored voxel values and real values,
+ * applying the type widening and the slope/intercept transform in one
+ * pass over the data.  They replace the element-by-element HDF5 soft
+ * converters on the real-valued hyperslab paths, which read the raw
+ * voxels with their native memory type and scale them here.
+ *
+ * On x86 processors the voxel to real direction and the range of a block
+ * of values are vectorized with SSE2 and AVX2, chosen at run time
+ * according to what the processor supports.
+ * All variants perform the same double precision arithmetic (no fused
+ * multiply-add) so that they produce identical results.
+ ************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <hdf5.h>
+#include "minc2.h"
+#include "minc2_private.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MI2_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/** Instruction set used by the kernels, -1 until first detected. */
+static int miscale_isa = -1;
+
+/** Returns TRUE if \a mitype is a type handled by the scaling kernels.
+ */
+int miscale_supported(mitype_t mitype)
+{
+  switch (mitype) {
+  case MI_TYPE_BYTE:
+  case MI_TYPE_UBYTE:
+  case MI_TYPE_SHORT:
+  case MI_TYPE_USHORT:
+  case MI_TYPE_INT:
+  case MI_TYPE_UINT:
+  case MI_TYPE_FLOAT:
+  case MI_TYPE_DOUBLE:
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+/** Returns the best instruction set available on this processor.
+ */
+static int miscale_detect_isa(void)
+{
+#ifdef MI2_HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return MI2_SIMD_AVX2;
+  }
+#ifdef __SSE2__
+  return MI2_SIMD_SSE2;
+#endif
+#endif /*MI2_HAVE_X86_SIMD*/
+  return MI2_SIMD_SCALAR;
+}
+
+/** Returns the instruction set currently used by the scaling kernels.
+ */
+int miscale_get_isa(void)
+{
+  if (miscale_isa < 0) {
+    miscale_isa = miscale_detect_isa();
+  }
+  return miscale_isa;
+}
+
+/** Selects the instruction set used by the scaling kernels, limited to
+ * what the processor supports. Returns the instruction set actually
+ * selected.
+ */
+int miscale_set_isa(int isa)
+{
+  int best = miscale_detect_isa();
+
+  if (isa < MI2_SIMD_SCALAR) {
+    isa = MI2_SIMD_SCALAR;
+  }
+  miscale_isa = (isa > best) ? best : isa;
+  return miscale_isa;
+}
+
+/** Returns a printable name for an instruction set.
+ */
+const char *miscale_isa_name(int isa)
+{
+  switch (isa) {
+  case MI2_SIMD_SCALAR: return "scalar";
+  case MI2_SIMD_SSE2:   return "sse2";
+  case MI2_SIMD_AVX2:   return "avx2";
+  default:              return "unknown";
+  }
+}
+
+#define MISCALE_TO_REAL(type_in,type_out) \
+  { \
+    const type_in *_src=(const type_in *)src; \
+    type_out *_dst=(type_out *)dst; \
+    size_t _i; \
+    for (_i = 0; _i < n; _i++) { \
+      _dst[_i] = (type_out)((double)_src[_i] * scale + offset); \
+    } \
+  }
+
+#define MISCALE_TO_REAL_ANY(type_in) \
+  { \
+    if (dst_type == MI_TYPE_DOUBLE) \
+      MISCALE_TO_REAL(type_in,double) \
+    else \
+      MISCALE_TO_REAL(type_in,float) \
+  }
+
+/** Portable voxel to real conversion.
+ */
+static void miscale_to_real_scalar(mitype_t src_type, const void *src,
+                                   mitype_t dst_type, void *dst, size_t n,
+                                   double scale, double offset)
+{
+  switch (src_type) {
+  case MI_TYPE_BYTE:
+    MISCALE_TO_REAL_ANY(signed char);
+    break;
+  case MI_TYPE_UBYTE:
+    MISCALE_TO_REAL_ANY(unsigned char);
+    break;
+  case MI_TYPE_SHORT:
+    MISCALE_TO_REAL_ANY(short);
+    break;
+  case MI_TYPE_USHORT:
+    MISCALE_TO_REAL_ANY(unsigned short);
+    break;
+  case MI_TYPE_INT:
+    MISCALE_TO_REAL_ANY(int);
+    break;
+  case MI_TYPE_UINT:
+    MISCALE_TO_REAL_ANY(unsigned int);
+    break;
+  case MI_TYPE_FLOAT:
+    MISCALE_TO_REAL_ANY(float);
+    break;
+  case MI_TYPE_DOUBLE:
+    MISCALE_TO_REAL_ANY(double);
+    break;
+  default:
+    break;
+  }
+}
+
+/* The range kernels compare voxels in their own type, many at a time.
+ * Real accumulators start at +-HUGE_VAL and are passed as the second
+ * operand of min/max, which then ignore NaNs as the scalar code does.
+ */
+#define MISIMD_REDUCE(type_in,lanes,store,vlo,vhi) \
+  { \
+    type_in _t[lanes]; \
+    int _l; \
+    store(_t, vlo); \
+    for (_l = 0; _l < (lanes); _l++) { \
+      if ((double)_t[_l] < *min) { \
+        *min = (double)_t[_l]; \
+      } \
+    } \
+    store(_t, vhi); \
+    for (_l = 0; _l < (lanes); _l++) { \
+      if ((double)_t[_l] > *max) { \
+        *max = (double)_t[_l]; \
+      } \
+    } \
+  }
+
+#define MISIMD_MINMAX_REAL(type_in,vtype,set1,load,min_op,max_op,store) \
+  { \
+    const type_in *_src=(const type_in *)src; \
+    const size_t _w = sizeof(vtype) / sizeof(type_in); \
+    vtype _lo = set1(HUGE_VAL); \
+    vtype _hi = set1(-HUGE_VAL); \
+    size_t _i; \
+    for (_i = 0; _i + _w <= n; _i += _w) { \
+      vtype _v = load(_src + _i); \
+      _lo = min_op(_v, _lo); \
+      _hi = max_op(_v, _hi); \
+    } \
+    MISIMD_REDUCE(type_in, sizeof(vtype) / sizeof(type_in), store, _lo, _hi); \
+    done = _i; \
+  }
+
+#if defined(MI2_HAVE_X86_SIMD) && defined(__SSE2__)
+
+/* SSE2 loaders, each widening four voxels into two pairs of doubles.
+ */
+static inline void misse2_cvt_epi32(__m128i x, __m128d *lo, __m128d *hi)
+{
+  *lo = _mm_cvtepi32_pd(x);
+  *hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(x, 0x0E));
+}
+
+static inline void misse2_load_ubyte(const void *p, __m128d *lo, __m128d *hi)
+{
+  int v;
+  __m128i x;
+  memcpy(&v, p, sizeof(v));
+  x = _mm_cvtsi32_si128(v);
+  x = _mm_unpacklo_epi8(x, _mm_setzero_si128());
+  x = _mm_unpacklo_epi16(x, _mm_setzero_si128());
+  misse2_cvt_epi32(x, lo, hi);
+}
+
+static inline void misse2_load_byte(const void *p, __m128d *lo, __m128d *hi)
+{
+  int v;
+  __m128i x;
+  memcpy(&v, p, sizeof(v));
+  x = _mm_cvtsi32_si128(v);
+  x = _mm_unpacklo_epi8(x, x);
+  x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 24);
+  misse2_cvt_epi32(x, lo, hi);
+}
+
+static inline void misse2_load_ushort(const void *p, __m128d *lo, __m128d *hi)
+{
+  __m128i x = _mm_loadl_epi64((const __m128i *)p);
+  x = _mm_unpacklo_epi16(x, _mm_setzero_si128());
+  misse2_cvt_epi32(x, lo, hi);
+}
+
+static inline void misse2_load_short(const void *p, __m128d *lo, __m128d *hi)
+{
+  __m128i x = _mm_loadl_epi64((const __m128i *)p);
+  x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+  misse2_cvt_epi32(x, lo, hi);
+}
+
+static inline void misse2_load_int(const void *p, __m128d *lo, __m128d *hi)
+{
+  misse2_cvt_epi32(_mm_loadu_si128((const __m128i *)p), lo, hi);
+}
+
+static inline void misse2_load_uint(const void *p, __m128d *lo, __m128d *hi)
+{
+  /* Values above INT_MAX come out negative; add 2^32 back. */
+  const __m128d wrap = _mm_set1_pd(4294967296.0);
+  misse2_cvt_epi32(_mm_loadu_si128((const __m128i *)p), lo, hi);
+  *lo = _mm_add_pd(*lo, _mm_and_pd(_mm_cmplt_pd(*lo, _mm_setzero_pd()), wrap));
+  *hi = _mm_add_pd(*hi, _mm_and_pd(_mm_cmplt_pd(*hi, _mm_setzero_pd()), wrap));
+}
+
+static inline void misse2_load_float(const void *p, __m128d *lo, __m128d *hi)
+{
+  __m128 x = _mm_loadu_ps((const float *)p);
+  *lo = _mm_cvtps_pd(x);
+  *hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+}
+
+static inline void misse2_load_double(const void *p, __m128d *lo, __m128d *hi)
+{
+  *lo = _mm_loadu_pd((const double *)p);
+  *hi = _mm_loadu_pd((const double *)p + 2);
+}
+
+#define MISSE2_TO_REAL(type_in,load) \
+  { \
+    const type_in *_src=(const type_in *)src; \
+    size_t _i; \
+    for (_i = 0; _i + 4 <= n; _i += 4) { \
+      __m128d _lo, _hi; \
+      load(_src + _i, &_lo, &_hi); \
+      _lo = _mm_add_pd(_mm_mul_pd(_lo, vscale), voffset); \
+      _hi = _mm_add_pd(_mm_mul_pd(_hi, vscale), voffset); \
+      if (dst_type == MI_TYPE_DOUBLE) { \
+        _mm_storeu_pd((double *)dst + _i, _lo); \
+        _mm_storeu_pd((double *)dst + _i + 2, _hi); \
+      } else { \
+        _mm_storeu_ps((float *)dst + _i, \
+                      _mm_movelh_ps(_mm_cvtpd_ps(_lo), _mm_cvtpd_ps(_hi))); \
+      } \
+    } \
+    done = _i; \
+  }
+
+/** SSE2 voxel to real conversion, returns the number of voxels handled.
+ */
+static size_t miscale_to_real_sse2(mitype_t src_type, const void *src,
+                                   mitype_t dst_type, void *dst, size_t n,
+                                   double scale, double offset)
+{
+  const __m128d vscale = _mm_set1_pd(scale);
+  const __m128d voffset = _mm_set1_pd(offset);
+  size_t done = 0;
+
+  switch (src_type) {
+  case MI_TYPE_BYTE:
+    MISSE2_TO_REAL(signed char, misse2_load_byte);
+    break;
+  case MI_TYPE_UBYTE:
+    MISSE2_TO_REAL(unsigned char, misse2_load_ubyte);
+    break;
+  case MI_TYPE_SHORT:
+    MISSE2_TO_REAL(short, misse2_load_short);
+    break;
+  case MI_TYPE_USHORT:
+    MISSE2_TO_REAL(unsigned short, misse2_load_ushort);
+    break;
+  case MI_TYPE_INT:
+    MISSE2_TO_REAL(int, misse2_load_int);
+    break;
+  case MI_TYPE_UINT:
+    MISSE2_TO_REAL(unsigned int, misse2_load_uint);
+    break;
+  case MI_TYPE_FLOAT:
+    MISSE2_TO_REAL(float, misse2_load_float);
+    break;
+  case MI_TYPE_DOUBLE:
+    MISSE2_TO_REAL(double, misse2_load_double);
+    break;
+  default:
+    break;
+  }
+  return done;
+}
+
+#define misse2_store_si128(p,v) _mm_storeu_si128((__m128i *)(p), v)
+
+/* Signed bytes and unsigned shorts are offset by \a bias into the range
+ * of the unsigned byte and signed short instructions SSE2 has.
+ */
+#define MISSE2_MINMAX_INT(type_in,min_op,max_op,bias) \
+  { \
+    const type_in *_src=(const type_in *)src; \
+    const size_t _w = 16 / sizeof(type_in); \
+    const __m128i _bias = bias; \
+    size_t _i; \
+    if (n >= _w) { \
+      __m128i _lo = _mm_xor_si128(_mm_loadu_si128((const __m128i *)_src), _bias); \
+      __m128i _hi = _lo; \
+      for (_i = _w; _i + _w <= n; _i += _w) { \
+        __m128i _v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(_src + _i)), \
+                                   _bias); \
+        _lo = min_op(_lo, _v); \
+        _hi = max_op(_hi, _v); \
+      } \
+      _lo = _mm_xor_si128(_lo, _bias); \
+      _hi = _mm_xor_si128(_hi, _bias); \
+      MISIMD_REDUCE(type_in, 16 / sizeof(type_in), misse2_store_si128, _lo, _hi); \
+      done = _i; \
+    } \
+  }
+
+/** SSE2 range of values, returns the number of values handled.  Only
+ * the types with SSE2 comparisons are handled.
+ */
+static size_t miscale_minmax_sse2(mitype_t type, const void *src, size_t n,
+                                  double *min, double *max)
+{
+  size_t done = 0;
+
+  switch (type) {
+  case MI_TYPE_BYTE:
+    MISSE2_MINMAX_INT(signed char, _mm_min_epu8, _mm_max_epu8,
+                      _mm_set1_epi8((char) 0x80));
+    break;
+  case MI_TYPE_UBYTE:
+    MISSE2_MINMAX_INT(unsigned char, _mm_min_epu8, _mm_max_epu8,
+                      _mm_setzero_si128());
+    break;
+  case MI_TYPE_SHORT:
+    MISSE2_MINMAX_INT(short, _mm_min_epi16, _mm_max_epi16,
+                      _mm_setzero_si128());
+    break;
+  case MI_TYPE_USHORT:
+    MISSE2_MINMAX_INT(unsigned short, _mm_min_epi16, _mm_max_epi16,
+                      _mm_set1_epi16((short) 0x8000));
+    break;
+  case MI_TYPE_FLOAT:
+    MISIMD_MINMAX_REAL(float, __m128, _mm_set1_ps, _mm_loadu_ps,
+                       _mm_min_ps, _mm_max_ps, _mm_storeu_ps);
+    break;
+  case MI_TYPE_DOUBLE:
+    MISIMD_MINMAX_REAL(double, __m128d, _mm_set1_pd, _mm_loadu_pd,
+                       _mm_min_pd, _mm_max_pd, _mm_storeu_pd);
+    break;
+  default:
+    break;
+  }
+  return done;
+}
+
+#endif /*MI2_HAVE_X86_SIMD && __SSE2__*/
+
+#ifdef MI2_HAVE_X86_SIMD
+
+#define MI2_AVX2 __attribute__((target("avx2")))
+
+/* AVX2 loaders, each widening four voxels into four doubles.
+ */
+static inline MI2_AVX2 __m256d miavx2_load_ubyte(const void *p)
+{
+  int v;
+  memcpy(&v, p, sizeof(v));
+  return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(v)));
+}
+
+static inline MI2_AVX2 __m256d miavx2_load_byte(const void *p)
+{
+  int v;
+  memcpy(&v, p, sizeof(v));
+  return _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(v)));
+}
+
+static inline MI2_AVX2 __m256d miavx2_load_ushort(const void *p)
+{
+  return _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)p)));
+}
+
+static inline MI2_AVX2 __m256d miavx2_load_short(const void *p)
+{
+  return _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)p)));
+}
+
+static inline MI2_AVX2 __m256d miavx2_load_int(const void *p)
+{
+  return _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)p));
+}
+
+static inline MI2_AVX2 __m256d miavx2_load_uint(const void *p)
+{
+  /* Values above INT_MAX come out negative; add 2^32 back. */
+  __m256d x = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)p));
+  __m256d neg = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LT_OQ);
+  return _mm256_add_pd(x, _mm256_and_pd(neg, _mm256_set1_pd(4294967296.0)));
+}
+
+static inline MI2_AVX2 __m256d miavx2_load_float(const void *p)
+{
+  return _mm256_cvtps_pd(_mm_loadu_ps((const float *)p));
+}
+
+static inline MI2_AVX2 __m256d miavx2_load_double(const void *p)
+{
+  return _mm256_loadu_pd((const double *)p);
+}
+
+#define MIAVX2_TO_REAL(type_in,load) \
+  { \
+    const type_in *_src=(const type_in *)src; \
+    size_t _i; \
+    if (dst_type == MI_TYPE_DOUBLE) { \
+      double *_dst=(double *)dst; \
+      for (_i = 0; _i + 4 <= n; _i += 4) { \
+        __m256d _v = _mm256_add_pd(_mm256_mul_pd(load(_src + _i), vscale), voffset); \
+        _mm256_storeu_pd(_dst + _i, _v); \
+      } \
+    } else { \
+      float *_dst=(float *)dst; \
+      for (_i = 0; _i + 4 <= n; _i += 4) { \
+        __m256d _v = _mm256_add_pd(_mm256_mul_pd(load(_src + _i), vscale), voffset); \
+        _mm_storeu_ps(_dst + _i, _mm256_cvtpd_ps(_v)); \
+      } \
+    } \
+    done = _i; \
+  }
+
+/** AVX2 voxel to real conversion, returns the number of voxels handled.
+ */
+static MI2_AVX2 size_t miscale_to_real_avx2(mitype_t src_type, const void *src,
+                                            mitype_t dst_type, void *dst, size_t n,
+                                            double scale, double offset)
+{
+  const __m256d vscale = _mm256_set1_pd(scale);
+  const __m256d voffset = _mm256_set1_pd(offset);
+  size_t done = 0;
+
+  switch (src_type) {
+  case MI_TYPE_BYTE:
+    MIAVX2_TO_REAL(signed char, miavx2_load_byte);
+    break;
+  case MI_TYPE_UBYTE:
+    MIAVX2_TO_REAL(unsigned char, miavx2_load_ubyte);
+    break;
+  case MI_TYPE_SHORT:
+    MIAVX2_TO_REAL(short, miavx2_load_short);
+    break;
+  case MI_TYPE_USHORT:
+    MIAVX2_TO_REAL(unsigned short, miavx2_load_ushort);
+    break;
+  case MI_TYPE_INT:
+    MIAVX2_TO_REAL(int, miavx2_load_int);
+    break;
+  case MI_TYPE_UINT:
+    MIAVX2_TO_REAL(unsigned int, miavx2_load_uint);
+    break;
+  case MI_TYPE_FLOAT:
+    MIAVX2_TO_REAL(float, miavx2_load_float);
+    break;
+  case MI_TYPE_DOUBLE:
+    MIAVX2_TO_REAL(double, miavx2_load_double);
+    break;
+  default:
+    break;
+  }
+  return done;
+}
+
+#define miavx2_store_si256(p,v) _mm256_storeu_si256((__m256i *)(p), v)
+
+#define MIAVX2_MINMAX_INT(type_in,min_op,max_op) \
+  { \
+    const type_in *_src=(const type_in *)src; \
+    const size_t _w = 32 / sizeof(type_in); \
+    size_t _i; \
+    if (n >= _w) { \
+      __m256i _lo = _mm256_loadu_si256((const __m256i *)_src); \
+      __m256i _hi = _lo; \
+      for (_i = _w; _i + _w <= n; _i += _w) { \
+        __m256i _v = _mm256_loadu_si256((const __m256i *)(_src + _i)); \
+        _lo = min_op(_lo, _v); \
+        _hi = max_op(_hi, _v); \
+      } \
+      MISIMD_REDUCE(type_in, 32 / sizeof(type_in), miavx2_store_si256, _lo, _hi); \
+      done = _i; \
+    } \
+  }
+
+/** AVX2 range of values, returns the number of values handled.
+ */
+static MI2_AVX2 size_t miscale_minmax_avx2(mitype_t type, const void *src,
+                                           size_t n, double *min, double *max)
+{
+  size_t done = 0;
+
+  switch (type) {
+  case MI_TYPE_BYTE:
+    MIAVX2_MINMAX_INT(signed char, _mm256_min_epi8, _mm256_max_epi8);
+    break;
+  case MI_TYPE_UBYTE:
+    MIAVX2_MINMAX_INT(unsigned char, _mm256_min_epu8, _mm256_max_epu8);
+    break;
+  case MI_TYPE_SHORT:
+    MIAVX2_MINMAX_INT(short, _mm256_min_epi16, _mm256_max_epi16);
+    break;
+  case MI_TYPE_USHORT:
+    MIAVX2_MINMAX_INT(unsigned short, _mm256_min_epu16, _mm256_max_epu16);
+    break;
+  case MI_TYPE_INT:
+    MIAVX2_MINMAX_INT(int, _mm256_min_epi32, _mm256_max_epi32);
+    break;
+  case MI_TYPE_UINT:
+    MIAVX2_MINMAX_INT(unsigned int, _mm256_min_epu32, _mm256_max_epu32);
+    break;
+  case MI_TYPE_FLOAT:
+    MISIMD_MINMAX_REAL(float, __m256, _mm256_set1_ps, _mm256_loadu_ps,
+                       _mm256_min_ps, _mm256_max_ps, _mm256_storeu_ps);
+    break;
+  case MI_TYPE_DOUBLE:
+    MISIMD_MINMAX_REAL(double, __m256d, _mm256_set1_pd, _mm256_loadu_pd,
+                       _mm256_min_pd, _mm256_max_pd, _mm256_storeu_pd);
+    break;
+  default:
+    break;
+  }
+  return done;
+}
+
+#endif /*MI2_HAVE_X86_SIMD*/
+
+/** Convert \a n voxels of type \a src_type into real values of type
+ * \a dst_type (MI_TYPE_FLOAT or MI_TYPE_DOUBLE), computing
+ * src * scale + offset in double precision.
+ */
+int miscale_to_real(mitype_t src_type, const void *src,
+                    mitype_t dst_type, void *dst, size_t n,
+                    double scale, double offset)
+{
+  size_t done = 0;
+
+  if (!miscale_supported(src_type) ||
+      (dst_type != MI_TYPE_FLOAT && dst_type != MI_TYPE_DOUBLE)) {
+    return MI_LOG_ERROR(MI2_MSG_BADTYPE, src_type);
+  }
+
+  switch (miscale_get_isa()) {
+#ifdef MI2_HAVE_X86_SIMD
+  case MI2_SIMD_AVX2:
+    done = miscale_to_real_avx2(src_type, src, dst_type, dst, n, scale, offset);
+    break;
+#endif
+#if defined(MI2_HAVE_X86_SIMD) && defined(__SSE2__)
+  case MI2_SIMD_SSE2:
+    done = miscale_to_real_sse2(src_type, src, dst_type, dst, n, scale, offset);
+    break;
+#endif
+  default:
+    break;
+  }
+
+  if (done < n) {
+    miscale_to_real_scalar(src_type,
+                           (const char *)src + done * mitype_len(src_type),
+                           dst_type,
+                           (char *)dst + done * mitype_len(dst_type),
+                           n - done, scale, offset);
+  }
+  return MI_NOERROR;
+}
+
+#define MISCALE_MINMAX(type_in) \
+  { \
+    const type_in *_src=(const type_in *)src; \
+    size_t _i; \
+    for (_i = 0; _i < n; _i++) { \
+      double _v = (double)_src[_i]; \
+      if (_v < *min) { \
+        *min = _v; \
+      } \
+      if (_v > *max) { \
+        *max = _v; \
+      } \
+    } \
+  }
+
+/** Find the smallest and largest of \a n values of type \a type,
+ * returned as doubles in \a min and \a max.  NaNs are ignored.  If
+ * there are no other values \a min is left greater than \a max.
+ */
+int miscale_minmax(mitype_t type, const void *src, size_t n,
+                   double *min, double *max)
+{
+  size_t done = 0;
+
+  if (!miscale_supported(type)) {
+    return MI_LOG_ERROR(MI2_MSG_BADTYPE, type);
+  }
+
+  *min = HUGE_VAL;
+  *max = -HUGE_VAL;
+  switch (miscale_get_isa()) {
+#ifdef MI2_HAVE_X86_SIMD
+  case MI2_SIMD_AVX2:
+    done = miscale_minmax_avx2(type, src, n, min, max);
+    break;
+#endif
+#if defined(MI2_HAVE_X86_SIMD) && defined(__SSE2__)
+  case MI2_SIMD_SSE2:
+    done = miscale_minmax_sse2(type, src, n, min, max);
+    break;
+#endif
+  default:
+    break;
+  }
+
+  src = (const char *)src + done * mitype_len(type);
+  n -= done;
+  switch (type) {
+  case MI_TYPE_BYTE:
+    MISCALE_MINMAX(signed char);
+    break;
+  case MI_TYPE_UBYTE:
+    MISCALE_MINMAX(unsigned char);
+    break;
+  case MI_TYPE_SHORT:
+    MISCALE_MINMAX(short);
+    break;
+  case MI_TYPE_USHORT:
+    MISCALE_MINMAX(unsigned short);
+    break;
+  case MI_TYPE_INT:
+    MISCALE_MINMAX(int);
+    break;
+  case MI_TYPE_UINT:
+    MISCALE_MINMAX(unsigned int);
+    break;
+  case MI_TYPE_FLOAT:
+    MISCALE_MINMAX(float);
+    break;
+  case MI_TYPE_DOUBLE:
+    MISCALE_MINMAX(double);
+    break;
+  default:
+    break;
+  }
+  return MI_NOERROR;
+}
+
+#define MISCALE_FROM_REAL_INT(type_in,type_out,out_min,out_max) \
+  { \
+    const type_in *_src=(const type_in *)src; \
+    type_out *_dst=(type_out *)dst; \
+    size_t _i; \
+    for (_i = 0; _i < n; _i++) { \
+      double _t = rint((double)_src[_i] * scale + offset); \
+      if (_t != _t) { \
+        _t = 0.0; \
+      } else if (_t > (double)(out_max)) { \
+        _t = (double)(out_max); \
+      } else if (_t < (double)(out_min)) { \
+        _t = (double)(out_min); \
+      } \
+      _dst[_i] = (type_out)_t; \
+    } \
+  }
+
+#define MISCALE_FROM_REAL_FLT(type_in,type_out) \
+  { \
+    const type_in *_src=(const type_in *)src; \
+    type_out *_dst=(type_out *)dst; \
+    size_t _i; \
+    for (_i = 0; _i < n; _i++) { \
+      _dst[_i] = (type_out)((double)_src[_i] * scale + offset); \
+    } \
+  }
+
+#define MISCALE_FROM_REAL_ANY(type_in) \
+  { \
+    switch (dst_type) { \
+    case MI_TYPE_BYTE: \
+      MISCALE_FROM_REAL_INT(type_in, signed char, SCHAR_MIN, SCHAR_MAX); \
+      break; \
+    case MI_TYPE_UBYTE: \
+      MISCALE_FROM_REAL_INT(type_in, unsigned char, 0, UCHAR_MAX); \
+      break; \
+    case MI_TYPE_SHORT: \
+      MISCALE_FROM_REAL_INT(type_in, short, SHRT_MIN, SHRT_MAX); \
+      break; \
+    case MI_TYPE_USHORT: \
+      MISCALE_FROM_REAL_INT(type_in, unsigned short, 0, USHRT_MAX); \
+      break; \
+    case MI_TYPE_INT: \
+      MISCALE_FROM_REAL_INT(type_in, int, INT_MIN, INT_MAX); \
+      break; \
+    case MI_TYPE_UINT: \
+      MISCALE_FROM_REAL_INT(type_in, unsigned int, 0, UINT_MAX); \
+      break; \
+    case MI_TYPE_FLOAT: \
+      MISCALE_FROM_REAL_FLT(type_in, float); \
+      break; \
+    case MI_TYPE_DOUBLE: \
+      MISCALE_FROM_REAL_FLT(type_in, double); \
+      break; \
+    default: \
+      break; \
+    } \
+  }
+
+/** Convert \a n real values of type \a src_type (MI_TYPE_FLOAT or
+ * MI_TYPE_DOUBLE) into voxels of type \a dst_type, computing
+ * src * scale + offset. Integer results are rounded to the nearest
+ * value and clamped to the range of the type, and NaNs become 0, as the
+ * HDF5 double-to-integer converter does.
+ */
+int miscale_from_real(mitype_t src_type, const void *src,
+                      mitype_t dst_type, void *dst, size_t n,
+                      double scale, double offset)
+{
+  if (!miscale_supported(dst_type)) {
+    return MI_LOG_ERROR(MI2_MSG_BADTYPE, dst_type);
+  }
+
+  switch (src_type) {
+  case MI_TYPE_FLOAT:
+    MISCALE_FROM_REAL_ANY(float);
+    break;
+  case MI_TYPE_DOUBLE:
+    MISCALE_FROM_REAL_ANY(double);
+    break;
+  default:
+    return MI_LOG_ERROR(MI2_MSG_BADTYPE, src_type);
+  }
+  return MI_NOERROR;
+}
+
+// kate: indent-mode cstyle; indent-width 2; replace-tabs on;
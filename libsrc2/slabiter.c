@@ -0,0 +1,356 @@
+/** \file slabiter.c
+ * \brief MINC 2.0 prefetching slab iterator
+ *
+ * A slab iterator hands out the image of a volume as a sequence of
+ * slabs of a fixed shape, in the order of the apparent dimensions with
+ * the last one varying fastest.  With a prefetch depth above zero a
+ * background thread reads and converts the following slabs into a ring
+ * of buffers while the caller works on the current one, so that reading
+ * and decompression overlap the processing.
+ *
+ * The background thread calls the HDF5 library, so prefetching needs a
+ * thread-safe build of HDF5; otherwise each slab is read when it is
+ * asked for.  Either way the iterator owns the image of the volume
+ * until it is freed: the hyperslab functions must not be used on the
+ * same volume meanwhile.
+ ************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <hdf5.h>
+#include "minc2.h"
+#include "minc2_private.h"
+
+#if defined(HAVE_PTHREAD) && defined(H5_HAVE_THREADSAFE)
+#include <pthread.h>
+#define MI2_PREFETCH_SLABS 1
+#endif
+
+/** Upper limit for the prefetch depth of a slab iterator. */
+#define MI2_MAX_PREFETCH 64
+
+/** \internal
+ * One buffer of the ring, with the slab it holds.
+ */
+typedef struct {
+  misize_t start[MI2_MAX_VAR_DIMS];
+  misize_t count[MI2_MAX_VAR_DIMS];
+  void *buffer;
+  int result;                   /* Outcome of reading the slab */
+} mislabslot_t;
+
+struct mislabiter {
+  mihandle_t volume;
+  mislabmode_t mode;
+  mitype_t buffer_data_type;
+  double min;                   /* Range of MI_SLAB_NORMALIZED */
+  double max;
+  int ndims;
+  misize_t dims[MI2_MAX_VAR_DIMS];  /* Apparent dimension lengths */
+  misize_t shape[MI2_MAX_VAR_DIMS]; /* Largest slab */
+  misize_t n_slabs;
+  mislabslot_t *slots;
+  int n_slots;
+  misize_t n_read;              /* Slabs read so far */
+  misize_t n_taken;             /* Slabs handed out so far */
+  misize_t n_released;          /* Slabs whose buffer may be reused */
+#ifdef MI2_PREFETCH_SLABS
+  int threaded;
+  int stop;                     /* Set when the iterator is freed */
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t slab_read;
+  pthread_cond_t slot_free;
+#endif
+};
+
+/** \internal
+ * Finds the position of slab number \a index and reads it into \a slot.
+ */
+static int miread_slab(mislabiter_t iterator, misize_t index,
+                       mislabslot_t *slot)
+{
+  int i;
+
+  for (i = iterator->ndims - 1; i >= 0; i--) {
+    misize_t n = (iterator->dims[i] + iterator->shape[i] - 1) / iterator->shape[i];
+
+    slot->start[i] = (index % n) * iterator->shape[i];
+    slot->count[i] = iterator->dims[i] - slot->start[i];
+    if (slot->count[i] > iterator->shape[i]) {
+      slot->count[i] = iterator->shape[i];
+    }
+    index /= n;
+  }
+
+  switch (iterator->mode) {
+  case MI_SLAB_VOXEL:
+    return miget_voxel_value_hyperslab(iterator->volume, iterator->buffer_data_type,
+                                       slot->start, slot->count, slot->buffer);
+  case MI_SLAB_REAL:
+    return miget_real_value_hyperslab(iterator->volume, iterator->buffer_data_type,
+                                      slot->start, slot->count, slot->buffer);
+  case MI_SLAB_NORMALIZED:
+    return miget_hyperslab_normalized(iterator->volume, iterator->buffer_data_type,
+                                      slot->start, slot->count,
+                                      iterator->min, iterator->max, slot->buffer);
+  default:
+    return (MI_ERROR);
+  }
+}
+
+#ifdef MI2_PREFETCH_SLABS
+/** \internal
+ * Body of the background thread: reads the slabs in order, as buffers
+ * become free.
+ */
+static void *miprefetch_slabs(void *arg)
+{
+  mislabiter_t iterator = (mislabiter_t) arg;
+  misize_t index;
+  int stop;
+
+  for (index = 0; index < iterator->n_slabs; index++) {
+    mislabslot_t *slot = &iterator->slots[index % iterator->n_slots];
+
+    pthread_mutex_lock(&iterator->lock);
+    while (index >= iterator->n_released + iterator->n_slots && !iterator->stop) {
+      pthread_cond_wait(&iterator->slot_free, &iterator->lock);
+    }
+    stop = iterator->stop;
+    pthread_mutex_unlock(&iterator->lock);
+    if (stop) {
+      break;
+    }
+
+    slot->result = miread_slab(iterator, index, slot);
+
+    pthread_mutex_lock(&iterator->lock);
+    iterator->n_read++;
+    pthread_cond_signal(&iterator->slab_read);
+    pthread_mutex_unlock(&iterator->lock);
+  }
+  return NULL;
+}
+#endif /* MI2_PREFETCH_SLABS */
+
+/** Start iterating over the image of a volume in slabs.
+ * \param volume The volume handle
+ * \param mode The conversion applied to the voxels, as done by
+ *  miget_voxel_value_hyperslab(), miget_real_value_hyperslab() or
+ *  miget_hyperslab_normalized()
+ * \param buffer_data_type The type of the slab buffers
+ * \param slab_count The shape of a slab, in apparent dimension order; a
+ *  length of 0 takes the whole dimension.  The slabs at the end of a
+ *  dimension are shorter when its length is not a multiple of the slab.
+ * \param min The real value mapped to the smallest value of the buffer
+ *  type by MI_SLAB_NORMALIZED, otherwise ignored
+ * \param max The real value mapped to the largest value
+ * \param prefetch The number of slabs read ahead in the background, or
+ *  0 to read each slab when it is asked for
+ * \param iterator Returns the iterator, to be freed with
+ *  mifree_slab_iterator()
+ */
+int mistart_slab_iterator(mihandle_t volume, mislabmode_t mode,
+                          mitype_t buffer_data_type,
+                          const misize_t slab_count[],
+                          double min, double max, int prefetch,
+                          mislabiter_t *iterator)
+{
+  midimhandle_t dimensions[MI2_MAX_VAR_DIMS];
+  mislabiter_t it;
+  size_t slab_bytes;
+  int i;
+
+  if (volume == NULL || slab_count == NULL || iterator == NULL ||
+      prefetch < 0 || mode < MI_SLAB_VOXEL || mode > MI_SLAB_NORMALIZED) {
+    return (MI_ERROR);
+  }
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
+  if (prefetch > MI2_MAX_PREFETCH) {
+    prefetch = MI2_MAX_PREFETCH;
+  }
+#ifndef MI2_PREFETCH_SLABS
+  prefetch = 0;
+#endif
+
+  it = (mislabiter_t) calloc(1, sizeof(struct mislabiter));
+  if (it == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_OUTOFMEM, sizeof(struct mislabiter));
+  }
+  it->volume = volume;
+  it->mode = mode;
+  it->buffer_data_type = buffer_data_type;
+  it->min = min;
+  it->max = max;
+  it->ndims = volume->number_of_dims;
+
+  /* The hyperslab functions take the apparent order, once one is set. */
+  if (miget_volume_dimensions(volume, MI_DIMCLASS_ANY, MI_DIMATTR_ALL,
+                              (volume->dim_indices != NULL) ?
+                              MI_DIMORDER_APPARENT : MI_DIMORDER_FILE,
+                              it->ndims, dimensions) < 0 ||
+      miget_dimension_sizes(dimensions, it->ndims, it->dims) < 0) {
+    free(it);
+    return (MI_ERROR);
+  }
+
+  it->n_slabs = 1;
+  slab_bytes = mitype_len(buffer_data_type);
+  for (i = 0; i < it->ndims; i++) {
+    it->shape[i] = slab_count[i];
+    if (it->shape[i] == 0 || it->shape[i] > it->dims[i]) {
+      it->shape[i] = it->dims[i];
+    }
+    if (it->shape[i] == 0) {
+      it->n_slabs = 0;          /* An empty dimension has no slabs */
+      it->shape[i] = 1;
+    }
+    it->n_slabs *= (it->dims[i] + it->shape[i] - 1) / it->shape[i];
+    slab_bytes *= it->shape[i];
+  }
+
+  /* The caller holds one buffer while the others are filled. */
+  it->n_slots = prefetch + 1;
+  it->slots = (mislabslot_t *) calloc(it->n_slots, sizeof(mislabslot_t));
+  if (it->slots == NULL) {
+    int n_slots = it->n_slots;
+
+    free(it);
+    return MI_LOG_ERROR(MI2_MSG_OUTOFMEM, n_slots * sizeof(mislabslot_t));
+  }
+  for (i = 0; i < it->n_slots; i++) {
+    it->slots[i].buffer = malloc(slab_bytes);
+    if (it->slots[i].buffer == NULL) {
+      mifree_slab_iterator(it);
+      return MI_LOG_ERROR(MI2_MSG_OUTOFMEM, slab_bytes);
+    }
+  }
+
+#ifdef MI2_PREFETCH_SLABS
+  if (prefetch > 0 && it->n_slabs > 0) {
+    pthread_mutex_init(&it->lock, NULL);
+    pthread_cond_init(&it->slab_read, NULL);
+    pthread_cond_init(&it->slot_free, NULL);
+    if (pthread_create(&it->thread, NULL, miprefetch_slabs, it) != 0) {
+      pthread_cond_destroy(&it->slot_free);
+      pthread_cond_destroy(&it->slab_read);
+      pthread_mutex_destroy(&it->lock);
+    } else {
+      it->threaded = TRUE;
+    }
+  }
+#endif
+
+  *iterator = it;
+  return (MI_NOERROR);
+}
+
+/** Get the next slab of an iterator.  The buffer of the previous slab is
+ * handed back to the iterator, to be filled again.
+ * \param iterator The slab iterator
+ * \param start If not NULL, returns the position of the slab
+ * \param count If not NULL, returns the shape of the slab
+ * \param buffer Returns the voxels of the slab, valid until the next call,
+ *  or NULL once all the slabs have been read
+ * \return MI_ERROR if the slab could not be read
+ */
+int minext_slab(mislabiter_t iterator, misize_t start[], misize_t count[],
+                void **buffer)
+{
+  mislabslot_t *slot;
+  int prefetched = FALSE;
+  int i;
+
+  if (iterator == NULL || buffer == NULL) {
+    return (MI_ERROR);
+  }
+
+#ifdef MI2_PREFETCH_SLABS
+  if (iterator->threaded) {
+    prefetched = TRUE;
+    pthread_mutex_lock(&iterator->lock);
+    iterator->n_released = iterator->n_taken;
+    pthread_cond_signal(&iterator->slot_free);
+    while (iterator->n_read <= iterator->n_taken &&
+           iterator->n_taken < iterator->n_slabs) {
+      pthread_cond_wait(&iterator->slab_read, &iterator->lock);
+    }
+    pthread_mutex_unlock(&iterator->lock);
+  }
+#endif
+
+  if (iterator->n_taken >= iterator->n_slabs) {
+    *buffer = NULL;
+    return (MI_NOERROR);
+  }
+  slot = &iterator->slots[iterator->n_taken % iterator->n_slots];
+
+  if (!prefetched) {
+    slot->result = miread_slab(iterator, iterator->n_taken, slot);
+    iterator->n_read++;
+  }
+  iterator->n_taken++;
+
+  for (i = 0; i < iterator->ndims; i++) {
+    if (start != NULL) {
+      start[i] = slot->start[i];
+    }
+    if (count != NULL) {
+      count[i] = slot->count[i];
+    }
+  }
+  *buffer = slot->buffer;
+  return (slot->result < 0) ? MI_ERROR : MI_NOERROR;
+}
+
+/** Get the number of slabs an iterator hands out in all.
+ */
+int miget_slab_count(mislabiter_t iterator, misize_t *n_slabs)
+{
+  if (iterator == NULL || n_slabs == NULL) {
+    return (MI_ERROR);
+  }
+  *n_slabs = iterator->n_slabs;
+  return (MI_NOERROR);
+}
+
+/** Stop a slab iterator and free its buffers.  Slabs being read ahead
+ * are finished first.
+ */
+int mifree_slab_iterator(mislabiter_t iterator)
+{
+  int i;
+
+  if (iterator == NULL) {
+    return (MI_ERROR);
+  }
+#ifdef MI2_PREFETCH_SLABS
+  if (iterator->threaded) {
+    pthread_mutex_lock(&iterator->lock);
+    iterator->stop = TRUE;
+    pthread_cond_signal(&iterator->slot_free);
+    pthread_mutex_unlock(&iterator->lock);
+    pthread_join(iterator->thread, NULL);
+
+    pthread_cond_destroy(&iterator->slot_free);
+    pthread_cond_destroy(&iterator->slab_read);
+    pthread_mutex_destroy(&iterator->lock);
+  }
+#endif
+  if (iterator->slots != NULL) {
+    for (i = 0; i < iterator->n_slots; i++) {
+      free(iterator->slots[i].buffer);
+    }
+    free(iterator->slots);
+  }
+  free(iterator);
+  return (MI_NOERROR);
+}
+
+// kate: indent-mode cstyle; indent-width 2; replace-tabs on;
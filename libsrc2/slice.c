@@ -33,81 +33,213 @@
  */
 static int mirw_volume_minmax ( int opcode, mihandle_t volume, double *value );
 
+/** Reads image-max and image-min of a slice scaled \a volume into
+ * memory, unless they are there already.  The slice functions and the
+ * real value hyperslab functions then use these copies, which are
+ * written back by miflush_slice_ranges().
+ */
+int miload_slice_ranges ( mihandle_t volume )
+{
+  hid_t fspc_id;
+  size_t n = 1;
+  int i;
+
+  if ( volume->range_max != NULL ) {
+    return ( MI_NOERROR );
+  }
+  if ( volume->imax_id < 0 || volume->imin_id < 0 ) {
+    return ( MI_ERROR );
+  }
+
+  MI_CHECK_HDF_CALL_RET ( fspc_id = H5Dget_space ( volume->imax_id ),
+                          "H5Dget_space" );
+  volume->range_rank = H5Sget_simple_extent_ndims ( fspc_id );
+  if ( volume->range_rank < 0 || volume->range_rank > MI2_MAX_VAR_DIMS ) {
+    H5Sclose ( fspc_id );
+    return ( MI_ERROR );
+  }
+  H5Sget_simple_extent_dims ( fspc_id, volume->range_dims, NULL );
+  H5Sclose ( fspc_id );
+  for ( i = 0; i < volume->range_rank; i++ ) {
+    n *= volume->range_dims[i];
+  }
+
+  volume->range_max = ( double * ) malloc ( 2 * n * sizeof ( double ) );
+  if ( volume->range_max == NULL ) {
+    return ( MI_LOG_ERROR ( MI2_MSG_OUTOFMEM, 2 * n * sizeof ( double ) ) );
+  }
+  volume->range_min = volume->range_max + n;
+  if ( H5Dread ( volume->imax_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL,
+                 H5P_DEFAULT, volume->range_max ) < 0 ||
+       H5Dread ( volume->imin_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL,
+                 H5P_DEFAULT, volume->range_min ) < 0 ) {
+    mifree_slice_ranges ( volume );
+    return ( MI_LOG_ERROR ( MI2_MSG_HDF5, "H5Dread" ) );
+  }
+  volume->range_dirty = FALSE;
+  return ( MI_NOERROR );
+}
+
+/** Writes the cached image-max and image-min back to the file if they
+ * were changed.
+ */
+int miflush_slice_ranges ( mihandle_t volume )
+{
+  if ( volume->range_max == NULL || !volume->range_dirty ) {
+    return ( MI_NOERROR );
+  }
+  MI_CHECK_HDF_CALL_RET ( H5Dwrite ( volume->imax_id, H5T_NATIVE_DOUBLE,
+                                     H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                                     volume->range_max ), "H5Dwrite" );
+  MI_CHECK_HDF_CALL_RET ( H5Dwrite ( volume->imin_id, H5T_NATIVE_DOUBLE,
+                                     H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                                     volume->range_min ), "H5Dwrite" );
+  volume->range_dirty = FALSE;
+  return ( MI_NOERROR );
+}
+
+/** Drops the cached image-max and image-min without writing them. */
+void mifree_slice_ranges ( mihandle_t volume )
+{
+  free ( volume->range_max );
+  volume->range_max = NULL;
+  volume->range_min = NULL;
+  volume->range_dirty = FALSE;
+}
+
+/** Copies the cached ranges of the block of slices \a hdf_start ... \a
+ * hdf_start + \a hdf_count - 1, in file order, to or from \a slice_max
+ * and \a slice_min.
+ */
+static int micopy_cached_ranges ( mihandle_t volume, const hsize_t hdf_start[],
+                                  const hsize_t hdf_count[], double *slice_max,
+                                  double *slice_min, int to_cache )
+{
+  hsize_t index[MI2_MAX_VAR_DIMS];
+  size_t n = 1;
+  size_t k;
+  int rank = volume->range_rank;
+  int i;
+
+  for ( i = 0; i < rank; i++ ) {
+    if ( hdf_start[i] + hdf_count[i] > volume->range_dims[i] ) {
+      return ( MI_LOG_ERROR ( MI2_MSG_GENERIC, "Slice outside the volume" ) );
+    }
+    n *= hdf_count[i];
+    index[i] = 0;
+  }
+
+  for ( k = 0; k < n; k++ ) {
+    size_t offset = 0;
+
+    for ( i = 0; i < rank; i++ ) {
+      offset = offset * volume->range_dims[i] + hdf_start[i] + index[i];
+    }
+    if ( to_cache ) {
+      volume->range_max[offset] = slice_max[k];
+      volume->range_min[offset] = slice_min[k];
+    } else {
+      slice_max[k] = volume->range_max[offset];
+      slice_min[k] = volume->range_min[offset];
+    }
+    for ( i = rank - 1; i >= 0; i-- ) {
+      if ( ++index[i] < hdf_count[i] ) {
+        break;
+      }
+      index[i] = 0;
+    }
+  }
+  if ( to_cache ) {
+    volume->range_dirty = TRUE;
+  }
+  return ( MI_NOERROR );
+}
+
+/** Gets the ranges of a block of slices in file order, from image-max
+ * and image-min as cached in memory.  The block has as many dimensions
+ * as image-max.
+ */
+int miget_cached_slice_ranges ( mihandle_t volume, const hsize_t hdf_start[],
+                                const hsize_t hdf_count[], double *slice_max,
+                                double *slice_min )
+{
+  if ( miload_slice_ranges ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
+  return ( micopy_cached_ranges ( volume, hdf_start, hdf_count,
+                                  slice_max, slice_min, FALSE ) );
+}
+
 /** Get the minimum or maximum value for the slice containing the given point.
  */
 static int mirw_slice_minmax ( int opcode, mihandle_t volume,
                     const misize_t start_positions[],
                     misize_t array_length, double *value )
 {
-  hid_t dset_id;
-  hid_t fspc_id;
-  hid_t mspc_id;
   hsize_t hdf_start[MI2_MAX_VAR_DIMS];//VF: should it be hssize_t ?
   hsize_t hdf_count[MI2_MAX_VAR_DIMS];
+  misize_t start[MI2_MAX_VAR_DIMS];
   misize_t count[MI2_MAX_VAR_DIMS];
   int dir[MI2_MAX_VAR_DIMS];
-  misize_t ndims;
+  double *cached;
   misize_t i;
-  int result;
+  size_t offset = 0;
 
   if ( volume == NULL || value == NULL ) {
     return ( MI_ERROR );    /* Bad parameters */
   }
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
 
   if ( !volume->has_slice_scaling ) {
     return mirw_volume_minmax ( opcode, volume, value );
   }
 
-  if ( opcode & MIRW_SCALE_MIN ) {
-    dset_id = volume->imin_id;
-  } else {
-    dset_id = volume->imax_id;
+  /* The cached ranges are only written back to volumes open for writing. */
+  if ( ( opcode & MIRW_SCALE_SET ) && ( volume->mode & MI2_OPEN_RDWR ) == 0 ) {
+    return ( MI_LOG_ERROR ( MI2_MSG_GENERIC,
+                            "Setting slice range of a read-only volume" ) );
   }
 
-  fspc_id = H5Dget_space ( dset_id );
-  if ( fspc_id < 0 ) {
+  if ( miload_slice_ranges ( volume ) < 0 ) {
     return ( MI_ERROR );
   }
-
-  ndims = H5Sget_simple_extent_ndims ( fspc_id );
-  if ( ndims > array_length ) {
-    ndims = array_length;
+  if ( array_length < ( misize_t ) volume->range_rank ) {
+    return ( MI_ERROR );    /* Too few coordinates */
   }
 
-  for ( i = 0; i < ndims; i++ ) {
+  for ( i = 0; i < ( misize_t ) volume->number_of_dims; i++ ) {
+    start[i] = ( i < array_length ) ? start_positions[i] : 0;
     count[i] = 1;
   }
 
   mitranslate_hyperslab_origin ( volume,
-                                 start_positions,
+                                 start,
                                  count,
                                  hdf_start,
                                  hdf_count,
                                  dir );
 
-  result = H5Sselect_elements ( fspc_id, H5S_SELECT_SET, 1, hdf_start );
-  if ( result < 0 ) {
-    return ( MI_ERROR );
+  for ( i = 0; i < ( misize_t ) volume->range_rank; i++ ) {
+    if ( hdf_start[i] >= volume->range_dims[i] ) {
+      return ( MI_ERROR );
+    }
+    offset = offset * volume->range_dims[i] + hdf_start[i];
   }
 
-  /* Create a trivial scalar space to read the single value.
-   */
-  mspc_id = H5Screate ( H5S_SCALAR );
-
+  cached = ( opcode & MIRW_SCALE_MIN ) ? volume->range_min : volume->range_max;
   if ( opcode & MIRW_SCALE_SET ) {
-    result = H5Dwrite ( dset_id, H5T_NATIVE_DOUBLE, mspc_id, fspc_id,
-                        H5P_DEFAULT, value );
-  } else {
-    result = H5Dread ( dset_id, H5T_NATIVE_DOUBLE, mspc_id, fspc_id,
-                       H5P_DEFAULT, value );
-  }
+    cached[offset] = *value;
+    volume->range_dirty = TRUE;
 
-  if ( result < 0 ) {
-    return ( MI_ERROR );
+    /* The lower resolution images are scaled from these ranges. */
+    if ( volume->range_rank > 0 && volume->selected_resolution == 0 ) {
+      minc_mark_stale_thumbnails ( volume, hdf_start[0], 1 );
+    }
+  } else {
+    *value = cached[offset];
   }
-
-  H5Sclose ( fspc_id );
-  H5Sclose ( mspc_id );
   return ( MI_NOERROR );
 }
 
@@ -238,6 +370,295 @@ int miset_slice_range ( mihandle_t volume, const misize_t start_positions[],
   return ( MI_NOERROR );
 }
 
+/** Number of leading dimensions which select a slice, the dimensions
+ * of image-max and image-min if the volume has slice scaling.
+ */
+static int mislice_rank ( mihandle_t volume )
+{
+  int rank;
+
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
+  rank = volume->number_of_dims - 2;
+  if ( volume->has_slice_scaling ) {
+    if ( miload_slice_ranges ( volume ) < 0 ) {
+      return ( MI_ERROR );
+    }
+    rank = volume->range_rank;
+  }
+  return ( rank < 0 ) ? 0 : rank;
+}
+
+/** Copy the \a n_slices ranges in \a src, in the order of the slices of
+ * the hyperslab \a count, to \a dst in file order, or back from file
+ * order if \a to_file is FALSE.
+ */
+static int mireorder_slice_ranges ( mihandle_t volume, int rank,
+                                    const misize_t count[], const int dir[],
+                                    const hsize_t hdf_count[],
+                                    size_t n_slices, int to_file,
+                                    const double *src, double *dst )
+{
+  hsize_t index[MI2_MAX_VAR_DIMS];
+  size_t k;
+  int i;
+
+  for ( i = 0; i < rank; i++ ) {
+    int file_i = ( volume->dim_indices != NULL ) ? volume->dim_indices[i] : i;
+
+    if ( file_i >= rank ) {
+      return ( MI_LOG_ERROR ( MI2_MSG_GENERIC,
+                              "Slice dimensions moved by the apparent order" ) );
+    }
+    index[i] = 0;
+  }
+
+  for ( k = 0; k < n_slices; k++ ) {
+    size_t f = 0;
+
+    for ( i = 0; i < rank; i++ ) {
+      int file_i = ( volume->dim_indices != NULL ) ? volume->dim_indices[i] : i;
+      hsize_t h = ( dir[i] > 0 ) ? index[i] : count[i] - 1 - index[i];
+      int j;
+
+      for ( j = file_i + 1; j < rank; j++ ) {
+        h *= hdf_count[j];
+      }
+      f += h;
+    }
+    if ( to_file ) {
+      dst[f] = src[k];
+    } else {
+      dst[k] = src[f];
+    }
+
+    /* Next slice of the hyperslab. */
+    for ( i = rank - 1; i >= 0; i-- ) {
+      if ( ++index[i] < count[i] ) {
+        break;
+      }
+      index[i] = 0;
+    }
+  }
+  return ( MI_NOERROR );
+}
+
+/** Reads or writes the ranges of all the slices of a hyperslab at once.
+ */
+static int mirw_slice_ranges ( int opcode, mihandle_t volume,
+                               const misize_t start[], const misize_t count[],
+                               double *slice_max, double *slice_min )
+{
+  hsize_t hdf_start[MI2_MAX_VAR_DIMS];
+  hsize_t hdf_count[MI2_MAX_VAR_DIMS];
+  int dir[MI2_MAX_VAR_DIMS];
+  double *tmp_max = NULL;
+  double *tmp_min = NULL;
+  size_t n_slices = 1;
+  int reorder = FALSE;
+  int result = MI_ERROR;
+  int rank;
+  int i;
+
+  if ( volume == NULL || start == NULL || count == NULL ||
+       slice_max == NULL || slice_min == NULL ) {
+    return ( MI_ERROR );    /* Bad parameters */
+  }
+
+  if ( ( rank = mislice_rank ( volume ) ) < 0 ) {
+    return ( MI_ERROR );
+  }
+  for ( i = 0; i < rank; i++ ) {
+    n_slices *= count[i];
+  }
+  if ( n_slices == 0 ) {
+    return ( MI_NOERROR );
+  }
+
+  if ( !volume->has_slice_scaling ) {
+    /* All the slices share the volume range. */
+    double vmax = slice_max[0];
+    double vmin = slice_min[0];
+    size_t k;
+
+    if ( ( opcode & MIRW_SCALE_SET ) == 0 ) {
+      for ( k = 0; k < n_slices; k++ ) {
+        slice_max[k] = volume->scale_max;
+        slice_min[k] = volume->scale_min;
+      }
+      return ( MI_NOERROR );
+    }
+    for ( k = 1; k < n_slices; k++ ) {
+      if ( slice_max[k] > vmax ) {
+        vmax = slice_max[k];
+      }
+      if ( slice_min[k] < vmin ) {
+        vmin = slice_min[k];
+      }
+    }
+    return ( miset_volume_range ( volume, vmax, vmin ) );
+  }
+
+  /* The cached ranges are only written back to volumes open for writing. */
+  if ( ( opcode & MIRW_SCALE_SET ) && ( volume->mode & MI2_OPEN_RDWR ) == 0 ) {
+    return ( MI_LOG_ERROR ( MI2_MSG_GENERIC,
+                            "Setting slice ranges of a read-only volume" ) );
+  }
+
+  mitranslate_hyperslab_origin ( volume, start, count,
+                                 hdf_start, hdf_count, dir );
+  for ( i = 0; i < rank; i++ ) {
+    if ( dir[i] < 0 ||
+         ( volume->dim_indices != NULL && volume->dim_indices[i] != i ) ) {
+      reorder = TRUE;
+    }
+  }
+
+  if ( reorder ) {
+    tmp_max = ( double * ) malloc ( 2 * n_slices * sizeof ( double ) );
+    if ( tmp_max == NULL ) {
+      return ( MI_LOG_ERROR ( MI2_MSG_OUTOFMEM, 2 * n_slices * sizeof ( double ) ) );
+    }
+    tmp_min = tmp_max + n_slices;
+    if ( ( opcode & MIRW_SCALE_SET ) &&
+         ( mireorder_slice_ranges ( volume, rank, count, dir, hdf_count,
+                                    n_slices, TRUE, slice_max, tmp_max ) < 0 ||
+           mireorder_slice_ranges ( volume, rank, count, dir, hdf_count,
+                                    n_slices, TRUE, slice_min, tmp_min ) < 0 ) ) {
+      goto cleanup;
+    }
+  } else {
+    tmp_max = slice_max;
+    tmp_min = slice_min;
+  }
+
+  if ( opcode & MIRW_SCALE_SET ) {
+    result = micopy_cached_ranges ( volume, hdf_start, hdf_count,
+                                    tmp_max, tmp_min, TRUE );
+    /* The lower resolution images are scaled from these ranges. */
+    if ( result >= 0 && rank > 0 && volume->selected_resolution == 0 ) {
+      minc_mark_stale_thumbnails ( volume, hdf_start[0], hdf_count[0] );
+    }
+  } else {
+    result = micopy_cached_ranges ( volume, hdf_start, hdf_count,
+                                    tmp_max, tmp_min, FALSE );
+    if ( result >= 0 && reorder &&
+         ( mireorder_slice_ranges ( volume, rank, count, dir, hdf_count,
+                                    n_slices, FALSE, tmp_max, slice_max ) < 0 ||
+           mireorder_slice_ranges ( volume, rank, count, dir, hdf_count,
+                                    n_slices, FALSE, tmp_min, slice_min ) < 0 ) ) {
+      result = MI_ERROR;
+    }
+  }
+  result = ( result < 0 ) ? MI_ERROR : MI_NOERROR;
+
+cleanup:
+  if ( reorder ) {
+    free ( tmp_max );
+  }
+  return ( result );
+}
+
+/**
+ * This function gets the maximum and minimum real values of all the
+ * slices of the hyperslab of \a volume given by \a start and \a count,
+ * which must have an entry for each dimension of the volume.  The
+ * slices are selected by the leading dimensions, all but the last two
+ * unless the file was written otherwise; \a slice_max and \a slice_min
+ * receive one value for each of them, in the order of the hyperslab.
+ * Without slice scaling every slice gets the volume range.
+ */
+int miget_slice_ranges ( mihandle_t volume, const misize_t start[],
+                         const misize_t count[], double slice_max[],
+                         double slice_min[] )
+{
+  return ( mirw_slice_ranges ( MIRW_SCALE_GET, volume, start, count,
+                               slice_max, slice_min ) );
+}
+
+/**
+ * This function sets the maximum and minimum real values of all the
+ * slices of the hyperslab of \a volume given by \a start and \a count.
+ * The arrays are laid out as for miget_slice_ranges().
+ * Without slice scaling the volume range is set to cover all the
+ * values given.
+ */
+int miset_slice_ranges ( mihandle_t volume, const misize_t start[],
+                         const misize_t count[], const double slice_max[],
+                         const double slice_min[] )
+{
+  return ( mirw_slice_ranges ( MIRW_SCALE_SET, volume, start, count,
+                               ( double * ) slice_max,
+                               ( double * ) slice_min ) );
+}
+
+/**
+ * This function sets the range of each slice of the hyperslab of \a
+ * volume given by \a start and \a count to the smallest and largest of
+ * the real values in \a buffer, which holds that hyperslab with values
+ * of type \a buffer_data_type, as it will be passed to
+ * miset_real_value_hyperslab().  The hyperslab should cover its slices
+ * entirely.  Slices with no values other than NaNs get the range 0 to 1.
+ */
+int miset_slice_ranges_from_hyperslab ( mihandle_t volume,
+                                        mitype_t buffer_data_type,
+                                        const misize_t start[],
+                                        const misize_t count[],
+                                        const void *buffer )
+{
+  double *slice_max;
+  double *slice_min;
+  size_t n_slices = 1;
+  size_t slice_n = 1;
+  size_t type_size = mitype_len ( buffer_data_type );
+  size_t k;
+  int rank;
+  int i;
+  int result;
+
+  if ( volume == NULL || start == NULL || count == NULL || buffer == NULL ) {
+    return ( MI_ERROR );
+  }
+  if ( !miscale_supported ( buffer_data_type ) ) {
+    return ( MI_LOG_ERROR ( MI2_MSG_BADTYPE, buffer_data_type ) );
+  }
+  if ( ( rank = mislice_rank ( volume ) ) < 0 ) {
+    return ( MI_ERROR );
+  }
+  for ( i = 0; i < volume->number_of_dims; i++ ) {
+    if ( i < rank ) {
+      n_slices *= count[i];
+    } else {
+      slice_n *= count[i];
+    }
+  }
+  if ( n_slices == 0 || slice_n == 0 ) {
+    return ( MI_NOERROR );
+  }
+
+  slice_max = ( double * ) malloc ( 2 * n_slices * sizeof ( double ) );
+  if ( slice_max == NULL ) {
+    return ( MI_LOG_ERROR ( MI2_MSG_OUTOFMEM, 2 * n_slices * sizeof ( double ) ) );
+  }
+  slice_min = slice_max + n_slices;
+
+  for ( k = 0; k < n_slices; k++ ) {
+    miscale_minmax ( buffer_data_type,
+                     ( const char * ) buffer + k * slice_n * type_size,
+                     slice_n, &slice_min[k], &slice_max[k] );
+    if ( slice_min[k] > slice_max[k] ) {
+      slice_min[k] = 0.0;
+      slice_max[k] = 1.0;
+    }
+  }
+
+  result = mirw_slice_ranges ( MIRW_SCALE_SET, volume, start, count,
+                               slice_max, slice_min );
+  free ( slice_max );
+  return ( result );
+}
+
 /** Internal function to read/write the volume global minimum or
  * maximum real range.
  */
@@ -251,6 +672,9 @@ static int mirw_volume_minmax ( int opcode, mihandle_t volume, double *value )
   if ( volume == NULL || value == NULL ) {
     return ( MI_ERROR );
   }
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
   if ( volume->has_slice_scaling ) {
     return ( MI_ERROR );
   }
@@ -404,6 +828,9 @@ int miget_slice_scaling_flag ( mihandle_t volume, miboolean_t *slice_scaling_fla
   if ( volume == NULL || slice_scaling_flag == NULL ) {
     return ( MI_ERROR );
   }
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
   *slice_scaling_flag = volume->has_slice_scaling;
   return ( MI_NOERROR );
 }
@@ -415,6 +842,9 @@ int miset_slice_scaling_flag ( mihandle_t volume, miboolean_t slice_scaling_flag
   if ( volume == NULL ) {
     return ( MI_ERROR );
   }
+  if ( miload_volume_image ( volume ) < 0 ) {
+    return ( MI_ERROR );
+  }
   volume->has_slice_scaling = slice_scaling_flag;
   return ( MI_NOERROR );
 }
@@ -19,6 +19,7 @@
 
 #define _GNU_SOURCE 1
 #include <stdlib.h>
+#include <string.h>
 #include <hdf5.h>
 #include "minc2.h"
 #include "minc2_private.h"
@@ -30,6 +31,16 @@
 /** Maximum number of elements in a filter parameter list. */
 #define MI2_MAX_CD_ELEMENTS 100
 
+/** Uncompressed size of the chunks chosen for bulk access patterns. */
+#define MI2_BULK_CHUNK_BYTES (1 << 20)
+
+/** Uncompressed size of the chunks chosen for small patches. */
+#define MI2_PATCH_CHUNK_BYTES (64 << 10)
+
+/** Bounds of the chunk cache size chosen for an access pattern. */
+#define MI2_MIN_CACHE_BYTES (1 << 20)
+#define MI2_MAX_CACHE_BYTES (256 << 20)
+
 /** Create a volume property list.  The new list will be returned in the
  * \a props parameter.    When the program is finished
  * using the property list it should call  mifree_volume_props() to free the
@@ -50,6 +61,7 @@ int minew_volume_props(mivolumeprops_t  *props)
    */
   handle->enable_flag = FALSE;
   handle->depth = 0;
+  handle->resolution_filter = MI_FILTER_DEFAULT;
   handle->compression_type = MI_COMPRESS_NONE;
   handle->zlib_level = 0;
   handle->edge_count = 0;
@@ -58,6 +70,8 @@ int minew_volume_props(mivolumeprops_t  *props)
   handle->record_length = 0;
   handle->record_name = NULL;
   handle->template_flag = 0;
+  handle->cache_size = 0;
+  handle->cache_slots = 0;
   
   *props = handle;
   
@@ -95,12 +109,6 @@ int miget_volume_props(mihandle_t volume, mivolumeprops_t *props)
   mivolumeprops_t handle;
   hid_t hdf_vol_dataset;
   hid_t hdf_plist;
-  int nfilters;
-  unsigned int flags;
-  size_t cd_nelmts;
-  unsigned int cd_values[MI2_MAX_CD_ELEMENTS];
-  char fname[MI2_CHAR_LENGTH];
-  int fcode;
   
   if (volume->hdf_id < 0) {
     return (MI_ERROR);
@@ -113,7 +121,7 @@ int miget_volume_props(mihandle_t volume, mivolumeprops_t *props)
   if (hdf_plist < 0) {
     return (MI_ERROR);
   }
-  handle = (mivolumeprops_t)malloc(sizeof(struct mivolprops));
+  handle = (mivolumeprops_t)calloc(1, sizeof(struct mivolprops));
   if (handle == NULL) {
     return (MI_ERROR);
   }
@@ -136,33 +144,8 @@ int miget_volume_props(mihandle_t volume, mivolumeprops_t *props)
     for (i = 0; i < handle->edge_count; i++) {
       handle->edge_lengths[i] = dims[i];
     }
-    /* Get the number of filters in the pipeline */
-    nfilters = H5Pget_nfilters(hdf_plist);
-    if (nfilters == 0) {
-      handle->zlib_level = 0;
-      handle->compression_type = MI_COMPRESS_NONE;
-    }
-    else {
-      for (i = 0; i < nfilters; i++) {
-        cd_nelmts = MI2_MAX_CD_ELEMENTS;
-        fcode = H5Pget_filter1(hdf_plist, i, &flags, &cd_nelmts,
-                               cd_values, sizeof(fname), fname);
-        switch (fcode) {
-          case H5Z_FILTER_DEFLATE:
-            handle->compression_type = MI_COMPRESS_ZLIB;
-            handle->zlib_level = cd_values[0];
-            break;
-          case H5Z_FILTER_SHUFFLE:
-            break;
-          case H5Z_FILTER_FLETCHER32:
-            break;
-          case H5Z_FILTER_SZIP:
-            break;
-          default:
-            break;
-        }
-      }
-    }
+    /* Identify the codec from the filter pipeline */
+    handle->compression_type = micodec_detect(hdf_plist, &handle->zlib_level);
   }
   else {
     handle->edge_count = 0;
@@ -230,7 +213,50 @@ int miget_props_multi_resolution(mivolumeprops_t props, miboolean_t *enable_flag
   return (MI_NOERROR);
 }
 
+/** Set the filter used to compute the lower resolution images of a
+ * multi-resolution volume.  MI_FILTER_DEFAULT selects the box filter,
+ * or the mode for label volumes, whose values must not be averaged.
+ * \param props A volume property list handle
+ * \param filter MI_FILTER_DEFAULT, MI_FILTER_BOX, MI_FILTER_GAUSSIAN or
+ * MI_FILTER_MODE
+ * \ingroup mi2VPrp
+ */
+int miset_props_resolution_filter(mivolumeprops_t props, mifilter_t filter)
+{
+  if (props == NULL) {
+    return (MI_ERROR);
+  }
+  switch (filter) {
+  case MI_FILTER_DEFAULT:
+  case MI_FILTER_BOX:
+  case MI_FILTER_GAUSSIAN:
+  case MI_FILTER_MODE:
+    props->resolution_filter = filter;
+    return (MI_NOERROR);
+  default:
+    return (MI_ERROR);
+  }
+}
+
+/** Get the filter used to compute the lower resolution images.
+ * \param props A volume property list handle
+ * \param filter Pointer to the filter
+ * \ingroup mi2VPrp
+ */
+int miget_props_resolution_filter(mivolumeprops_t props, mifilter_t *filter)
+{
+  if (props == NULL || filter == NULL) {
+    return (MI_ERROR);
+  }
+  *filter = props->resolution_filter;
+  return (MI_NOERROR);
+}
+
 /** Select a different resolution from a multi-resolution image.
+ * A level which is missing, or stale because the full resolution image
+ * was modified since it was built, is computed first, only where it is
+ * out of date.  The levels of volumes opened read-only are computed in
+ * memory when the file does not hold them up to date.
  * \ingroup mi2VPrp
  */
 int miselect_resolution(mihandle_t volume, int depth)
@@ -241,25 +267,30 @@ int miselect_resolution(mihandle_t volume, int depth)
   if ( volume->hdf_id < 0 || depth > MI2_MAX_RESOLUTION_GROUP || depth < 0) {
     return (MI_ERROR);
   }
-  
-  grp_id = H5Gopen1(volume->hdf_id, MI_ROOT_PATH "/image");
-  if (grp_id < 0) {
+  if (miload_volume_image(volume) < 0) {
     return (MI_ERROR);
   }
-  /* Check given depth with the available depth in file.
-   Make sure the selected resolution does exist.
-   */
-  if (depth > volume->create_props->depth) {
+  
+  /* The cached slice ranges belong to the current resolution. */
+  if (miflush_slice_ranges(volume) < 0) {
     return (MI_ERROR);
   }
-  else if (depth != 0) {
-    if (minc_update_thumbnail(volume, grp_id, 0, depth) < 0) {
-      return (MI_ERROR);
-    }
+  mifree_slice_ranges(volume);
+
+  if (depth == 0) {
+    grp_id = H5Gopen2(volume->hdf_id, MI_ROOT_PATH "/image", H5P_DEFAULT);
+  } else {
+    grp_id = minc_select_thumbnail(volume, depth);
+  }
+  if (grp_id < 0) {
+    return (MI_ERROR);
   }
   
   volume->selected_resolution = depth;
   
+  /* Cached dataspaces describe the previous resolution. */
+  mifree_hyperslab_cache(volume);
+
   if (volume->image_id >= 0) {
     H5Dclose(volume->image_id);
   }
@@ -279,10 +310,12 @@ int miselect_resolution(mihandle_t volume, int depth)
     sprintf(path, "%d/image-min", depth);
     volume->imin_id = H5Dopen1(grp_id, path);
   }
+  H5Gclose(grp_id);
   return (MI_NOERROR);
 }
 
-/** Compute or recompute all resolution groups.
+/** Compute or recompute all resolution groups.  Only the parts of the
+ * levels which are stale are computed.
  *
  * \ingroup mi2VPrp
  */
@@ -291,8 +324,11 @@ int miflush_from_resolution(mihandle_t volume, int depth)
   if ( volume->hdf_id < 0 || depth > MI2_MAX_RESOLUTION_GROUP || depth <= 0) {
     return (MI_ERROR);
   }
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
   
-  if (depth > volume->create_props->depth) {
+  if (volume->create_props != NULL && depth > volume->create_props->depth) {
     return (MI_ERROR);
   }
   else {
@@ -305,12 +341,43 @@ int miflush_from_resolution(mihandle_t volume, int depth)
   return (MI_NOERROR);
 }
 
+/** Choose when the lower resolution images of a volume are computed.
+ * By default the stale parts of every level are computed when the volume
+ * is closed.  With \a lazy set they are only computed when the level is
+ * selected with miselect_resolution() or miflush_from_resolution() is
+ * called, and the stale slices are recorded in the file so that they
+ * can be computed after the volume is opened again.
+ * \ingroup mi2VPrp
+ */
+int miset_volume_lazy_resolution(mihandle_t volume, miboolean_t lazy)
+{
+  if (volume == NULL) {
+    return (MI_ERROR);
+  }
+  volume->lazy_resolution = lazy;
+  return (MI_NOERROR);
+}
+
+/** Get whether the lower resolution images of a volume are computed
+ * when they are selected rather than when the volume is closed.
+ * \ingroup mi2VPrp
+ */
+int miget_volume_lazy_resolution(mihandle_t volume, miboolean_t *lazy)
+{
+  if (volume == NULL || lazy == NULL) {
+    return (MI_ERROR);
+  }
+  *lazy = volume->lazy_resolution;
+  return (MI_NOERROR);
+}
+
 /** Set compression type for a volume property list
  * Note that enabling compression will automatically
  * enable blocking with default parameters.
  * \param props A volume properties list
- * \param compression_type The type of compression to use (MI_COMPRESS_NONE
- * or MI_COMPRESS_ZLIB)
+ * \param compression_type The type of compression to use (MI_COMPRESS_NONE,
+ * MI_COMPRESS_ZLIB, MI_COMPRESS_SHUFFLE_ZLIB, MI_COMPRESS_LZ4,
+ * MI_COMPRESS_SHUFFLE_LZ4 or MI_COMPRESS_RLE)
  * \ingroup mi2VPrp
  */
 int miset_props_compression_type(mivolumeprops_t props,
@@ -327,7 +394,11 @@ int miset_props_compression_type(mivolumeprops_t props,
       props->compression_type = MI_COMPRESS_NONE;
       break;
     case MI_COMPRESS_ZLIB:
-      props->compression_type = MI_COMPRESS_ZLIB;
+    case MI_COMPRESS_SHUFFLE_ZLIB:
+    case MI_COMPRESS_LZ4:
+    case MI_COMPRESS_SHUFFLE_LZ4:
+    case MI_COMPRESS_RLE:
+      props->compression_type = compression_type;
       props->zlib_level = MI2_DEFAULT_ZLIB_LEVEL;
       for (i = 0; i < MI2_MAX_VAR_DIMS; i++) {
         edge_lengths[i] = MI2_CHUNK_SIZE;
@@ -458,6 +529,214 @@ int miget_props_blocking(mivolumeprops_t props, int *edge_count, int *edge_lengt
   return (MI_NOERROR);
 }
 
+/** Halves the longest edge which is not fixed until a chunk holds at
+ * most \a max_voxels voxels, which keeps the chunk as close to a cube as
+ * the dimensions allow.
+ */
+static void mifit_chunk(int ndims, int edges[], const int fixed[],
+                        size_t max_voxels)
+{
+  for (;;) {
+    size_t n_voxels = 1;
+    int longest = -1;
+    int i;
+
+    for (i = 0; i < ndims; i++) {
+      n_voxels *= edges[i];
+      if (!fixed[i] && edges[i] > 1 &&
+          (longest < 0 || edges[i] > edges[longest])) {
+        longest = i;
+      }
+    }
+    if (n_voxels <= max_voxels || longest < 0) {
+      break;
+    }
+    edges[longest] = (edges[longest] + 1) / 2;
+  }
+}
+
+/** Smallest prime number not less than \a n, for the number of chunk
+ * cache slots.
+ */
+static size_t minext_prime(size_t n)
+{
+  size_t d;
+
+  if (n <= 2) {
+    return 2;
+  }
+  for (n |= 1; ; n += 2) {
+    for (d = 3; d * d <= n && n % d != 0; d += 2)
+      ;
+    if (d * d > n) {
+      return n;
+    }
+  }
+}
+
+/** Choose the blocking structure and chunk cache size of a volume from
+ * the way it will be read.  The chunks are shaped so that each access
+ * reads as few chunks as possible:
+ *
+ * - MI_ACCESS_VOLUME: chunks of about 1MB, as close to cubes as possible;
+ * - MI_ACCESS_SLICES: one slice thick along \a dimension_name;
+ * - MI_ACCESS_PATCHES: small cubes of about 64KB, one time point thick;
+ * - MI_ACCESS_TIMESERIES: the whole length of \a dimension_name, so that
+ *   the series of a voxel lies in a single chunk.
+ *
+ * The chunk cache is sized to hold the chunks which one access touches,
+ * so that neighbouring accesses find them again.
+ *
+ * \param props A volume property list handle
+ * \param pattern The expected access pattern
+ * \param dimension_name The dimension slices are taken along, or the
+ * dimension of the time series; NULL selects the first dimension, or the
+ * time dimension for MI_ACCESS_TIMESERIES
+ * \param ndims The number of dimensions of the volume
+ * \param dimensions The dimensions of the volume, in file order
+ * \param volume_type The voxel type of the volume
+ * \ingroup mi2VPrp
+ */
+int miset_props_access_pattern(mivolumeprops_t props, miaccess_pattern_t pattern,
+                               const char *dimension_name, int ndims,
+                               const midimhandle_t dimensions[],
+                               mitype_t volume_type)
+{
+  int edges[MI2_MAX_VAR_DIMS];
+  int fixed[MI2_MAX_VAR_DIMS];
+  size_t el_size;
+  size_t chunk_bytes;
+  size_t cache_chunks = 1;
+  size_t cache_size;
+  hid_t type_id;
+  int dim = -1;
+  int i;
+
+  if (props == NULL || dimensions == NULL || ndims < 1 ||
+      ndims > MI2_MAX_VAR_DIMS) {
+    return (MI_ERROR);
+  }
+
+  type_id = mitype_to_hdftype(volume_type, TRUE);
+  if (type_id < 0) {
+    return (MI_LOG_ERROR(MI2_MSG_BADTYPE, volume_type));
+  }
+  el_size = H5Tget_size(type_id);
+  H5Tclose(type_id);
+
+  /* Find the dimension named by the pattern. */
+  for (i = 0; i < ndims; i++) {
+    if (dimension_name != NULL) {
+      if (!strcmp(dimensions[i]->name, dimension_name)) {
+        dim = i;
+      }
+    } else if (pattern == MI_ACCESS_TIMESERIES) {
+      if (dimensions[i]->dim_class == MI_DIMCLASS_TIME) {
+        dim = i;
+      }
+    } else {
+      dim = 0;
+    }
+  }
+  if (dim < 0 && (pattern == MI_ACCESS_SLICES ||
+                  pattern == MI_ACCESS_TIMESERIES)) {
+    return (MI_LOG_ERROR(MI2_MSG_GENERIC,
+                         "No dimension for the access pattern"));
+  }
+
+  for (i = 0; i < ndims; i++) {
+    edges[i] = (int) dimensions[i]->length;
+    fixed[i] = FALSE;
+  }
+
+  switch (pattern) {
+  case MI_ACCESS_VOLUME:
+    mifit_chunk(ndims, edges, fixed, MI2_BULK_CHUNK_BYTES / el_size);
+    break;
+
+  case MI_ACCESS_SLICES:
+    edges[dim] = 1;
+    fixed[dim] = TRUE;
+    mifit_chunk(ndims, edges, fixed, MI2_BULK_CHUNK_BYTES / el_size);
+    /* Every chunk of a slice. */
+    for (i = 0; i < ndims; i++) {
+      cache_chunks *= (dimensions[i]->length + edges[i] - 1) / edges[i];
+    }
+    cache_chunks /= dimensions[dim]->length;
+    break;
+
+  case MI_ACCESS_PATCHES:
+    for (i = 0; i < ndims; i++) {
+      if (dimensions[i]->dim_class == MI_DIMCLASS_TIME) {
+        edges[i] = 1;
+        fixed[i] = TRUE;
+      }
+    }
+    mifit_chunk(ndims, edges, fixed, MI2_PATCH_CHUNK_BYTES / el_size);
+    /* A patch may straddle two chunks along each dimension. */
+    for (i = 0; i < ndims; i++) {
+      if ((misize_t) edges[i] < dimensions[i]->length) {
+        cache_chunks *= 2;
+      }
+    }
+    break;
+
+  case MI_ACCESS_TIMESERIES:
+    fixed[dim] = TRUE;
+    mifit_chunk(ndims, edges, fixed, MI2_BULK_CHUNK_BYTES / el_size);
+    /* A row of chunks along the fastest varying other dimension, so that
+     * voxels visited in file order keep finding their chunk.
+     */
+    i = (dim == ndims - 1) ? ndims - 2 : ndims - 1;
+    if (i >= 0) {
+      cache_chunks = (dimensions[i]->length + edges[i] - 1) / edges[i];
+    }
+    break;
+
+  default:
+    return (MI_ERROR);
+  }
+
+  chunk_bytes = el_size;
+  for (i = 0; i < ndims; i++) {
+    chunk_bytes *= edges[i];
+  }
+  cache_size = cache_chunks * chunk_bytes;
+  if (cache_size < MI2_MIN_CACHE_BYTES) {
+    cache_size = MI2_MIN_CACHE_BYTES;
+  }
+  if (cache_size > MI2_MAX_CACHE_BYTES) {
+    cache_size = MI2_MAX_CACHE_BYTES;
+  }
+  if (cache_size < chunk_bytes) {
+    cache_size = chunk_bytes;
+  }
+
+  props->cache_size = cache_size;
+  /* HDF5 suggests about 100 slots per chunk held, a prime number. */
+  props->cache_slots = minext_prime(100 * (cache_size / chunk_bytes + 1));
+
+  return (miset_props_blocking(props, ndims, edges));
+}
+
+/** Get the chunk cache size chosen by miset_props_access_pattern().
+ * Zero values mean the HDF5 defaults.
+ * \param props A volume property list handle
+ * \param cache_size Returns the size of the chunk cache in bytes
+ * \param cache_slots Returns the number of hash slots of the cache
+ * \ingroup mi2VPrp
+ */
+int miget_props_chunk_cache(mivolumeprops_t props, size_t *cache_size,
+                            size_t *cache_slots)
+{
+  if (props == NULL) {
+    return (MI_ERROR);
+  }
+  *cache_size = props->cache_size;
+  *cache_slots = props->cache_slots;
+  return (MI_NOERROR);
+}
+
 /** Set properties for uniform/nonuniform record dimension
  * \ingroup mi2VPrp
  */
@@ -19,6 +19,10 @@
 #include <unistd.h>
 #endif //HAVE_UNISTD_H
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif //HAVE_SYS_MMAN_H
+
 #ifdef HAVE_MINC1
 #include "minc.h"
 #endif //HAVE_MINC1
@@ -99,32 +103,64 @@ static int _generate_ident( char * id_str, size_t length )
   return result;
 }
 
+/**
+ * Apply the chunk cache defaults given by the environment or ~/.mincrc
+ * (MINC_CHUNK_CACHE_KB, MINC_CHUNK_CACHE_SLOTS and MINC_CHUNK_CACHE_W0)
+ * to a file access property list.
+ */
+static void _hdf_set_chunk_cache(hid_t fapl_id)
+{
+  int mdc_nelmts;
+  size_t nslots;
+  size_t nbytes;
+  double w0;
+  int cache_kb = mi2get_cfg_int(MICFG_CHUNK_CACHE);
+  int slots = mi2get_cfg_int(MICFG_CHUNK_SLOTS);
+  char *w0_str = mi2get_cfg_str(MICFG_CHUNK_W0);
+
+  if (H5Pget_cache(fapl_id, &mdc_nelmts, &nslots, &nbytes, &w0) >= 0) {
+    if (cache_kb > 0) {
+      nbytes = (size_t) cache_kb * 1024;
+    }
+    if (slots > 0) {
+      nslots = slots;
+    }
+    if (w0_str != NULL && atof(w0_str) >= 0.0 && atof(w0_str) <= 1.0) {
+      w0 = atof(w0_str);
+    }
+    H5Pset_cache(fapl_id, mdc_nelmts, nslots, nbytes, w0);
+  }
+  free(w0_str);
+}
+
 /**
  * open HDF5 file 
  */
 static hid_t _hdf_open(const char *path, int mode)
 {
   hid_t fd;
+  hid_t fapl_id;
 /*  hid_t grp_id;
   hid_t dset_id;
   int ndims;*/
   
+  fapl_id = H5Pcreate(H5P_FILE_ACCESS);
+  _hdf_set_chunk_cache(fapl_id);
+
   H5E_BEGIN_TRY {
     #if HDF5_MMAP_TEST
     if (mode & 0x8000) {
-      hid_t prp_id;
-      
-      prp_id = H5Pcreate(H5P_FILE_ACCESS);
-      H5Pset_fapl_mmap(prp_id, 8192, 1);
-      fd = H5Fopen(path, mode & 0x7FFF, prp_id);
-      H5Pclose(prp_id);
+      H5Pset_fapl_mmap(fapl_id, 8192, 1);
+      fd = H5Fopen(path, mode & 0x7FFF, fapl_id);
     } else {
-      fd = H5Fopen(path, mode, H5P_DEFAULT);
+      fd = H5Fopen(path, mode, fapl_id);
     }
     #else
-    fd = H5Fopen(path, mode, H5P_DEFAULT);
+    fd = H5Fopen(path, mode, fapl_id);
     #endif
   } H5E_END_TRY;
+
+  H5Pclose(fapl_id);
   
   
   /* Open the image variables.
@@ -211,6 +247,7 @@ static hid_t _hdf_create(const char *path, int cmode)
 
   /*VF use all the features of new HDF5 1.8*/
   H5Pset_libver_bounds (fpid, H5F_LIBVER_18, H5F_LIBVER_18);
+  _hdf_set_chunk_cache(fpid);
   
   H5E_BEGIN_TRY {
     fd = H5Fcreate(path, cmode, H5P_DEFAULT, fpid);
@@ -294,10 +331,35 @@ int micreate_volume_image(mihandle_t volume)
     return MI_ERROR;
   }
 
-  MI_CHECK_HDF_CALL_RET(dset_id = H5Dcreate1(volume->hdf_id, MI_ROOT_PATH "/image/0/image",
-                                             volume->ftype_id,
-                                             dataspace_id, 
-                                             volume->plist_id),"H5Dcreate1")
+  /* Size the chunk cache for the access pattern, if one was given */
+  if (volume->create_props != NULL && volume->create_props->cache_size != 0) {
+    hid_t dapl_id;
+
+    if ((dapl_id = H5Pcreate(H5P_DATASET_ACCESS)) < 0) {
+      H5Sclose(dataspace_id);
+      return (MI_LOG_ERROR(MI2_MSG_HDF5, "H5Pcreate"));
+    }
+    if (H5Pset_chunk_cache(dapl_id, volume->create_props->cache_slots,
+                           volume->create_props->cache_size,
+                           H5D_CHUNK_CACHE_W0_DEFAULT) < 0) {
+      H5Pclose(dapl_id);
+      H5Sclose(dataspace_id);
+      return (MI_LOG_ERROR(MI2_MSG_HDF5, "H5Pset_chunk_cache"));
+    }
+    MI_CHECK_HDF_CALL(dset_id = H5Dcreate2(volume->hdf_id, MI_ROOT_PATH "/image/0/image",
+                                           volume->ftype_id, dataspace_id, H5P_DEFAULT,
+                                           volume->plist_id, dapl_id),"H5Dcreate2")
+    H5Pclose(dapl_id);
+  } else {
+    MI_CHECK_HDF_CALL(dset_id = H5Dcreate1(volume->hdf_id, MI_ROOT_PATH "/image/0/image",
+                                           volume->ftype_id,
+                                           dataspace_id, 
+                                           volume->plist_id),"H5Dcreate1")
+  }
+  if (dset_id < 0) {
+    H5Sclose(dataspace_id);
+    return (MI_ERROR);
+  }
 
   volume->image_id = dset_id;
 
@@ -413,6 +475,7 @@ static int miset_volume_world_indices(mihandle_t hvol)
 static mihandle_t mialloc_volume_handle(void)
 {
   mihandle_t handle = (mihandle_t) malloc(sizeof(struct mivolume));
+  int i;
 
   if (handle != NULL) {
     /* Clear the memory by default. */
@@ -425,10 +488,16 @@ static mihandle_t mialloc_volume_handle(void)
     handle->imax_id = -1;
     handle->imin_id = -1;
     handle->plist_id = -1;
+    handle->image_fspc_id = -1;
+    handle->image_mspc_id = -1;
+    for (i = 0; i < MI2_TYPE_CACHE_SLOTS; i++) {
+      handle->buffer_type_ids[i] = -1;
+    }
     handle->has_slice_scaling = FALSE;
     handle->is_dirty = FALSE;
     handle->dim_indices = NULL;
     handle->selected_resolution = 0;
+    handle->thumb_file_id = -1;
   }
   return (handle);
 }
@@ -607,7 +676,7 @@ int micreate_volume(const char *filename, int number_of_dimensions,
   */
 
   if (create_props != NULL &&
-      (create_props->compression_type == MI_COMPRESS_ZLIB ||
+      (create_props->compression_type != MI_COMPRESS_NONE ||
        create_props->edge_count != 0)) {
     /* Set the storage to CHUNKED */
     MI_CHECK_HDF_CALL_RET(stat = H5Pset_layout(hdf_plist, H5D_CHUNKED),"H5Pset_layout")
@@ -627,8 +696,15 @@ int micreate_volume(const char *filename, int number_of_dimensions,
     /* Sets the size of the chunks used to store a chunked layout dataset */
     MI_CHECK_HDF_CALL_RET(stat = H5Pset_chunk(hdf_plist, number_of_dimensions, hdf_size),"H5Pset_chunk")
     
-    /* Sets compression method and compression level */
-    MI_CHECK_HDF_CALL_RET(stat = H5Pset_deflate(hdf_plist, create_props->zlib_level),"H5Pset_deflate")
+    /* Sets compression method and compression level; blocking alone
+      has always implied zlib.
+    */
+    if (micodec_set_filters(hdf_plist,
+                            (create_props->compression_type == MI_COMPRESS_NONE) ?
+                            MI_COMPRESS_ZLIB : create_props->compression_type,
+                            create_props->zlib_level) < 0) {
+      return (MI_ERROR);
+    }
 
   } else { /* No COMPRESSION or CHUNKING is enabled */
     
@@ -647,6 +723,13 @@ int micreate_volume(const char *filename, int number_of_dimensions,
         return (MI_ERROR);
       }
     }
+    /* Nothing has been computed for the new levels. */
+    minc_mark_stale_thumbnails(handle, 0, (hsize_t) -1);
+    handle->resolution_filter = create_props->resolution_filter;
+    if (minc_save_resolution_filter(handle) < 0) {
+      free(handle);
+      return (MI_ERROR);
+    }
   }
 
   /* Try creating DIMENSIONS GROUP i.e. /minc-2.0/dimensions
@@ -905,20 +988,14 @@ int micreate_volume(const char *filename, int number_of_dimensions,
     levels of resolution is specified maximum is 16.
     */
     props_handle->depth = create_props->depth;
-    /* Set compression type, currently two values
-    either no compression or zlib is applicable.
+    props_handle->resolution_filter = create_props->resolution_filter;
+    /* Set compression type, any of the codecs in codec.c.
     */
-    switch (create_props->compression_type) {
-    case MI_COMPRESS_NONE:
-      props_handle->compression_type = MI_COMPRESS_NONE;
-      break;
-    case MI_COMPRESS_ZLIB:
-      props_handle->compression_type = MI_COMPRESS_ZLIB;
-      break;
-    default:
+    if (!micodec_supported(create_props->compression_type)) {
       free(props_handle);
       return MI_LOG_ERROR(MI2_MSG_BADTYPE,create_props->compression_type);
     }
+    props_handle->compression_type = create_props->compression_type;
     /* Note that setting compression on (i.e., MI_COMPRESS_ZLIB)
     turns chunking on by default. Need to set the number of chunks
     (edge_count)
@@ -943,6 +1020,8 @@ int micreate_volume(const char *filename, int number_of_dimensions,
       strcpy(props_handle->record_name, create_props->record_name);
     }
     props_handle->template_flag = create_props->template_flag;
+    props_handle->cache_size = create_props->cache_size;
+    props_handle->cache_slots = create_props->cache_slots;
   }
   /* Set the handle to volume properties */
   handle->create_props = props_handle;
@@ -963,6 +1042,9 @@ int miget_volume_dimension_count(mihandle_t volume, midimclass_t cls,
   if (volume == NULL || number_of_dimensions == NULL) {
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to get dimension count with null volume or null variable");
   }
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
   /* For each dimension check to make sure that dimension class and
     attribute match with the specified parameters and if yes
     increment the dimension count
@@ -991,6 +1073,9 @@ int miget_volume_voxel_count(mihandle_t volume, misize_t *number_of_voxels)
   if (volume == NULL || number_of_voxels == NULL) {
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to get voxel count with null volume or null variable");
   }
+  if (miload_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
 
   /* Quickest way to do this is with the dataspace identifier of the
   * volume. Use the volume's current resolution.
@@ -1212,27 +1297,24 @@ static int _miget_file_dimension(mihandle_t volume, const char *dimname,
 
 /** Opens an existing MINC volume for read-only access if mode argument is
   * MI2_OPEN_READ, or read-write access if mode argument is MI2_OPEN_RDWR.
+  * Adding MI2_OPEN_HEADER to the mode opens only the file, so that its
+  * attributes can be read quickly; the dimensions, the image dataset and
+  * its type are set up when they are first needed.
   * \ingroup mi2Vol
 */
 int miopen_volume(const char *filename, int mode, mihandle_t *volume)
 {
   hid_t file_id;
-  hid_t dset_id;
-  hid_t space_id;
   mihandle_t handle;
   int hdf_mode;
-  char dimorder[MI2_CHAR_LENGTH];
-  int i,r;
-  char *p1, *p2;
-  H5T_class_t hdf_class;
-  size_t nbytes;
-  int is_signed;
-  int n_dimensions;
+  miboolean_t header_only;
 
   /* Initialization.
     For the actual body of this function look at m2utils.c
   */
   miinit();
+  header_only = (mode & MI2_OPEN_HEADER) != 0;
+  mode &= ~MI2_OPEN_HEADER;
   /* Convert the specified mode to hdf mode */
   if (mode == MI2_OPEN_READ) {
     hdf_mode = H5F_ACC_RDONLY;
@@ -1294,28 +1376,101 @@ int miopen_volume(const char *filename, int mode, mihandle_t *volume)
   handle->hdf_id = file_id;
   handle->mode = mode;
 
+  /* Everything else waits for the first access to the image. */
+  handle->header_only = TRUE;
+  if (header_only) {
+    if (H5Lexists(file_id, MI_ROOT_PATH, H5P_DEFAULT) <= 0) {
+      miclose_volume(handle);
+      return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to open file which is not a MINC 2.0 file");
+    }
+  } else if (miload_volume_image(handle) < 0) {
+    miclose_volume(handle);
+    return (MI_ERROR);
+  }
+
+  *volume = handle;
+  return (MI_NOERROR);
+}
+
+/** \internal
+ * Releases the dimensions, datasets and types of a volume.
+ */
+static void mirelease_volume_image(mihandle_t volume)
+{
+  int i;
+
+  if (volume->image_id > 0) {
+    H5Dclose(volume->image_id);
+  }
+  if (volume->imax_id > 0) {
+    H5Dclose(volume->imax_id);
+  }
+  if (volume->imin_id > 0) {
+    H5Dclose(volume->imin_id);
+  }
+  if (volume->ftype_id > 0) {
+    H5Tclose(volume->ftype_id);
+  }
+  if (volume->mtype_id > 0) {
+    H5Tclose(volume->mtype_id);
+  }
+  volume->image_id = volume->imax_id = volume->imin_id = -1;
+  volume->ftype_id = volume->mtype_id = 0;
+
+  if (volume->dim_handles != NULL) {
+    
+    for(i=0;i<volume->number_of_dims;i++)
+    {
+      mifree_dimension_handle(volume->dim_handles[i]);
+    }
+    
+    free(volume->dim_handles);
+    volume->dim_handles = NULL;
+  }
+  volume->number_of_dims = 0;
+  if (volume->dim_indices != NULL) {
+    free(volume->dim_indices);
+    volume->dim_indices = NULL;
+  }
+}
+
+/** \internal
+ * Reads the dimensions and opens the image of an existing volume.
+ */
+static int _miopen_volume_image(mihandle_t handle)
+{
+  hid_t file_id = handle->hdf_id;
+  hid_t dset_id;
+  hid_t space_id;
+  char dimorder[MI2_CHAR_LENGTH];
+  int i,r;
+  char *p1, *p2;
+  H5T_class_t hdf_class;
+  size_t nbytes;
+  int is_signed;
+  int n_dimensions;
+
   /* Get the volume class.
   */
   _miget_volume_class(handle, &handle->volume_class);
 
   /* GET THE DIMENSION COUNT
   */
-  n_dimensions = handle->number_of_dims = _miget_file_dimension_count(file_id);
+  n_dimensions = _miget_file_dimension_count(file_id);
   
   if( n_dimensions <= 0 ) {
-    free(handle);
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to open minc file without image variable");
   }
 
   /* READ EACH OF THE DIMENSIONS
   */
-  handle->dim_handles = (midimhandle_t *)malloc(n_dimensions *
+  handle->dim_handles = (midimhandle_t *)calloc(n_dimensions,
                         sizeof(midimhandle_t));
   
   if(handle->dim_handles == NULL) {
-    free(handle);
     return MI_LOG_ERROR(MI2_MSG_OUTOFMEM, n_dimensions * sizeof(midimhandle_t));
   }
+  handle->number_of_dims = n_dimensions;
   
   /* Get the attribute (dimorder) from the image dataset */
   r =  miget_attribute(handle, MI_ROOT_PATH "/image/0/image", "dimorder",
@@ -1382,6 +1537,16 @@ int miopen_volume(const char *filename, int mode, mihandle_t *volume)
 
   /* Open the image dataset */
   MI_CHECK_HDF_CALL_RET(handle->image_id = H5Dopen1(file_id, MI_ROOT_PATH "/image/0/image"),"H5Dopen1");
+  /* Warn about codecs which this build cannot decode; the header is
+    still usable but reading the image will fail.
+  */
+  {
+    hid_t dcpl_id = H5Dget_create_plist(handle->image_id);
+    if (dcpl_id >= 0) {
+      micodec_check_filters(dcpl_id);
+      H5Pclose(dcpl_id);
+    }
+  }
   /* Get the Id for the copy of the datatype for the dataset */
   MI_CHECK_HDF_CALL_RET(handle->ftype_id = H5Dget_type(handle->image_id),"H5Dget_type");
 
@@ -1472,7 +1637,27 @@ int miopen_volume(const char *filename, int mode, mihandle_t *volume)
   /* Read the current settings for valid-range */
   miread_valid_range(handle, &handle->valid_max, &handle->valid_min);
 
-  *volume = handle;
+  /* Which parts of the lower resolution images are out of date */
+  minc_load_thumbnail_state(handle);
+
+  return (MI_NOERROR);
+}
+
+/** \internal
+ * Completes the setup of a volume opened with MI2_OPEN_HEADER.  Every
+ * function which needs more than the attributes of the volume calls this
+ * first; it does nothing once the image has been opened.
+ */
+int miload_volume_image(mihandle_t volume)
+{
+  if (!volume->header_only) {
+    return (MI_NOERROR);
+  }
+  if (_miopen_volume_image(volume) < 0) {
+    mirelease_volume_image(volume);
+    return (MI_ERROR);
+  }
+  volume->header_only = FALSE;
   return (MI_NOERROR);
 }
 
@@ -1483,7 +1668,9 @@ static int miflush_volume(mihandle_t volume)
 {
   if ((volume->mode & MI2_OPEN_RDWR) != 0) {
     H5Fflush(volume->hdf_id, H5F_SCOPE_GLOBAL);
-    misave_valid_range(volume);
+    if (!volume->header_only) {
+      misave_valid_range(volume);
+    }
   }
   return (MI_NOERROR);
 }
@@ -1495,63 +1682,329 @@ static int miflush_volume(mihandle_t volume)
 */
 int miclose_volume(mihandle_t volume)
 {
-  int i;
-  
+  int result = MI_NOERROR;
+
   if (volume == NULL) {
     return MI_LOG_ERROR(MI2_MSG_GENERIC,"Trying to close null volume");
   }
 
-  if (volume->is_dirty) {
-    minc_update_thumbnails(volume);
-    volume->is_dirty = FALSE;
+  /* Nothing but attributes can have changed in a volume opened with
+   * MI2_OPEN_HEADER which was never read.
+   */
+  if ((volume->mode & MI2_OPEN_RDWR) && !volume->header_only) {
+    /* A failed write is reported once the volume is closed. */
+    if (miflush_slice_ranges(volume) < 0) {
+      result = MI_ERROR;
+    }
+    if (misave_label_index(volume) < 0) {
+      result = MI_ERROR;
+    }
+
+    /* With lazy resolution the levels are left stale, to be computed when
+     * they are next selected.
+     */
+    if (volume->is_dirty && !volume->lazy_resolution) {
+      minc_update_thumbnails(volume);
+    }
+    minc_save_thumbnail_state(volume);
   }
+  volume->is_dirty = FALSE;
 
   miflush_volume(volume);
 
-  if (volume->image_id > 0) {
-    H5Dclose(volume->image_id);
-  }
-  if (volume->imax_id > 0) {
-    H5Dclose(volume->imax_id);
-  }
-  if (volume->imin_id > 0) {
-    H5Dclose(volume->imin_id);
-  }
-  if (volume->ftype_id > 0) {
-    H5Tclose(volume->ftype_id);
-  }
-  if (volume->mtype_id > 0) {
-    H5Tclose(volume->mtype_id);
-  }
+  mifree_hyperslab_cache(volume);
+  mifree_slice_ranges(volume);
+  mirelease_volume_mapping(volume);
+  mifree_label_dictionary(volume);
+  mifree_label_index(volume);
+
+  mirelease_volume_image(volume);
   if (volume->plist_id > 0) {
     H5Pclose(volume->plist_id);
   }
+  if (volume->thumb_file_id >= 0) {
+    H5Fclose(volume->thumb_file_id);
+  }
   if (_hdf_close(volume->hdf_id) < 0) {
     return (MI_ERROR);
   }
-  if (volume->dim_handles != NULL) {
-    
-    for(i=0;i<volume->number_of_dims;i++)
-    {
-      mifree_dimension_handle(volume->dim_handles[i]);
-    }
-    
-    free(volume->dim_handles);
-  }
-  if (volume->dim_indices != NULL) {
-    free(volume->dim_indices);
-  }
   if (volume->create_props != NULL) {
     mifree_volume_props(volume->create_props);
   }
   
   free(volume);
 
+  return (result);
+}
+
+/** Set the HDF5 chunk cache used to read and write the image of a
+  * volume.  A cache able to hold all the chunks which one access
+  * touches avoids decompressing them again for the next access.
+  * \param volume The volume handle
+  * \param cache_size The size of the cache in bytes, or 0 for the default
+  * \param cache_slots The number of hash slots, preferably a prime about
+  *  100 times the number of chunks held, or 0 for the default
+  * \param preemption Between 0 and 1, how readily chunks which have been
+  *  read completely are evicted first, or a negative value for the default
+  *  \ingroup mi2Vol
+*/
+int miset_volume_chunk_cache(mihandle_t volume, size_t cache_size,
+                             size_t cache_slots, double preemption)
+{
+  char path[MI2_MAX_PATH];
+  hid_t dapl_id;
+  hid_t dset_id;
+  hid_t grp_id;
+
+  if (volume == NULL || preemption > 1.0) {
+    return (MI_ERROR);
+  }
+  if (miload_volume_image(volume) < 0 || volume->image_id < 0) {
+    return (MI_ERROR);
+  }
+
+  /* The image reopened is that of the selected resolution. */
+  if (volume->selected_resolution == 0) {
+    grp_id = H5Gopen2(volume->hdf_id, MI_ROOT_PATH "/image", H5P_DEFAULT);
+  } else {
+    grp_id = minc_select_thumbnail(volume, volume->selected_resolution);
+  }
+  if (grp_id < 0) {
+    return (MI_ERROR);
+  }
+  sprintf(path, "%d/image", volume->selected_resolution);
+
+  dapl_id = H5Pcreate(H5P_DATASET_ACCESS);
+  if (dapl_id < 0) {
+    H5Gclose(grp_id);
+    return MI_LOG_ERROR(MI2_MSG_HDF5,"H5Pcreate");
+  }
+  H5Pset_chunk_cache(dapl_id,
+                     (cache_slots != 0) ? cache_slots : H5D_CHUNK_CACHE_NSLOTS_DEFAULT,
+                     (cache_size != 0) ? cache_size : H5D_CHUNK_CACHE_NBYTES_DEFAULT,
+                     (preemption >= 0.0) ? preemption : H5D_CHUNK_CACHE_W0_DEFAULT);
+
+  /* The cache belongs to the open dataset, so the image is closed, which
+    writes back its cached chunks, and opened again with the new cache.
+  */
+  H5Dclose(volume->image_id);
+  dset_id = H5Dopen2(grp_id, path, dapl_id);
+  H5Pclose(dapl_id);
+  if (dset_id < 0) {
+    volume->image_id = H5Dopen2(grp_id, path, H5P_DEFAULT);
+  } else {
+    volume->image_id = dset_id;
+  }
+  H5Gclose(grp_id);
+
+  /* Cached dataspaces belong to the dataset closed. */
+  mifree_hyperslab_cache(volume);
+
+  if (dset_id < 0) {
+    return MI_LOG_ERROR(MI2_MSG_HDF5,"H5Dopen2");
+  }
+  return (MI_NOERROR);
+}
+
+/** Get the HDF5 chunk cache settings of the image of a volume.
+  * \param volume The volume handle
+  * \param cache_size Returns the size of the cache in bytes
+  * \param cache_slots Returns the number of hash slots
+  * \param preemption Returns the preemption policy
+  *  \ingroup mi2Vol
+*/
+int miget_volume_chunk_cache(mihandle_t volume, size_t *cache_size,
+                             size_t *cache_slots, double *preemption)
+{
+  hid_t dapl_id;
+  herr_t stat;
+
+  if (volume == NULL) {
+    return (MI_ERROR);
+  }
+  if (miload_volume_image(volume) < 0 || volume->image_id < 0) {
+    return (MI_ERROR);
+  }
+  MI_CHECK_HDF_CALL_RET(dapl_id = H5Dget_access_plist(volume->image_id),"H5Dget_access_plist")
+  stat = H5Pget_chunk_cache(dapl_id, cache_slots, cache_size, preemption);
+  H5Pclose(dapl_id);
+  MI_CHECK_HDF_CALL_RET(stat,"H5Pget_chunk_cache")
+  return (MI_NOERROR);
+}
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_SYSCONF)
+/** \internal
+ * Maps the current image of a volume, after checking that its voxels are
+ * stored in the file exactly as they are laid out in memory.
+ */
+static int mimap_volume_image(mihandle_t volume)
+{
+  hsize_t dims[MI2_MAX_VAR_DIMS];
+  hid_t dcpl_id, file_id, fapl_id, type_id, native_id, space_id;
+  haddr_t offset;
+  H5D_layout_t layout;
+  H5T_class_t type_class;
+  htri_t is_native;
+  size_t length;
+  size_t delta;
+  void *base;
+  int *fd = NULL;
+  int ndims;
+  int i;
+
+  MI_CHECK_HDF_CALL_RET(dcpl_id = H5Dget_create_plist(volume->image_id),"H5Dget_create_plist")
+  layout = H5Pget_layout(dcpl_id);
+  H5Pclose(dcpl_id);
+  if (layout != H5D_CONTIGUOUS) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Only a contiguous image can be mapped");
+  }
+
+  MI_CHECK_HDF_CALL_RET(type_id = H5Dget_type(volume->image_id),"H5Dget_type")
+  type_class = H5Tget_class(type_id);
+  length = H5Tget_size(type_id);
+  native_id = H5Tget_native_type(type_id, H5T_DIR_ASCEND);
+  is_native = (native_id >= 0) ? H5Tequal(type_id, native_id) : FALSE;
+  if (native_id >= 0) {
+    H5Tclose(native_id);
+  }
+  H5Tclose(type_id);
+  if ((type_class != H5T_INTEGER && type_class != H5T_FLOAT) || is_native <= 0) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"Only an image of a native numeric type can be mapped");
+  }
+
+  /* The voxels are read directly from the file, so it must be a plain
+   * file; the lower resolutions of a read-only volume live in memory.
+   */
+  MI_CHECK_HDF_CALL_RET(file_id = H5Iget_file_id(volume->image_id),"H5Iget_file_id")
+  fapl_id = H5Fget_access_plist(file_id);
+  if (fapl_id < 0 || H5Pget_driver(fapl_id) != H5FD_SEC2 ||
+      H5Fget_vfd_handle(file_id, fapl_id, (void **) &fd) < 0) {
+    fd = NULL;
+  }
+  if (fapl_id >= 0) {
+    H5Pclose(fapl_id);
+  }
+
+  /* Voxels written through HDF5 may still be in its buffers. */
+  if (fd != NULL && (volume->mode & MI2_OPEN_RDWR)) {
+    H5Fflush(file_id, H5F_SCOPE_LOCAL);
+  }
+  H5Fclose(file_id);
+  if (fd == NULL) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"The file of the image can't be mapped");
+  }
+
+  offset = H5Dget_offset(volume->image_id);
+  if (offset == HADDR_UNDEF) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"The image has no storage to map");
+  }
+
+  MI_CHECK_HDF_CALL_RET(space_id = H5Dget_space(volume->image_id),"H5Dget_space")
+  ndims = H5Sget_simple_extent_dims(space_id, dims, NULL);
+  H5Sclose(space_id);
+  for (i = 0; i < ndims; i++) {
+    length *= dims[i];
+  }
+
+  /* The mapping must start on a page boundary. */
+  delta = (size_t) (offset % (haddr_t) sysconf(_SC_PAGESIZE));
+  base = mmap(NULL, length + delta, PROT_READ, MAP_SHARED, *fd,
+              (off_t) (offset - delta));
+  if (base == MAP_FAILED) {
+    return MI_LOG_ERROR(MI2_MSG_GENERIC,"mmap failed");
+  }
+  volume->map_base = base;
+  volume->map_length = length + delta;
+  volume->map_data = (char *) base + delta;
+  volume->map_resolution = volume->selected_resolution;
+  return (MI_NOERROR);
+}
+#endif /* HAVE_MMAP */
+
+/** Map the image of a volume into memory, read-only, so that its voxels
+  * can be read without being copied.  This is only possible for an image
+  * stored contiguously and uncompressed, in the native byte order, in a
+  * file opened with the default HDF5 file driver.  The voxels are the
+  * values stored in the file, of the type returned by miget_data_type(),
+  * with the dimensions in file order.  Changes made through a volume
+  * opened for writing appear in the mapping once they are flushed.
+  * \param volume The volume handle
+  * \param data Returns a pointer to the first voxel, valid until
+  *  mirelease_volume_mapping() or miclose_volume()
+  * \param strides If not NULL, returns the distance in bytes between
+  *  neighbouring voxels along each dimension, in file order
+  * \return MI_ERROR if the image can't be mapped, in which case it must be
+  *  read with the hyperslab functions
+  *  \ingroup mi2Vol
+*/
+int miget_volume_mapping(mihandle_t volume, const void **data,
+                         misize_t strides[])
+{
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_SYSCONF)
+  hsize_t dims[MI2_MAX_VAR_DIMS];
+  hid_t space_id;
+  misize_t stride;
+  int ndims;
+  int i;
+
+  if (volume == NULL || data == NULL) {
+    return (MI_ERROR);
+  }
+  if (miload_volume_image(volume) < 0 || volume->image_id < 0) {
+    return (MI_ERROR);
+  }
+
+  /* A mapping belongs to the resolution selected when it was made. */
+  if (volume->map_base != NULL &&
+      volume->map_resolution != volume->selected_resolution) {
+    mirelease_volume_mapping(volume);
+  }
+  if (volume->map_base == NULL && mimap_volume_image(volume) < 0) {
+    return (MI_ERROR);
+  }
+  *data = volume->map_data;
+
+  if (strides != NULL) {
+    MI_CHECK_HDF_CALL_RET(space_id = H5Dget_space(volume->image_id),"H5Dget_space")
+    ndims = H5Sget_simple_extent_dims(space_id, dims, NULL);
+    H5Sclose(space_id);
+
+    stride = H5Tget_size(volume->ftype_id);
+    for (i = ndims - 1; i >= 0; i--) {
+      strides[i] = stride;
+      stride *= dims[i];
+    }
+  }
+  return (MI_NOERROR);
+#else
+  return MI_LOG_ERROR(MI2_MSG_GENERIC,"Memory mapping is not supported");
+#endif /* HAVE_MMAP */
+}
+
+/** Release the mapping of the image of a volume made by
+  * miget_volume_mapping(), which miclose_volume() otherwise does.
+  * \param volume The volume handle
+  *  \ingroup mi2Vol
+*/
+int mirelease_volume_mapping(mihandle_t volume)
+{
+  if (volume == NULL) {
+    return (MI_ERROR);
+  }
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_SYSCONF)
+  if (volume->map_base != NULL) {
+    munmap(volume->map_base, volume->map_length);
+  }
+#endif /* HAVE_MMAP */
+  volume->map_base = NULL;
+  volume->map_data = NULL;
+  volume->map_length = 0;
   return (MI_NOERROR);
 }
 
 
 
+
 /** \internal
 */
 void miinit_default_range(mitype_t mitype, double *valid_max, double *valid_min)
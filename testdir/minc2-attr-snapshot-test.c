@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "minc2.h"
+
+/* Reads the attributes of a volume with a large DICOM-like group one at a
+ * time and as a snapshot, and copies them to a second volume attribute by
+ * attribute and with micopy_attr, comparing the times and the results.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define N_ATTRS 1000
+#define N_READS 5
+
+#define FILENAME "attr-snapshot.mnc"
+#define COPY1_FILENAME "attr-snapshot-copy1.mnc"
+#define COPY2_FILENAME "attr-snapshot-copy2.mnc"
+#define DICOM_PATH "/dicom_0x0018"
+#define JSON_START "{\"dicom_0x0018\":{\"el_0x0000\":\"value \\\"0\\\"\\tof\\\\element\","
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static mihandle_t create_volume(const char *filename)
+{
+  static const char *names[3] = { "zspace", "yspace", "xspace" };
+  midimhandle_t hdim[3];
+  mihandle_t hvol;
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    micreate_dimension(names[i], MI_DIMCLASS_SPATIAL,
+                       MI_DIMATTR_REGULARLY_SAMPLED, 4, &hdim[i]);
+  }
+  if (micreate_volume(filename, 3, hdim, MI_TYPE_SHORT, MI_CLASS_REAL,
+                      NULL, &hvol) < 0) {
+    TESTRPT("failed to create volume", 0);
+    return NULL;
+  }
+  micreate_volume_image(hvol);
+  return hvol;
+}
+
+static void create_test_file(void)
+{
+  mihandle_t hvol = create_volume(FILENAME);
+  char name[32];
+  char text[64];
+  double vec[3];
+  int i;
+
+  if (hvol == NULL) {
+    return;
+  }
+  for (i = 0; i < N_ATTRS; i++) {
+    sprintf(name, "el_0x%04x", i);
+    switch (i % 3) {
+    case 0:
+      sprintf(text, "value \"%d\"\tof\\element", i);
+      miset_attr_values(hvol, MI_TYPE_STRING, DICOM_PATH, name,
+                        strlen(text) + 1, text);
+      break;
+    case 1:
+      vec[0] = i;
+      vec[1] = i * 0.5;
+      vec[2] = -i;
+      miset_attr_values(hvol, MI_TYPE_DOUBLE, DICOM_PATH, name, 3, vec);
+      break;
+    default:
+      miset_attr_values(hvol, MI_TYPE_INT, DICOM_PATH, name, 1, &i);
+      break;
+    }
+  }
+  miset_attr_values(hvol, MI_TYPE_STRING, "/patient", "full_name",
+                    strlen("Doe^Jane") + 1, "Doe^Jane");
+  vec[0] = 2.5;
+  miset_attr_values(hvol, MI_TYPE_DOUBLE, "/acquisition", "slice_thickness",
+                    1, vec);
+  miclose_volume(hvol);
+}
+
+/* Reads every attribute through the milist and miget_attr_values
+ * functions, as applications do now.
+ */
+static int read_one_by_one(mihandle_t hvol)
+{
+  milisthandle_t hlist;
+  char name[256];
+  char value[256];
+  double values[8];
+  mitype_t type;
+  size_t length;
+  int n = 0;
+
+  if (milist_start(hvol, DICOM_PATH, 0, &hlist) < 0) {
+    TESTRPT("failed to list attributes", 0);
+    return 0;
+  }
+  while (milist_attr_next(hvol, hlist, value, sizeof(value),
+                          name, sizeof(name)) == MI_NOERROR) {
+    miget_attr_type(hvol, DICOM_PATH, name, &type);
+    miget_attr_length(hvol, DICOM_PATH, name, &length);
+    if (type == MI_TYPE_STRING) {
+      miget_attr_values(hvol, type, DICOM_PATH, name, sizeof(value), value);
+    } else {
+      miget_attr_values(hvol, MI_TYPE_DOUBLE, DICOM_PATH, name, length, values);
+    }
+    n++;
+  }
+  milist_finish(hlist);
+  return n;
+}
+
+/* Copies every attribute by hand, as micopy_attr used to. */
+static void copy_one_by_one(mihandle_t hvol, mihandle_t hcopy)
+{
+  milisthandle_t hlist;
+  char name[256];
+  char value[256];
+  double values[8];
+  mitype_t type;
+  size_t length;
+
+  milist_start(hvol, DICOM_PATH, 0, &hlist);
+  while (milist_attr_next(hvol, hlist, value, sizeof(value),
+                          name, sizeof(name)) == MI_NOERROR) {
+    miget_attr_type(hvol, DICOM_PATH, name, &type);
+    miget_attr_length(hvol, DICOM_PATH, name, &length);
+    if (type == MI_TYPE_STRING) {
+      miget_attr_values(hvol, type, DICOM_PATH, name, sizeof(value), value);
+      miset_attr_values(hcopy, type, DICOM_PATH, name, length, value);
+    } else {
+      miget_attr_values(hvol, type, DICOM_PATH, name, length, values);
+      miset_attr_values(hcopy, type, DICOM_PATH, name, length, values);
+    }
+  }
+  milist_finish(hlist);
+}
+
+static void check_snapshot(miattrsnapshot_t snapshot)
+{
+  const char *path, *name;
+  const void *values;
+  mitype_t type;
+  size_t length;
+  char *json;
+  char *p;
+  int count, index, depth, in_string;
+
+  /* The group also holds its "vartype" attribute. */
+  if (miget_snapshot_attr_count(snapshot, &count) < 0 || count != N_ATTRS + 1) {
+    TESTRPT("wrong attribute count", count);
+  }
+  if (mifind_snapshot_attr(snapshot, DICOM_PATH, "el_0x0007", &index) < 0 ||
+      miget_snapshot_attr(snapshot, index, &path, &name, &type, &length,
+                          &values) < 0) {
+    TESTRPT("failed to find attribute", 7);
+  } else if (type != MI_TYPE_DOUBLE || length != 3 ||
+             ((const double *) values)[1] != 3.5 ||
+             strcmp(name, "el_0x0007") != 0) {
+    TESTRPT("wrong attribute", (int) type);
+  }
+  if (mifind_snapshot_attr(snapshot, "dicom_0x0018", "el_0x03e8", &index) >= 0) {
+    TESTRPT("found attribute which does not exist", index);
+  }
+  if (mifind_snapshot_attr(snapshot, "dicom_0x0018", "el_0x03e4", &index) < 0 ||
+      miget_snapshot_attr(snapshot, index, NULL, NULL, &type, &length,
+                          &values) < 0 ||
+      type != MI_TYPE_STRING ||
+      strcmp((const char *) values, "value \"996\"\tof\\element") != 0 ||
+      length != strlen((const char *) values) + 1) {
+    TESTRPT("wrong string attribute", index);
+  }
+
+  if (miget_snapshot_json(snapshot, &json) < 0) {
+    TESTRPT("failed to write JSON", 0);
+    return;
+  }
+  if (strncmp(json, JSON_START, strlen(JSON_START)) != 0 ||
+      strstr(json, "\"el_0x0007\":[7,3.5,-7]") == NULL ||
+      strstr(json, "\"el_0x03e4\":\"value \\\"996\\\"\\tof\\\\element\"") == NULL) {
+    TESTRPT("wrong JSON", 0);
+  }
+  depth = 0;
+  in_string = 0;
+  for (p = json; *p != '\0'; p++) {
+    if (in_string) {
+      if (*p == '\\') {
+        p++;
+      } else if (*p == '"') {
+        in_string = 0;
+      }
+    } else if (*p == '"') {
+      in_string = 1;
+    } else if (*p == '{') {
+      depth++;
+    } else if (*p == '}') {
+      depth--;
+    }
+  }
+  if (depth != 0 || in_string) {
+    TESTRPT("unbalanced JSON", depth);
+  }
+  free(json);
+}
+
+static void check_copy(const char *filename)
+{
+  miattrsnapshot_t original, copy;
+  const char *name1, *name2;
+  const void *values1, *values2;
+  mitype_t type1, type2;
+  size_t length1, length2;
+  mihandle_t hvol, hcopy;
+  int count1, count2, i;
+
+  miopen_volume(FILENAME, MI2_OPEN_READ, &hvol);
+  if (miopen_volume(filename, MI2_OPEN_READ, &hcopy) < 0) {
+    TESTRPT("failed to open copy", 0);
+    miclose_volume(hvol);
+    return;
+  }
+  if (miget_attr_snapshot(hvol, DICOM_PATH, &original) < 0 ||
+      miget_attr_snapshot(hcopy, DICOM_PATH, &copy) < 0) {
+    TESTRPT("failed to read copy", 0);
+  } else {
+    miget_snapshot_attr_count(original, &count1);
+    miget_snapshot_attr_count(copy, &count2);
+    if (count1 != count2) {
+      TESTRPT("wrong number of copied attributes", count2);
+    }
+    for (i = 0; i < count1 && i < count2; i++) {
+      miget_snapshot_attr(original, i, NULL, &name1, &type1, &length1, &values1);
+      miget_snapshot_attr(copy, i, NULL, &name2, &type2, &length2, &values2);
+      if (strcmp(name1, name2) != 0 || type1 != type2 || length1 != length2 ||
+          memcmp(values1, values2,
+                 type1 == MI_TYPE_STRING ? length1 :
+                 length1 * (type1 == MI_TYPE_INT ? sizeof(int) : sizeof(double))) != 0) {
+        TESTRPT("copied attribute differs", i);
+        break;
+      }
+    }
+    mifree_attr_snapshot(original);
+    mifree_attr_snapshot(copy);
+  }
+  miclose_volume(hcopy);
+  miclose_volume(hvol);
+}
+
+int main(void)
+{
+  miattrsnapshot_t snapshot;
+  mihandle_t hvol, hcopy;
+  double t0, t_list, t_snap, t_copy_list, t_copy_snap;
+  char name[64];
+  double thickness;
+  int i, n = 0;
+
+  create_test_file();
+
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open volume", 0);
+    return error_cnt;
+  }
+
+  t0 = now();
+  for (i = 0; i < N_READS; i++) {
+    n = read_one_by_one(hvol);
+  }
+  t_list = (now() - t0) / N_READS;
+  if (n != N_ATTRS + 1) {
+    TESTRPT("wrong number of listed attributes", n);
+  }
+
+  t0 = now();
+  for (i = 0; i < N_READS; i++) {
+    if (miget_attr_snapshot(hvol, DICOM_PATH, &snapshot) < 0) {
+      TESTRPT("failed to read snapshot", i);
+      break;
+    }
+    if (i < N_READS - 1) {
+      mifree_attr_snapshot(snapshot);
+    }
+  }
+  t_snap = (now() - t0) / N_READS;
+  if (i == N_READS) {
+    check_snapshot(snapshot);
+    mifree_attr_snapshot(snapshot);
+  }
+  printf("read %d attributes: one by one %.2f ms, snapshot %.2f ms (%.1fx)\n",
+         N_ATTRS, t_list * 1e3, t_snap * 1e3, t_list / t_snap);
+
+  /* A snapshot of the whole info group reaches every group below it. */
+  if (miget_attr_snapshot(hvol, "", &snapshot) < 0) {
+    TESTRPT("failed to read info snapshot", 0);
+  } else {
+    int index;
+    const void *values;
+
+    if (mifind_snapshot_attr(snapshot, "/patient", "full_name", &index) < 0 ||
+        miget_snapshot_attr(snapshot, index, NULL, NULL, NULL, NULL,
+                            &values) < 0 ||
+        strcmp((const char *) values, "Doe^Jane") != 0) {
+      TESTRPT("wrong patient name in info snapshot", 0);
+    }
+    if (mifind_snapshot_attr(snapshot, "/dicom_0x0018", "el_0x0001", &index) < 0) {
+      TESTRPT("missing DICOM attribute in info snapshot", 0);
+    }
+    mifree_attr_snapshot(snapshot);
+  }
+
+  hcopy = create_volume(COPY1_FILENAME);
+  t0 = now();
+  copy_one_by_one(hvol, hcopy);
+  t_copy_list = now() - t0;
+  miclose_volume(hcopy);
+
+  hcopy = create_volume(COPY2_FILENAME);
+  t0 = now();
+  if (micopy_attr(hvol, DICOM_PATH, hcopy) < 0) {
+    TESTRPT("failed to copy attributes", 0);
+  }
+  t_copy_snap = now() - t0;
+  micopy_attr(hvol, "/patient", hcopy);
+  micopy_attr(hvol, "/acquisition", hcopy);
+  miclose_volume(hcopy);
+  printf("copy %d attributes: one by one %.2f ms, micopy_attr %.2f ms (%.1fx)\n",
+         N_ATTRS, t_copy_list * 1e3, t_copy_snap * 1e3,
+         t_copy_list / t_copy_snap);
+  miclose_volume(hvol);
+
+  check_copy(COPY1_FILENAME);
+  check_copy(COPY2_FILENAME);
+
+  miopen_volume(COPY2_FILENAME, MI2_OPEN_READ, &hcopy);
+  if (miget_attr_values(hcopy, MI_TYPE_STRING, "/patient", "full_name",
+                        sizeof(name), name) < 0 ||
+      strcmp(name, "Doe^Jane") != 0) {
+    TESTRPT("wrong copied patient name", 0);
+  }
+  if (miget_attr_values(hcopy, MI_TYPE_DOUBLE, "/acquisition",
+                        "slice_thickness", 1, &thickness) < 0 ||
+      thickness != 2.5) {
+    TESTRPT("wrong copied slice thickness", 0);
+  }
+  miclose_volume(hcopy);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
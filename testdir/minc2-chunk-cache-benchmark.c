@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "minc2.h"
+
+/* Reads voxel time series of a compressed 4D volume, which cross the
+ * chunks along the time axis, with the default HDF5 chunk cache, with a
+ * cache set through MINC_CHUNK_CACHE_KB and with a cache set by
+ * miset_volume_chunk_cache(), and checks that all three read the same
+ * values.  Given -benchmark, it reads many more series and prints how
+ * long each cache takes.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NT 60
+#define NZ 32
+#define NY 64
+#define NX 64
+#define NDIMS 4
+#define N_SERIES_Y 8
+#define N_SERIES_X 16
+#define N_CHECKED_SERIES 4
+#define CACHE_BYTES (64 << 20)
+
+#define FILENAME "chunk-cache-benchmark.mnc"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void create_test_file(void)
+{
+  static const char *names[NDIMS] = { "time", "zspace", "yspace", "xspace" };
+  static const misize_t lengths[NDIMS] = { NT, NZ, NY, NX };
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  mivolumeprops_t props;
+  misize_t start[NDIMS] = { 0, 0, 0, 0 };
+  misize_t count[NDIMS] = { NT, NZ, NY, NX };
+  short *buf;
+  int t, i;
+
+  for (i = 0; i < NDIMS; i++) {
+    micreate_dimension(names[i], i == 0 ? MI_DIMCLASS_TIME : MI_DIMCLASS_SPATIAL,
+                       MI_DIMATTR_REGULARLY_SAMPLED, lengths[i], &hdim[i]);
+  }
+
+  /* The default blocking of 32 along every dimension. */
+  minew_volume_props(&props);
+  miset_props_compression_type(props, MI_COMPRESS_ZLIB);
+  micreate_volume(FILENAME, NDIMS, hdim, MI_TYPE_SHORT, MI_CLASS_REAL,
+                  props, &hvol);
+  micreate_volume_image(hvol);
+  mifree_volume_props(props);
+
+  /* Written at once, so that each chunk is compressed only once. */
+  buf = (short *) malloc(NT * NZ * NY * NX * sizeof(short));
+  for (t = 0; t < NT; t++) {
+    short *slice = buf + t * NZ * NY * NX;
+
+    for (i = 0; i < NZ * NY * NX; i++) {
+      slice[i] = (short)((i % NX) * 7 + (i / NX % NY) * 3 + t * 11 + i % 5);
+    }
+  }
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count, buf) < 0) {
+    TESTRPT("failed to write test image", 0);
+  }
+  free(buf);
+  miclose_volume(hvol);
+}
+
+/* Reads the time series of the first n_series voxels of a block of
+ * N_SERIES_Y by N_SERIES_X, one voxel at a time.
+ */
+static double read_series(mihandle_t hvol, int n_series, short *series)
+{
+  misize_t start[NDIMS] = { 0, NZ / 2, 0, 0 };
+  misize_t count[NDIMS] = { NT, 1, 1, 1 };
+  double t0 = now();
+  int i;
+
+  for (i = 0; i < n_series; i++) {
+    start[2] = i / N_SERIES_X;
+    start[3] = i % N_SERIES_X;
+    if (miget_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                    series) < 0) {
+      TESTRPT("failed to read time series", i);
+    }
+    series += NT;
+  }
+  return now() - t0;
+}
+
+int main(int argc, char **argv)
+{
+  int run_benchmarks = (argc > 1 && strcmp(argv[1], "-benchmark") == 0);
+  int n_series = run_benchmarks ? N_SERIES_Y * N_SERIES_X : N_CHECKED_SERIES;
+  size_t nbytes = n_series * NT * sizeof(short);
+  short *reference = (short *) malloc(nbytes);
+  short *series = (short *) malloc(nbytes);
+  size_t cache_size, cache_slots;
+  double preemption;
+  mihandle_t hvol;
+  double t;
+
+  create_test_file();
+
+  /* Default cache: each chunk is larger than the cache. */
+  unsetenv("MINC_CHUNK_CACHE_KB");
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open image", 0);
+    return (error_cnt);
+  }
+  t = read_series(hvol, n_series, reference);
+  if (run_benchmarks) {
+    printf("%-26s %8.3f s\n", "default cache:", t);
+  }
+  miclose_volume(hvol);
+
+  /* Cache from the environment. */
+  setenv("MINC_CHUNK_CACHE_KB", "65536", 1);
+  miopen_volume(FILENAME, MI2_OPEN_READ, &hvol);
+  if (miget_volume_chunk_cache(hvol, &cache_size, &cache_slots, &preemption) < 0 ||
+      cache_size != CACHE_BYTES) {
+    TESTRPT("environment cache size not used", (int) (cache_size >> 10));
+  }
+  t = read_series(hvol, n_series, series);
+  if (run_benchmarks) {
+    printf("%-26s %8.3f s\n", "MINC_CHUNK_CACHE_KB:", t);
+  }
+  if (memcmp(series, reference, nbytes) != 0) {
+    TESTRPT("reads differ with the environment cache", 0);
+  }
+  miclose_volume(hvol);
+  unsetenv("MINC_CHUNK_CACHE_KB");
+
+  /* Cache set on the volume. */
+  miopen_volume(FILENAME, MI2_OPEN_READ, &hvol);
+  if (miset_volume_chunk_cache(hvol, CACHE_BYTES, 1009, 0.75) < 0 ||
+      miget_volume_chunk_cache(hvol, &cache_size, &cache_slots, &preemption) < 0 ||
+      cache_size != CACHE_BYTES || cache_slots != 1009 || preemption != 0.75) {
+    TESTRPT("failed to set volume cache", (int) (cache_size >> 10));
+  }
+  memset(series, 0, nbytes);
+  t = read_series(hvol, n_series, series);
+  if (run_benchmarks) {
+    printf("%-26s %8.3f s\n", "miset_volume_chunk_cache:", t);
+  }
+  if (memcmp(series, reference, nbytes) != 0) {
+    TESTRPT("reads differ with the volume cache", 0);
+  }
+  miclose_volume(hvol);
+
+  free(reference);
+  free(series);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "minc2.h"
+
+/* Writes a volume with each compression codec and checks that it reads
+ * back unchanged, that the codec is reported by the volume properties,
+ * and that the parallel chunk I/O, which encodes and decodes the chunks
+ * itself, agrees with the HDF5 filters.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define CZ 40
+#define CY 60
+#define CX 70
+#define NDIMS 3
+#define NTHREADS 4
+#define NVOXELS (CZ * CY * CX)
+
+#define FILENAME "codec-test.mnc"
+
+static const micompression_t codecs[] = {
+  MI_COMPRESS_NONE,
+  MI_COMPRESS_ZLIB,
+  MI_COMPRESS_SHUFFLE_ZLIB,
+  MI_COMPRESS_LZ4,
+  MI_COMPRESS_SHUFFLE_LZ4,
+  MI_COMPRESS_RLE
+};
+
+static void create_test_file(micompression_t codec, int nthreads,
+                             const short *buf)
+{
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  mivolumeprops_t props;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { CZ, CY, CX };
+  int edges[NDIMS] = { 16, 16, 16 };
+
+  micreate_dimension("zspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CZ, &hdim[0]);
+  micreate_dimension("yspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CY, &hdim[1]);
+  micreate_dimension("xspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CX, &hdim[2]);
+
+  minew_volume_props(&props);
+  if (miset_props_compression_type(props, codec) < 0) {
+    TESTRPT("failed to set compression type", codec);
+  }
+  if (codec != MI_COMPRESS_NONE) {
+    miset_props_blocking(props, NDIMS, edges);
+  }
+
+  micreate_volume(FILENAME, NDIMS, hdim, MI_TYPE_SHORT,
+                  MI_CLASS_REAL, props, &hvol);
+  micreate_volume_image(hvol);
+  miset_volume_valid_range(hvol, 32767.0, -32768.0);
+  miset_volume_range(hvol, 10.0, -10.0);
+  mifree_volume_props(props);
+
+  miset_volume_io_threads(hvol, nthreads);
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  (void *) buf) < 0) {
+    TESTRPT("failed to write test image", codec);
+  }
+  miclose_volume(hvol);
+}
+
+static void check_file(micompression_t codec, const short *buf)
+{
+  static const misize_t start[NDIMS] = { 0, 0, 0 };
+  static const misize_t count[NDIMS] = { CZ, CY, CX };
+  static const misize_t part_start[NDIMS] = { 5, 11, 23 };
+  static const misize_t part_count[NDIMS] = { 30, 40, 41 };
+  short *serial = (short *) malloc(NVOXELS * sizeof(short));
+  short *parallel = (short *) malloc(NVOXELS * sizeof(short));
+  mivolumeprops_t props;
+  micompression_t stored = -1;
+  mihandle_t hvol;
+
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open image", codec);
+    free(serial);
+    free(parallel);
+    return;
+  }
+
+  if (miget_volume_props(hvol, &props) < 0 ||
+      miget_props_compression_type(props, &stored) < 0 || stored != codec) {
+    TESTRPT("wrong compression type reported", stored);
+  } else {
+    mifree_volume_props(props);
+  }
+
+  if (miget_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  serial) < 0) {
+    TESTRPT("failed to read image", codec);
+  } else if (memcmp(serial, buf, NVOXELS * sizeof(short)) != 0) {
+    TESTRPT("image differs from the values written", codec);
+  }
+
+  miset_volume_io_threads(hvol, NTHREADS);
+  if (miget_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  parallel) < 0) {
+    TESTRPT("failed to read image with threads", codec);
+  } else if (memcmp(parallel, buf, NVOXELS * sizeof(short)) != 0) {
+    TESTRPT("threaded read differs from the values written", codec);
+  }
+
+  /* Edge chunks of a partial hyperslab. */
+  miset_volume_io_threads(hvol, 0);
+  miget_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, part_start, part_count,
+                              serial);
+  miset_volume_io_threads(hvol, NTHREADS);
+  miget_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, part_start, part_count,
+                              parallel);
+  if (memcmp(serial, parallel, 30 * 40 * 41 * sizeof(short)) != 0) {
+    TESTRPT("threaded partial read differs", codec);
+  }
+
+  miclose_volume(hvol);
+  free(serial);
+  free(parallel);
+}
+
+int main(void)
+{
+  short *buf = (short *) malloc(NVOXELS * sizeof(short));
+  int i, j;
+
+  /* Smooth, MR-like values with some noise in the low byte. */
+  for (i = 0; i < NVOXELS; i++) {
+    int x = i % CX, y = (i / CX) % CY, z = i / (CX * CY);
+    buf[i] = (short)(((x - CX / 2) * (x - CX / 2) + (y - CY / 2) * (y - CY / 2) +
+                      z * 40) * 3 + (i * 7919) % 13);
+  }
+
+  for (i = 0; i < (int)(sizeof(codecs) / sizeof(codecs[0])); i++) {
+    for (j = 0; j < 2; j++) {
+      create_test_file(codecs[i], j ? NTHREADS : 0, buf);
+      check_file(codecs[i], buf);
+    }
+  }
+
+  free(buf);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
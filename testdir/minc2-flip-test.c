@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "minc2.h"
+#include "restructure.h"
+
+/* Checks the read path for volumes whose dimensions are flipped but not
+ * permuted. For every combination of flipped dimensions, a hyperslab
+ * read through the flipped volume must match the same hyperslab read in
+ * file order and then restructured with restructure_array().
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+/* Large enough that a whole-volume read needs several blocks. */
+#define CZ 40
+#define CY 100
+#define CX 150
+#define NDIMS 3
+
+#define FILENAME "flip-test.mnc"
+
+static void create_test_file(void)
+{
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  short *buf = (short *) malloc(CX * CY * CZ * sizeof(short));
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { CZ, CY, CX };
+  int i;
+
+  micreate_dimension("zspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CZ, &hdim[0]);
+  micreate_dimension("yspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CY, &hdim[1]);
+  micreate_dimension("xspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CX, &hdim[2]);
+
+  micreate_volume(FILENAME, NDIMS, hdim, MI_TYPE_SHORT,
+                  MI_CLASS_REAL, NULL, &hvol);
+  micreate_volume_image(hvol);
+
+  for (i = 0; i < CZ * CY * CX; i++) {
+    buf[i] = (short)(i * 7 + i / CX);
+  }
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count, buf) < 0) {
+    TESTRPT("failed to write test image", 0);
+  }
+
+  miclose_volume(hvol);
+  free(buf);
+}
+
+/* Reads start/count from the volume with the dimensions flipped as in
+ * flip_mask, and compares against the file order read restructured in
+ * memory.
+ */
+static void check_flipped_read(int flip_mask, const misize_t start[],
+                               const misize_t count[])
+{
+  mihandle_t vol;
+  midimhandle_t dim[NDIMS];
+  misize_t file_start[NDIMS];
+  size_t lengths[NDIMS];
+  int map[NDIMS];
+  int dir[NDIMS];
+  size_t total = 1;
+  short *expected, *actual;
+  int i;
+
+  for (i = 0; i < NDIMS; i++) {
+    total *= count[i];
+  }
+  expected = (short *) malloc(total * sizeof(short));
+  actual = (short *) malloc(total * sizeof(short));
+
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &vol) < 0) {
+    TESTRPT("failed to open image", flip_mask);
+    free(expected);
+    free(actual);
+    return;
+  }
+  miget_volume_dimensions(vol, MI_DIMCLASS_ANY, MI_DIMATTR_ALL,
+                          MI_DIMORDER_FILE, NDIMS, dim);
+  for (i = 0; i < NDIMS; i++) {
+    misize_t length;
+
+    miget_dimension_size(dim[i], &length);
+    if (flip_mask & (1 << i)) {
+      /* The flipped hyperslab covers the mirror image in the file. */
+      file_start[i] = length - start[i] - count[i];
+      dir[i] = -1;
+    } else {
+      file_start[i] = start[i];
+      dir[i] = 1;
+    }
+    lengths[i] = count[i];
+    map[i] = i;
+  }
+
+  /* Current path: file order read, then restructure in memory. */
+  if (miget_voxel_value_hyperslab(vol, MI_TYPE_SHORT, file_start, count,
+                                  expected) < 0) {
+    TESTRPT("failed to read file order hyperslab", flip_mask);
+  }
+  restructure_array(NDIMS, (unsigned char *) expected, lengths,
+                    sizeof(short), map, dir);
+
+  /* Flip-only path. */
+  for (i = 0; i < NDIMS; i++) {
+    if (flip_mask & (1 << i)) {
+      miset_dimension_apparent_voxel_order(dim[i], MI_COUNTER_FILE_ORDER);
+    }
+  }
+  if (miget_voxel_value_hyperslab(vol, MI_TYPE_SHORT, start, count,
+                                  actual) < 0) {
+    TESTRPT("failed to read flipped hyperslab", flip_mask);
+  }
+
+  if (memcmp(expected, actual, total * sizeof(short)) != 0) {
+    TESTRPT("flipped read differs from restructured read", flip_mask);
+  }
+
+  miclose_volume(vol);
+  free(expected);
+  free(actual);
+}
+
+int main(void)
+{
+  static const misize_t full_start[NDIMS] = { 0, 0, 0 };
+  static const misize_t full_count[NDIMS] = { CZ, CY, CX };
+  static const misize_t part_start[NDIMS] = { 3, 11, 20 };
+  static const misize_t part_count[NDIMS] = { 29, 57, 101 };
+  static const misize_t row_start[NDIMS] = { 17, 42, 5 };
+  static const misize_t row_count[NDIMS] = { 1, 1, 140 };
+  int flip_mask;
+
+  create_test_file();
+
+  for (flip_mask = 1; flip_mask < (1 << NDIMS); flip_mask++) {
+    check_flipped_read(flip_mask, full_start, full_count);
+    check_flipped_read(flip_mask, part_start, part_count);
+    check_flipped_read(flip_mask, row_start, row_count);
+  }
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
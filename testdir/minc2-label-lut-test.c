@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "minc2.h"
+
+/* Reads label volumes of several integer types through
+ * miget_label_hyperslab(), with and without a lookup table and in file
+ * and apparent dimension order, and measures name and value lookups in a
+ * volume with many labels.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NZ 20
+#define NY 64
+#define NX 48
+#define NDIMS 3
+#define NVOXELS (NZ * NY * NX)
+#define N_LABELS 1000
+#define N_LOOKUPS 200000
+
+#define FILENAME "label-lut.mnc"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Label of a voxel, between 0 and n_labels - 1. */
+static int test_label(int i, int n_labels)
+{
+  return ((i / 7) * 31 + i % 5) % n_labels;
+}
+
+static int create_test_file(mitype_t type, int n_labels)
+{
+  static const char *names[NDIMS] = { "zspace", "yspace", "xspace" };
+  static const misize_t lengths[NDIMS] = { NZ, NY, NX };
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { NZ, NY, NX };
+  void *buf;
+  char name[32];
+  int i;
+
+  buf = malloc(NVOXELS * sizeof(int));
+  for (i = 0; i < NVOXELS; i++) {
+    int label = test_label(i, n_labels);
+    if (type == MI_TYPE_UBYTE) {
+      ((unsigned char *) buf)[i] = (unsigned char) label;
+    } else if (type == MI_TYPE_USHORT) {
+      ((unsigned short *) buf)[i] = (unsigned short) label;
+    } else {
+      ((int *) buf)[i] = label;
+    }
+  }
+  for (i = 0; i < NDIMS; i++) {
+    micreate_dimension(names[i], MI_DIMCLASS_SPATIAL,
+                       MI_DIMATTR_REGULARLY_SAMPLED, lengths[i], &hdim[i]);
+  }
+  if (micreate_volume(FILENAME, NDIMS, hdim, type, MI_CLASS_LABEL, NULL,
+                      &hvol) < 0) {
+    TESTRPT("failed to create volume", (int) type);
+    free(buf);
+    return (-1);
+  }
+  for (i = 0; i < n_labels; i++) {
+    sprintf(name, "label-%d", i);
+    midefine_label(hvol, i, name);
+  }
+  micreate_volume_image(hvol);
+  if (miset_voxel_value_hyperslab(hvol, type, start, count, buf) < 0) {
+    TESTRPT("failed to write labels", (int) type);
+  }
+  miclose_volume(hvol);
+  free(buf);
+  return (0);
+}
+
+/* Reads the whole volume as labels and checks them. */
+static void check_labels(mitype_t type, int n_labels)
+{
+  static char *reversed[NDIMS] = { "xspace", "yspace", "zspace" };
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { NZ, NY, NX };
+  misize_t rcount[NDIMS] = { NX, NY, NZ };
+  int *labels = (int *) malloc(NVOXELS * sizeof(int));
+  int *lut = (int *) malloc(n_labels * sizeof(int));
+  mihandle_t hvol;
+  int x, y, z, i;
+
+  if (create_test_file(type, n_labels) < 0 ||
+      miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open volume", (int) type);
+    free(labels);
+    free(lut);
+    return;
+  }
+
+  if (miget_label_hyperslab(hvol, start, count, NULL, 0, labels) < 0) {
+    TESTRPT("failed to read labels", (int) type);
+  }
+  for (i = 0; i < NVOXELS; i++) {
+    if (labels[i] != test_label(i, n_labels)) {
+      TESTRPT("wrong label", i);
+      break;
+    }
+  }
+
+  /* A table covering only half of the labels leaves the others alone. */
+  for (i = 0; i < n_labels / 2; i++) {
+    lut[i] = -1 - i;
+  }
+  if (miget_label_hyperslab(hvol, start, count, lut, n_labels / 2,
+                            labels) < 0) {
+    TESTRPT("failed to read labels through table", (int) type);
+  }
+  for (i = 0; i < NVOXELS; i++) {
+    int label = test_label(i, n_labels);
+    if (labels[i] != ((label < n_labels / 2) ? -1 - label : label)) {
+      TESTRPT("wrong mapped label", i);
+      break;
+    }
+  }
+
+  /* A part of the volume, in the reverse order of its dimensions. */
+  miset_apparent_dimension_order_by_name(hvol, NDIMS, reversed);
+  start[0] = 5;
+  start[2] = 3;
+  rcount[0] = NX - 5;
+  rcount[2] = NZ - 3;
+  if (miget_label_hyperslab(hvol, start, rcount, NULL, 0, labels) < 0) {
+    TESTRPT("failed to read labels in apparent order", (int) type);
+  }
+  for (x = 0; x < NX - 5; x++) {
+    for (y = 0; y < NY; y++) {
+      for (z = 0; z < NZ - 3; z++) {
+        int expected = test_label(((z + 3) * NY + y) * NX + x + 5, n_labels);
+        if (labels[(x * NY + y) * (NZ - 3) + z] != expected) {
+          TESTRPT("wrong label in apparent order", (int) type);
+          x = NX;
+          y = NY;
+          break;
+        }
+      }
+    }
+  }
+  miclose_volume(hvol);
+  free(labels);
+  free(lut);
+}
+
+int main(void)
+{
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { NZ, NY, NX };
+  unsigned short *raw = (unsigned short *) malloc(NVOXELS * sizeof(unsigned short));
+  int *labels = (int *) malloc(NVOXELS * sizeof(int));
+  int *remapped = (int *) malloc(NVOXELS * sizeof(int));
+  int *lut = (int *) malloc(N_LABELS * sizeof(int));
+  double t0, t_names, t_values, t_manual, t_lut;
+  long sum = 0;
+  mihandle_t hvol;
+  char name[32];
+  char *label_name;
+  int value, n, i;
+
+  check_labels(MI_TYPE_UBYTE, 200);
+  check_labels(MI_TYPE_USHORT, N_LABELS);
+  check_labels(MI_TYPE_INT, N_LABELS);
+
+  create_test_file(MI_TYPE_USHORT, N_LABELS);
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open volume", 0);
+    return (error_cnt);
+  }
+
+  if (miget_number_of_defined_labels(hvol, &n) < 0 || n != N_LABELS) {
+    TESTRPT("wrong number of labels", n);
+  }
+  for (i = 0; i < N_LABELS; i++) {
+    sprintf(name, "label-%d", i);
+    if (miget_label_value(hvol, name, &value) < 0 || value != i) {
+      TESTRPT("wrong label value", i);
+      break;
+    }
+    if (miget_label_name(hvol, i, &label_name) < 0) {
+      TESTRPT("failed to get label name", i);
+      break;
+    }
+    if (strcmp(label_name, name) != 0) {
+      TESTRPT("wrong label name", i);
+    }
+    mifree_name(label_name);
+  }
+  if (miget_label_value_by_index(hvol, N_LABELS - 1, &value) < 0 ||
+      value != N_LABELS - 1) {
+    TESTRPT("wrong label value by index", value);
+  }
+  if (miget_label_value_by_index(hvol, N_LABELS, &value) >= 0) {
+    TESTRPT("label index past the end", 0);
+  }
+  if (miget_label_name(hvol, N_LABELS, &label_name) >= 0) {
+    TESTRPT("name of an undefined label", 0);
+  }
+  if (miget_label_value(hvol, "Mauve", &value) >= 0) {
+    TESTRPT("value of an undefined label", 0);
+  }
+
+  /* Name and value lookups. */
+  t0 = now();
+  for (i = 0; i < N_LOOKUPS; i++) {
+    sprintf(name, "label-%d", (i * 7) % N_LABELS);
+    miget_label_value(hvol, name, &value);
+    sum += value;
+  }
+  t_names = now() - t0;
+  t0 = now();
+  for (i = 0; i < N_LOOKUPS; i++) {
+    miget_label_name(hvol, (i * 7) % N_LABELS, &label_name);
+    sum += label_name[6];
+    mifree_name(label_name);
+  }
+  t_values = now() - t0;
+  printf("%d labels, %d lookups: by name %.1f ms, by value %.1f ms (sum %ld)\n",
+         N_LABELS, N_LOOKUPS, t_names * 1e3, t_values * 1e3, sum);
+
+  /* Reading then remapping the labels, against remapping as they are
+   * read.
+   */
+  for (i = 0; i < N_LABELS; i++) {
+    lut[i] = (i * 13) % 97;
+  }
+  miget_voxel_value_hyperslab(hvol, MI_TYPE_USHORT, start, count, raw);
+  t0 = now();
+  miget_voxel_value_hyperslab(hvol, MI_TYPE_USHORT, start, count, raw);
+  for (i = 0; i < NVOXELS; i++) {
+    remapped[i] = lut[raw[i]];
+  }
+  t_manual = now() - t0;
+  t0 = now();
+  miget_label_hyperslab(hvol, start, count, lut, N_LABELS, labels);
+  t_lut = now() - t0;
+  if (memcmp(labels, remapped, NVOXELS * sizeof(int)) != 0) {
+    TESTRPT("labels read through table differ", 0);
+  }
+  printf("%d voxels: read and remap %.2f ms, miget_label_hyperslab %.2f ms\n",
+         NVOXELS, t_manual * 1e3, t_lut * 1e3);
+
+  miclose_volume(hvol);
+  free(raw);
+  free(labels);
+  free(remapped);
+  free(lut);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
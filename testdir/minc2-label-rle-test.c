@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "minc2.h"
+
+/* Writes an atlas-like label volume, mostly background, with each
+ * storage mode and compares the file sizes, checks that the run-length
+ * encoded volume reads back unchanged, and checks the label voxel counts
+ * and bounding boxes saved with it, before and after the labels are
+ * changed.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NZ 64
+#define NY 96
+#define NX 80
+#define NDIMS 3
+#define NVOXELS (NZ * NY * NX)
+#define N_BLOBS 40
+
+#define FILENAME "label-rle.mnc"
+
+struct extent {
+  long n_voxels;
+  int first[NDIMS];
+  int last[NDIMS];
+};
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Scatters small ellipsoids, labelled 1 to N_BLOBS, over a background of
+ * zeros.
+ */
+static void make_atlas(unsigned short *labels)
+{
+  int b, x, y, z;
+
+  memset(labels, 0, NVOXELS * sizeof(unsigned short));
+  srand(42);
+  for (b = 1; b <= N_BLOBS; b++) {
+    int cz = 6 + rand() % (NZ - 12), cy = 6 + rand() % (NY - 12);
+    int cx = 6 + rand() % (NX - 12);
+    int rz = 2 + rand() % 4, ry = 2 + rand() % 5, rx = 2 + rand() % 5;
+
+    for (z = cz - rz; z <= cz + rz; z++) {
+      for (y = cy - ry; y <= cy + ry; y++) {
+        for (x = cx - rx; x <= cx + rx; x++) {
+          double dz = (double) (z - cz) / rz, dy = (double) (y - cy) / ry;
+          double dx = (double) (x - cx) / rx;
+          if (dz * dz + dy * dy + dx * dx <= 1.0) {
+            labels[(z * NY + y) * NX + x] = (unsigned short) b;
+          }
+        }
+      }
+    }
+  }
+}
+
+static void find_extents(const unsigned short *labels, struct extent *extents)
+{
+  int i, d;
+
+  memset(extents, 0, (N_BLOBS + 1) * sizeof(struct extent));
+  for (i = 0; i < NVOXELS; i++) {
+    struct extent *e = &extents[labels[i]];
+    int coords[NDIMS];
+
+    coords[0] = i / (NY * NX);
+    coords[1] = (i / NX) % NY;
+    coords[2] = i % NX;
+    for (d = 0; d < NDIMS; d++) {
+      if (e->n_voxels == 0 || coords[d] < e->first[d]) {
+        e->first[d] = coords[d];
+      }
+      if (e->n_voxels == 0 || coords[d] > e->last[d]) {
+        e->last[d] = coords[d];
+      }
+    }
+    e->n_voxels++;
+  }
+}
+
+static long create_test_file(micompression_t codec,
+                             const unsigned short *labels)
+{
+  static const char *names[NDIMS] = { "zspace", "yspace", "xspace" };
+  static const misize_t lengths[NDIMS] = { NZ, NY, NX };
+  midimhandle_t hdim[NDIMS];
+  mivolumeprops_t props;
+  mihandle_t hvol;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { NZ, NY, NX };
+  char name[32];
+  struct stat st;
+  int i;
+
+  for (i = 0; i < NDIMS; i++) {
+    micreate_dimension(names[i], MI_DIMCLASS_SPATIAL,
+                       MI_DIMATTR_REGULARLY_SAMPLED, lengths[i], &hdim[i]);
+  }
+  minew_volume_props(&props);
+  if (miset_props_compression_type(props, codec) < 0) {
+    TESTRPT("failed to set compression type", (int) codec);
+  }
+  if (micreate_volume(FILENAME, NDIMS, hdim, MI_TYPE_USHORT, MI_CLASS_LABEL,
+                      props, &hvol) < 0) {
+    TESTRPT("failed to create volume", (int) codec);
+    mifree_volume_props(props);
+    return (0);
+  }
+  mifree_volume_props(props);
+  midefine_label(hvol, 0, "background");
+  for (i = 1; i <= N_BLOBS; i++) {
+    sprintf(name, "structure-%d", i);
+    midefine_label(hvol, i, name);
+  }
+  micreate_volume_image(hvol);
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_USHORT, start, count,
+                                  (void *) labels) < 0) {
+    TESTRPT("failed to write labels", (int) codec);
+  }
+  miclose_volume(hvol);
+  return (stat(FILENAME, &st) == 0) ? (long) st.st_size : 0;
+}
+
+/* Compares the labels present, their voxel counts and bounding boxes
+ * with those found in the labels written.
+ */
+static void check_extents(mihandle_t hvol, const struct extent *extents)
+{
+  int values[N_BLOBS + 2];
+  misize_t n_voxels, start[NDIMS], count[NDIMS];
+  int n_present = 0, n_labels, i, d;
+
+  for (i = 0; i <= N_BLOBS; i++) {
+    n_present += (extents[i].n_voxels > 0);
+  }
+  if (miget_present_labels(hvol, N_BLOBS + 2, values, &n_labels) < 0 ||
+      n_labels != n_present) {
+    TESTRPT("wrong number of labels present", n_labels);
+    return;
+  }
+  for (i = 1; i < n_labels; i++) {
+    if (values[i] <= values[i - 1]) {
+      TESTRPT("labels present out of order", values[i]);
+    }
+  }
+  for (i = 0; i <= N_BLOBS + 1; i++) {
+    if (miget_label_extent(hvol, i, &n_voxels, start, count) < 0) {
+      TESTRPT("failed to get label extent", i);
+      continue;
+    }
+    if (i > N_BLOBS || extents[i].n_voxels == 0) {
+      if (n_voxels != 0 || count[0] != 0) {
+        TESTRPT("extent of an absent label", i);
+      }
+      continue;
+    }
+    if ((long) n_voxels != extents[i].n_voxels) {
+      TESTRPT("wrong label voxel count", i);
+    }
+    for (d = 0; d < NDIMS; d++) {
+      if ((int) start[d] != extents[i].first[d] ||
+          (int) (start[d] + count[d] - 1) != extents[i].last[d]) {
+        TESTRPT("wrong label bounding box", i);
+        break;
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  static const micompression_t codecs[] = {
+    MI_COMPRESS_NONE, MI_COMPRESS_ZLIB, MI_COMPRESS_RLE
+  };
+  static const char *codec_names[] = { "none", "zlib", "rle" };
+  unsigned short *labels = (unsigned short *) malloc(NVOXELS * sizeof(unsigned short));
+  unsigned short *back = (unsigned short *) malloc(NVOXELS * sizeof(unsigned short));
+  int *ints = (int *) malloc(NVOXELS * sizeof(int));
+  struct extent extents[N_BLOBS + 1];
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { NZ, NY, NX };
+  misize_t location[NDIMS];
+  misize_t n_voxels;
+  double t0, t_scan, t_saved, t_read[3];
+  long sizes[3];
+  mihandle_t hvol;
+  int i, n_labels;
+
+  make_atlas(labels);
+  find_extents(labels, extents);
+
+  /* File sizes and the time to read the whole image, by storage mode. */
+  for (i = 0; i < 3; i++) {
+    sizes[i] = create_test_file(codecs[i], labels);
+    if (miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+      TESTRPT("failed to open volume", i);
+      continue;
+    }
+    t0 = now();
+    miget_voxel_value_hyperslab(hvol, MI_TYPE_USHORT, start, count, back);
+    t_read[i] = now() - t0;
+    if (memcmp(back, labels, NVOXELS * sizeof(unsigned short)) != 0) {
+      TESTRPT("labels read back differ", i);
+    }
+    if (i == 0) {
+      /* An uncompressed label volume is scanned for its labels. */
+      t0 = now();
+      check_extents(hvol, extents);
+      t_scan = now() - t0;
+    }
+    miclose_volume(hvol);
+  }
+  for (i = 0; i < 3; i++) {
+    printf("%s: %ld bytes, read in %.2f ms\n", codec_names[i], sizes[i],
+           t_read[i] * 1e3);
+  }
+  if (sizes[2] * 10 > sizes[0]) {
+    TESTRPT("run-length encoded volume not much smaller", (int) sizes[2]);
+  }
+
+  /* The run-length encoded volume, left by the loop above, has its
+   * labels indexed.
+   */
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open volume", 0);
+    return (error_cnt);
+  }
+  t0 = now();
+  check_extents(hvol, extents);
+  t_saved = now() - t0;
+  printf("label extents: scanning the image %.2f ms, saved index %.3f ms\n",
+         t_scan * 1e3, t_saved * 1e3);
+  if (miget_label_hyperslab(hvol, start, count, NULL, 0, ints) < 0) {
+    TESTRPT("failed to read labels", 0);
+  }
+  for (i = 0; i < NVOXELS; i++) {
+    if (ints[i] != labels[i]) {
+      TESTRPT("wrong label", i);
+      break;
+    }
+  }
+  miclose_volume(hvol);
+
+  /* Changed labels are seen before the volume is closed, and saved with
+   * it. Label 7 is erased, and a voxel of label 3 is set in a corner.
+   */
+  for (i = 0; i < NVOXELS; i++) {
+    if (labels[i] == 7) {
+      labels[i] = 0;
+    }
+  }
+  labels[NVOXELS - 1] = 3;
+  find_extents(labels, extents);
+  if (miopen_volume(FILENAME, MI2_OPEN_RDWR, &hvol) < 0) {
+    TESTRPT("failed to open volume for writing", 0);
+  } else {
+    miset_voxel_value_hyperslab(hvol, MI_TYPE_USHORT, start, count, labels);
+    check_extents(hvol, extents);
+    miclose_volume(hvol);
+  }
+  miopen_volume(FILENAME, MI2_OPEN_READ, &hvol);
+  check_extents(hvol, extents);
+  if (miget_label_extent(hvol, 7, &n_voxels, NULL, NULL) < 0 || n_voxels != 0) {
+    TESTRPT("erased label still present", (int) n_voxels);
+  }
+  miclose_volume(hvol);
+
+  /* A single voxel written through a volume opened for writing. */
+  location[0] = 0;
+  location[1] = 0;
+  location[2] = 0;
+  miopen_volume(FILENAME, MI2_OPEN_RDWR, &hvol);
+  midefine_label(hvol, N_BLOBS + 1, "extra");
+  miset_voxel_value(hvol, location, NDIMS, N_BLOBS + 1);
+  miclose_volume(hvol);
+  miopen_volume(FILENAME, MI2_OPEN_READ, &hvol);
+  if (miget_present_labels(hvol, 0, NULL, &n_labels) < 0 ||
+      miget_label_extent(hvol, N_BLOBS + 1, &n_voxels, NULL, NULL) < 0 ||
+      n_voxels != 1) {
+    TESTRPT("new label not indexed", (int) n_voxels);
+  }
+  miclose_volume(hvol);
+
+  /* Building the lower resolutions before the volume is closed leaves
+   * the label index to be saved with it.
+   */
+  miopen_volume(FILENAME, MI2_OPEN_RDWR, &hvol);
+  miset_voxel_value(hvol, location, NDIMS, 0);
+  if (miflush_from_resolution(hvol, 1) < 0) {
+    TESTRPT("failed to flush the resolutions", 0);
+  }
+  if (miclose_volume(hvol) < 0) {
+    TESTRPT("failed to close volume", 0);
+  }
+  miopen_volume(FILENAME, MI2_OPEN_READ, &hvol);
+  if (miget_label_extent(hvol, N_BLOBS + 1, &n_voxels, NULL, NULL) < 0 ||
+      n_voxels != 0) {
+    TESTRPT("erased label indexed after a flush", (int) n_voxels);
+  }
+  miclose_volume(hvol);
+
+  free(labels);
+  free(back);
+  free(ints);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
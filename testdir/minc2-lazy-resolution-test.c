@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "minc2.h"
+
+/* Checks that the lower resolution images of a volume with lazy
+ * resolution are left stale when it is closed, are computed when they
+ * are selected, in the file or in memory for a volume opened read-only,
+ * and that recomputing only the slices touched by a write gives the
+ * same images as building the whole pyramid again.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define CZ 24
+#define CY 30
+#define CX 35
+#define NDIMS 3
+#define DEPTH 2
+#define NVOXELS (CZ * CY * CX)
+#define FIRST_CHANGED 10
+#define N_CHANGED 3
+
+#define LAZY_FILE "lazy-resolution-test.mnc"
+#define UPDATE_FILE "lazy-resolution-update.mnc"
+#define REF_FILE "lazy-resolution-ref.mnc"
+
+static void fill(short *buf, int changed)
+{
+  int i;
+
+  for (i = 0; i < NVOXELS; i++) {
+    int x = i % CX, y = (i / CX) % CY, z = i / (CX * CY);
+
+    buf[i] = (short)(x * 150 - y * 90 + z * 400 + (i * 7919) % 97);
+    if (changed && z >= FIRST_CHANGED && z < FIRST_CHANGED + N_CHANGED) {
+      buf[i] = (short)(-buf[i] / 2 + 1000);
+    }
+  }
+}
+
+static void create_volume(const char *filename, miboolean_t lazy,
+                          const short *buf)
+{
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  mivolumeprops_t props;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { CZ, CY, CX };
+  int edges[NDIMS] = { 4, 16, 16 };
+
+  micreate_dimension("zspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CZ, &hdim[0]);
+  micreate_dimension("yspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CY, &hdim[1]);
+  micreate_dimension("xspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CX, &hdim[2]);
+
+  minew_volume_props(&props);
+  miset_props_compression_type(props, MI_COMPRESS_ZLIB);
+  miset_props_blocking(props, NDIMS, edges);
+  miset_props_multi_resolution(props, TRUE, DEPTH);
+  miset_props_resolution_filter(props, MI_FILTER_GAUSSIAN);
+
+  micreate_volume(filename, NDIMS, hdim, MI_TYPE_SHORT, MI_CLASS_REAL,
+                  props, &hvol);
+  micreate_volume_image(hvol);
+  miset_volume_valid_range(hvol, 32767.0, -32768.0);
+  miset_volume_range(hvol, 10.0, -10.0);
+  mifree_volume_props(props);
+  if (miset_volume_lazy_resolution(hvol, lazy) < 0) {
+    TESTRPT("failed to set lazy resolution", lazy);
+  }
+
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  (void *) buf) < 0) {
+    TESTRPT("failed to write image", 0);
+  }
+  if (miclose_volume(hvol) < 0) {
+    TESTRPT("failed to close volume", 0);
+  }
+}
+
+/* Rewrites the changed slices of an existing volume. */
+static void update_volume(const char *filename, miboolean_t lazy,
+                          const short *buf)
+{
+  mihandle_t hvol;
+  misize_t start[NDIMS] = { FIRST_CHANGED, 0, 0 };
+  misize_t count[NDIMS] = { N_CHANGED, CY, CX };
+
+  if (miopen_volume(filename, MI2_OPEN_RDWR, &hvol) < 0) {
+    TESTRPT("failed to open volume", 0);
+    return;
+  }
+  miset_volume_lazy_resolution(hvol, lazy);
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  (void *) (buf + FIRST_CHANGED * CY * CX)) < 0) {
+    TESTRPT("failed to update image", 0);
+  }
+  miclose_volume(hvol);
+}
+
+/* Reads the voxels of a resolution level directly from the file. */
+static int read_level(const char *filename, int level, short *buf)
+{
+  char path[128];
+  hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t dset_id;
+  int result = -1;
+
+  sprintf(path, "/minc-2.0/image/%d/image", level);
+  H5E_BEGIN_TRY {
+    dset_id = H5Dopen2(file_id, path, H5P_DEFAULT);
+  } H5E_END_TRY;
+  if (dset_id >= 0) {
+    result = H5Dread(dset_id, H5T_NATIVE_SHORT, H5S_ALL, H5S_ALL,
+                     H5P_DEFAULT, buf);
+    H5Dclose(dset_id);
+  }
+  H5Fclose(file_id);
+  return result;
+}
+
+/* Returns whether the file records stale slices for a level, and the
+ * recorded range.
+ */
+static int is_stale(const char *filename, int level,
+                    unsigned long long range[2])
+{
+  char path[128];
+  hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t grp_id;
+  int stale;
+
+  sprintf(path, "/minc-2.0/image/%d", level);
+  grp_id = H5Gopen2(file_id, path, H5P_DEFAULT);
+  stale = H5Lexists(grp_id, "image", H5P_DEFAULT) <= 0;
+  range[0] = 0;
+  range[1] = (unsigned long long) -1;
+  if (H5Aexists(grp_id, "stale-slices") > 0) {
+    hid_t attr_id = H5Aopen(grp_id, "stale-slices", H5P_DEFAULT);
+
+    H5Aread(attr_id, H5T_NATIVE_ULLONG, range);
+    H5Aclose(attr_id);
+    stale = 1;
+  }
+  H5Gclose(grp_id);
+  H5Fclose(file_id);
+  return stale;
+}
+
+static int level_voxels(int level)
+{
+  return (CZ >> level) * (CY >> level) * (CX >> level);
+}
+
+/* Compares a level of a file with the same level of the reference. */
+static void check_file_level(const char *filename, int level)
+{
+  short *expected = (short *) malloc(NVOXELS * sizeof(short));
+  short *stored = (short *) malloc(NVOXELS * sizeof(short));
+
+  read_level(REF_FILE, level, expected);
+  if (read_level(filename, level, stored) < 0) {
+    TESTRPT("level missing", level);
+  } else if (memcmp(expected, stored,
+                    level_voxels(level) * sizeof(short)) != 0) {
+    TESTRPT("level differs from a full build", level);
+  }
+  free(expected);
+  free(stored);
+}
+
+/* Compares the level selected in an open volume with the reference. */
+static void check_level(mihandle_t hvol, int level)
+{
+  short *expected = (short *) malloc(NVOXELS * sizeof(short));
+  short *stored = (short *) malloc(NVOXELS * sizeof(short));
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { CZ >> level, CY >> level, CX >> level };
+
+  read_level(REF_FILE, level, expected);
+  if (miget_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  stored) < 0) {
+    TESTRPT("failed to read selected resolution", level);
+  } else if (memcmp(expected, stored,
+                    level_voxels(level) * sizeof(short)) != 0) {
+    TESTRPT("selected level differs from a full build", level);
+  }
+  free(expected);
+  free(stored);
+}
+
+/* Selects a level of an open volume and compares it with the reference. */
+static void check_selected_level(mihandle_t hvol, int level)
+{
+  if (miselect_resolution(hvol, level) < 0) {
+    TESTRPT("failed to select resolution", level);
+  } else {
+    check_level(hvol, level);
+  }
+}
+
+int main(void)
+{
+  short *buf = (short *) malloc(NVOXELS * sizeof(short));
+  unsigned long long range[2];
+  miboolean_t lazy;
+  mihandle_t hvol;
+  int level;
+
+  fill(buf, FALSE);
+  create_volume(REF_FILE, FALSE, buf);
+  create_volume(UPDATE_FILE, FALSE, buf);
+
+  /* Nothing is computed when a lazy volume is closed. */
+  create_volume(LAZY_FILE, TRUE, buf);
+  for (level = 1; level <= DEPTH; level++) {
+    if (!is_stale(LAZY_FILE, level, range)) {
+      TESTRPT("lazy level built on close", level);
+    }
+  }
+
+  /* Selecting a level computes it in the file, and only that level. */
+  if (miopen_volume(LAZY_FILE, MI2_OPEN_RDWR, &hvol) < 0) {
+    TESTRPT("failed to open lazy volume", 0);
+    return (error_cnt);
+  }
+  if (miget_volume_lazy_resolution(hvol, &lazy) < 0 || lazy) {
+    TESTRPT("volumes are not lazy by default", lazy);
+  }
+  check_selected_level(hvol, 1);
+  miclose_volume(hvol);
+  if (is_stale(LAZY_FILE, 1, range)) {
+    TESTRPT("selected level still stale", 1);
+  }
+  check_file_level(LAZY_FILE, 1);
+  if (!is_stale(LAZY_FILE, 2, range)) {
+    TESTRPT("unselected level built", 2);
+  }
+
+  /* Rewrite a few slices, and build the reference from scratch. */
+  fill(buf, TRUE);
+  create_volume(REF_FILE, FALSE, buf);
+  update_volume(UPDATE_FILE, FALSE, buf);
+  update_volume(LAZY_FILE, TRUE, buf);
+
+  /* Only the slices touched by the write are recomputed on close. */
+  for (level = 1; level <= DEPTH; level++) {
+    if (is_stale(UPDATE_FILE, level, range)) {
+      TESTRPT("level stale after update", level);
+    }
+    check_file_level(UPDATE_FILE, level);
+  }
+
+  /* The lazy volume records the slices touched by the write. */
+  if (!is_stale(LAZY_FILE, 1, range) || range[0] != FIRST_CHANGED ||
+      range[1] != FIRST_CHANGED + N_CHANGED) {
+    TESTRPT("wrong stale slices", (int) range[0]);
+  }
+
+  /* A volume opened read-only computes its stale levels in memory. */
+  if (miopen_volume(LAZY_FILE, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open lazy volume", 0);
+    return (error_cnt);
+  }
+  check_selected_level(hvol, 2);
+  check_selected_level(hvol, 1);
+  check_selected_level(hvol, 2);
+
+  /* A new chunk cache keeps the level selected. */
+  if (miset_volume_chunk_cache(hvol, 1 << 20, 0, -1.0) < 0) {
+    TESTRPT("failed to set chunk cache", 2);
+  }
+  check_level(hvol, 2);
+  miclose_volume(hvol);
+  if (!is_stale(LAZY_FILE, 1, range)) {
+    TESTRPT("read-only volume modified", 1);
+  }
+
+  /* Flushing computes the remaining stale slices of every level. */
+  miopen_volume(LAZY_FILE, MI2_OPEN_RDWR, &hvol);
+  if (miflush_from_resolution(hvol, DEPTH) < 0) {
+    TESTRPT("failed to flush resolutions", DEPTH);
+  }
+  miclose_volume(hvol);
+  for (level = 1; level <= DEPTH; level++) {
+    if (is_stale(LAZY_FILE, level, range)) {
+      TESTRPT("level stale after flush", level);
+    }
+    check_file_level(LAZY_FILE, level);
+  }
+
+  free(buf);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "minc2.h"
+
+/* Maps the image of a contiguous volume and compares the voxels with
+ * those read through the hyperslab functions, measures random voxel
+ * reads through both, and checks that images which can't be mapped are
+ * refused.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NZ 40
+#define NY 128
+#define NX 96
+#define NDIMS 3
+#define NVOXELS (NZ * NY * NX)
+#define N_LOOKUPS 20000
+
+#define FILENAME "mapping-test.mnc"
+#define ZLIB_FILENAME "mapping-test-zlib.mnc"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void create_test_file(const char *filename, mivolumeprops_t props,
+                             const short *buf)
+{
+  static const char *names[NDIMS] = { "zspace", "yspace", "xspace" };
+  static const misize_t lengths[NDIMS] = { NZ, NY, NX };
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { NZ, NY, NX };
+  int i;
+
+  for (i = 0; i < NDIMS; i++) {
+    micreate_dimension(names[i], MI_DIMCLASS_SPATIAL,
+                       MI_DIMATTR_REGULARLY_SAMPLED, lengths[i], &hdim[i]);
+  }
+  if (micreate_volume(filename, NDIMS, hdim, MI_TYPE_SHORT, MI_CLASS_REAL,
+                      props, &hvol) < 0) {
+    TESTRPT("failed to create volume", 0);
+    return;
+  }
+  micreate_volume_image(hvol);
+  miset_volume_valid_range(hvol, 4000.0, -4000.0);
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  (void *) buf) < 0) {
+    TESTRPT("failed to write test image", 0);
+  }
+  miclose_volume(hvol);
+}
+
+static void check_mapping(mihandle_t hvol, const short *buf)
+{
+  const void *data;
+  misize_t strides[NDIMS];
+  const char *base;
+  int z, y, x;
+
+  if (miget_volume_mapping(hvol, &data, strides) < 0) {
+    TESTRPT("failed to map image", 0);
+    return;
+  }
+  if (strides[0] != NY * NX * sizeof(short) ||
+      strides[1] != NX * sizeof(short) || strides[2] != sizeof(short)) {
+    TESTRPT("wrong strides", (int) strides[0]);
+  }
+  base = (const char *) data;
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        short v = *(const short *) (base + z * strides[0] + y * strides[1] +
+                                    x * strides[2]);
+        if (v != buf[(z * NY + y) * NX + x]) {
+          TESTRPT("wrong mapped voxel", (z * NY + y) * NX + x);
+          return;
+        }
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  short *buf = (short *) malloc(NVOXELS * sizeof(short));
+  misize_t *coords = (misize_t *) malloc(N_LOOKUPS * NDIMS * sizeof(misize_t));
+  misize_t location[NDIMS];
+  misize_t strides[NDIMS];
+  mivolumeprops_t props;
+  const void *data;
+  const void *data2;
+  mihandle_t hvol;
+  double t0, t_read, t_map, value;
+  double sum_read = 0.0, sum_map = 0.0;
+  short voxel;
+  int i;
+
+  for (i = 0; i < NVOXELS; i++) {
+    buf[i] = (short) ((i * 37) % 8000 - 4000);
+  }
+  srand(1234);
+  for (i = 0; i < N_LOOKUPS; i++) {
+    coords[i * NDIMS + 0] = rand() % NZ;
+    coords[i * NDIMS + 1] = rand() % NY;
+    coords[i * NDIMS + 2] = rand() % NX;
+  }
+  create_test_file(FILENAME, NULL, buf);
+
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open volume", 0);
+    return error_cnt;
+  }
+  check_mapping(hvol, buf);
+
+  /* Random voxel reads, through HDF5 and through the mapping. */
+  t0 = now();
+  for (i = 0; i < N_LOOKUPS; i++) {
+    miget_voxel_value(hvol, &coords[i * NDIMS], NDIMS, &value);
+    sum_read += value;
+  }
+  t_read = now() - t0;
+
+  t0 = now();
+  miget_volume_mapping(hvol, &data, strides);
+  for (i = 0; i < N_LOOKUPS; i++) {
+    const misize_t *c = &coords[i * NDIMS];
+    sum_map += *(const short *) ((const char *) data + c[0] * strides[0] +
+                                 c[1] * strides[1] + c[2] * strides[2]);
+  }
+  t_map = now() - t0;
+  if (sum_read != sum_map) {
+    TESTRPT("mapped voxels differ from those read", (int) (sum_read - sum_map));
+  }
+  printf("%d random voxels: miget_voxel_value %.1f ms, mapping %.2f ms (%.0fx)\n",
+         N_LOOKUPS, t_read * 1e3, t_map * 1e3, t_read / t_map);
+
+  /* The mapping is kept until it is released. */
+  if (miget_volume_mapping(hvol, &data2, NULL) < 0 || data2 != data) {
+    TESTRPT("mapping not reused", 0);
+  }
+  mirelease_volume_mapping(hvol);
+  check_mapping(hvol, buf);
+  miclose_volume(hvol);
+
+  /* A volume opened with MI2_OPEN_HEADER sets up its image first. */
+  if (miopen_volume(FILENAME, MI2_OPEN_READ | MI2_OPEN_HEADER, &hvol) < 0) {
+    TESTRPT("failed to open header", 0);
+  } else {
+    check_mapping(hvol, buf);
+    miclose_volume(hvol);
+  }
+
+  /* Voxels written through a volume open for writing show up once the
+   * image is mapped.
+   */
+  if (miopen_volume(FILENAME, MI2_OPEN_RDWR, &hvol) < 0) {
+    TESTRPT("failed to open volume for writing", 0);
+  } else {
+    location[0] = 3;
+    location[1] = 17;
+    location[2] = 5;
+    voxel = 1234;
+    buf[(3 * NY + 17) * NX + 5] = voxel;
+    miset_voxel_value(hvol, location, NDIMS, voxel);
+    check_mapping(hvol, buf);
+    miclose_volume(hvol);
+  }
+
+  /* A compressed image is refused. */
+  minew_volume_props(&props);
+  miset_props_compression_type(props, MI_COMPRESS_ZLIB);
+  miset_props_zlib_compression(props, 4);
+  create_test_file(ZLIB_FILENAME, props, buf);
+  mifree_volume_props(props);
+  if (miopen_volume(ZLIB_FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open compressed volume", 0);
+  } else {
+    if (miget_volume_mapping(hvol, &data, strides) >= 0) {
+      TESTRPT("mapped a compressed image", 0);
+    }
+    miclose_volume(hvol);
+  }
+
+  free(coords);
+  free(buf);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "minc2.h"
+
+/* Checks that a volume opened with MI2_OPEN_HEADER gives the same
+ * attributes as a full open, and sets up its image when it is first
+ * accessed.  Given -benchmark, it also measures the time taken to open a
+ * volume, read one of its attributes and close it again, both ways.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NT 3
+#define NZ 10
+#define NY 20
+#define NX 24
+#define NDIMS 4
+#define NVOXELS (NT * NZ * NY * NX)
+#define N_OPENS 400
+
+#define FILENAME "open-benchmark.mnc"
+#define HDF_FILENAME "open-benchmark.h5"
+#define PATIENT_NAME "Doe^Jane"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void create_test_file(const short *buf)
+{
+  static const char *names[NDIMS] = { "time", "zspace", "yspace", "xspace" };
+  static const misize_t lengths[NDIMS] = { NT, NZ, NY, NX };
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  misize_t start[NDIMS] = { 0, 0, 0, 0 };
+  misize_t count[NDIMS] = { NT, NZ, NY, NX };
+  int i;
+
+  for (i = 0; i < NDIMS; i++) {
+    micreate_dimension(names[i], i == 0 ? MI_DIMCLASS_TIME : MI_DIMCLASS_SPATIAL,
+                       MI_DIMATTR_REGULARLY_SAMPLED, lengths[i], &hdim[i]);
+    miset_dimension_separation(hdim[i], 0.5 + i);
+  }
+  micreate_volume(FILENAME, NDIMS, hdim, MI_TYPE_SHORT, MI_CLASS_REAL,
+                  NULL, &hvol);
+  miset_slice_scaling_flag(hvol, TRUE);
+  micreate_volume_image(hvol);
+  miset_volume_valid_range(hvol, 4000.0, -4000.0);
+  miset_attr_values(hvol, MI_TYPE_STRING, "/patient", "full_name",
+                    strlen(PATIENT_NAME) + 1, PATIENT_NAME);
+  miadd_history_attr(hvol, strlen("created by minc2-open-benchmark") + 1,
+                     "created by minc2-open-benchmark");
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  (void *) buf) < 0) {
+    TESTRPT("failed to write test image", 0);
+  }
+  for (start[0] = 0; start[0] < NT; start[0]++) {
+    for (start[1] = 0; start[1] < NZ; start[1]++) {
+      miset_slice_range(hvol, start, NDIMS, 2.0 + start[1], -1.0 - start[0]);
+    }
+  }
+  miclose_volume(hvol);
+}
+
+/* Opens the volume, reads the patient name and closes it again,
+ * \a n_opens times.
+ */
+static double time_opens(int mode, int n_opens)
+{
+  char name[64];
+  mihandle_t hvol;
+  double t0 = now();
+  int i;
+
+  for (i = 0; i < n_opens; i++) {
+    if (miopen_volume(FILENAME, mode, &hvol) < 0) {
+      TESTRPT("failed to open volume", mode);
+      return 0.0;
+    }
+    if (miget_attr_values(hvol, MI_TYPE_STRING, "/patient", "full_name",
+                          sizeof(name), name) < 0 ||
+        strcmp(name, PATIENT_NAME) != 0) {
+      TESTRPT("wrong patient name", mode);
+    }
+    miclose_volume(hvol);
+  }
+  return (now() - t0) / n_opens;
+}
+
+/* Checks what a volume opened with MI2_OPEN_HEADER reports once its
+ * image is accessed.
+ */
+static void check_deferred(int mode, const short *buf)
+{
+  short *back = (short *) malloc(NVOXELS * sizeof(short));
+  misize_t start[NDIMS] = { 0, 0, 0, 0 };
+  misize_t count[NDIMS] = { NT, NZ, NY, NX };
+  midimhandle_t hdims[NDIMS];
+  mihandle_t hvol;
+  double valid_max, valid_min, smax, smin, sep, preemption;
+  size_t cache_size, cache_slots;
+  mitype_t type;
+  int ndims;
+
+  if (miopen_volume(FILENAME, mode | MI2_OPEN_HEADER, &hvol) < 0) {
+    TESTRPT("failed to open header", mode);
+    free(back);
+    return;
+  }
+  if (miset_volume_chunk_cache(hvol, 1 << 20, 0, -1.0) < 0 ||
+      miget_volume_chunk_cache(hvol, &cache_size, &cache_slots,
+                               &preemption) < 0 || cache_size != 1 << 20) {
+    TESTRPT("failed to set chunk cache", mode);
+  }
+  if (miget_data_type(hvol, &type) < 0 || type != MI_TYPE_SHORT) {
+    TESTRPT("wrong data type", (int) type);
+  }
+  if (miget_volume_dimension_count(hvol, MI_DIMCLASS_ANY, MI_DIMATTR_ALL,
+                                   &ndims) < 0 || ndims != NDIMS) {
+    TESTRPT("wrong dimension count", ndims);
+  }
+  miget_volume_dimensions(hvol, MI_DIMCLASS_ANY, MI_DIMATTR_ALL,
+                          MI_DIMORDER_FILE, NDIMS, hdims);
+  miget_dimension_separation(hdims[2], MI_ORDER_FILE, &sep);
+  if (sep != 2.5) {
+    TESTRPT("wrong dimension separation", (int) (sep * 10));
+  }
+  miget_volume_valid_range(hvol, &valid_max, &valid_min);
+  if (valid_max != 4000.0 || valid_min != -4000.0) {
+    TESTRPT("wrong valid range", (int) valid_max);
+  }
+  start[0] = 2;
+  start[1] = 7;
+  miget_slice_range(hvol, start, NDIMS, &smax, &smin);
+  if (smax != 9.0 || smin != -3.0) {
+    TESTRPT("wrong slice range", (int) smax);
+  }
+  start[0] = start[1] = 0;
+  if (miget_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  back) < 0 ||
+      memcmp(back, buf, NVOXELS * sizeof(short)) != 0) {
+    TESTRPT("wrong voxels", mode);
+  }
+  miclose_volume(hvol);
+  free(back);
+}
+
+int main(int argc, char **argv)
+{
+  int run_benchmarks = (argc > 1 && strcmp(argv[1], "-benchmark") == 0);
+  int n_opens = run_benchmarks ? N_OPENS : 1;
+  short *buf = (short *) malloc(NVOXELS * sizeof(short));
+  double t_full, t_header;
+  double valid_max, valid_min;
+  mihandle_t hvol;
+  hid_t file_id;
+  int i;
+
+  for (i = 0; i < NVOXELS; i++) {
+    buf[i] = (short) ((i * 37) % 8000 - 4000);
+  }
+  create_test_file(buf);
+
+  t_full = time_opens(MI2_OPEN_READ, n_opens);
+  t_header = time_opens(MI2_OPEN_READ | MI2_OPEN_HEADER, n_opens);
+  if (run_benchmarks) {
+    printf("open, read attribute, close: full %.1f us, header only %.1f us (%.1fx)\n",
+           t_full * 1e6, t_header * 1e6, t_full / t_header);
+  }
+
+  check_deferred(MI2_OPEN_READ, buf);
+  check_deferred(MI2_OPEN_RDWR, buf);
+
+  /* Attributes written through a header-only volume leave the image and
+   * its valid range alone.
+   */
+  if (miopen_volume(FILENAME, MI2_OPEN_RDWR | MI2_OPEN_HEADER, &hvol) < 0) {
+    TESTRPT("failed to open header for writing", 0);
+  } else {
+    miset_attr_values(hvol, MI_TYPE_STRING, "/patient", "full_name",
+                      strlen("Roe^Richard") + 1, "Roe^Richard");
+    miclose_volume(hvol);
+  }
+  miopen_volume(FILENAME, MI2_OPEN_READ, &hvol);
+  miget_volume_valid_range(hvol, &valid_max, &valid_min);
+  if (valid_max != 4000.0 || valid_min != -4000.0) {
+    TESTRPT("valid range changed by header write", (int) valid_max);
+  }
+  miclose_volume(hvol);
+  check_deferred(MI2_OPEN_READ, buf);
+
+  /* A HDF5 file which is not a MINC file is refused up front. */
+  file_id = H5Fcreate(HDF_FILENAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  H5Fclose(file_id);
+  if (miopen_volume(HDF_FILENAME, MI2_OPEN_READ | MI2_OPEN_HEADER,
+                    &hvol) >= 0) {
+    TESTRPT("opened a file which is not a MINC file", 0);
+    miclose_volume(hvol);
+  }
+
+  free(buf);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "minc2.h"
+
+/* Checks that hyperslabs read from a compressed volume with several I/O
+ * threads, which decode the chunks in parallel, are identical to the
+ * ones read serially.  Part of the volume is never written, so that the
+ * fill value of unallocated chunks is exercised as well.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define CZ 50
+#define CY 70
+#define CX 90
+#define NDIMS 3
+#define NTHREADS 4
+
+#define FILENAME "parallel-read-test.mnc"
+
+static void create_test_file(void)
+{
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  mivolumeprops_t props;
+  unsigned short *buf;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { CZ - 20, CY, CX };
+  int edges[NDIMS] = { 16, 16, 16 };
+  int i;
+
+  micreate_dimension("zspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CZ, &hdim[0]);
+  micreate_dimension("yspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CY, &hdim[1]);
+  micreate_dimension("xspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CX, &hdim[2]);
+
+  minew_volume_props(&props);
+  miset_props_compression_type(props, MI_COMPRESS_ZLIB);
+  miset_props_zlib_compression(props, 3);
+  miset_props_blocking(props, NDIMS, edges);
+
+  micreate_volume(FILENAME, NDIMS, hdim, MI_TYPE_USHORT,
+                  MI_CLASS_REAL, props, &hvol);
+  micreate_volume_image(hvol);
+  miset_volume_valid_range(hvol, 65535.0, 0.0);
+  miset_volume_range(hvol, 100.0, -100.0);
+  mifree_volume_props(props);
+
+  /* The last 20 slices are left unwritten. */
+  buf = (unsigned short *) malloc(count[0] * CY * CX * sizeof(unsigned short));
+  for (i = 0; i < count[0] * CY * CX; i++) {
+    buf[i] = (unsigned short)((i * 2654435761u) >> 16);
+  }
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_USHORT, start, count, buf) < 0) {
+    TESTRPT("failed to write test image", 0);
+  }
+
+  miclose_volume(hvol);
+  free(buf);
+}
+
+/* Reads the same hyperslab with and without I/O threads and compares. */
+static void check_read(mihandle_t vol, mitype_t buffer_type, int real_value,
+                       const misize_t start[], const misize_t count[])
+{
+  size_t nbytes = count[0] * count[1] * count[2] * sizeof(double);
+  void *serial = malloc(nbytes);
+  void *parallel = malloc(nbytes);
+  int r1, r2;
+
+  memset(serial, 0x5a, nbytes);
+  memset(parallel, 0xa5, nbytes);
+
+  miset_volume_io_threads(vol, 0);
+  if (real_value) {
+    r1 = miget_real_value_hyperslab(vol, buffer_type, start, count, serial);
+  } else {
+    r1 = miget_voxel_value_hyperslab(vol, buffer_type, start, count, serial);
+  }
+
+  miset_volume_io_threads(vol, NTHREADS);
+  if (real_value) {
+    r2 = miget_real_value_hyperslab(vol, buffer_type, start, count, parallel);
+  } else {
+    r2 = miget_voxel_value_hyperslab(vol, buffer_type, start, count, parallel);
+  }
+
+  if (r1 < 0 || r2 < 0) {
+    TESTRPT("failed to read hyperslab", buffer_type);
+  } else {
+    nbytes = count[0] * count[1] * count[2];
+    nbytes *= (buffer_type == MI_TYPE_DOUBLE) ? sizeof(double) :
+              (buffer_type == MI_TYPE_FLOAT) ? sizeof(float) : sizeof(short);
+    if (memcmp(serial, parallel, nbytes) != 0) {
+      TESTRPT("parallel read differs from serial read", buffer_type);
+    }
+  }
+  free(serial);
+  free(parallel);
+}
+
+int main(void)
+{
+  static const misize_t full_start[NDIMS] = { 0, 0, 0 };
+  static const misize_t full_count[NDIMS] = { CZ, CY, CX };
+  static const misize_t part_start[NDIMS] = { 7, 13, 29 };
+  static const misize_t part_count[NDIMS] = { 33, 41, 50 };
+  static const misize_t slice_start[NDIMS] = { 17, 0, 0 };
+  static const misize_t slice_count[NDIMS] = { 1, CY, CX };
+  mihandle_t vol;
+  int nthreads = -1;
+
+  create_test_file();
+
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &vol) < 0) {
+    TESTRPT("failed to open image", 0);
+    return (error_cnt);
+  }
+
+  if (miset_volume_io_threads(vol, NTHREADS) < 0 ||
+      miget_volume_io_threads(vol, &nthreads) < 0 || nthreads != NTHREADS) {
+    TESTRPT("failed to set I/O threads", nthreads);
+  }
+
+  check_read(vol, MI_TYPE_USHORT, FALSE, full_start, full_count);
+  check_read(vol, MI_TYPE_USHORT, FALSE, part_start, part_count);
+  check_read(vol, MI_TYPE_USHORT, FALSE, slice_start, slice_count);
+  check_read(vol, MI_TYPE_DOUBLE, TRUE, full_start, full_count);
+  check_read(vol, MI_TYPE_FLOAT, TRUE, part_start, part_count);
+  check_read(vol, MI_TYPE_DOUBLE, FALSE, part_start, part_count);
+
+  miclose_volume(vol);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
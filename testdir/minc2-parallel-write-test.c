@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "minc2.h"
+
+/* Checks that volumes written with several I/O threads, which deflate
+ * the chunks in parallel and store them directly, are identical to the
+ * ones written serially: both the voxels read back and the compressed
+ * chunks stored in the file must match.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+/* Not multiples of the chunk size, so there are edge chunks. */
+#define CZ 45
+#define CY 60
+#define CX 75
+#define CHUNK 16
+#define NDIMS 3
+#define NTHREADS 4
+
+#define SERIAL_FILE "parallel-write-serial.mnc"
+#define PARALLEL_FILE "parallel-write-parallel.mnc"
+#define IMAGE_PATH "/minc-2.0/image/0/image"
+
+static void write_test_file(const char *filename, int nthreads)
+{
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  mivolumeprops_t props;
+  short *buf;
+  double *real_buf;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { 30, CY, CX };
+  int edges[NDIMS] = { CHUNK, CHUNK, CHUNK };
+  int i;
+
+  micreate_dimension("zspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CZ, &hdim[0]);
+  micreate_dimension("yspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CY, &hdim[1]);
+  micreate_dimension("xspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CX, &hdim[2]);
+
+  minew_volume_props(&props);
+  miset_props_compression_type(props, MI_COMPRESS_ZLIB);
+  miset_props_zlib_compression(props, 5);
+  miset_props_blocking(props, NDIMS, edges);
+
+  micreate_volume(filename, NDIMS, hdim, MI_TYPE_SHORT,
+                  MI_CLASS_REAL, props, &hvol);
+  micreate_volume_image(hvol);
+  miset_volume_valid_range(hvol, 32767.0, -32768.0);
+  miset_volume_range(hvol, 10.0, -10.0);
+  mifree_volume_props(props);
+
+  if (miset_volume_io_threads(hvol, nthreads) < 0) {
+    TESTRPT("failed to set I/O threads", nthreads);
+  }
+
+  buf = (short *) malloc(CZ * CY * CX * sizeof(short));
+  real_buf = (double *) malloc(CZ * CY * CX * sizeof(double));
+  for (i = 0; i < CZ * CY * CX; i++) {
+    buf[i] = (short)(((i % CX) * (i / CX % CY)) / 7 + (i * 37) % 11);
+    real_buf[i] = (double)((i * 13) % 2001 - 1000) / 100.0;
+  }
+
+  /* Voxel values for the first slices, which ends inside a chunk. */
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count, buf) < 0) {
+    TESTRPT("failed to write voxel hyperslab", nthreads);
+  }
+
+  /* Real values for an unaligned block overlapping the voxel values. */
+  start[0] = 20; start[1] = 5; start[2] = 9;
+  count[0] = 25; count[1] = 50; count[2] = 66;
+  if (miset_real_value_hyperslab(hvol, MI_TYPE_DOUBLE, start, count,
+                                 real_buf) < 0) {
+    TESTRPT("failed to write real hyperslab", nthreads);
+  }
+
+  miclose_volume(hvol);
+  free(buf);
+  free(real_buf);
+}
+
+/* Compares the stored bytes of every chunk of the two files. */
+static void compare_chunks(void)
+{
+  hid_t f1 = H5Fopen(SERIAL_FILE, H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t f2 = H5Fopen(PARALLEL_FILE, H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t d1 = H5Dopen2(f1, IMAGE_PATH, H5P_DEFAULT);
+  hid_t d2 = H5Dopen2(f2, IMAGE_PATH, H5P_DEFAULT);
+  unsigned char *c1 = malloc(2 * CHUNK * CHUNK * CHUNK * sizeof(short));
+  unsigned char *c2 = malloc(2 * CHUNK * CHUNK * CHUNK * sizeof(short));
+  hsize_t offset[NDIMS];
+  int n_chunks = 0;
+
+  if (d1 < 0 || d2 < 0) {
+    TESTRPT("failed to open image datasets", 0);
+  }
+  for (offset[0] = 0; offset[0] < CZ; offset[0] += CHUNK) {
+    for (offset[1] = 0; offset[1] < CY; offset[1] += CHUNK) {
+      for (offset[2] = 0; offset[2] < CX; offset[2] += CHUNK) {
+        hsize_t s1 = 0, s2 = 0;
+        uint32_t m1, m2;
+
+        H5Dget_chunk_storage_size(d1, offset, &s1);
+        H5Dget_chunk_storage_size(d2, offset, &s2);
+        if (s1 != s2) {
+          TESTRPT("stored chunk sizes differ", (int) offset[0]);
+          continue;
+        }
+        if (H5Dread_chunk(d1, H5P_DEFAULT, offset, &m1, c1) < 0 ||
+            H5Dread_chunk(d2, H5P_DEFAULT, offset, &m2, c2) < 0 ||
+            m1 != m2 || memcmp(c1, c2, s1) != 0) {
+          TESTRPT("stored chunks differ", (int) offset[0]);
+        }
+        n_chunks++;
+      }
+    }
+  }
+  if (n_chunks == 0) {
+    TESTRPT("no chunks compared", 0);
+  }
+  free(c1);
+  free(c2);
+  H5Dclose(d1);
+  H5Dclose(d2);
+  H5Fclose(f1);
+  H5Fclose(f2);
+}
+
+/* Compares the real values read back from the two files. */
+static void compare_values(void)
+{
+  mihandle_t v1, v2;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { CZ, CY, CX };
+  double *b1 = (double *) malloc(CZ * CY * CX * sizeof(double));
+  double *b2 = (double *) malloc(CZ * CY * CX * sizeof(double));
+
+  if (miopen_volume(SERIAL_FILE, MI2_OPEN_READ, &v1) < 0 ||
+      miopen_volume(PARALLEL_FILE, MI2_OPEN_READ, &v2) < 0) {
+    TESTRPT("failed to open volumes", 0);
+    return;
+  }
+  if (miget_real_value_hyperslab(v1, MI_TYPE_DOUBLE, start, count, b1) < 0 ||
+      miget_real_value_hyperslab(v2, MI_TYPE_DOUBLE, start, count, b2) < 0) {
+    TESTRPT("failed to read volumes", 0);
+  } else if (memcmp(b1, b2, CZ * CY * CX * sizeof(double)) != 0) {
+    TESTRPT("volumes differ", 0);
+  }
+  miclose_volume(v1);
+  miclose_volume(v2);
+  free(b1);
+  free(b2);
+}
+
+int main(void)
+{
+  write_test_file(SERIAL_FILE, 0);
+  write_test_file(PARALLEL_FILE, NTHREADS);
+
+  compare_values();
+  compare_chunks();
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "minc2.h"
+
+/* Checks the lower resolution images of multi-resolution volumes against
+ * the box, Gaussian and mode filters computed here, for volumes with a
+ * single real range and with slice scaling, and checks that building
+ * them with several threads gives the same images.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+/* Odd sizes, so the last slices are clamped or dropped. */
+#define CZ 21
+#define CY 30
+#define CX 35
+#define NDIMS 3
+#define DEPTH 2
+#define NTHREADS 4
+#define NVOXELS (CZ * CY * CX)
+
+#define SERIAL_FILE "pyramid-test.mnc"
+#define PARALLEL_FILE "pyramid-test-threads.mnc"
+
+static void write_volume(const char *filename, miclass_t volume_class,
+                         mifilter_t filter, int nthreads, int slice_scaling,
+                         const short *buf)
+{
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  mivolumeprops_t props;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { CZ, CY, CX };
+  int edges[NDIMS] = { 8, 16, 16 };
+  int i;
+
+  micreate_dimension("zspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CZ, &hdim[0]);
+  micreate_dimension("yspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CY, &hdim[1]);
+  micreate_dimension("xspace", MI_DIMCLASS_SPATIAL,
+                     MI_DIMATTR_REGULARLY_SAMPLED, CX, &hdim[2]);
+
+  minew_volume_props(&props);
+  miset_props_compression_type(props, MI_COMPRESS_ZLIB);
+  miset_props_blocking(props, NDIMS, edges);
+  miset_props_multi_resolution(props, TRUE, DEPTH);
+  if (miset_props_resolution_filter(props, filter) < 0) {
+    TESTRPT("failed to set resolution filter", filter);
+  }
+
+  micreate_volume(filename, NDIMS, hdim, MI_TYPE_SHORT, volume_class,
+                  props, &hvol);
+  if (slice_scaling) {
+    miset_slice_scaling_flag(hvol, TRUE);
+  }
+  micreate_volume_image(hvol);
+  miset_volume_valid_range(hvol, 32767.0, -32768.0);
+  if (volume_class == MI_CLASS_REAL && !slice_scaling) {
+    miset_volume_range(hvol, 10.0, -10.0);
+  }
+  mifree_volume_props(props);
+  miset_volume_io_threads(hvol, nthreads);
+
+  if (miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count,
+                                  (void *) buf) < 0) {
+    TESTRPT("failed to write image", filter);
+  }
+  if (slice_scaling) {
+    for (i = 0; i < CZ; i++) {
+      start[0] = i;
+      miset_slice_range(hvol, start, NDIMS, 1.0 + 0.3 * i, -1.0 + 0.1 * i);
+    }
+  }
+  /* The lower resolution images are built when the volume is closed. */
+  if (miclose_volume(hvol) < 0) {
+    TESTRPT("failed to close volume", filter);
+  }
+}
+
+/* Reads a dataset of a resolution level as doubles. */
+static void read_level(const char *filename, int level, const char *name,
+                       double *buf)
+{
+  char path[128];
+  hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t dset_id;
+
+  sprintf(path, "/minc-2.0/image/%d/%s", level, name);
+  dset_id = H5Dopen2(file_id, path, H5P_DEFAULT);
+  if (dset_id < 0 ||
+      H5Dread(dset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+              buf) < 0) {
+    TESTRPT("failed to read level", level);
+  }
+  H5Dclose(dset_id);
+  H5Fclose(file_id);
+}
+
+static int clamp(int i, int n)
+{
+  return (i < 0) ? 0 : (i >= n) ? n - 1 : i;
+}
+
+/* Halves \a in along every dimension with the separable box or Gaussian
+ * filter, and returns the new sizes in \a n.
+ */
+static void reduce(const double *in, int n[NDIMS], double *out, int gaussian)
+{
+  static const double box[2] = { 0.5, 0.5 };
+  static const double gauss[4] = { 0.125, 0.375, 0.375, 0.125 };
+  const double *w = gaussian ? gauss : box;
+  int taps = gaussian ? 4 : 2;
+  int first = gaussian ? -1 : 0;
+  int z, y, x, a, b, c;
+
+  for (z = 0; z < n[0] / 2; z++) {
+    for (y = 0; y < n[1] / 2; y++) {
+      for (x = 0; x < n[2] / 2; x++) {
+        double sum = 0.0;
+
+        for (a = 0; a < taps; a++) {
+          for (b = 0; b < taps; b++) {
+            for (c = 0; c < taps; c++) {
+              int iz = clamp(2 * z + first + a, n[0]);
+              int iy = clamp(2 * y + first + b, n[1]);
+              int ix = clamp(2 * x + first + c, n[2]);
+
+              sum += w[a] * w[b] * w[c] * in[(iz * n[1] + iy) * n[2] + ix];
+            }
+          }
+        }
+        out[(z * (n[1] / 2) + y) * (n[2] / 2) + x] = sum;
+      }
+    }
+  }
+  for (a = 0; a < NDIMS; a++) {
+    n[a] /= 2;
+  }
+}
+
+/* Compares the voxels of the levels of \a filename with the filtered
+ * source, which must be rounded to the nearest integer.
+ */
+static void check_filter(const char *filename, const short *buf, int gaussian)
+{
+  double *expected = (double *) malloc(NVOXELS * sizeof(double));
+  double *next = (double *) malloc(NVOXELS * sizeof(double));
+  double *stored = (double *) malloc(NVOXELS * sizeof(double));
+  int n[NDIMS] = { CZ, CY, CX };
+  int level, i;
+
+  for (i = 0; i < NVOXELS; i++) {
+    expected[i] = buf[i];
+  }
+  for (level = 1; level <= DEPTH; level++) {
+    double *t;
+    int n_level;
+
+    reduce(expected, n, next, gaussian);
+    t = expected;
+    expected = next;
+    next = t;
+    n_level = n[0] * n[1] * n[2];
+
+    read_level(filename, level, "image", stored);
+    for (i = 0; i < n_level; i++) {
+      if (fabs(stored[i] - expected[i]) > 0.5 + 1e-9) {
+        TESTRPT("wrong filtered voxel", i);
+        break;
+      }
+    }
+
+    /* The single real range is kept by every level. */
+    read_level(filename, level, "image-max", stored);
+    for (i = 0; i < n[0]; i++) {
+      if (stored[i] != 10.0) {
+        TESTRPT("wrong image-max", i);
+        break;
+      }
+    }
+  }
+  free(expected);
+  free(next);
+  free(stored);
+}
+
+/* Compares the same level of two files. */
+static void check_identical(int level)
+{
+  double *b1 = (double *) malloc(NVOXELS * sizeof(double));
+  double *b2 = (double *) malloc(NVOXELS * sizeof(double));
+  int n = (CZ >> level) * (CY >> level) * (CX >> level);
+
+  read_level(SERIAL_FILE, level, "image", b1);
+  read_level(PARALLEL_FILE, level, "image", b2);
+  if (memcmp(b1, b2, n * sizeof(double)) != 0) {
+    TESTRPT("threaded build differs", level);
+  }
+  free(b1);
+  free(b2);
+}
+
+/* Checks the first level of a label image built with the mode filter. */
+static void check_mode(const short *buf)
+{
+  double *stored = (double *) malloc(NVOXELS * sizeof(double));
+  int z, y, x, a, b, c;
+
+  read_level(SERIAL_FILE, 1, "image", stored);
+  for (z = 0; z < CZ / 2; z++) {
+    for (y = 0; y < CY / 2; y++) {
+      for (x = 0; x < CX / 2; x++) {
+        int counts[8] = { 0 };
+        int best = 0;
+
+        for (a = 0; a < 2; a++) {
+          for (b = 0; b < 2; b++) {
+            for (c = 0; c < 2; c++) {
+              counts[buf[((2 * z + a) * CY + 2 * y + b) * CX + 2 * x + c]]++;
+            }
+          }
+        }
+        for (a = 1; a < 8; a++) {
+          if (counts[a] > counts[best]) {
+            best = a;
+          }
+        }
+        if (stored[(z * (CY / 2) + y) * (CX / 2) + x] != best) {
+          TESTRPT("wrong mode", z);
+          z = CZ;
+          y = CY;
+          break;
+        }
+      }
+    }
+  }
+  free(stored);
+}
+
+/* Checks the real values of the first level of a slice scaled image. */
+static void check_slice_scaled(const short *buf)
+{
+  int n[NDIMS] = { CZ, CY, CX };
+  int n_slice = (CY / 2) * (CX / 2);
+  double *real = (double *) malloc(NVOXELS * sizeof(double));
+  double *expected = (double *) malloc(NVOXELS * sizeof(double));
+  double *stored = (double *) malloc(NVOXELS * sizeof(double));
+  double smax[CZ], smin[CZ];
+  int i, z;
+
+  for (i = 0; i < NVOXELS; i++) {
+    z = i / (CY * CX);
+    real[i] = (buf[i] + 32768.0) / 65535.0 * (0.2 * z + 2.0) + (-1.0 + 0.1 * z);
+  }
+  reduce(real, n, expected, FALSE);
+
+  read_level(SERIAL_FILE, 1, "image", stored);
+  read_level(SERIAL_FILE, 1, "image-max", smax);
+  read_level(SERIAL_FILE, 1, "image-min", smin);
+  for (z = 0; z < CZ / 2; z++) {
+    double quantum = (smax[z] - smin[z]) / 65535.0;
+
+    for (i = z * n_slice; i < (z + 1) * n_slice; i++) {
+      double v = (stored[i] + 32768.0) * quantum + smin[z];
+
+      if (fabs(v - expected[i]) > quantum) {
+        TESTRPT("wrong slice scaled value", i);
+        z = CZ;
+        break;
+      }
+    }
+  }
+  free(real);
+  free(expected);
+  free(stored);
+}
+
+int main(void)
+{
+  short *buf = (short *) malloc(NVOXELS * sizeof(short));
+  int i;
+
+  for (i = 0; i < NVOXELS; i++) {
+    int x = i % CX, y = (i / CX) % CY, z = i / (CX * CY);
+    buf[i] = (short)((x - CX / 2) * (x - CX / 2) * 20 + y * 300 - z * 500 +
+                     (i * 7919) % 97);
+  }
+
+  write_volume(SERIAL_FILE, MI_CLASS_REAL, MI_FILTER_BOX, 0, FALSE, buf);
+  check_filter(SERIAL_FILE, buf, FALSE);
+  write_volume(PARALLEL_FILE, MI_CLASS_REAL, MI_FILTER_BOX, NTHREADS, FALSE,
+               buf);
+  check_identical(1);
+  check_identical(2);
+
+  write_volume(SERIAL_FILE, MI_CLASS_REAL, MI_FILTER_GAUSSIAN, 0, FALSE, buf);
+  check_filter(SERIAL_FILE, buf, TRUE);
+  write_volume(PARALLEL_FILE, MI_CLASS_REAL, MI_FILTER_GAUSSIAN, NTHREADS,
+               FALSE, buf);
+  check_identical(1);
+  check_identical(2);
+
+  write_volume(SERIAL_FILE, MI_CLASS_REAL, MI_FILTER_DEFAULT, 0, TRUE, buf);
+  check_slice_scaled(buf);
+
+  /* Labels 0 to 5 in blocks which do not line up with the 2x2x2 ones. */
+  for (i = 0; i < NVOXELS; i++) {
+    int x = i % CX, y = (i / CX) % CY, z = i / (CX * CY);
+    buf[i] = (short)((x / 3 + y / 5 + z / 3) % 6);
+  }
+  write_volume(SERIAL_FILE, MI_CLASS_INT, MI_FILTER_MODE, 0, FALSE, buf);
+  check_mode(buf);
+  write_volume(PARALLEL_FILE, MI_CLASS_INT, MI_FILTER_MODE, NTHREADS, FALSE,
+               buf);
+  check_identical(1);
+
+  free(buf);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "minc2.h"
+#include "minc2_private.h"
+#include "config.h"
+
+/* Checks that the voxel scaling kernels for each voxel/real type pair,
+ * and the range kernel for each voxel type, give the same results with
+ * every instruction set available on this machine as the scalar code,
+ * and that NaNs are stored as 0 in integer voxels.  Given -benchmark, it
+ * also measures the throughput of each kernel.  A further argument sets
+ * the number of voxels.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, printf(\
+                                  "Error reported on line #%d, %s: %d\n", \
+                                  __LINE__, msg, val))
+
+#define N_REPEAT 20
+
+static const mitype_t voxel_types[] = {
+  MI_TYPE_BYTE, MI_TYPE_UBYTE, MI_TYPE_SHORT, MI_TYPE_USHORT,
+  MI_TYPE_INT, MI_TYPE_UINT, MI_TYPE_FLOAT, MI_TYPE_DOUBLE
+};
+
+static const char *voxel_names[] = {
+  "byte", "ubyte", "short", "ushort", "int", "uint", "float", "double"
+};
+
+#define N_VOXEL_TYPES (sizeof(voxel_types) / sizeof(voxel_types[0]))
+
+/* Fill the buffer with a repeatable pattern covering the whole type. */
+static void fill_voxels(unsigned char *buffer, size_t nbytes)
+{
+  size_t i;
+  unsigned int seed = 12345;
+
+  for (i = 0; i < nbytes; i++) {
+    seed = seed * 1103515245 + 12345;
+    buffer[i] = (unsigned char)(seed >> 16);
+  }
+}
+
+/* Float and double patterns from random bytes may hold NaNs, which
+ * never compare equal, so those are built from integers instead.
+ */
+static void fill_reals(mitype_t mitype, void *buffer, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    double v = (double)(long)(i * 2654435761u % 65536) - 32768.0;
+    if (mitype == MI_TYPE_FLOAT) {
+      ((float *)buffer)[i] = (float)(v / 7.0);
+    } else {
+      ((double *)buffer)[i] = v / 7.0;
+    }
+  }
+}
+
+/* Scales reals holding NaNs into each integer voxel type, which must
+ * store them as 0, as HDF5 does.
+ */
+static int check_nan_to_voxel(void)
+{
+  float fvalues[4];
+  double dvalues[4];
+  double voxels[4];
+  double back[4];
+  int error_cnt = 0;
+  size_t t;
+  int d, i;
+
+  fvalues[0] = fvalues[2] = (float) nan("");
+  fvalues[1] = 3.0f;
+  fvalues[3] = -2.0f;
+  for (i = 0; i < 4; i++) {
+    dvalues[i] = fvalues[i];
+  }
+  for (t = 0; t < N_VOXEL_TYPES; t++) {
+    if (voxel_types[t] == MI_TYPE_FLOAT || voxel_types[t] == MI_TYPE_DOUBLE) {
+      continue;
+    }
+    for (d = 0; d < 2; d++) {
+      memset(voxels, 0x5a, sizeof(voxels));
+      if (miscale_from_real(d ? MI_TYPE_DOUBLE : MI_TYPE_FLOAT,
+                            d ? (void *) dvalues : (void *) fvalues,
+                            voxel_types[t], voxels, 4, 1.0, 0.0) < 0 ||
+          miscale_to_real(voxel_types[t], voxels, MI_TYPE_DOUBLE, back, 4,
+                          1.0, 0.0) < 0) {
+        TESTRPT("miscale_from_real failed", (int) t);
+        continue;
+      }
+      if (back[0] != 0.0 || back[2] != 0.0) {
+        printf("NaN not stored as 0 in %s from %s\n", voxel_names[t],
+               d ? "double" : "float");
+        TESTRPT("NaN voxel", (int) t);
+      }
+      if (back[1] != 3.0 ||
+          back[3] != ((voxel_types[t] == MI_TYPE_UBYTE ||
+                       voxel_types[t] == MI_TYPE_USHORT ||
+                       voxel_types[t] == MI_TYPE_UINT) ? 0.0 : -2.0)) {
+        TESTRPT("Wrong voxel next to a NaN", (int) t);
+      }
+    }
+  }
+  return (error_cnt);
+}
+
+int main(int argc, char **argv)
+{
+  size_t n = 1 << 20;
+  int run_benchmarks = FALSE;
+  int n_repeat = 1;
+  unsigned char *voxels;
+  unsigned char *reference;
+  unsigned char *result;
+  int error_cnt = 0;
+  int best_isa;
+  int isa;
+  size_t t;
+  int d;
+  int a;
+
+  for (a = 1; a < argc; a++) {
+    if (strcmp(argv[a], "-benchmark") == 0) {
+      run_benchmarks = TRUE;
+      n_repeat = N_REPEAT;
+    } else {
+      n = (size_t) atol(argv[a]);
+    }
+  }
+
+  /* Odd length so that the scalar tail is exercised as well. */
+  n |= 1;
+
+  voxels = malloc(n * sizeof(double));
+  reference = malloc(n * sizeof(double));
+  result = malloc(n * sizeof(double));
+  if (voxels == NULL || reference == NULL || result == NULL) {
+    TESTRPT("Out of memory", 0);
+    return 1;
+  }
+
+  best_isa = miscale_get_isa();
+  printf("Scaling kernels, %lu voxels, best instruction set: %s\n",
+         (unsigned long) n, miscale_isa_name(best_isa));
+
+  for (t = 0; t < N_VOXEL_TYPES; t++) {
+    if (voxel_types[t] == MI_TYPE_FLOAT || voxel_types[t] == MI_TYPE_DOUBLE) {
+      fill_reals(voxel_types[t], voxels, n);
+    } else {
+      fill_voxels(voxels, n * mitype_len(voxel_types[t]));
+    }
+
+    for (d = 0; d < 2; d++) {
+      mitype_t real_type = d ? MI_TYPE_DOUBLE : MI_TYPE_FLOAT;
+      size_t real_bytes = n * mitype_len(real_type);
+
+      for (isa = MI2_SIMD_SCALAR; isa <= best_isa; isa++) {
+        clock_t t0, t1;
+        double seconds;
+        int r;
+
+        miscale_set_isa(isa);
+
+        t0 = clock();
+        for (r = 0; r < n_repeat; r++) {
+          if (miscale_to_real(voxel_types[t], voxels, real_type, result,
+                              n, 0.0123, -17.5) < 0) {
+            TESTRPT("miscale_to_real failed", r);
+          }
+        }
+        t1 = clock();
+        seconds = (double)(t1 - t0) / CLOCKS_PER_SEC;
+
+        if (isa == MI2_SIMD_SCALAR) {
+          memcpy(reference, result, real_bytes);
+        } else if (memcmp(reference, result, real_bytes) != 0) {
+          printf("%s output differs from scalar for %s -> %s\n",
+                 miscale_isa_name(isa), voxel_names[t],
+                 d ? "double" : "float");
+          TESTRPT("Kernel mismatch", isa);
+        }
+
+        if (run_benchmarks) {
+          printf("%-6s -> %-6s %-6s %10.1f Mvoxels/s\n",
+                 voxel_names[t], d ? "double" : "float",
+                 miscale_isa_name(isa),
+                 seconds > 0.0 ? (double) n * n_repeat / seconds / 1.0e6 : 0.0);
+        }
+      }
+    }
+
+    for (isa = MI2_SIMD_SCALAR; isa <= best_isa; isa++) {
+      static double ref_min, ref_max;
+      double vmin, vmax;
+      clock_t t0, t1;
+      double seconds;
+      int r;
+
+      miscale_set_isa(isa);
+
+      t0 = clock();
+      for (r = 0; r < n_repeat; r++) {
+        if (miscale_minmax(voxel_types[t], voxels, n, &vmin, &vmax) < 0) {
+          TESTRPT("miscale_minmax failed", r);
+        }
+      }
+      t1 = clock();
+      seconds = (double)(t1 - t0) / CLOCKS_PER_SEC;
+
+      if (isa == MI2_SIMD_SCALAR) {
+        ref_min = vmin;
+        ref_max = vmax;
+      } else if (vmin != ref_min || vmax != ref_max) {
+        printf("%s range differs from scalar for %s\n",
+               miscale_isa_name(isa), voxel_names[t]);
+        TESTRPT("Range mismatch", isa);
+      }
+
+      if (run_benchmarks) {
+        printf("%-6s    %-6s %-6s %10.1f Mvoxels/s\n",
+               voxel_names[t], "range", miscale_isa_name(isa),
+               seconds > 0.0 ? (double) n * n_repeat / seconds / 1.0e6 : 0.0);
+      }
+    }
+  }
+  miscale_set_isa(best_isa);
+
+  error_cnt += check_nan_to_voxel();
+
+  free(voxels);
+  free(reference);
+  free(result);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
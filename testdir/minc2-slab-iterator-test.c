@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "minc2.h"
+
+/* Reads a compressed, slice scaled volume through slab iterators of
+ * several shapes, modes and prefetch depths, comparing every slab with
+ * the whole image read at once, and measures a slice by slice loop which
+ * alternates reading and processing with and without prefetching.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NZ 48
+#define NY 96
+#define NX 80
+#define NDIMS 3
+#define NVOXELS (NZ * NY * NX)
+
+#define FILENAME "slab-iterator.mnc"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void create_test_file(void)
+{
+  static const char *names[NDIMS] = { "zspace", "yspace", "xspace" };
+  static const misize_t lengths[NDIMS] = { NZ, NY, NX };
+  short *buf = (short *) malloc(NVOXELS * sizeof(short));
+  midimhandle_t hdim[NDIMS];
+  mivolumeprops_t props;
+  mihandle_t hvol;
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { NZ, NY, NX };
+  int i;
+
+  for (i = 0; i < NVOXELS; i++) {
+    buf[i] = (short) ((i * 37) % 8000 - 4000 + (i / NX) % 11);
+  }
+  for (i = 0; i < NDIMS; i++) {
+    micreate_dimension(names[i], MI_DIMCLASS_SPATIAL,
+                       MI_DIMATTR_REGULARLY_SAMPLED, lengths[i], &hdim[i]);
+  }
+  minew_volume_props(&props);
+  miset_props_compression_type(props, MI_COMPRESS_ZLIB);
+  miset_props_zlib_compression(props, 4);
+  if (micreate_volume(FILENAME, NDIMS, hdim, MI_TYPE_SHORT, MI_CLASS_REAL,
+                      props, &hvol) < 0) {
+    TESTRPT("failed to create volume", 0);
+    mifree_volume_props(props);
+    free(buf);
+    return;
+  }
+  mifree_volume_props(props);
+  miset_slice_scaling_flag(hvol, TRUE);
+  micreate_volume_image(hvol);
+  miset_volume_valid_range(hvol, 4010.0, -4000.0);
+  miset_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count, buf);
+  for (start[0] = 0; start[0] < NZ; start[0]++) {
+    miset_slice_range(hvol, start, NDIMS, 100.0 + start[0], -50.0 - start[0]);
+  }
+  miclose_volume(hvol);
+  free(buf);
+}
+
+/* Checks every slab of an iterator against the whole image. */
+static void check_iterator(mihandle_t hvol, mislabmode_t mode, mitype_t type,
+                           const misize_t shape[], int prefetch,
+                           const void *image)
+{
+  size_t size = (type == MI_TYPE_FLOAT) ? sizeof(float) :
+                (type == MI_TYPE_USHORT) ? sizeof(unsigned short) : sizeof(short);
+  misize_t start[NDIMS], count[NDIMS];
+  misize_t n_slabs, n = 0, n_voxels = 0;
+  mislabiter_t it;
+  void *buffer;
+  misize_t z, y;
+
+  if (mistart_slab_iterator(hvol, mode, type, shape, -100.0, 200.0,
+                            prefetch, &it) < 0) {
+    TESTRPT("failed to start iterator", prefetch);
+    return;
+  }
+  miget_slab_count(it, &n_slabs);
+
+  while (minext_slab(it, start, count, &buffer) == MI_NOERROR &&
+         buffer != NULL) {
+    const char *slab = (const char *) buffer;
+
+    for (z = 0; z < count[0]; z++) {
+      for (y = 0; y < count[1]; y++) {
+        const char *expected = (const char *) image +
+          (((start[0] + z) * NY + start[1] + y) * NX + start[2]) * size;
+        if (memcmp(slab + (z * count[1] + y) * count[2] * size, expected,
+                   count[2] * size) != 0) {
+          TESTRPT("wrong slab", (int) n);
+          mifree_slab_iterator(it);
+          return;
+        }
+      }
+    }
+    n_voxels += count[0] * count[1] * count[2];
+    n++;
+  }
+  if (buffer != NULL) {
+    TESTRPT("failed to read slab", (int) n);
+  }
+  if (n != n_slabs || n_voxels != NVOXELS) {
+    TESTRPT("wrong number of slabs", (int) n);
+  }
+  /* Past the end the iterator keeps returning no slab. */
+  if (minext_slab(it, NULL, NULL, &buffer) < 0 || buffer != NULL) {
+    TESTRPT("slab past the end", 0);
+  }
+  mifree_slab_iterator(it);
+}
+
+/* Stands for the work done on a slice. */
+static double process_slice(const float *slice)
+{
+  double sum = 0.0;
+  int pass, i;
+
+  for (pass = 0; pass < 8; pass++) {
+    for (i = 0; i < NY * NX; i++) {
+      sum += sqrt(fabs(slice[i]) + pass);
+    }
+  }
+  return sum;
+}
+
+int main(void)
+{
+  static const misize_t shapes[][NDIMS] = {
+    { 1, 0, 0 },                /* Slices */
+    { 5, 0, 0 },                /* Slabs of slices, the last one shorter */
+    { 0, 7, 0 },                /* Along the second dimension */
+    { 0, 0, 9 },                /* Along the last dimension */
+    { 3, 10, 16 },              /* Blocks */
+  };
+  static const int depths[] = { 0, 1, 3 };
+  misize_t start[NDIMS] = { 0, 0, 0 };
+  misize_t count[NDIMS] = { NZ, NY, NX };
+  misize_t slice_count[NDIMS] = { 1, NY, NX };
+  short *voxels = (short *) malloc(NVOXELS * sizeof(short));
+  float *reals = (float *) malloc(NVOXELS * sizeof(float));
+  unsigned short *normalized = (unsigned short *) malloc(NVOXELS * sizeof(unsigned short));
+  float *slice = (float *) malloc(NY * NX * sizeof(float));
+  double t0, t_sync, t_prefetch, sum_sync = 0.0, sum_prefetch = 0.0;
+  mislabiter_t it;
+  mihandle_t hvol;
+  void *buffer;
+  size_t s, d;
+  int i;
+
+  create_test_file();
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open volume", 0);
+    return error_cnt;
+  }
+  miget_voxel_value_hyperslab(hvol, MI_TYPE_SHORT, start, count, voxels);
+  miget_real_value_hyperslab(hvol, MI_TYPE_FLOAT, start, count, reals);
+  miget_hyperslab_normalized(hvol, MI_TYPE_USHORT, start, count, -100.0, 200.0,
+                             normalized);
+
+  for (s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+    for (d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+      check_iterator(hvol, MI_SLAB_VOXEL, MI_TYPE_SHORT, shapes[s], depths[d], voxels);
+      check_iterator(hvol, MI_SLAB_REAL, MI_TYPE_FLOAT, shapes[s], depths[d], reals);
+      check_iterator(hvol, MI_SLAB_NORMALIZED, MI_TYPE_USHORT, shapes[s], depths[d],
+                     normalized);
+    }
+  }
+
+  /* An iterator freed before its end stops reading ahead. */
+  if (mistart_slab_iterator(hvol, MI_SLAB_REAL, MI_TYPE_FLOAT, slice_count,
+                            0.0, 0.0, 4, &it) < 0) {
+    TESTRPT("failed to start iterator", 0);
+  } else {
+    minext_slab(it, NULL, NULL, &buffer);
+    minext_slab(it, NULL, NULL, &buffer);
+    if (buffer == NULL || memcmp(buffer, reals + NY * NX, NY * NX * sizeof(float)) != 0) {
+      TESTRPT("wrong second slice", 0);
+    }
+    mifree_slab_iterator(it);
+  }
+
+  /* Reading then processing each slice in turn, against processing each
+   * slice while the next ones are read.
+   */
+  t0 = now();
+  for (i = 0; i < NZ; i++) {
+    start[0] = i;
+    miget_real_value_hyperslab(hvol, MI_TYPE_FLOAT, start, slice_count, slice);
+    sum_sync += process_slice(slice);
+  }
+  t_sync = now() - t0;
+
+  t0 = now();
+  mistart_slab_iterator(hvol, MI_SLAB_REAL, MI_TYPE_FLOAT, slice_count,
+                        0.0, 0.0, 2, &it);
+  while (minext_slab(it, NULL, NULL, &buffer) == MI_NOERROR && buffer != NULL) {
+    sum_prefetch += process_slice((const float *) buffer);
+  }
+  mifree_slab_iterator(it);
+  t_prefetch = now() - t0;
+
+  if (sum_sync != sum_prefetch) {
+    TESTRPT("prefetched slices differ", 0);
+  }
+  printf("%d slices read and processed: in turn %.1f ms, prefetching %.1f ms (%.2fx)\n",
+         NZ, t_sync * 1e3, t_prefetch * 1e3, t_sync / t_prefetch);
+
+  miclose_volume(hvol);
+  free(voxels);
+  free(reals);
+  free(normalized);
+  free(slice);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
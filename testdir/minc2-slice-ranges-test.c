@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "minc2.h"
+
+/* Checks the batched slice range functions against the per-slice ones
+ * on a 4D slice scaled volume, with file order and with a flipped
+ * dimension, checks that the ranges cached on the handle are written
+ * when it is closed, and compares the time taken to set the ranges of every
+ * slice one at a time and in one call.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NT 12
+#define NZ 40
+#define NY 32
+#define NX 33
+#define NDIMS 4
+#define N_SLICES (NT * NZ)
+#define SLICE_N (NY * NX)
+
+#define FILENAME "slice-ranges-test.mnc"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double value(int slice, int i)
+{
+  return sin(i * 0.37 + slice) * (slice + 1) + slice * 0.5;
+}
+
+static mihandle_t create_volume(void)
+{
+  static const char *names[NDIMS] = { "time", "zspace", "yspace", "xspace" };
+  static const misize_t lengths[NDIMS] = { NT, NZ, NY, NX };
+  midimhandle_t hdim[NDIMS];
+  mihandle_t hvol;
+  int i;
+
+  for (i = 0; i < NDIMS; i++) {
+    micreate_dimension(names[i], i == 0 ? MI_DIMCLASS_TIME : MI_DIMCLASS_SPATIAL,
+                       MI_DIMATTR_REGULARLY_SAMPLED, lengths[i], &hdim[i]);
+  }
+  micreate_volume(FILENAME, NDIMS, hdim, MI_TYPE_SHORT, MI_CLASS_REAL,
+                  NULL, &hvol);
+  miset_slice_scaling_flag(hvol, TRUE);
+  micreate_volume_image(hvol);
+  return hvol;
+}
+
+/* Compares the batched ranges of a hyperslab with the per-slice ones. */
+static void check_ranges(mihandle_t hvol, const misize_t start[],
+                         const misize_t count[])
+{
+  double *smax = (double *) malloc(N_SLICES * sizeof(double));
+  double *smin = (double *) malloc(N_SLICES * sizeof(double));
+  misize_t coords[NDIMS] = { 0, 0, 0, 0 };
+  int t, z, k = 0;
+
+  if (miget_slice_ranges(hvol, start, count, smax, smin) < 0) {
+    TESTRPT("failed to get slice ranges", 0);
+  }
+  for (t = 0; t < (int) count[0]; t++) {
+    for (z = 0; z < (int) count[1]; z++, k++) {
+      double vmax, vmin;
+
+      coords[0] = start[0] + t;
+      coords[1] = start[1] + z;
+      miget_slice_range(hvol, coords, NDIMS, &vmax, &vmin);
+      if (smax[k] != vmax || smin[k] != vmin) {
+        TESTRPT("batched range differs", k);
+        free(smax);
+        free(smin);
+        return;
+      }
+    }
+  }
+  free(smax);
+  free(smin);
+}
+
+int main(void)
+{
+  double *buf = (double *) malloc(N_SLICES * SLICE_N * sizeof(double));
+  double *back = (double *) malloc(N_SLICES * SLICE_N * sizeof(double));
+  double smax[N_SLICES], smin[N_SLICES];
+  misize_t start[NDIMS] = { 0, 0, 0, 0 };
+  misize_t count[NDIMS] = { NT, NZ, NY, NX };
+  misize_t part_start[NDIMS] = { 3, 5, 0, 0 };
+  misize_t part_count[NDIMS] = { 4, 17, NY, NX };
+  misize_t coords[NDIMS] = { 0, 0, 0, 0 };
+  midimhandle_t hdims[NDIMS];
+  mihandle_t hvol;
+  double t_single, t_batch, t0;
+  int k, i;
+
+  for (k = 0; k < N_SLICES; k++) {
+    for (i = 0; i < SLICE_N; i++) {
+      buf[k * SLICE_N + i] = value(k, i);
+    }
+  }
+  /* NaNs are left out of the ranges. */
+  buf[7 * SLICE_N + 3] = NAN;
+  buf[8 * SLICE_N] = NAN;
+
+  hvol = create_volume();
+  if (miset_slice_ranges_from_hyperslab(hvol, MI_TYPE_DOUBLE, start, count,
+                                        buf) < 0) {
+    TESTRPT("failed to set ranges from hyperslab", 0);
+  }
+  for (k = 0; k < N_SLICES; k++) {
+    double emax = -HUGE_VAL, emin = HUGE_VAL, vmax, vmin;
+
+    for (i = 0; i < SLICE_N; i++) {
+      double v = buf[k * SLICE_N + i];
+      if (v > emax) emax = v;
+      if (v < emin) emin = v;
+    }
+    coords[0] = k / NZ;
+    coords[1] = k % NZ;
+    miget_slice_range(hvol, coords, NDIMS, &vmax, &vmin);
+    if (vmax != emax || vmin != emin) {
+      TESTRPT("wrong slice range", k);
+      break;
+    }
+  }
+
+  /* The real values written go through the ranges just set. */
+  buf[7 * SLICE_N + 3] = buf[8 * SLICE_N] = 0.0;
+  miset_slice_ranges_from_hyperslab(hvol, MI_TYPE_DOUBLE, start, count, buf);
+  miset_real_value_hyperslab(hvol, MI_TYPE_DOUBLE, start, count, buf);
+  miget_real_value_hyperslab(hvol, MI_TYPE_DOUBLE, start, count, back);
+  for (k = 0; k < N_SLICES; k++) {
+    double quantum;
+
+    coords[0] = k / NZ;
+    coords[1] = k % NZ;
+    miget_slice_range(hvol, coords, NDIMS, &smax[0], &smin[0]);
+    quantum = (smax[0] - smin[0]) / 65535.0;
+    for (i = 0; i < SLICE_N; i++) {
+      if (fabs(back[k * SLICE_N + i] - buf[k * SLICE_N + i]) > quantum) {
+        TESTRPT("wrong real value", k);
+        k = N_SLICES;
+        break;
+      }
+    }
+  }
+
+  check_ranges(hvol, start, count);
+  check_ranges(hvol, part_start, part_count);
+
+  /* Per-slice writes against a single batched write. */
+  for (k = 0; k < N_SLICES; k++) {
+    smax[k] = k + 1.0;
+    smin[k] = -k - 1.0;
+  }
+  t0 = now();
+  for (k = 0; k < N_SLICES; k++) {
+    coords[0] = k / NZ;
+    coords[1] = k % NZ;
+    miset_slice_range(hvol, coords, NDIMS, smax[k], smin[k]);
+  }
+  t_single = now() - t0;
+  t0 = now();
+  if (miset_slice_ranges(hvol, start, count, smax, smin) < 0) {
+    TESTRPT("failed to set slice ranges", 0);
+  }
+  t_batch = now() - t0;
+  printf("%d slices: miset_slice_range %.3f ms, miset_slice_ranges %.3f ms\n",
+         N_SLICES, t_single * 1000.0, t_batch * 1000.0);
+  check_ranges(hvol, start, count);
+  miclose_volume(hvol);
+
+  /* A flipped slice dimension reverses the order of the ranges. */
+  if (miopen_volume(FILENAME, MI2_OPEN_RDWR, &hvol) < 0) {
+    TESTRPT("failed to open volume", 0);
+    return (error_cnt);
+  }
+  /* The cached ranges were written back when the volume was closed. */
+  for (k = 0; k < N_SLICES; k++) {
+    double vmax, vmin;
+
+    coords[0] = k / NZ;
+    coords[1] = k % NZ;
+    miget_slice_range(hvol, coords, NDIMS, &vmax, &vmin);
+    if (vmax != k + 1.0 || vmin != -k - 1.0) {
+      TESTRPT("range not written on close", k);
+      break;
+    }
+  }
+  miget_volume_real_range(hvol, smax);
+  if (smax[0] != -N_SLICES || smax[1] != N_SLICES) {
+    TESTRPT("wrong volume real range", (int) smax[1]);
+  }
+  miget_volume_dimensions(hvol, MI_DIMCLASS_ANY, MI_DIMATTR_ALL,
+                          MI_DIMORDER_FILE, NDIMS, hdims);
+  miset_dimension_apparent_voxel_order(hdims[1], MI_COUNTER_FILE_ORDER);
+  check_ranges(hvol, part_start, part_count);
+  for (k = 0; k < part_count[0] * part_count[1]; k++) {
+    smax[k] = 100.0 + k;
+    smin[k] = -100.0 - k;
+  }
+  miset_slice_ranges(hvol, part_start, part_count, smax, smin);
+  for (k = 0; k < part_count[0] * part_count[1]; k++) {
+    double vmax, vmin;
+
+    coords[0] = part_start[0] + k / part_count[1];
+    coords[1] = part_start[1] + k % part_count[1];
+    miget_slice_range(hvol, coords, NDIMS, &vmax, &vmin);
+    if (vmax != smax[k] || vmin != smin[k]) {
+      TESTRPT("wrong flipped slice range", k);
+      break;
+    }
+  }
+  check_ranges(hvol, start, count);
+  if (miclose_volume(hvol) < 0) {
+    TESTRPT("failed to close volume", 0);
+  }
+
+  /* The ranges of a volume opened read-only cannot be changed. */
+  if (miopen_volume(FILENAME, MI2_OPEN_READ, &hvol) < 0) {
+    TESTRPT("failed to open volume read-only", 0);
+    return (error_cnt);
+  }
+  coords[0] = 0;
+  coords[1] = 0;
+  miget_slice_range(hvol, coords, NDIMS, &smax[0], &smin[0]);
+  if (miset_slice_range(hvol, coords, NDIMS, 99.0, -99.0) == 0) {
+    TESTRPT("set slice range of a read-only volume", 0);
+  }
+  if (miset_slice_ranges(hvol, part_start, part_count, smax, smin) == 0) {
+    TESTRPT("set slice ranges of a read-only volume", 0);
+  }
+  miget_slice_range(hvol, coords, NDIMS, &smax[1], &smin[1]);
+  if (smax[1] != smax[0] || smin[1] != smin[0]) {
+    TESTRPT("range of a read-only volume changed", (int) smax[1]);
+  }
+  miclose_volume(hvol);
+
+  free(buf);
+  free(back);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
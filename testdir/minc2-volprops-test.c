@@ -7,6 +7,82 @@
 
 static int error_cnt = 0;
 
+/* Checks the chunk shapes chosen for each access pattern of a 4D
+ * volume of 120 time points.
+ */
+static void test_access_patterns(void)
+{
+  static const char *names[4] = { "time", "zspace", "yspace", "xspace" };
+  static const misize_t lengths[4] = { 120, 40, 64, 64 };
+  midimhandle_t dims[4];
+  mivolumeprops_t props;
+  int edges[MI2_MAX_VAR_DIMS];
+  int edge_count;
+  size_t cache_size, cache_slots;
+  size_t n_voxels;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    micreate_dimension(names[i], i == 0 ? MI_DIMCLASS_TIME : MI_DIMCLASS_SPATIAL,
+                       MI_DIMATTR_REGULARLY_SAMPLED, lengths[i], &dims[i]);
+  }
+  minew_volume_props(&props);
+
+  /* The series of a voxel must lie in a single chunk. */
+  if (miset_props_access_pattern(props, MI_ACCESS_TIMESERIES, NULL, 4, dims,
+                                 MI_TYPE_SHORT) < 0) {
+    TESTRPT("failed", MI_ACCESS_TIMESERIES);
+  }
+  miget_props_blocking(props, &edge_count, edges, MI2_MAX_VAR_DIMS);
+  miget_props_chunk_cache(props, &cache_size, &cache_slots);
+  if (edge_count != 4 || edges[0] != 120 || cache_size < 1 << 20 ||
+      cache_slots == 0) {
+    TESTRPT("bad time series chunks", edges[0]);
+  }
+
+  /* Slices along z are one voxel thick. */
+  if (miset_props_access_pattern(props, MI_ACCESS_SLICES, "zspace", 4, dims,
+                                 MI_TYPE_SHORT) < 0) {
+    TESTRPT("failed", MI_ACCESS_SLICES);
+  }
+  miget_props_blocking(props, &edge_count, edges, MI2_MAX_VAR_DIMS);
+  if (edges[1] != 1) {
+    TESTRPT("bad slice chunks", edges[1]);
+  }
+
+  /* Patches are small and one time point thick. */
+  if (miset_props_access_pattern(props, MI_ACCESS_PATCHES, NULL, 4, dims,
+                                 MI_TYPE_FLOAT) < 0) {
+    TESTRPT("failed", MI_ACCESS_PATCHES);
+  }
+  miget_props_blocking(props, &edge_count, edges, MI2_MAX_VAR_DIMS);
+  n_voxels = (size_t) edges[0] * edges[1] * edges[2] * edges[3];
+  if (edges[0] != 1 || n_voxels * sizeof(float) > 64 << 10 ||
+      edges[1] < 8 || edges[2] < 8 || edges[3] < 8) {
+    TESTRPT("bad patch chunks", (int) n_voxels);
+  }
+
+  if (miset_props_access_pattern(props, MI_ACCESS_VOLUME, NULL, 4, dims,
+                                 MI_TYPE_SHORT) < 0) {
+    TESTRPT("failed", MI_ACCESS_VOLUME);
+  }
+  miget_props_blocking(props, &edge_count, edges, MI2_MAX_VAR_DIMS);
+  n_voxels = (size_t) edges[0] * edges[1] * edges[2] * edges[3];
+  if (n_voxels * sizeof(short) > 1 << 20 || n_voxels * sizeof(short) < 1 << 19) {
+    TESTRPT("bad volume chunks", (int) n_voxels);
+  }
+
+  if (miset_props_access_pattern(props, MI_ACCESS_SLICES, "vector_dimension",
+                                 4, dims, MI_TYPE_SHORT) == MI_NOERROR) {
+    TESTRPT("accepted unknown dimension", 0);
+  }
+
+  mifree_volume_props(props);
+  for (i = 0; i < 4; i++) {
+    mifree_dimension_handle(dims[i]);
+  }
+}
+
 
 int main(int argc, char **argv)
 {
@@ -75,6 +151,8 @@ int main(int argc, char **argv)
 
   mifree_volume_props(props);
 
+  test_access_patterns();
+
   while (--argc > 0) {
       r = miopen_volume(*++argv, MI2_OPEN_RDWR, &vol);
       if (r < 0) {
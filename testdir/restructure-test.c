@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "restructure.h"
+
+/* Checks that restructure_array_copy() produces the same result as the
+ * in-place restructure_array() for random shapes, dimension orders,
+ * flips and element sizes.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, printf(\
+                                  "Error reported on line #%d, %s: %d\n", \
+                                  __LINE__, msg, val))
+
+#define N_TRIALS 400
+#define MAX_DIMS 5
+
+int main(void)
+{
+  static const size_t el_sizes[] = { 1, 2, 3, 4, 8 };
+  int error_cnt = 0;
+  int trial;
+
+  srand(1234);
+
+  for (trial = 0; trial < N_TRIALS; trial++) {
+    size_t ndims = 1 + rand() % MAX_DIMS;
+    size_t el_size = el_sizes[rand() % 5];
+    size_t lengths_perm[MAX_DIMS];
+    int map[MAX_DIMS];
+    int dir[MAX_DIMS];
+    size_t total = el_size;
+    unsigned char *orig, *in_place, *copy;
+    size_t i;
+
+    for (i = 0; i < ndims; i++) {
+      /* Mostly small edges, now and then longer than a tile. */
+      lengths_perm[i] = 1 + rand() % ((rand() % 4 == 0) ? 70 : 9);
+      total *= lengths_perm[i];
+      map[i] = (int) i;
+      dir[i] = (rand() % 2) ? 1 : -1;
+    }
+    for (i = ndims - 1; i > 0; i--) {
+      size_t j = rand() % (i + 1);
+      int t = map[i];
+      map[i] = map[j];
+      map[j] = t;
+    }
+
+    orig = malloc(total);
+    in_place = malloc(total);
+    copy = malloc(total);
+    for (i = 0; i < total; i++) {
+      orig[i] = (unsigned char) rand();
+    }
+    memcpy(in_place, orig, total);
+
+    restructure_array(ndims, in_place, lengths_perm, el_size, map, dir);
+    restructure_array_copy(ndims, copy, orig, lengths_perm, el_size, map, dir);
+
+    if (memcmp(in_place, copy, total) != 0) {
+      printf("Mismatch: ndims %d el_size %d lengths", (int) ndims, (int) el_size);
+      for (i = 0; i < ndims; i++) {
+        printf(" %d(map %d dir %d)", (int) lengths_perm[i], map[i], dir[i]);
+      }
+      printf("\n");
+      TESTRPT("restructure_array_copy differs from restructure_array", trial);
+    }
+
+    free(orig);
+    free(in_place);
+    free(copy);
+  }
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
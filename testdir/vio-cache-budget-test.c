@@ -0,0 +1,333 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include <volume_io.h>
+
+/* Reads and writes several cached volumes at once, with and without a
+ * memory budget shared by their caches, checking every voxel, that the
+ * memory held stays within the budget, that it goes to the volumes most
+ * recently used, and that the statistics of each volume add up; then
+ * does the same from one thread per volume, and checks that cache sizes
+ * above 2 GB are kept.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NZ 32
+#define NY 48
+#define NX 40
+#define NDIMS 3
+#define N_VOLUMES 4
+#define BLOCK_SIZE 8
+#define BLOCK_BYTES (BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE * sizeof(short))
+#define VOLUME_BYTES (NZ * NY * NX * sizeof(short))
+#define BUDGET (VOLUME_BYTES / 2)
+
+static VIO_STR dim_names[NDIMS] = { MIzspace, MIyspace, MIxspace };
+
+struct scanner {
+  VIO_Volume volume;
+  int which;
+  long n_wrong;
+};
+
+static short test_value(int which, int z, int y, int x)
+{
+  return (short) (((z * 31 + y * 7 + x * 3 + which * 1000) % 8000) - 4000);
+}
+
+static void file_name(int which, char *name)
+{
+  sprintf(name, "vio-cache-budget-%d.mnc", which);
+}
+
+static void create_test_file(int which)
+{
+  int sizes[NDIMS] = { NZ, NY, NX };
+  char name[64];
+  VIO_Volume volume;
+  int x, y, z;
+
+  set_n_bytes_cache_threshold(-1);
+  volume = create_volume(NDIMS, dim_names, NC_SHORT, TRUE, -32768.0, 32767.0);
+  set_volume_sizes(volume, sizes);
+  set_volume_real_range(volume, -32768.0, 32767.0);
+  alloc_volume_data(volume);
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        set_volume_voxel_value(volume, z, y, x, 0, 0,
+                               test_value(which, z, y, x));
+      }
+    }
+  }
+  file_name(which, name);
+  if (output_volume(name, NC_SHORT, TRUE, 0.0, 0.0, volume, NULL,
+                    NULL) != VIO_OK) {
+    TESTRPT("failed to write volume", which);
+  }
+  delete_volume(volume);
+}
+
+static VIO_Volume read_test_file(int which)
+{
+  int block_sizes[VIO_MAX_DIMENSIONS];
+  char name[64];
+  VIO_Volume volume;
+  int d;
+
+  for (d = 0; d < VIO_MAX_DIMENSIONS; d++) {
+    block_sizes[d] = BLOCK_SIZE;
+  }
+  set_n_bytes_cache_threshold(0);
+  set_default_cache_block_sizes(block_sizes);
+  set_default_cache_read_ahead(0);
+  file_name(which, name);
+  if (input_volume(name, NDIMS, dim_names, MI_ORIGINAL_TYPE, FALSE,
+                   0.0, 0.0, TRUE, &volume, NULL) != VIO_OK) {
+    TESTRPT("failed to read volume", which);
+    return NULL;
+  }
+  if (!volume_is_cached(volume)) {
+    TESTRPT("volume not cached", which);
+  }
+  return volume;
+}
+
+/* Reads a row of each volume in turn, checking every voxel, with the
+ * values of the first negated if sign is -1, and returns the most memory
+ * held by all caches after any row.
+ */
+static VIO_Long interleaved_scan(VIO_Volume volumes[], int sign)
+{
+  VIO_Long n_bytes, most = 0;
+  int i, x, y, z;
+
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (i = 0; i < N_VOLUMES; i++) {
+        for (x = 0; x < NX; x++) {
+          if (get_volume_voxel_value(volumes[i], z, y, x, 0, 0) !=
+              (i == 0 ? sign : 1) * test_value(i, z, y, x)) {
+            TESTRPT("wrong voxel", i);
+            return most;
+          }
+        }
+        n_bytes = get_n_bytes_in_volume_caches();
+        if (n_bytes > most) {
+          most = n_bytes;
+        }
+      }
+    }
+  }
+  return most;
+}
+
+/* Checks that the memory held by each cache adds up to that held by all. */
+static void check_stats(VIO_Volume volumes[], VIO_volume_cache_stats stats[])
+{
+  VIO_Long total = 0;
+  int i;
+
+  for (i = 0; i < N_VOLUMES; i++) {
+    get_volume_cache_stats(volumes[i], &stats[i]);
+    if (stats[i].n_bytes_in_cache !=
+        stats[i].n_blocks_in_cache * (VIO_Long) BLOCK_BYTES) {
+      TESTRPT("bytes and blocks in cache differ", i);
+    }
+    if (stats[i].max_bytes_in_cache < (VIO_Long) VOLUME_BYTES) {
+      TESTRPT("volume cache too small", i);
+    }
+    total += stats[i].n_bytes_in_cache;
+  }
+  if (total != get_n_bytes_in_volume_caches()) {
+    TESTRPT("bytes in caches do not add up", (int) total);
+  }
+}
+
+/* Reads the voxels of a volume twice over, checking each. */
+static void *scan_volume(void *arg)
+{
+  struct scanner *s = (struct scanner *) arg;
+  int pass, x, y, z;
+
+  for (pass = 0; pass < 2; pass++) {
+    for (z = 0; z < NZ; z++) {
+      for (y = 0; y < NY; y++) {
+        for (x = 0; x < NX; x++) {
+          if (get_volume_voxel_value(s->volume, z, y, x, 0, 0) !=
+              test_value(s->which, z, y, x)) {
+            s->n_wrong++;
+          }
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+int main(void)
+{
+  VIO_Volume volumes[N_VOLUMES];
+  VIO_volume_cache_stats stats[N_VOLUMES];
+  struct scanner scanners[N_VOLUMES];
+  pthread_t threads[N_VOLUMES];
+  VIO_Long unbudgeted, budgeted;
+  long n_wrong;
+  int i, x, y, z;
+
+  for (i = 0; i < N_VOLUMES; i++) {
+    create_test_file(i);
+  }
+
+  /* Without a budget, each volume ends up wholly cached. */
+  set_volume_cache_budget(0);
+  for (i = 0; i < N_VOLUMES; i++) {
+    if ((volumes[i] = read_test_file(i)) == NULL) {
+      return error_cnt;
+    }
+  }
+  unbudgeted = interleaved_scan(volumes, 1);
+  if (unbudgeted != (VIO_Long) N_VOLUMES * VOLUME_BYTES) {
+    TESTRPT("volumes not wholly cached", (int) unbudgeted);
+  }
+  check_stats(volumes, stats);
+  for (i = 0; i < N_VOLUMES; i++) {
+    delete_volume(volumes[i]);
+  }
+  if (get_n_bytes_in_volume_caches() != 0) {
+    TESTRPT("memory held after deleting volumes",
+            (int) get_n_bytes_in_volume_caches());
+  }
+
+  /* With a budget of half a volume for all of them, the memory held stays
+   * within it, and every volume gives blocks up to the others.
+   */
+  set_volume_cache_budget(BUDGET);
+  if (get_volume_cache_budget() != BUDGET) {
+    TESTRPT("wrong budget", (int) get_volume_cache_budget());
+  }
+  for (i = 0; i < N_VOLUMES; i++) {
+    volumes[i] = read_test_file(i);
+  }
+  budgeted = interleaved_scan(volumes, 1);
+  printf("%d volumes read row by row: %lld bytes cached without a budget, "
+         "%lld with a budget of %lld\n", N_VOLUMES, unbudgeted, budgeted,
+         (VIO_Long) BUDGET);
+  if (budgeted > BUDGET) {
+    TESTRPT("budget exceeded", (int) budgeted);
+  }
+  check_stats(volumes, stats);
+  for (i = 0; i < N_VOLUMES; i++) {
+    if (stats[i].n_blocks_given_up == 0 || stats[i].n_blocks_taken == 0) {
+      TESTRPT("volume did not share the budget", i);
+    }
+  }
+
+  /* The memory goes to the volume in use. */
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        if (get_volume_voxel_value(volumes[N_VOLUMES - 1], z, y, x, 0, 0) !=
+            test_value(N_VOLUMES - 1, z, y, x)) {
+          TESTRPT("wrong voxel", z);
+        }
+      }
+    }
+  }
+  check_stats(volumes, stats);
+  if (stats[N_VOLUMES - 1].n_bytes_in_cache < BUDGET - (VIO_Long) BLOCK_BYTES) {
+    TESTRPT("volume in use did not get the budget",
+            (int) stats[N_VOLUMES - 1].n_bytes_in_cache);
+  }
+
+  /* Blocks written and then given up to other volumes are written out, and
+   * read back.
+   */
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        set_volume_voxel_value(volumes[0], z, y, x, 0, 0,
+                               -get_volume_voxel_value(volumes[0], z, y, x,
+                                                       0, 0));
+        (void) get_volume_voxel_value(volumes[1 + x % (N_VOLUMES - 1)],
+                                      z, y, x, 0, 0);
+      }
+    }
+  }
+  if (interleaved_scan(volumes, -1) > BUDGET) {
+    TESTRPT("budget exceeded after writing", 0);
+  }
+  for (i = 0; i < N_VOLUMES; i++) {
+    delete_volume(volumes[i]);
+  }
+
+  /* One thread per volume, each reading its own. */
+  for (i = 0; i < N_VOLUMES; i++) {
+    volumes[i] = read_test_file(i);
+    scanners[i].volume = volumes[i];
+    scanners[i].which = i;
+    scanners[i].n_wrong = 0;
+  }
+  for (i = 0; i < N_VOLUMES; i++) {
+    if (pthread_create(&threads[i], NULL, scan_volume, &scanners[i]) != 0) {
+      TESTRPT("failed to start thread", i);
+      scan_volume(&scanners[i]);
+      threads[i] = pthread_self();
+    }
+  }
+  n_wrong = 0;
+  for (i = 0; i < N_VOLUMES; i++) {
+    if (!pthread_equal(threads[i], pthread_self())) {
+      pthread_join(threads[i], NULL);
+    }
+    n_wrong += scanners[i].n_wrong;
+  }
+  if (n_wrong != 0) {
+    TESTRPT("wrong voxels read by threads", (int) n_wrong);
+  }
+  check_stats(volumes, stats);
+  for (i = 0; i < N_VOLUMES; i++) {
+    delete_volume(volumes[i]);
+  }
+  if (get_n_bytes_in_volume_caches() != 0) {
+    TESTRPT("memory held after deleting volumes",
+            (int) get_n_bytes_in_volume_caches());
+  }
+
+  /* Sizes above 2 GB. */
+  set_volume_cache_budget(0);
+  set_default_max_bytes_in_cache((VIO_Long) 3 << 30);
+  if (get_default_max_bytes_in_cache() <= INT_MAX) {
+    TESTRPT("cache size truncated", (int) get_default_max_bytes_in_cache());
+  }
+  volumes[0] = read_test_file(0);
+  get_volume_cache_stats(volumes[0], &stats[0]);
+  if (stats[0].max_bytes_in_cache != (VIO_Long) VOLUME_BYTES) {
+    TESTRPT("wrong cache size", (int) stats[0].max_bytes_in_cache);
+  }
+  delete_volume(volumes[0]);
+  set_n_bytes_cache_threshold((VIO_Long) 5 << 30);
+  if (get_n_bytes_cache_threshold() <= INT_MAX) {
+    TESTRPT("cache threshold truncated", 0);
+  }
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
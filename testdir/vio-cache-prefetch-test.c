@@ -0,0 +1,336 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <volume_io.h>
+
+/* Reads a cached volume in file order and across it, with and without
+ * read-ahead, while working on each row as it is read; asks for regions
+ * of the volume to be read ahead, including regions partly outside it and
+ * larger than the cache; and reads and writes the volume from several
+ * threads while blocks are being read ahead, checking every voxel.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NZ 64
+#define NY 96
+#define NX 80
+#define NDIMS 3
+#define NVOXELS (NZ * NY * NX)
+#define N_THREADS 4
+#define ROW_WORK 200
+
+#define FILENAME "vio-cache-prefetch.mnc"
+
+static VIO_STR dim_names[NDIMS] = { MIzspace, MIyspace, MIxspace };
+
+struct scanner {
+  VIO_Volume volume;
+  int first_z;
+  int step_z;
+  int sign;
+  long n_wrong;
+};
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static short test_value(int z, int y, int x)
+{
+  return (short) (((z * 31 + y * 7 + x * 3) % 8000) - 4000);
+}
+
+/* Stands for the work a program does with each row it reads. */
+static double row_work(double value)
+{
+  int i;
+
+  for (i = 0; i < ROW_WORK; i++) {
+    value = sqrt(value * value + 1.0);
+  }
+  return value;
+}
+
+static void create_test_file(void)
+{
+  int sizes[NDIMS] = { NZ, NY, NX };
+  VIO_Volume volume;
+  int x, y, z;
+
+  set_n_bytes_cache_threshold(-1);
+  volume = create_volume(NDIMS, dim_names, NC_SHORT, TRUE, -32768.0, 32767.0);
+  set_volume_sizes(volume, sizes);
+  set_volume_real_range(volume, -32768.0, 32767.0);
+  alloc_volume_data(volume);
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        set_volume_voxel_value(volume, z, y, x, 0, 0, test_value(z, y, x));
+      }
+    }
+  }
+  if (output_volume(FILENAME, NC_SHORT, TRUE, 0.0, 0.0, volume, NULL,
+                    NULL) != VIO_OK) {
+    TESTRPT("failed to write volume", 0);
+  }
+  delete_volume(volume);
+}
+
+/* Reads the test file into a cache of cache_bytes, with blocks of
+ * block_size voxels on a side, reading ahead read_ahead blocks.
+ */
+static VIO_Volume read_test_file(int cache_bytes, int block_size,
+                                 int read_ahead)
+{
+  int block_sizes[VIO_MAX_DIMENSIONS];
+  VIO_Volume volume;
+  int d;
+
+  for (d = 0; d < VIO_MAX_DIMENSIONS; d++) {
+    block_sizes[d] = block_size;
+  }
+  set_n_bytes_cache_threshold(0);
+  set_default_max_bytes_in_cache(cache_bytes);
+  set_default_cache_block_sizes(block_sizes);
+  set_default_cache_read_ahead(read_ahead);
+  if (input_volume(FILENAME, NDIMS, dim_names, MI_ORIGINAL_TYPE, FALSE,
+                   0.0, 0.0, TRUE, &volume, NULL) != VIO_OK) {
+    TESTRPT("failed to read volume", cache_bytes);
+    return NULL;
+  }
+  if (!volume_is_cached(volume)) {
+    TESTRPT("volume not cached", cache_bytes);
+  }
+  return volume;
+}
+
+/* Reads the slices of a scanner in file order, checking each voxel. */
+static void *scan_slices(void *arg)
+{
+  struct scanner *s = (struct scanner *) arg;
+  int x, y, z;
+
+  for (z = s->first_z; z < NZ; z += s->step_z) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        if (get_volume_voxel_value(s->volume, z, y, x, 0, 0) !=
+            s->sign * test_value(z, y, x)) {
+          s->n_wrong++;
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+/* Negates the voxels of the slices of a scanner, in file order. */
+static void *negate_slices(void *arg)
+{
+  struct scanner *s = (struct scanner *) arg;
+  int x, y, z;
+
+  for (z = s->first_z; z < NZ; z += s->step_z) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        set_volume_voxel_value(s->volume, z, y, x, 0, 0,
+                               -get_volume_voxel_value(s->volume, z, y, x,
+                                                       0, 0));
+      }
+    }
+  }
+  return NULL;
+}
+
+/* Runs a function on N_THREADS threads, each with its own slices. */
+static long run_threads(void *(*function)(void *), VIO_Volume volume,
+                        int sign)
+{
+  struct scanner scanners[N_THREADS];
+  pthread_t threads[N_THREADS];
+  long n_wrong = 0;
+  int i;
+
+  for (i = 0; i < N_THREADS; i++) {
+    scanners[i].volume = volume;
+    scanners[i].first_z = i;
+    scanners[i].step_z = N_THREADS;
+    scanners[i].sign = sign;
+    scanners[i].n_wrong = 0;
+    if (pthread_create(&threads[i], NULL, function, &scanners[i]) != 0) {
+      TESTRPT("failed to start thread", i);
+      function(&scanners[i]);
+      threads[i] = pthread_self();
+    }
+  }
+  for (i = 0; i < N_THREADS; i++) {
+    if (!pthread_equal(threads[i], pthread_self())) {
+      pthread_join(threads[i], NULL);
+    }
+    n_wrong += scanners[i].n_wrong;
+  }
+  return n_wrong;
+}
+
+/* Reads the whole volume once, in file order or with x slowest and z
+ * fastest, working on each row read, and returns the time taken.
+ */
+static double timed_scan(VIO_Volume volume, VIO_BOOL across)
+{
+  double t0 = now(), row;
+  long n_wrong = 0;
+  int a, b, c, x, y, z;
+
+  for (a = 0; a < (across ? NX : NZ); a++) {
+    for (b = 0; b < NY; b++) {
+      row = 0.0;
+      for (c = 0; c < (across ? NZ : NX); c++) {
+        z = across ? c : a;
+        y = b;
+        x = across ? a : c;
+        if (get_volume_voxel_value(volume, z, y, x, 0, 0) !=
+            test_value(z, y, x)) {
+          n_wrong++;
+        }
+        row += test_value(z, y, x);
+      }
+      if (row_work(row) < 0.0) {
+        n_wrong++;
+      }
+    }
+  }
+  if (n_wrong != 0) {
+    TESTRPT("wrong voxels scanned", (int) n_wrong);
+  }
+  return now() - t0;
+}
+
+/* Checks every voxel of a region of the volume. */
+static void check_region(VIO_Volume volume, int start[], int count[])
+{
+  int x, y, z;
+
+  for (z = MAX(start[0], 0); z < MIN(start[0] + count[0], NZ); z++) {
+    for (y = MAX(start[1], 0); y < MIN(start[1] + count[1], NY); y++) {
+      for (x = MAX(start[2], 0); x < MIN(start[2] + count[2], NX); x++) {
+        if (get_volume_voxel_value(volume, z, y, x, 0, 0) !=
+            test_value(z, y, x)) {
+          TESTRPT("wrong voxel in region", z);
+          return;
+        }
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  static const char *order_names[2] = { "file order", "across" };
+  int start[NDIMS], count[NDIMS];
+  struct timespec pause = { 0, 50000000 };
+  double t0, t_off, t_on, t_cold, t_warm;
+  VIO_Volume volume;
+  int across;
+
+  create_test_file();
+
+  /* An eighth of the volume in the cache, read with and without
+   * read-ahead.
+   */
+  for (across = 0; across <= 1; across++) {
+    volume = read_test_file(NX * NY * 8 * sizeof(short), 8, 0);
+    if (volume == NULL) {
+      return error_cnt;
+    }
+    t_off = timed_scan(volume, across);
+    delete_volume(volume);
+    volume = read_test_file(NX * NY * 8 * sizeof(short), 8, 4);
+    t_on = timed_scan(volume, across);
+    delete_volume(volume);
+    printf("%s, an eighth cached: no read-ahead %.1f ms, "
+           "read-ahead of 4 blocks %.1f ms\n",
+           order_names[across], t_off * 1e3, t_on * 1e3);
+  }
+
+  /* A quarter of the volume in the cache, and a slab of it asked for
+   * ahead of being read, against a slab that was not.
+   */
+  volume = read_test_file(NVOXELS / 4 * sizeof(short), 16, 0);
+  start[0] = 16;
+  start[1] = 0;
+  start[2] = 0;
+  count[0] = 16;
+  count[1] = NY;
+  count[2] = NX;
+  prefetch_volume_region(volume, start, count);
+  nanosleep(&pause, NULL);
+  t0 = now();
+  check_region(volume, start, count);
+  t_warm = now() - t0;
+  start[0] = 32;
+  t0 = now();
+  check_region(volume, start, count);
+  t_cold = now() - t0;
+  printf("a slab of 16 slices: not read ahead %.2f ms, read ahead %.2f ms\n",
+         t_cold * 1e3, t_warm * 1e3);
+
+  /* Regions partly outside the volume, empty, and larger than the cache,
+   * while the blocks are still being read.
+   */
+  start[0] = -5;
+  start[1] = NY - 20;
+  start[2] = -100;
+  count[0] = 30;
+  count[1] = 50;
+  count[2] = 200;
+  prefetch_volume_region(volume, start, count);
+  check_region(volume, start, count);
+  count[1] = 0;
+  prefetch_volume_region(volume, start, count);
+  start[0] = 0;
+  start[1] = 0;
+  start[2] = 0;
+  count[0] = NZ;
+  count[1] = NY;
+  count[2] = NX;
+  prefetch_volume_region(volume, start, count);
+  check_region(volume, start, count);
+  prefetch_volume_region(volume, start, count);
+  delete_volume(volume);
+
+  /* Several threads reading their own slices, then negating them while
+   * blocks are read ahead and written back, then reading them again.
+   */
+  volume = read_test_file(NX * NY * 8 * sizeof(short), 8, 4);
+  if (run_threads(scan_slices, volume, 1) != 0) {
+    TESTRPT("wrong voxels read by threads", 0);
+  }
+  run_threads(negate_slices, volume, 1);
+  if (run_threads(scan_slices, volume, -1) != 0) {
+    TESTRPT("wrong voxels after writing", 0);
+  }
+  delete_volume(volume);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
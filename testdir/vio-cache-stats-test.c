@@ -0,0 +1,326 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <volume_io.h>
+
+/* Reads a cached volume in file order and across it, checking that the
+ * statistics kept by the cache add up, records the accesses and replays
+ * them through the cache model, checking that it counts the same, and
+ * compares the misses of several block shapes on the accesses across the
+ * volume; then writes the volume through a small cache, checking the bytes
+ * written, and writes out the statistics of all caches.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NZ 32
+#define NY 48
+#define NX 40
+#define NDIMS 3
+#define NVOXELS (NZ * NY * NX)
+#define BLOCK_SIZE 8
+#define N_BLOCKS ((NZ / BLOCK_SIZE) * (NY / BLOCK_SIZE) * (NX / BLOCK_SIZE))
+#define VOLUME_BYTES (NVOXELS * sizeof(short))
+#define SMALL_CACHE (VOLUME_BYTES / 8)
+
+#define FILENAME "vio-cache-stats.mnc"
+#define TRACE_FILENAME "vio-cache-stats.trace"
+#define STATS_FILENAME "vio-cache-stats.json"
+
+static VIO_STR dim_names[NDIMS] = { MIzspace, MIyspace, MIxspace };
+
+static short test_value(int z, int y, int x)
+{
+  return (short) (((z * 31 + y * 7 + x * 3) % 8000) - 4000);
+}
+
+static void create_test_file(void)
+{
+  int sizes[NDIMS] = { NZ, NY, NX };
+  VIO_Volume volume;
+  int x, y, z;
+
+  set_n_bytes_cache_threshold(-1);
+  volume = create_volume(NDIMS, dim_names, NC_SHORT, TRUE, -32768.0, 32767.0);
+  set_volume_sizes(volume, sizes);
+  set_volume_real_range(volume, -32768.0, 32767.0);
+  alloc_volume_data(volume);
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        set_volume_voxel_value(volume, z, y, x, 0, 0, test_value(z, y, x));
+      }
+    }
+  }
+  if (output_volume(FILENAME, NC_SHORT, TRUE, 0.0, 0.0, volume, NULL,
+                    NULL) != VIO_OK) {
+    TESTRPT("failed to write volume", 0);
+  }
+  delete_volume(volume);
+}
+
+/* Reads the test file into a cache of cache_bytes, with cubic blocks of
+ * BLOCK_SIZE voxels on a side, and nothing read ahead.
+ */
+static VIO_Volume read_test_file(VIO_Long cache_bytes)
+{
+  int block_sizes[VIO_MAX_DIMENSIONS];
+  VIO_Volume volume;
+  int d;
+
+  for (d = 0; d < VIO_MAX_DIMENSIONS; d++) {
+    block_sizes[d] = BLOCK_SIZE;
+  }
+  set_n_bytes_cache_threshold(0);
+  set_default_max_bytes_in_cache(cache_bytes);
+  set_default_cache_block_sizes(block_sizes);
+  set_default_cache_read_ahead(0);
+  if (input_volume(FILENAME, NDIMS, dim_names, MI_ORIGINAL_TYPE, FALSE,
+                   0.0, 0.0, TRUE, &volume, NULL) != VIO_OK) {
+    TESTRPT("failed to read volume", 0);
+    return NULL;
+  }
+  if (!volume_is_cached(volume)) {
+    TESTRPT("volume not cached", 0);
+  }
+  return volume;
+}
+
+/* Reads the whole volume once, in file order or with x slowest and z
+ * fastest, checking each voxel, with the values negated if sign is -1.
+ */
+static void scan(VIO_Volume volume, VIO_BOOL across, int sign)
+{
+  int a, b, c, x, y, z;
+
+  for (a = 0; a < (across ? NX : NZ); a++) {
+    for (b = 0; b < NY; b++) {
+      for (c = 0; c < (across ? NZ : NX); c++) {
+        z = across ? c : a;
+        y = b;
+        x = across ? a : c;
+        if (get_volume_voxel_value(volume, z, y, x, 0, 0) !=
+            sign * test_value(z, y, x)) {
+          TESTRPT("wrong voxel", z);
+          return;
+        }
+      }
+    }
+  }
+}
+
+/* Passes back the statistics counted since before, and checks that they
+ * add up to the accesses made.
+ */
+static void get_stats_since(VIO_Volume volume, VIO_volume_cache_stats *before,
+                            VIO_volume_cache_stats *since, long n_accesses)
+{
+  get_volume_cache_stats(volume, since);
+  since->n_hits -= before->n_hits;
+  since->n_prev_hits -= before->n_prev_hits;
+  since->n_misses -= before->n_misses;
+  since->n_evictions -= before->n_evictions;
+  since->n_bytes_read -= before->n_bytes_read;
+  since->n_bytes_written -= before->n_bytes_written;
+  if (since->n_hits + since->n_prev_hits + since->n_misses != n_accesses) {
+    TESTRPT("accesses do not add up",
+            (int) (since->n_hits + since->n_prev_hits + since->n_misses));
+  }
+}
+
+/* Replays the trace, and returns the misses counted for blocks of the
+ * given sizes in a cache of max_bytes.
+ */
+static long simulate(int bz, int by, int bx, VIO_Long max_bytes,
+                     VIO_volume_cache_stats *stats)
+{
+  int block_sizes[VIO_MAX_DIMENSIONS] = { 0, 0, 0, 0, 0 };
+
+  block_sizes[0] = bz;
+  block_sizes[1] = by;
+  block_sizes[2] = bx;
+  if (simulate_volume_cache_trace(TRACE_FILENAME, block_sizes, max_bytes,
+                                  stats) != VIO_OK) {
+    TESTRPT("failed to replay trace", bz);
+  }
+  return (long) stats->n_misses;
+}
+
+/* Returns whether the file contains the string. */
+static int file_contains(const char *filename, const char *str)
+{
+  static char text[65536];
+  FILE *file = fopen(filename, "r");
+  size_t n;
+
+  if (file == NULL) {
+    return 0;
+  }
+  n = fread(text, 1, sizeof(text) - 1, file);
+  fclose(file);
+  text[n] = '\0';
+  return strstr(text, str) != NULL;
+}
+
+int main(void)
+{
+  static const int shapes[][NDIMS] = {
+    { 4, 4, 4 }, { 8, 8, 8 }, { 16, 16, 16 }, { 1, 0, 0 }, { 0, 0, 1 }
+  };
+  VIO_volume_cache_stats before, stats, simulated, whole;
+  VIO_Volume volume;
+  FILE *file;
+  long cubes, slices;
+  int i, x, y, z;
+
+  /* The statistics of caches deleted are kept, to be written at exit. */
+  setenv("VOLUME_CACHE_STATS", STATS_FILENAME, 1);
+
+  create_test_file();
+
+  /* The whole volume in the cache: each block is missed once, and read. */
+  volume = read_test_file(VOLUME_BYTES * 2);
+  if (volume == NULL) {
+    return error_cnt;
+  }
+  if (start_volume_cache_trace(volume, TRACE_FILENAME) != VIO_OK) {
+    TESTRPT("failed to start trace", 0);
+  }
+  get_volume_cache_stats(volume, &before);
+  scan(volume, FALSE, 1);
+  stop_volume_cache_trace(volume);
+  get_stats_since(volume, &before, &stats, NVOXELS);
+  printf("file order: %lld hits, %lld previous block hits, %lld misses, "
+         "%lld bytes read in %.2f ms\n", stats.n_hits, stats.n_prev_hits,
+         stats.n_misses, stats.n_bytes_read, stats.read_seconds * 1e3);
+  if (stats.n_misses != N_BLOCKS) {
+    TESTRPT("wrong number of misses", (int) stats.n_misses);
+  }
+  if (stats.n_bytes_read != (VIO_Long) VOLUME_BYTES) {
+    TESTRPT("wrong number of bytes read", (int) stats.n_bytes_read);
+  }
+  if (stats.n_evictions != 0 || stats.n_bytes_written != 0) {
+    TESTRPT("blocks evicted or written", (int) stats.n_evictions);
+  }
+  if (stats.n_prev_hits < stats.n_hits) {
+    TESTRPT("too few previous block hits", (int) stats.n_prev_hits);
+  }
+  if (stats.read_seconds < 0.0) {
+    TESTRPT("negative read time", 0);
+  }
+
+  /* The trace replayed with the same blocks counts the same. */
+  simulate(BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE, VOLUME_BYTES * 2, &simulated);
+  if (simulated.n_hits != stats.n_hits ||
+      simulated.n_prev_hits != stats.n_prev_hits ||
+      simulated.n_misses != stats.n_misses ||
+      simulated.n_bytes_read != stats.n_bytes_read ||
+      simulated.n_evictions != 0 || simulated.n_bytes_written != 0) {
+    TESTRPT("replay counts differ", (int) simulated.n_misses);
+  }
+
+  /* Across the volume, nothing more is read. */
+  get_volume_cache_stats(volume, &before);
+  scan(volume, TRUE, 1);
+  get_stats_since(volume, &before, &stats, NVOXELS);
+  if (stats.n_misses != 0 || stats.n_bytes_read != 0) {
+    TESTRPT("misses with the whole volume cached", (int) stats.n_misses);
+  }
+  delete_volume(volume);
+
+  /* An eighth of the volume in the cache, read across it, with blocks of
+   * several shapes.
+   */
+  volume = read_test_file(SMALL_CACHE);
+  start_volume_cache_trace(volume, TRACE_FILENAME);
+  get_volume_cache_stats(volume, &before);
+  scan(volume, TRUE, 1);
+  stop_volume_cache_trace(volume);
+  get_stats_since(volume, &before, &stats, NVOXELS);
+  printf("across, an eighth cached: %lld misses, %lld evictions\n",
+         stats.n_misses, stats.n_evictions);
+  if (stats.n_evictions == 0) {
+    TESTRPT("no blocks evicted from a small cache", 0);
+  }
+  for (i = 0; i < (int) (sizeof(shapes) / sizeof(shapes[0])); i++) {
+    simulate(shapes[i][0], shapes[i][1], shapes[i][2], SMALL_CACHE,
+             &simulated);
+    printf("  blocks of %d x %d x %d: %lld misses, %lld bytes read\n",
+           shapes[i][0], shapes[i][1], shapes[i][2], simulated.n_misses,
+           simulated.n_bytes_read);
+    simulate(shapes[i][0], shapes[i][1], shapes[i][2], VOLUME_BYTES * 4,
+             &whole);
+    if (whole.n_bytes_read != (VIO_Long) VOLUME_BYTES) {
+      TESTRPT("whole volume not read once", i);
+    }
+  }
+  cubes = simulate(BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE, SMALL_CACHE,
+                   &simulated);
+  if (simulated.n_misses != stats.n_misses ||
+      simulated.n_evictions != stats.n_evictions ||
+      simulated.n_bytes_read != stats.n_bytes_read) {
+    TESTRPT("replay counts differ with evictions", (int) cubes);
+  }
+  slices = simulate(1, 0, 0, SMALL_CACHE, &simulated);
+  if (slices != NVOXELS || cubes >= slices) {
+    TESTRPT("slices not worse than cubes across the volume", (int) cubes);
+  }
+  delete_volume(volume);
+
+  /* Written through a small cache, every block is written out at least
+   * once, and the values are read back.
+   */
+  volume = read_test_file(SMALL_CACHE);
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        set_volume_voxel_value(volume, z, y, x, 0, 0,
+                               -get_volume_voxel_value(volume, z, y, x,
+                                                       0, 0));
+      }
+    }
+  }
+  flush_volume_cache(volume);
+  get_volume_cache_stats(volume, &stats);
+  printf("written: %lld bytes in %.2f ms\n", stats.n_bytes_written,
+         stats.write_seconds * 1e3);
+  if (stats.n_bytes_written < (VIO_Long) VOLUME_BYTES) {
+    TESTRPT("too few bytes written", (int) stats.n_bytes_written);
+  }
+  scan(volume, FALSE, -1);
+
+  /* The statistics of all caches, the first two deleted. */
+  delete_volume(volume);
+  volume = read_test_file(SMALL_CACHE);
+  file = fopen("vio-cache-stats-out.json", "w");
+  if (file == NULL || output_volume_cache_stats(file) != VIO_OK) {
+    TESTRPT("failed to write statistics", 0);
+  }
+  if (file != NULL) {
+    fclose(file);
+  }
+  if (!file_contains("vio-cache-stats-out.json", "\"open\": false") ||
+      !file_contains("vio-cache-stats-out.json", "\"open\": true") ||
+      !file_contains("vio-cache-stats-out.json", "\"volumes\": [") ||
+      !file_contains("vio-cache-stats-out.json", FILENAME)) {
+    TESTRPT("statistics incomplete", 0);
+  }
+  delete_volume(volume);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
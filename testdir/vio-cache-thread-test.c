@@ -0,0 +1,417 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <volume_io.h>
+
+/* Reads a cached volume from many threads at once, through a cache much
+ * smaller than the volume, and compares every voxel with the volume read
+ * into memory; writes a cached volume from many threads, each setting its
+ * own slices, and reads it back.  Given -benchmark, it also measures how
+ * random reads scale with the number of threads, with the whole volume in
+ * the cache and with a cache of a few blocks, and how fast one thread
+ * reads in different orders.
+ */
+
+#define TESTRPT(msg, val) (error_cnt++, fprintf(stderr, \
+                           "Error reported on line #%d, %s: %d\n", \
+                           __LINE__, msg, val))
+
+static int error_cnt = 0;
+
+#define NZ 64
+#define NY 96
+#define NX 80
+#define NDIMS 3
+#define NVOXELS (NZ * NY * NX)
+#define MAX_THREADS 8
+#define N_READS 400000
+#define RUN_LENGTH 16
+
+#define FILENAME "vio-cache-thread.mnc"
+
+static VIO_STR dim_names[NDIMS] = { MIzspace, MIyspace, MIxspace };
+
+struct reader {
+  VIO_Volume volume;
+  const short *expected;
+  unsigned int seed;
+  int first_z;
+  int step_z;
+  long n_reads;
+  long n_wrong;
+  double sum;
+};
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static short test_value(int z, int y, int x)
+{
+  return (short) (((z * 31 + y * 7 + x * 3) % 8000) - 4000);
+}
+
+static VIO_Volume new_volume(void)
+{
+  int sizes[NDIMS] = { NZ, NY, NX };
+  VIO_Volume volume;
+
+  volume = create_volume(NDIMS, dim_names, NC_SHORT, TRUE, -32768.0, 32767.0);
+  set_volume_sizes(volume, sizes);
+  set_volume_real_range(volume, -32768.0, 32767.0);
+  return volume;
+}
+
+static void create_test_file(void)
+{
+  VIO_Volume volume;
+  int x, y, z;
+
+  set_n_bytes_cache_threshold(-1);
+  volume = new_volume();
+  alloc_volume_data(volume);
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        set_volume_voxel_value(volume, z, y, x, 0, 0, test_value(z, y, x));
+      }
+    }
+  }
+  if (output_volume(FILENAME, NC_SHORT, TRUE, 0.0, 0.0, volume, NULL,
+                    NULL) != VIO_OK) {
+    TESTRPT("failed to write volume", 0);
+  }
+  delete_volume(volume);
+}
+
+/* Reads the test file, cached when cache_bytes is positive. */
+static VIO_Volume read_test_file(int cache_bytes, int block_size)
+{
+  int block_sizes[VIO_MAX_DIMENSIONS];
+  VIO_Volume volume;
+  int d;
+
+  for (d = 0; d < VIO_MAX_DIMENSIONS; d++) {
+    block_sizes[d] = block_size;
+  }
+  set_n_bytes_cache_threshold(cache_bytes > 0 ? 0 : -1);
+  set_default_max_bytes_in_cache(cache_bytes);
+  set_default_cache_block_sizes(block_sizes);
+  if (input_volume(FILENAME, NDIMS, dim_names, MI_ORIGINAL_TYPE, FALSE,
+                   0.0, 0.0, TRUE, &volume, NULL) != VIO_OK) {
+    TESTRPT("failed to read volume", cache_bytes);
+    return NULL;
+  }
+  if (volume_is_cached(volume) != (cache_bytes > 0)) {
+    TESTRPT("volume cached or not as asked", cache_bytes);
+  }
+  return volume;
+}
+
+/* Reads short runs of voxels along x from random places, and checks them
+ * if there are values expected.
+ */
+static void *random_reads(void *arg)
+{
+  struct reader *r = (struct reader *) arg;
+  long n;
+  int i;
+
+  for (n = 0; n < r->n_reads; n += RUN_LENGTH) {
+    int z = rand_r(&r->seed) % NZ;
+    int y = rand_r(&r->seed) % NY;
+    int x0 = rand_r(&r->seed) % (NX - RUN_LENGTH);
+
+    for (i = 0; i < RUN_LENGTH; i++) {
+      VIO_Real value = get_volume_voxel_value(r->volume, z, y, x0 + i, 0, 0);
+
+      r->sum += value;
+      if (r->expected != NULL &&
+          value != r->expected[(z * NY + y) * NX + x0 + i]) {
+        r->n_wrong++;
+      }
+    }
+  }
+  return NULL;
+}
+
+/* Sets the slices first_z, first_z + step_z, ... */
+static void *write_slices(void *arg)
+{
+  struct reader *r = (struct reader *) arg;
+  int x, y, z;
+
+  for (z = r->first_z; z < NZ; z += r->step_z) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        set_volume_voxel_value(r->volume, z, y, x, 0, 0,
+                               -test_value(z, y, x));
+      }
+    }
+  }
+  return NULL;
+}
+
+/* Reads the same slices back, in the opposite order. */
+static void *check_slices(void *arg)
+{
+  struct reader *r = (struct reader *) arg;
+  int x, y, z;
+
+  for (z = NZ - 1; z >= 0; z--) {
+    if (z % r->step_z != r->first_z) {
+      continue;
+    }
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        if (get_volume_voxel_value(r->volume, z, y, x, 0, 0) !=
+            -test_value(z, y, x)) {
+          r->n_wrong++;
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+/* Runs a function on n_threads threads, returning the time taken. */
+static double run_threads(void *(*function)(void *), struct reader *readers,
+                          int n_threads)
+{
+  pthread_t threads[MAX_THREADS];
+  double t0 = now();
+  int i;
+
+  for (i = 0; i < n_threads; i++) {
+    if (pthread_create(&threads[i], NULL, function, &readers[i]) != 0) {
+      TESTRPT("failed to start thread", i);
+      function(&readers[i]);
+      threads[i] = pthread_self();
+    }
+  }
+  for (i = 0; i < n_threads; i++) {
+    if (!pthread_equal(threads[i], pthread_self())) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+  return now() - t0;
+}
+
+static void init_readers(struct reader *readers, int n_threads,
+                         VIO_Volume volume, const short *expected,
+                         long n_reads)
+{
+  int i;
+
+  memset(readers, 0, n_threads * sizeof(struct reader));
+  for (i = 0; i < n_threads; i++) {
+    readers[i].volume = volume;
+    readers[i].expected = expected;
+    readers[i].seed = 1234 + 77 * i;
+    readers[i].first_z = i;
+    readers[i].step_z = n_threads;
+    readers[i].n_reads = n_reads;
+  }
+}
+
+static long count_wrong(const struct reader *readers, int n_threads)
+{
+  long n_wrong = 0;
+  int i;
+
+  for (i = 0; i < n_threads; i++) {
+    n_wrong += readers[i].n_wrong;
+  }
+  return n_wrong;
+}
+
+/* Times N_READS random reads shared among 1, 2, 4 and 8 threads. */
+static void benchmark(VIO_Volume volume, const char *name)
+{
+  struct reader readers[MAX_THREADS];
+  double t, t_one = 0.0;
+  int n_threads;
+
+  for (n_threads = 1; n_threads <= MAX_THREADS; n_threads *= 2) {
+    init_readers(readers, n_threads, volume, NULL, N_READS / n_threads);
+    t = run_threads(random_reads, readers, n_threads);
+    if (n_threads == 1) {
+      t_one = t;
+    }
+    printf("%s, %d thread%s: %.1f M voxels/s (%.2fx)\n", name, n_threads,
+           (n_threads == 1) ? "" : "s", N_READS / t * 1e-6, t_one / t);
+  }
+}
+
+/* Times one thread reading the volume in file order, across the file
+ * order (x slowest, z fastest), and at random voxels.
+ */
+static void trace_benchmark(VIO_Volume volume, const char *name)
+{
+  unsigned int seed = 4321;
+  double t0, t_file, t_across, t_random, sum = 0.0;
+  int x, y, z, i;
+
+  t0 = now();
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        sum += get_volume_voxel_value(volume, z, y, x, 0, 0);
+      }
+    }
+  }
+  t_file = now() - t0;
+  t0 = now();
+  for (x = 0; x < NX; x++) {
+    for (y = 0; y < NY; y++) {
+      for (z = 0; z < NZ; z++) {
+        sum += get_volume_voxel_value(volume, z, y, x, 0, 0);
+      }
+    }
+  }
+  t_across = now() - t0;
+  t0 = now();
+  for (i = 0; i < NVOXELS; i++) {
+    z = rand_r(&seed) % NZ;
+    y = rand_r(&seed) % NY;
+    x = rand_r(&seed) % NX;
+    sum += get_volume_voxel_value(volume, z, y, x, 0, 0);
+  }
+  t_random = now() - t0;
+  printf("%s: file order %.1f, across %.1f, random %.1f M voxels/s (sum %g)\n",
+         name, NVOXELS / t_file * 1e-6, NVOXELS / t_across * 1e-6,
+         NVOXELS / t_random * 1e-6, sum);
+}
+
+/* Times reads through caches of different sizes and block sizes. */
+static void benchmark_caches(void)
+{
+  VIO_Volume volume;
+
+  volume = read_test_file(24 * 8 * 8 * 8 * sizeof(short), 8);
+  if (volume != NULL) {
+    benchmark(volume, "24 blocks cached");
+    delete_volume(volume);
+  }
+  volume = read_test_file(NX * NY * 8 * sizeof(short), 8);
+  if (volume != NULL) {
+    trace_benchmark(volume, "an eighth cached");
+    delete_volume(volume);
+  }
+
+  /* Small blocks, many of them in the cache. */
+  volume = read_test_file(NVOXELS * sizeof(short), 4);
+  if (volume != NULL) {
+    trace_benchmark(volume, "cold, 4x4x4 blocks");
+    trace_benchmark(volume, "whole volume cached, 4x4x4 blocks");
+    delete_volume(volume);
+  }
+  volume = read_test_file(NVOXELS / 2 * sizeof(short), 4);
+  if (volume != NULL) {
+    trace_benchmark(volume, "half cached, 4x4x4 blocks");
+    delete_volume(volume);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  short *expected = (short *) malloc(NVOXELS * sizeof(short));
+  struct reader readers[MAX_THREADS];
+  VIO_Volume volume;
+  int run_benchmarks = (argc > 1 && strcmp(argv[1], "-benchmark") == 0);
+  int x, y, z;
+
+  create_test_file();
+
+  /* The volume in memory gives the expected values. */
+  volume = read_test_file(0, 0);
+  if (volume == NULL) {
+    return error_cnt;
+  }
+  for (z = 0; z < NZ; z++) {
+    for (y = 0; y < NY; y++) {
+      for (x = 0; x < NX; x++) {
+        expected[(z * NY + y) * NX + x] =
+          (short) get_volume_voxel_value(volume, z, y, x, 0, 0);
+        if (expected[(z * NY + y) * NX + x] != test_value(z, y, x)) {
+          TESTRPT("wrong voxel in memory", x);
+          z = NZ;
+          y = NY;
+          break;
+        }
+      }
+    }
+  }
+  delete_volume(volume);
+
+  /* Many threads reading through a cache of 24 blocks of 8x8x8 voxels,
+   * a thirtieth of the volume.
+   */
+  volume = read_test_file(24 * 8 * 8 * 8 * sizeof(short), 8);
+  if (volume != NULL) {
+    init_readers(readers, MAX_THREADS, volume, expected, N_READS);
+    run_threads(random_reads, readers, MAX_THREADS);
+    if (count_wrong(readers, MAX_THREADS) != 0) {
+      TESTRPT("wrong voxels read by threads",
+              (int) count_wrong(readers, MAX_THREADS));
+    }
+    delete_volume(volume);
+  }
+
+  /* Many threads writing a new cached volume, through a cache of 16
+   * blocks, each its own slices, then reading them back.
+   */
+  set_n_bytes_cache_threshold(0);
+  set_default_max_bytes_in_cache(16 * 8 * 8 * 8 * sizeof(short));
+  volume = new_volume();
+  alloc_volume_data(volume);
+  if (!volume_is_cached(volume)) {
+    TESTRPT("new volume not cached", 0);
+  }
+  init_readers(readers, MAX_THREADS, volume, NULL, 0);
+  run_threads(write_slices, readers, MAX_THREADS);
+  run_threads(check_slices, readers, MAX_THREADS);
+  if (count_wrong(readers, MAX_THREADS) != 0) {
+    TESTRPT("wrong voxels written by threads",
+            (int) count_wrong(readers, MAX_THREADS));
+  }
+  delete_volume(volume);
+
+  volume = read_test_file(4 * NVOXELS * sizeof(short), 16);
+  if (volume != NULL) {
+    /* Reading every block once leaves the whole volume in the cache. */
+    init_readers(readers, 1, volume, expected, N_READS);
+    run_threads(random_reads, readers, 1);
+    if (count_wrong(readers, 1) != 0) {
+      TESTRPT("wrong voxels read", (int) count_wrong(readers, 1));
+    }
+    if (run_benchmarks) {
+      benchmark(volume, "whole volume cached");
+      trace_benchmark(volume, "whole volume cached");
+    }
+    delete_volume(volume);
+  }
+  if (run_benchmarks) {
+    benchmark_caches();
+  }
+
+  free(expected);
+
+  if (error_cnt != 0) {
+    fprintf(stderr, "%d error%s reported\n",
+            error_cnt, (error_cnt == 1) ? "" : "s");
+  } else {
+    fprintf(stderr, "No errors\n");
+  }
+  return (error_cnt);
+}
@@ -61,6 +61,7 @@ typedef int VIO_BOOL;
 typedef double VIO_Real;
 typedef signed char VIO_SCHAR;
 typedef unsigned char VIO_UCHAR;
+typedef long long VIO_Long;
 
 typedef enum { VIO_OK=0,
                VIO_ERROR,
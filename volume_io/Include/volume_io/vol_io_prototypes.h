@@ -1346,6 +1346,16 @@ VIOAPI  VIO_Status  input_minc_hyperslab(
     int              start[],
     int              count[] );
 
+VIOAPI  VIO_Status  input_minc2_hyperslab(
+    Minc_file        file,
+    VIO_Data_types   data_type,
+    int              n_array_dims,
+    int              array_sizes[],
+    void             *array_data_ptr,
+    int              to_array[],
+    int              start[],
+    int              count[] );
+
 VIOAPI  VIO_BOOL input_more_minc_file(
     Minc_file   file,
     VIO_Real        *fraction_done );
@@ -1579,6 +1589,16 @@ VIOAPI  VIO_Status  output_minc_hyperslab(
     int                 file_start[],
     int                 file_count[] );
 
+VIOAPI  VIO_Status  output_minc2_hyperslab(
+    Minc_file           file,
+    VIO_Data_types      data_type,
+    int                 n_array_dims,
+    int                 array_sizes[],
+    void                *array_data_ptr,
+    int                 to_array[],
+    int                 file_start[],
+    int                 file_count[] );
+
 VIOAPI  VIO_Status  output_volume_to_minc_file_position(
     Minc_file     file,
     VIO_Volume    volume,
@@ -1794,14 +1814,14 @@ VIOAPI  void  set_volume_voxel_hyperslab(
     VIO_Real     voxels[] );
 
 VIOAPI  void  set_n_bytes_cache_threshold(
-    int  threshold );
+    VIO_Long  threshold );
 
-VIOAPI  int  get_n_bytes_cache_threshold( void );
+VIOAPI  VIO_Long  get_n_bytes_cache_threshold( void );
 
 VIOAPI  void  set_default_max_bytes_in_cache(
-    int   max_bytes );
+    VIO_Long   max_bytes );
 
-VIOAPI  int  get_default_max_bytes_in_cache( void );
+VIOAPI  VIO_Long  get_default_max_bytes_in_cache( void );
 
 VIOAPI  void  set_default_cache_block_sizes(
     int                      block_sizes[] );
@@ -1809,6 +1829,18 @@ VIOAPI  void  set_default_cache_block_sizes(
 VIOAPI  void  set_cache_block_sizes_hint(
     VIO_Cache_block_size_hints  hint );
 
+VIOAPI  void  set_default_cache_read_ahead(
+    int   n_blocks );
+
+VIOAPI  int  get_default_cache_read_ahead( void );
+
+VIOAPI  void  set_volume_cache_budget(
+    VIO_Long   max_bytes );
+
+VIOAPI  VIO_Long  get_volume_cache_budget( void );
+
+VIOAPI  VIO_Long  get_n_bytes_in_volume_caches( void );
+
 VIOAPI  void  initialize_volume_cache(
     VIO_volume_cache_struct   *cache,
     VIO_Volume                volume );
@@ -1829,7 +1861,7 @@ VIOAPI  void  set_volume_cache_block_sizes(
 
 VIOAPI  void  set_volume_cache_size(
     VIO_Volume    volume,
-    int           max_memory_bytes );
+    VIO_Long      max_memory_bytes );
 
 VIOAPI  void  set_cache_output_volume_parameters(
     VIO_Volume                  volume,
@@ -1874,6 +1906,18 @@ VIOAPI  void  set_cached_volume_voxel(
     int      v,
     VIO_Real     value );
 
+VIOAPI  void  prefetch_volume_region(
+    VIO_Volume   volume,
+    int          start[],
+    int          count[] );
+
+VIOAPI  void  get_volume_cache_stats(
+    VIO_Volume               volume,
+    VIO_volume_cache_stats   *stats );
+
+VIOAPI  VIO_Status  output_volume_cache_stats(
+    FILE   *file );
+
 VIOAPI  VIO_BOOL cached_volume_has_been_modified(
     VIO_volume_cache_struct  *cache );
 
@@ -1884,6 +1928,28 @@ VIOAPI  void   set_volume_cache_debugging(
     VIO_Volume   volume,
     int      output_every );
 
+VIOAPI  VIO_Status  start_volume_cache_trace(
+    VIO_Volume   volume,
+    VIO_STR      filename );
+
+VIOAPI  void  stop_volume_cache_trace(
+    VIO_Volume   volume );
+
+VIOAPI  void  record_volume_cache_access(
+    VIO_volume_cache_struct  *cache,
+    int                      x,
+    int                      y,
+    int                      z,
+    int                      t,
+    int                      v,
+    VIO_BOOL                 writing );
+
+VIOAPI  VIO_Status  simulate_volume_cache_trace(
+    VIO_STR                  filename,
+    int                      block_sizes[],
+    VIO_Long                 max_bytes,
+    VIO_volume_cache_stats   *stats );
+
 VIOAPI  VIO_STR  *get_default_dim_names(
     int    n_dimensions );
 
@@ -37,18 +37,14 @@
 typedef  enum  { SLICE_ACCESS, RANDOM_VOLUME_ACCESS }
                VIO_Cache_block_size_hints;
 
-#define  CACHE_DEBUGGING
-#undef   CACHE_DEBUGGING
-
 typedef  struct  VIO_cache_block_struct
 {
     int                         block_index;
     VIO_SCHAR                modified_flag;
-    VIO_multidim_array              array;
-    struct  VIO_cache_block_struct  *prev_used;
-    struct  VIO_cache_block_struct  *next_used;
-    struct  VIO_cache_block_struct  **prev_hash;
-    struct  VIO_cache_block_struct  *next_hash;
+    VIO_SCHAR                referenced_flag;
+    VIO_SCHAR                loading_flag;
+    VIO_SCHAR                prefetched_flag;
+    VIO_multidim_array          array;
 } VIO_cache_block_struct;
 
 typedef  struct
@@ -57,6 +53,19 @@ typedef  struct
     int       block_offset;
 } VIO_cache_lookup_struct;
 
+/*--- the most shards the blocks of a cache are spread over */
+
+#define  MAX_CACHE_SHARDS  16
+
+/*--- the blocks are spread over shards, each with its own hash table
+      and lock, defined in volume_cache.c, as is the queue of blocks to be
+      read ahead; the recorder of accesses is in volume_cache_trace.c */
+
+struct  VIO_cache_shard_struct;
+struct  VIO_cache_mutex_struct;
+struct  VIO_cache_prefetch_struct;
+struct  VIO_cache_trace_struct;
+
 typedef struct
 {
     int                         n_dimensions;
@@ -79,23 +88,56 @@ typedef struct
     VIO_BOOL                    output_file_is_open;
     VIO_BOOL                    must_read_blocks_before_use;
     void                        *minc_file;
-    int                         n_blocks;
-    int                         max_cache_bytes;
+    VIO_Long                    max_cache_bytes;
+    VIO_Long                    block_bytes;
     int                         max_blocks;
-    int                         hash_table_size;
-    VIO_cache_block_struct      *head;
-    VIO_cache_block_struct      *tail;
-    VIO_cache_block_struct      **hash_table;
+    int                         n_shards;
+    struct VIO_cache_shard_struct  *shards;
+    struct VIO_cache_mutex_struct  *mutexes;
+    struct VIO_cache_prefetch_struct  *prefetch;
+    long                        epoch;
+
+    /*--- the share of the memory budget of all caches, covered by the
+          budget mutex in volume_cache.c */
+
+    VIO_Long                    n_bytes_in_cache;
+    long                        last_use;
+    int                         next_shard_to_give_up;
+    VIO_Long                    n_blocks_given_up;
+    VIO_Long                    n_blocks_taken;
 
     VIO_cache_lookup_struct     *lookup[VIO_MAX_DIMENSIONS];
-    VIO_cache_block_struct      *previous_block;
-    int                         previous_block_index;
+
+    /*--- the reading and writing of blocks, covered by the file mutex */
+
+    VIO_Long                    n_bytes_read;
+    VIO_Long                    n_bytes_written;
+    VIO_Real                    read_seconds;
+    VIO_Real                    write_seconds;
+
+    struct VIO_cache_trace_struct  *trace;
 
     VIO_BOOL                    debugging_on;
-    int                         n_accesses;
     int                         output_every;
-    int                         n_hits;
-    int                         n_prev_hits;
+    VIO_Long                    n_debug_misses;
 } VIO_volume_cache_struct;
 
+typedef struct
+{
+    VIO_Long                    n_bytes_in_cache;
+    VIO_Long                    max_bytes_in_cache;
+    VIO_Long                    n_blocks_in_cache;
+    VIO_Long                    n_blocks_given_up;
+    VIO_Long                    n_blocks_taken;
+
+    VIO_Long                    n_hits;
+    VIO_Long                    n_prev_hits;
+    VIO_Long                    n_misses;
+    VIO_Long                    n_evictions;
+    VIO_Long                    n_bytes_read;
+    VIO_Long                    n_bytes_written;
+    VIO_Real                    read_seconds;
+    VIO_Real                    write_seconds;
+} VIO_volume_cache_stats;
+
 #endif /* VOL_IO_VOLUME_CACHE_H */
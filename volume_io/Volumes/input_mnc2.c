@@ -621,7 +621,7 @@ VIOAPI  VIO_Status  close_minc2_input(
 @MODIFIED   : 
 ---------------------------------------------------------------------------- */
 
-static  VIO_Status   input_minc2_hyperslab(
+VIOAPI  VIO_Status   input_minc2_hyperslab(
     Minc_file        file,
     VIO_Data_types   data_type,
     int              n_array_dims,
@@ -882,9 +882,24 @@ VIOAPI  VIO_BOOL  input_more_minc2_file(
     if( !volume_is_alloced( volume ) )
     {
         alloc_volume_data( volume );
+        if( volume->is_cached_volume )
+        {
+            open_cache_volume_input_file( &volume->cache, volume,
+                                          file->filename,
+                                          &file->original_input_options );
+        }
         if( !volume_is_alloced( volume ) ) return( FALSE );
     }
 
+    /* --- a cached volume reads its blocks from the file as they are used */
+
+    if( volume->is_cached_volume )
+    {
+        *fraction_done = 1.0;
+        file->end_volume_flag = TRUE;
+        return( FALSE );
+    }
+
       /* --- set the counts for reading, actually these will be the same
               every time */
 
@@ -809,7 +809,7 @@ VIOAPI  VIO_Status  set_minc2_output_random_order(
 @MODIFIED   : 
 ---------------------------------------------------------------------------- */
 
-static  VIO_Status  output_minc2_hyperslab(
+VIOAPI  VIO_Status  output_minc2_hyperslab(
     Minc_file           file,
     VIO_Data_types      data_type,
     int                 n_array_dims,
@@ -19,19 +19,33 @@
 
 #include  <internal_volume_io.h>
 
+#ifdef HAVE_PTHREAD
+#include  <pthread.h>
+#endif
+
+#if HAVE_UNISTD_H
+#include  <unistd.h>
+#endif
+
 
-#define   HASH_FUNCTION_CONSTANT          0.6180339887498948482
-#define   HASH_TABLE_SIZE_FACTOR          3
+#define   HASH_FUNCTION_CONSTANT          2654435761u
+#define   HASH_TABLE_SIZE_FACTOR          2
+#define   NO_BLOCK                        -1
 
 #define   DEFAULT_BLOCK_SIZE              64
 #define   DEFAULT_CACHE_THRESHOLD         -1
 #define   DEFAULT_MAX_BYTES_IN_CACHE      100000000
+#define   DEFAULT_READ_AHEAD_BLOCKS       4
+#define   DEFAULT_CACHE_BUDGET            0
 
 static  VIO_BOOL  n_bytes_cache_threshold_set = FALSE;
-static  int      n_bytes_cache_threshold = DEFAULT_CACHE_THRESHOLD;
+static  VIO_Long  n_bytes_cache_threshold = DEFAULT_CACHE_THRESHOLD;
 
 static  VIO_BOOL  default_cache_size_set = FALSE;
-static  int      default_cache_size = DEFAULT_MAX_BYTES_IN_CACHE;
+static  VIO_Long  default_cache_size = DEFAULT_MAX_BYTES_IN_CACHE;
+
+static  VIO_BOOL  default_read_ahead_set = FALSE;
+static  int      default_read_ahead = DEFAULT_READ_AHEAD_BLOCKS;
 
 
 static  VIO_Cache_block_size_hints   block_size_hint = RANDOM_VOLUME_ACCESS;
@@ -43,23 +57,206 @@ static  int      default_block_sizes[VIO_MAX_DIMENSIONS] = {
                                                      DEFAULT_BLOCK_SIZE,
                                                      DEFAULT_BLOCK_SIZE };
 
+/*--- Any number of threads may get and set voxels of a cached volume at
+      once.  A block belongs to the shard given by its index, and the
+      shard's lock covers its hash table, its clock and the contents of
+      its blocks: voxels are read under the shared lock, unless the block
+      must be loaded or marked as referenced, everything else under the
+      exclusive lock.  The file is
+      read and written under the cache's file mutex, taken after a shard
+      lock; the open mutex, taken before any other, covers opening the
+      output file on the first write, which switches files with every
+      shard locked.  Blocks read ahead are loaded by a thread of the
+      cache's own, which reads the file with the shard unlocked; until it
+      is done the block is marked as loading, is never stolen, and any
+      thread wanting it waits for it.  Changing the block sizes or the
+      cache size, flushing and deleting the cache must not be done while
+      other threads are using the volume. */
+
+/*--- The caches of all volumes share one budget of memory.  A block's
+      voxels are allocated when the block is first needed, and when the
+      budget is spent, a block is taken from the volume whose cache was
+      least recently missed, freeing its voxels.  The budget mutex covers
+      the list of cached volumes and the memory counts; it is taken after
+      a shard lock, and while it is held the shards of other volumes are
+      only ever tried, never waited for. */
+
+typedef  struct  VIO_cache_shard_struct
+{
+#ifdef HAVE_PTHREAD
+    pthread_rwlock_t            lock;
+#endif
+    VIO_Long                    n_hits;
+    VIO_Long                    n_prev_hits;
+    VIO_Long                    n_misses;
+    VIO_Long                    n_evictions;
+    int                         n_blocks;
+    int                         max_blocks;
+    int                         clock_hand;
+    VIO_cache_block_struct      *blocks;
+    int                         n_free_blocks;
+    int                         *free_blocks;
+    int                         hash_shift;
+    int                         hash_table_size;
+    int                         *hash_table;
+} cache_shard_struct;
+
+struct  VIO_cache_mutex_struct
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t             file_mutex;
+    pthread_mutex_t             open_mutex;
+#else
+    int                         unused;
+#endif
+};
+
+#ifdef HAVE_PTHREAD
+#define  READ_LOCK_SHARD( shard )   pthread_rwlock_rdlock( &(shard)->lock )
+#define  WRITE_LOCK_SHARD( shard )  pthread_rwlock_wrlock( &(shard)->lock )
+#define  TRY_WRITE_LOCK_SHARD( shard )  \
+                          (pthread_rwlock_trywrlock( &(shard)->lock ) == 0)
+#define  UNLOCK_SHARD( shard )      pthread_rwlock_unlock( &(shard)->lock )
+#define  LOCK_CACHE_MUTEX( cache, m )   \
+                          pthread_mutex_lock( &(cache)->mutexes->m )
+#define  UNLOCK_CACHE_MUTEX( cache, m ) \
+                          pthread_mutex_unlock( &(cache)->mutexes->m )
+#else
+#define  READ_LOCK_SHARD( shard )
+#define  WRITE_LOCK_SHARD( shard )
+#define  TRY_WRITE_LOCK_SHARD( shard )  TRUE
+#define  UNLOCK_SHARD( shard )
+#define  LOCK_CACHE_MUTEX( cache, m )
+#define  UNLOCK_CACHE_MUTEX( cache, m )
+#endif
+
+/*--- the accesses to a shard are counted next to its lock, which the
+      access has just taken; hits are counted under the shared lock, so
+      the counts are added atomically, or, without atomic builtins, may
+      miss hits made by several threads at once */
+
+#if defined(HAVE_PTHREAD) && defined(HAVE_ATOMIC_BUILTINS)
+#define  COUNT_CACHE_EVENT( count ) \
+                   (void) __atomic_add_fetch( &(count), 1, __ATOMIC_RELAXED )
+#define  GET_CACHE_COUNT( count ) \
+                   __atomic_load_n( &(count), __ATOMIC_RELAXED )
+#else
+#define  COUNT_CACHE_EVENT( count )   (void) ++(count)
+#define  GET_CACHE_COUNT( count )     (count)
+#endif
+
+/*--- the blocks queued to be read ahead, and the last blocks missed, from
+      which runs of blocks at a constant stride are detected; all covered
+      by the prefetch mutex, taken after a shard lock */
+
+typedef  struct  VIO_cache_prefetch_struct
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t             mutex;
+    pthread_cond_t              work_cond;
+    pthread_cond_t              done_cond;
+    pthread_t                   thread;
+    VIO_BOOL                    thread_started;
+    VIO_BOOL                    stopping;
+    VIO_BOOL                    busy;
+#endif
+    int                         read_ahead;
+    int                         n_volume_blocks;
+    int                         *queue;
+    int                         queue_size;
+    int                         queue_head;
+    int                         n_queued;
+    int                         last_block_index;
+    int                         stride;
+    int                         ahead_block_index;
+} cache_prefetch_struct;
+
+/*--- each thread remembers the last block it used, so that the next access
+      to the same block skips the hash table.  The epoch tells whether the
+      block still belongs to the same cache allocation; whether it still
+      holds the same block index is checked under the shard lock. */
+
+#if !defined(HAVE_PTHREAD) || defined(HAVE_THREAD_LOCAL)
+#define  USE_PREVIOUS_BLOCK
+
+#ifdef HAVE_PTHREAD
+#define  CACHE_THREAD_LOCAL   __thread
+#else
+#define  CACHE_THREAD_LOCAL
+#endif
+
+typedef  struct
+{
+    long                        epoch;
+    int                         block_index;
+    VIO_cache_block_struct      *block;
+} previous_block_struct;
+
+static  CACHE_THREAD_LOCAL  previous_block_struct  previous_block =
+                                                         { 0, -1, NULL };
+#endif
+
+static  long  cache_epoch = 0;
+
+#ifdef HAVE_PTHREAD
+static  pthread_mutex_t  cache_epoch_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*--- the memory budget of all caches, the volumes sharing it and the
+      bytes they hold, covered by the budget mutex */
+
+static  VIO_BOOL    cache_budget_set = FALSE;
+static  VIO_Long    cache_budget = DEFAULT_CACHE_BUDGET;
+static  VIO_Long    n_bytes_in_caches = 0;
+static  int         n_cached_volumes = 0;
+static  VIO_Volume  *cached_volumes = NULL;
+static  long        cache_use_tick = 0;
+
+/*--- the statistics of the caches deleted, kept to be written out at exit
+      if the environment asks, also covered by the budget mutex */
+
+typedef  struct
+{
+    VIO_STR                     filename;
+    VIO_volume_cache_stats      stats;
+} kept_cache_stats_struct;
+
+static  VIO_BOOL                 cache_stats_output_checked = FALSE;
+static  VIO_STR                  cache_stats_filename = NULL;
+static  int                      n_kept_cache_stats = 0;
+static  kept_cache_stats_struct  *kept_cache_stats = NULL;
+static  int                      n_cache_traces = 0;
+
+#ifdef HAVE_PTHREAD
+static  pthread_mutex_t  cache_budget_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define  LOCK_CACHE_BUDGET()     pthread_mutex_lock( &cache_budget_mutex )
+#define  UNLOCK_CACHE_BUDGET()   pthread_mutex_unlock( &cache_budget_mutex )
+#else
+#define  LOCK_CACHE_BUDGET()
+#define  UNLOCK_CACHE_BUDGET()
+#endif
+
 static  void  alloc_volume_cache(
     VIO_volume_cache_struct   *cache,
     VIO_Volume                volume );
 
-#ifdef  CACHE_DEBUGGING
+static  void  wait_for_cache_prefetch(
+    VIO_volume_cache_struct   *cache );
+
+static  void  stop_cache_prefetch(
+    VIO_volume_cache_struct   *cache );
+
 static  void  initialize_cache_debug(
     VIO_volume_cache_struct  *cache );
 
-static  void  record_cache_hit(
-    VIO_volume_cache_struct  *cache );
+static  void  record_cache_debug_miss(
+    VIO_Volume               volume );
 
-static  void  record_cache_prev_hit(
-    VIO_volume_cache_struct  *cache );
+static  void  initialize_cache_stats_output(
+    VIO_Volume               volume );
 
-static  void  record_cache_no_hit(
-    VIO_volume_cache_struct  *cache );
-#endif
+static  void  keep_volume_cache_stats(
+    VIO_Volume               volume );
 
 /* ----------------------------- MNI Header -----------------------------------
 @NAME       : set_n_bytes_cache_threshold
@@ -73,11 +270,11 @@ static  void  record_cache_no_hit(
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - 64-bit size
 ---------------------------------------------------------------------------- */
 
 VIOAPI  void  set_n_bytes_cache_threshold(
-    int  threshold )
+    VIO_Long  threshold )
 {
     n_bytes_cache_threshold = threshold;
     n_bytes_cache_threshold_set = TRUE;
@@ -95,17 +292,17 @@ VIOAPI  void  set_n_bytes_cache_threshold(
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - 64-bit size
 ---------------------------------------------------------------------------- */
 
-VIOAPI  int  get_n_bytes_cache_threshold( void )
+VIOAPI  VIO_Long  get_n_bytes_cache_threshold( void )
 {
-    int   n_bytes;
+    VIO_Long   n_bytes;
 
     if( !n_bytes_cache_threshold_set )
     {
         if( getenv( "VOLUME_CACHE_THRESHOLD" ) != NULL &&
-            sscanf( getenv( "VOLUME_CACHE_THRESHOLD" ), "%d", &n_bytes ) == 1 )
+            sscanf( getenv( "VOLUME_CACHE_THRESHOLD" ), "%lld", &n_bytes ) == 1 )
         {
             n_bytes_cache_threshold = n_bytes;
         }
@@ -126,11 +323,11 @@ VIOAPI  int  get_n_bytes_cache_threshold( void )
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Oct. 19, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - 64-bit size
 ---------------------------------------------------------------------------- */
 
 VIOAPI  void  set_default_max_bytes_in_cache(
-    int   max_bytes )
+    VIO_Long   max_bytes )
 {
     default_cache_size_set = TRUE;
     default_cache_size = max_bytes;
@@ -147,17 +344,17 @@ VIOAPI  void  set_default_max_bytes_in_cache(
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - 64-bit size
 ---------------------------------------------------------------------------- */
 
-VIOAPI  int  get_default_max_bytes_in_cache( void )
+VIOAPI  VIO_Long  get_default_max_bytes_in_cache( void )
 {
-    int   n_bytes;
+    VIO_Long   n_bytes;
 
     if( !default_cache_size_set )
     {
         if( getenv( "VOLUME_CACHE_SIZE" ) != NULL &&
-            sscanf( getenv( "VOLUME_CACHE_SIZE" ), "%d", &n_bytes ) == 1 )
+            sscanf( getenv( "VOLUME_CACHE_SIZE" ), "%lld", &n_bytes ) == 1 )
         {
             default_cache_size = n_bytes;
         }
@@ -216,6 +413,157 @@ VIOAPI  void  set_cache_block_sizes_hint(
     default_block_sizes_set = FALSE;
 }
 
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : set_default_cache_read_ahead
+@INPUT      : n_blocks
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Sets the default number of blocks read ahead of a run of
+              cache misses at a constant stride.  Zero turns read-ahead off.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  void  set_default_cache_read_ahead(
+    int   n_blocks )
+{
+    default_read_ahead_set = TRUE;
+    default_read_ahead = n_blocks;
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_default_cache_read_ahead
+@INPUT      : 
+@OUTPUT     : 
+@RETURNS    : number of blocks
+@DESCRIPTION: Returns the number of blocks read ahead by a volume's cache.
+              If it hasn't been set, returns the program initialized value,
+              or the value set by the environment variable.  With a single
+              processor, reading ahead only takes time from the program, so
+              the initialized value is then zero.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  int  get_default_cache_read_ahead( void )
+{
+    int   n_blocks;
+
+    if( !default_read_ahead_set )
+    {
+#if HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
+        if( sysconf( _SC_NPROCESSORS_ONLN ) == 1 )
+            default_read_ahead = 0;
+#endif
+
+        if( getenv( "VOLUME_CACHE_READ_AHEAD" ) != NULL &&
+            sscanf( getenv( "VOLUME_CACHE_READ_AHEAD" ), "%d", &n_blocks ) == 1 )
+        {
+            default_read_ahead = n_blocks;
+        }
+
+        default_read_ahead_set = TRUE;
+    }
+
+    return( default_read_ahead );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : set_volume_cache_budget
+@INPUT      : max_bytes
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Sets the maximum amount of memory held by the caches of all
+              volumes together.  A non-positive value leaves only the limit
+              of each volume's cache.  A lower budget takes effect as blocks
+              are next needed.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  void  set_volume_cache_budget(
+    VIO_Long   max_bytes )
+{
+    LOCK_CACHE_BUDGET();
+    cache_budget_set = TRUE;
+    cache_budget = max_bytes;
+    UNLOCK_CACHE_BUDGET();
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_volume_cache_budget
+@INPUT      : 
+@OUTPUT     : 
+@RETURNS    : number of bytes
+@DESCRIPTION: Returns the maximum amount of memory held by the caches of
+              all volumes together.  If it hasn't been set, returns the
+              program initialized value, or the value set by the environment
+              variable.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  VIO_Long  get_volume_cache_budget( void )
+{
+    VIO_Long   n_bytes;
+
+    LOCK_CACHE_BUDGET();
+
+    if( !cache_budget_set )
+    {
+        if( getenv( "VOLUME_CACHE_BUDGET" ) != NULL &&
+            sscanf( getenv( "VOLUME_CACHE_BUDGET" ), "%lld", &n_bytes ) == 1 )
+        {
+            cache_budget = n_bytes;
+        }
+
+        cache_budget_set = TRUE;
+    }
+
+    n_bytes = cache_budget;
+
+    UNLOCK_CACHE_BUDGET();
+
+    return( n_bytes );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_n_bytes_in_volume_caches
+@INPUT      : 
+@OUTPUT     : 
+@RETURNS    : number of bytes
+@DESCRIPTION: Returns the amount of memory held by the blocks of the caches
+              of all volumes.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  VIO_Long  get_n_bytes_in_volume_caches( void )
+{
+    VIO_Long   n_bytes;
+
+    LOCK_CACHE_BUDGET();
+    n_bytes = n_bytes_in_caches;
+    UNLOCK_CACHE_BUDGET();
+
+    return( n_bytes );
+}
+
 /* ----------------------------- MNI Header -----------------------------------
 @NAME       : get_default_cache_block_sizes
 @INPUT      : 
@@ -287,7 +635,8 @@ static  void  get_default_cache_block_sizes(
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - statistics and trace asked for by the
+                                environment
 ---------------------------------------------------------------------------- */
 
 VIOAPI  void  initialize_volume_cache(
@@ -312,6 +661,41 @@ VIOAPI  void  initialize_volume_cache(
     cache->output_file_is_open = FALSE;
     cache->must_read_blocks_before_use = FALSE;
 
+    ALLOC( cache->mutexes, 1 );
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init( &cache->mutexes->file_mutex, NULL );
+    pthread_mutex_init( &cache->mutexes->open_mutex, NULL );
+#endif
+
+    ALLOC( cache->prefetch, 1 );
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init( &cache->prefetch->mutex, NULL );
+    pthread_cond_init( &cache->prefetch->work_cond, NULL );
+    pthread_cond_init( &cache->prefetch->done_cond, NULL );
+    cache->prefetch->thread_started = FALSE;
+    cache->prefetch->stopping = FALSE;
+    cache->prefetch->busy = FALSE;
+#endif
+    cache->prefetch->read_ahead = get_default_cache_read_ahead();
+
+    cache->n_bytes_in_cache = 0;
+    cache->last_use = 0;
+    cache->next_shard_to_give_up = 0;
+    cache->n_blocks_given_up = 0;
+    cache->n_blocks_taken = 0;
+
+    cache->n_bytes_read = 0;
+    cache->n_bytes_written = 0;
+    cache->read_seconds = 0.0;
+    cache->write_seconds = 0.0;
+    cache->trace = NULL;
+
+    /*--- read the budget from the environment before any block is taken,
+          and start the clock timing the file accesses */
+
+    (void) get_volume_cache_budget();
+    (void) current_realtime_seconds();
+
     get_volume_sizes( volume, sizes );
 
     get_default_cache_block_sizes( n_dims, sizes, cache->block_sizes );
@@ -319,9 +703,38 @@ VIOAPI  void  initialize_volume_cache(
 
     alloc_volume_cache( cache, volume );
 
-#ifdef CACHE_DEBUGGING
     initialize_cache_debug( cache );
+
+    initialize_cache_stats_output( volume );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : new_cache_epoch
+@INPUT      : 
+@OUTPUT     : 
+@RETURNS    : epoch
+@DESCRIPTION: Returns a number not returned before, identifying one
+              allocation of the blocks of a cache.
+@METHOD     : 
+@GLOBALS    : cache_epoch
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  long  new_cache_epoch( void )
+{
+    long   epoch;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock( &cache_epoch_mutex );
 #endif
+    epoch = ++cache_epoch;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock( &cache_epoch_mutex );
+#endif
+
+    return( epoch );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -331,21 +744,24 @@ VIOAPI  void  initialize_volume_cache(
 @OUTPUT     : 
 @RETURNS    : 
 @DESCRIPTION: Allocates the volume cache.  Uses the current value of the
-              volumes max cache size and block sizes to decide how much to
-              allocate.
+              volumes max cache size and block sizes to decide how many
+              blocks it may hold, and adds the volume to those sharing the
+              memory budget.
 @METHOD     : 
-@GLOBALS    : 
+@GLOBALS    : cached_volumes
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - voxels allocated as blocks are used
 ---------------------------------------------------------------------------- */
 
 static  void  alloc_volume_cache(
     VIO_volume_cache_struct   *cache,
     VIO_Volume                volume )
 {
-    int    dim, n_dims, sizes[VIO_MAX_DIMENSIONS], block, block_size;
-    int    x, block_stride, remainder, block_index;
+    int       dim, n_dims, sizes[VIO_MAX_DIMENSIONS], block, block_size;
+    int       x, block_stride, remainder, block_index, s;
+    VIO_Long  max_blocks;
+    cache_shard_struct   *shard;
 
     get_volume_sizes( volume, sizes );
     n_dims = get_volume_n_dimensions( volume );
@@ -375,33 +791,156 @@ static  void  alloc_volume_cache(
     }
 
     cache->total_block_size = block_size;
-    cache->max_blocks = cache->max_cache_bytes / block_size /
-                        get_type_size(get_volume_data_type(volume));
+    cache->block_bytes = (VIO_Long) block_size *
+                   (VIO_Long) get_type_size( get_volume_data_type(volume) );
+
+    max_blocks = cache->max_cache_bytes / cache->block_bytes;
+
+    if( max_blocks < 1 )
+        max_blocks = 1;
+
+    /*--- the blocks are allocated up front, so never more than the volume */
+
+    if( max_blocks > block_stride )
+        max_blocks = block_stride;
+
+    cache->max_blocks = (int) max_blocks;
+
+    /*--- share the blocks among the shards, at least one each */
+
+    cache->n_shards = MIN( cache->max_blocks, MAX_CACHE_SHARDS );
+
+    ALLOC( cache->shards, cache->n_shards );
+
+    for_less( s, 0, cache->n_shards )
+    {
+        shard = &cache->shards[s];
 
-    if( cache->max_blocks < 1 )
-        cache->max_blocks = 1;
+#ifdef HAVE_PTHREAD
+        pthread_rwlock_init( &shard->lock, NULL );
+#endif
+        shard->max_blocks = cache->max_blocks / cache->n_shards;
+        if( s < cache->max_blocks % cache->n_shards )
+            ++shard->max_blocks;
+
+        /*--- the voxels of a block are only allocated when it is used,
+              so the blocks start out free, to be taken in order */
+
+        ALLOC( shard->blocks, shard->max_blocks );
+        ALLOC( shard->free_blocks, shard->max_blocks );
+
+        for_less( block, 0, shard->max_blocks )
+        {
+            shard->blocks[block].block_index = NO_BLOCK;
+            shard->blocks[block].loading_flag = FALSE;
+            shard->free_blocks[block] = shard->max_blocks - 1 - block;
+        }
+
+        shard->n_free_blocks = shard->max_blocks;
+
+        shard->n_hits = 0;
+        shard->n_prev_hits = 0;
+        shard->n_misses = 0;
+        shard->n_evictions = 0;
+
+        /*--- create and initialize an empty hash table, a power of two
+              at least twice the number of blocks */
+
+        shard->hash_shift = 32;
+        shard->hash_table_size = 1;
+        while( shard->hash_table_size <
+               shard->max_blocks * HASH_TABLE_SIZE_FACTOR )
+        {
+            shard->hash_table_size *= 2;
+            --shard->hash_shift;
+        }
+
+        ALLOC( shard->hash_table, shard->hash_table_size );
+
+        for_less( block, 0, shard->hash_table_size )
+            shard->hash_table[block] = NO_BLOCK;
+
+        shard->n_blocks = 0;
+        shard->clock_hand = 0;
+    }
 
-    /*--- create and initialize an empty hash table */
+    /*--- there is never any point queueing more blocks than fit */
 
-    cache->hash_table_size = cache->max_blocks * HASH_TABLE_SIZE_FACTOR;
+    cache->prefetch->n_volume_blocks = block_stride;
+    cache->prefetch->queue_size = cache->max_blocks;
+    ALLOC( cache->prefetch->queue, cache->prefetch->queue_size );
+    cache->prefetch->queue_head = 0;
+    cache->prefetch->n_queued = 0;
+    cache->prefetch->last_block_index = NO_BLOCK;
+    cache->prefetch->stride = 0;
+    cache->prefetch->ahead_block_index = NO_BLOCK;
+
+    cache->epoch = new_cache_epoch();
+
+    /*--- share the memory budget with the other cached volumes */
+
+    LOCK_CACHE_BUDGET();
+    cache->last_use = ++cache_use_tick;
+    cache->next_shard_to_give_up = 0;
+    ADD_ELEMENT_TO_ARRAY( cached_volumes, n_cached_volumes, volume,
+                          DEFAULT_CHUNK_SIZE );
+    UNLOCK_CACHE_BUDGET();
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : free_volume_cache_shards
+@INPUT      : cache
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Frees the shards allocated by alloc_volume_cache(), which
+              must have no blocks, and the prefetch queue, which must be
+              empty, first taking the volume off those sharing the memory
+              budget, so that no other volume takes its blocks.
+@METHOD     : 
+@GLOBALS    : cached_volumes
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  free_volume_cache_shards(
+    VIO_volume_cache_struct   *cache )
+{
+    int    s, i;
 
-    ALLOC( cache->hash_table, cache->hash_table_size );
+    LOCK_CACHE_BUDGET();
+    for_less( i, 0, n_cached_volumes )
+    {
+        if( &cached_volumes[i]->cache == cache )
+        {
+            DELETE_ELEMENT_FROM_ARRAY( cached_volumes, n_cached_volumes, i,
+                                       DEFAULT_CHUNK_SIZE );
+            break;
+        }
+    }
+    UNLOCK_CACHE_BUDGET();
 
-    for_less( block, 0, cache->hash_table_size )
-        cache->hash_table[block] = NULL;
+    for_less( s, 0, cache->n_shards )
+    {
+#ifdef HAVE_PTHREAD
+        pthread_rwlock_destroy( &cache->shards[s].lock );
+#endif
+        FREE( cache->shards[s].hash_table );
+        FREE( cache->shards[s].blocks );
+        FREE( cache->shards[s].free_blocks );
+    }
 
-    /*--- set up the initial pointers */
+    FREE( cache->shards );
+    cache->shards = NULL;
+    cache->n_shards = 0;
 
-    cache->previous_block_index = -1;
-    cache->head = NULL;
-    cache->tail = NULL;
-    cache->n_blocks = 0;
+    FREE( cache->prefetch->queue );
 }
 
 VIOAPI  VIO_BOOL  volume_cache_is_alloced(
     VIO_volume_cache_struct   *cache )
 {
-    return( cache->hash_table != NULL );
+    return( cache->shards != NULL );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -441,12 +980,13 @@ static  void  get_block_start(
 @OUTPUT     : 
 @RETURNS    : 
 @DESCRIPTION: Writes out a cache block to the appropriate position in the
-              corresponding file.
+              corresponding file, counting the bytes written and the time
+              taken.
 @METHOD     : 
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - counts of bytes and time
 ---------------------------------------------------------------------------- */
 
 static  void  write_cache_block(
@@ -461,6 +1001,10 @@ static  void  write_cache_block(
     int              volume_sizes[VIO_MAX_DIMENSIONS];
     int              block_start[VIO_MAX_DIMENSIONS];
     void             *array_data_ptr;
+    VIO_Long         n_voxels;
+    VIO_Real         start_time;
+
+    LOCK_CACHE_MUTEX( cache, file_mutex );
 
     minc_file = (Minc_file) cache->minc_file;
 
@@ -468,6 +1012,8 @@ static  void  write_cache_block(
 
     get_volume_sizes( volume, volume_sizes );
 
+    n_voxels = 1;
+
     for_less( dim, 0, minc_file->n_file_dimensions )
     {
         ind = minc_file->to_volume_index[dim];
@@ -476,6 +1022,7 @@ static  void  write_cache_block(
             file_start[dim] = cache->file_offset[dim] + block_start[ind];
             file_count[dim] = MIN( volume_sizes[ind] - file_start[dim],
                                    cache->block_sizes[ind] );
+            n_voxels *= file_count[dim];
         }
         else
         {
@@ -484,9 +1031,11 @@ static  void  write_cache_block(
         }
     }
 
-    GET_MULTIDIM_PTR( array_data_ptr, block->array, 0, 0, 0, 0, 0 );
+    GET_MULTIDIM_PTR_1D( array_data_ptr, block->array, 0 );
     n_dims = cache->n_dimensions;
 
+    start_time = current_realtime_seconds();
+
 #ifdef HAVE_MINC1
     output_minc_hyperslab( (Minc_file) cache->minc_file,
                                   get_multidim_data_type(&block->array),
@@ -494,71 +1043,182 @@ static  void  write_cache_block(
                                   minc_file->to_volume_index,
                                   file_start, file_count );
 #elif  defined HAVE_MINC2 
-    /*TODO: Write out minc file using MINC2 api*/
+    output_minc2_hyperslab( (Minc_file) cache->minc_file,
+                                  get_multidim_data_type(&block->array),
+                                  n_dims, cache->block_sizes, array_data_ptr,
+                                  minc_file->to_volume_index,
+                                  file_start, file_count );
 #endif
+    cache->write_seconds += current_realtime_seconds() - start_time;
+    cache->n_bytes_written += n_voxels * (VIO_Long)
+                   get_type_size( get_multidim_data_type( &block->array ) );
+
     cache->must_read_blocks_before_use = TRUE;
+
+    UNLOCK_CACHE_MUTEX( cache, file_mutex );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
-@NAME       : flush_cache_blocks
+@NAME       : add_cache_bytes
 @INPUT      : cache
-              volume
-              deleting_volume_flag
+              n_bytes
 @OUTPUT     : 
 @RETURNS    : 
-@DESCRIPTION: Writes out all blocks that have been modified, unless we are
-              writing to a temporary file and the volume is being deleted.
+@DESCRIPTION: Adds to the memory held by a cache, or, if n_bytes is
+              negative, takes from it.  The budget mutex must not be held.
 @METHOD     : 
-@GLOBALS    : 
+@GLOBALS    : n_bytes_in_caches
 @CALLS      : 
-@CREATED    : Sep. 1, 1995    David MacDonald
+@CREATED    : Oct. 16, 2026
 @MODIFIED   : 
 ---------------------------------------------------------------------------- */
 
-static  void  flush_cache_blocks(
-    VIO_volume_cache_struct   *cache,
-    VIO_Volume                volume,
-    VIO_BOOL               deleting_volume_flag )
+static  void  add_cache_bytes(
+    VIO_volume_cache_struct  *cache,
+    VIO_Long                 n_bytes )
 {
-    VIO_cache_block_struct  *block;
+    LOCK_CACHE_BUDGET();
+    cache->n_bytes_in_cache += n_bytes;
+    n_bytes_in_caches += n_bytes;
+    UNLOCK_CACHE_BUDGET();
+}
 
-    /*--- don't bother flushing if deleting volume and just writing to temp */
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : take_free_cache_block
+@INPUT      : cache
+              shard
+              volume
+@OUTPUT     : 
+@RETURNS    : block
+@DESCRIPTION: Takes a free block of a shard, which must have one, and
+              allocates its voxels.  The memory must already have been
+              added to the cache's, and the shard locked for writing.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
 
-    if( cache->writing_to_temp_file && deleting_volume_flag )
-        return;
+static  VIO_cache_block_struct  *take_free_cache_block(
+    VIO_volume_cache_struct  *cache,
+    cache_shard_struct       *shard,
+    VIO_Volume               volume )
+{
+    VIO_cache_block_struct  *block;
 
-    /*--- step through linked list, freeing blocks */
+    --shard->n_free_blocks;
+    block = &shard->blocks[shard->free_blocks[shard->n_free_blocks]];
+    ++shard->n_blocks;
 
-    block = cache->head;
-    while( block != NULL )
-    {
-        if( block->modified_flag )
-        {
-            write_cache_block( cache, volume, block );
-            block->modified_flag = FALSE;
-        }
+    create_multidim_array( &block->array, 1, &cache->total_block_size,
+                           get_volume_data_type(volume) );
 
-        block = block->next_used;
-    }
+    return( block );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
-@NAME       : flush_volume_cache
-@INPUT      : volume
+@NAME       : free_cache_block
+@INPUT      : shard
+              block
 @OUTPUT     : 
 @RETURNS    : 
-@DESCRIPTION: Writes out all blocks that have been modified.
+@DESCRIPTION: Frees the voxels of a block, which must no longer be in the
+              hash table, and returns the block to the free blocks of the
+              shard, which must be locked for writing.  The memory is not
+              taken from the cache's.
 @METHOD     : 
 @GLOBALS    : 
 @CALLS      : 
-@CREATED    : Sep. 1, 1995    David MacDonald
+@CREATED    : Oct. 16, 2026
 @MODIFIED   : 
 ---------------------------------------------------------------------------- */
 
-VIOAPI  void  flush_volume_cache(
-    VIO_Volume                volume )
+static  void  free_cache_block(
+    cache_shard_struct       *shard,
+    VIO_cache_block_struct   *block )
 {
-    flush_cache_blocks( &volume->cache, volume, FALSE );
+    delete_multidim_array( &block->array );
+
+    block->block_index = NO_BLOCK;
+    block->modified_flag = FALSE;
+    block->referenced_flag = FALSE;
+    block->prefetched_flag = FALSE;
+
+    shard->free_blocks[shard->n_free_blocks] = (int) (block - shard->blocks);
+    ++shard->n_free_blocks;
+    --shard->n_blocks;
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : flush_cache_blocks
+@INPUT      : cache
+              volume
+              deleting_volume_flag
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Writes out all blocks that have been modified, unless we are
+              writing to a temporary file and the volume is being deleted.
+              Each shard is locked, since other volumes may take its blocks.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Sep. 1, 1995    David MacDonald
+@MODIFIED   : Oct. 16, 2026   - shards locked
+---------------------------------------------------------------------------- */
+
+static  void  flush_cache_blocks(
+    VIO_volume_cache_struct   *cache,
+    VIO_Volume                volume,
+    VIO_BOOL               deleting_volume_flag )
+{
+    int                     s, b;
+    cache_shard_struct      *shard;
+    VIO_cache_block_struct  *block;
+
+    /*--- don't bother flushing if deleting volume and just writing to temp */
+
+    if( cache->writing_to_temp_file && deleting_volume_flag )
+        return;
+
+    wait_for_cache_prefetch( cache );
+
+    /*--- step through the blocks of each shard, writing modified ones */
+
+    for_less( s, 0, cache->n_shards )
+    {
+        shard = &cache->shards[s];
+        WRITE_LOCK_SHARD( shard );
+        for_less( b, 0, shard->max_blocks )
+        {
+            block = &shard->blocks[b];
+            if( block->block_index != NO_BLOCK && block->modified_flag )
+            {
+                write_cache_block( cache, volume, block );
+                block->modified_flag = FALSE;
+            }
+        }
+        UNLOCK_SHARD( shard );
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : flush_volume_cache
+@INPUT      : volume
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Writes out all blocks that have been modified.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Sep. 1, 1995    David MacDonald
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  void  flush_volume_cache(
+    VIO_Volume                volume )
+{
+    flush_cache_blocks( &volume->cache, volume, FALSE );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -569,12 +1229,12 @@ VIOAPI  void  flush_volume_cache(
 @OUTPUT     : 
 @RETURNS    : 
 @DESCRIPTION: Deletes all cache blocks, writing out all blocks, if the volume
-              has been modified.
+              has been modified, and gives their memory back to the budget.
 @METHOD     : 
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - voxels freed
 ---------------------------------------------------------------------------- */
 
 static  void  delete_cache_blocks(
@@ -582,35 +1242,46 @@ static  void  delete_cache_blocks(
     VIO_Volume                volume,
     VIO_BOOL               deleting_volume_flag )
 {
-    int                 block;
-    VIO_cache_block_struct  *current, *next;
+    int                 block, s, n_freed;
+    cache_shard_struct      *shard;
 
     /*--- if required, write out cache blocks */
 
     if( !cache->writing_to_temp_file || !deleting_volume_flag )
         flush_cache_blocks( cache, volume, deleting_volume_flag );
 
-    /*--- step through linked list, freeing blocks */
+    wait_for_cache_prefetch( cache );
+
+    /*--- free the blocks of each shard, leaving no blocks present */
 
-    current = cache->head;
-    while( current != NULL )
+    for_less( s, 0, cache->n_shards )
     {
-        next = current->next_used;
-        delete_multidim_array( &current->array );
-        FREE( current );
-        current = next;
-    }
+        shard = &cache->shards[s];
+        WRITE_LOCK_SHARD( shard );
+
+        n_freed = 0;
+        for_less( block, 0, shard->max_blocks )
+        {
+            if( shard->blocks[block].block_index != NO_BLOCK )
+            {
+                free_cache_block( shard, &shard->blocks[block] );
+                ++n_freed;
+            }
+        }
 
-    /*--- initialize cache to no blocks present */
+        shard->clock_hand = 0;
 
-    cache->n_blocks = 0;
+        for_less( block, 0, shard->hash_table_size )
+            shard->hash_table[block] = NO_BLOCK;
 
-    for_less( block, 0, cache->hash_table_size )
-        cache->hash_table[block] = NULL;
+        add_cache_bytes( cache, -n_freed * cache->block_bytes );
 
-    cache->previous_block_index = -1;
-    cache->head = NULL;
-    cache->tail = NULL;
+        UNLOCK_SHARD( shard );
+    }
+
+    /*--- blocks remembered by any thread are no longer valid */
+
+    cache->epoch = new_cache_epoch();
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -624,7 +1295,7 @@ static  void  delete_cache_blocks(
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - stops the trace, keeps the statistics
 ---------------------------------------------------------------------------- */
 
 VIOAPI  void  delete_volume_cache(
@@ -633,10 +1304,15 @@ VIOAPI  void  delete_volume_cache(
 {
     int   dim, n_dims;
 
+    stop_cache_prefetch( cache );
+
+    stop_volume_cache_trace( volume );
+
     delete_cache_blocks( cache, volume, TRUE );
 
-    FREE( cache->hash_table );
-    cache->hash_table = NULL;
+    keep_volume_cache_stats( volume );
+
+    free_volume_cache_shards( cache );
 
     n_dims = cache->n_dimensions;
     for_less( dim, 0, n_dims )
@@ -669,6 +1345,16 @@ VIOAPI  void  delete_volume_cache(
             (void) close_minc2_input( (Minc_file) cache->minc_file );
 #endif
     }
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_destroy( &cache->mutexes->file_mutex );
+    pthread_mutex_destroy( &cache->mutexes->open_mutex );
+    pthread_mutex_destroy( &cache->prefetch->mutex );
+    pthread_cond_destroy( &cache->prefetch->work_cond );
+    pthread_cond_destroy( &cache->prefetch->done_cond );
+#endif
+    FREE( cache->mutexes );
+    FREE( cache->prefetch );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -720,7 +1406,7 @@ VIOAPI  void  set_volume_cache_block_sizes(
 
     delete_cache_blocks( cache, volume, FALSE );
 
-    FREE( cache->hash_table );
+    free_volume_cache_shards( cache );
 
     for_less( dim, 0, get_volume_n_dimensions( volume ) )
     {
@@ -746,12 +1432,12 @@ VIOAPI  void  set_volume_cache_block_sizes(
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Oct. 24, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - 64-bit size
 ---------------------------------------------------------------------------- */
 
 VIOAPI  void  set_volume_cache_size(
     VIO_Volume    volume,
-    int       max_memory_bytes )
+    VIO_Long      max_memory_bytes )
 {
     int                   dim;
     VIO_volume_cache_struct   *cache;
@@ -763,7 +1449,7 @@ VIOAPI  void  set_volume_cache_size(
 
     delete_cache_blocks( cache, volume, FALSE );
 
-    FREE( cache->hash_table );
+    free_volume_cache_shards( cache );
 
     for_less( dim, 0, get_volume_n_dimensions( volume ) )
     {
@@ -853,6 +1539,36 @@ VIOAPI  void  open_cache_volume_input_file(
     cache->must_read_blocks_before_use = TRUE;
 }
 
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : lock_all_cache_shards
+@INPUT      : cache
+              locking
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Locks every shard for writing, or unlocks them, so that
+              fields read by voxel accesses under a shard lock can be changed.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  lock_all_cache_shards(
+    VIO_volume_cache_struct   *cache,
+    VIO_BOOL                  locking )
+{
+    int   s;
+
+    for_less( s, 0, cache->n_shards )
+    {
+        if( locking )
+            WRITE_LOCK_SHARD( &cache->shards[s] );
+        else
+            UNLOCK_SHARD( &cache->shards[s] );
+    }
+}
+
 /* ----------------------------- MNI Header -----------------------------------
 @NAME       : open_cache_volume_output_file
 @INPUT      : cache
@@ -981,9 +1697,19 @@ static  VIO_Status  open_cache_volume_output_file(
     {
 #ifdef HAVE_MINC1
         (void) output_minc_volume( out_minc_file );
-        (void) close_minc_input( (Minc_file) cache->minc_file );
 #elif defined  HAVE_MINC2
         (void) output_minc2_volume( out_minc_file );
+#endif 
+    }
+
+    lock_all_cache_shards( cache, TRUE );
+    LOCK_CACHE_MUTEX( cache, file_mutex );
+
+    if( cache->minc_file != NULL )
+    {
+#ifdef HAVE_MINC1
+        (void) close_minc_input( (Minc_file) cache->minc_file );
+#elif defined  HAVE_MINC2
         (void) close_minc2_input( (Minc_file) cache->minc_file );
 #endif 
 
@@ -992,6 +1718,9 @@ static  VIO_Status  open_cache_volume_output_file(
 
     cache->minc_file = out_minc_file;
 
+    UNLOCK_CACHE_MUTEX( cache, file_mutex );
+    lock_all_cache_shards( cache, FALSE );
+
     delete_dimension_names( volume, out_dim_names );
 
     delete_string( output_filename );
@@ -1002,10 +1731,16 @@ static  VIO_Status  open_cache_volume_output_file(
 VIOAPI  void  cache_volume_range_has_changed(
     VIO_Volume   volume )
 {
+    int   s, n_blocks;
+
     if( !volume->is_cached_volume )
         return;
 
-    if( volume->cache.minc_file == NULL && volume->cache.n_blocks == 0 )
+    n_blocks = 0;
+    for_less( s, 0, volume->cache.n_shards )
+        n_blocks += volume->cache.shards[s].n_blocks;
+
+    if( volume->cache.minc_file == NULL && n_blocks == 0 )
         return;
 
     /* This message is not useful.
@@ -1059,12 +1794,13 @@ VIOAPI  void  set_cache_volume_file_offset(
               block_start
 @OUTPUT     : 
 @RETURNS    : 
-@DESCRIPTION: Reads one cache block.
+@DESCRIPTION: Reads one cache block, counting the bytes read and the time
+              taken.  The file mutex must be held.
 @METHOD     : 
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - counts of bytes and time
 ---------------------------------------------------------------------------- */
 
 static  void  read_cache_block(
@@ -1079,11 +1815,15 @@ static  void  read_cache_block(
     int              file_start[VIO_MAX_DIMENSIONS];
     int              file_count[VIO_MAX_DIMENSIONS];
     void             *array_data_ptr;
+    VIO_Long         n_voxels;
+    VIO_Real         start_time;
 
     minc_file = (Minc_file) cache->minc_file;
 
     get_volume_sizes( volume, sizes );
 
+    n_voxels = 1;
+
     for_less( dim, 0, minc_file->n_file_dimensions )
     {
         ind = minc_file->to_volume_index[dim];
@@ -1092,6 +1832,7 @@ static  void  read_cache_block(
             file_start[dim] = cache->file_offset[dim] + block_start[ind];
             file_count[dim] = MIN( sizes[ind] - file_start[dim],
                                    cache->block_sizes[ind] );
+            n_voxels *= file_count[dim];
         }
         else
         {
@@ -1101,7 +1842,9 @@ static  void  read_cache_block(
     }
 
     n_dims = cache->n_dimensions;
-    GET_MULTIDIM_PTR( array_data_ptr, block->array, 0, 0, 0, 0, 0 );
+    GET_MULTIDIM_PTR_1D( array_data_ptr, block->array, 0 );
+
+    start_time = current_realtime_seconds();
 
 #ifdef HAVE_MINC1
     input_minc_hyperslab( (Minc_file) cache->minc_file,
@@ -1110,184 +1853,913 @@ static  void  read_cache_block(
                                  minc_file->to_volume_index,
                                  file_start, file_count );
 #elif defined HAVE_MINC2
-    /*TODO: call minc2 api ?*/
+    input_minc2_hyperslab( (Minc_file) cache->minc_file,
+                                 get_multidim_data_type(&block->array),
+                                 n_dims, cache->block_sizes, array_data_ptr,
+                                 minc_file->to_volume_index,
+                                 file_start, file_count );
 #endif 
+
+    cache->read_seconds += current_realtime_seconds() - start_time;
+    cache->n_bytes_read += n_voxels * (VIO_Long)
+                   get_type_size( get_multidim_data_type( &block->array ) );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
-@NAME       : appropriate_a_cache_block
+@NAME       : hash_block_index
+@INPUT      : key
+              shift
+@OUTPUT     : 
+@RETURNS    : hash address
+@DESCRIPTION: Hashes a block index key into a table index, using 
+              multiplicative hashing: the top bits of the key times the
+              golden ratio, for a table of 2 to the power 32 - shift.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Sep. 1, 1995    David MacDonald
+@MODIFIED   : Oct. 16, 2026   - integer arithmetic
+---------------------------------------------------------------------------- */
+
+static  int  hash_block_index(
+    int  key,
+    int  shift )
+{
+    return( (int) (((unsigned int) key * HASH_FUNCTION_CONSTANT) >> shift) );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : find_cache_block
 @INPUT      : cache
-              volume
-@OUTPUT     : block
+              shard
+              block_index
+@OUTPUT     : hash_index
+@RETURNS    : number of the block in the shard, or NO_BLOCK
+@DESCRIPTION: Looks for a block in the hash table of a shard, probing
+              linearly from its hash address.  Passes back the position of
+              the block in the table, or of the empty entry where it would
+              be inserted.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  int  find_cache_block(
+    VIO_volume_cache_struct  *cache,
+    cache_shard_struct       *shard,
+    int                      block_index,
+    int                      *hash_index )
+{
+    int   index, mask, b;
+
+    mask = shard->hash_table_size - 1;
+    index = hash_block_index( block_index / cache->n_shards,
+                              shard->hash_shift );
+
+    while( (b = shard->hash_table[index]) != NO_BLOCK &&
+           shard->blocks[b].block_index != block_index )
+    {
+        index = (index + 1) & mask;
+    }
+
+    *hash_index = index;
+
+    return( b );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : remove_from_hash_table
+@INPUT      : cache
+              shard
+              hash_index
+@OUTPUT     : 
 @RETURNS    : 
-@DESCRIPTION: Finds an available cache block, either by allocating one, or
-              stealing the least recently used one.
+@DESCRIPTION: Removes the entry at hash_index from the hash table of a shard,
+              moving back any later entries of the same probe sequence into
+              the gap, so that lookups need no deleted markers.
 @METHOD     : 
 @GLOBALS    : 
 @CALLS      : 
-@CREATED    : Sep. 1, 1995    David MacDonald
+@CREATED    : Oct. 16, 2026
 @MODIFIED   : 
 ---------------------------------------------------------------------------- */
 
-static  VIO_cache_block_struct  *appropriate_a_cache_block(
+static  void  remove_from_hash_table(
     VIO_volume_cache_struct  *cache,
-    VIO_Volume               volume )
+    cache_shard_struct       *shard,
+    int                      hash_index )
 {
-    VIO_cache_block_struct  *block;
+    int   gap, index, home, mask, b;
 
-    /*--- if can allocate more blocks, do so */
+    mask = shard->hash_table_size - 1;
+    gap = hash_index;
+    index = hash_index;
 
-    if( cache->n_blocks < cache->max_blocks )
+    while( TRUE )
     {
-        ALLOC( block, 1 );
+        index = (index + 1) & mask;
+        b = shard->hash_table[index];
+        if( b == NO_BLOCK )
+            break;
+
+        home = hash_block_index( shard->blocks[b].block_index /
+                                 cache->n_shards, shard->hash_shift );
 
-        create_multidim_array( &block->array, 1, &cache->total_block_size,
-                               get_volume_data_type(volume) );
+        /*--- the entry can fill the gap unless its home lies cyclically
+              after the gap, up to the entry */
 
-        ++cache->n_blocks;
+        if( ((index - home) & mask) >= ((index - gap) & mask) )
+        {
+            shard->hash_table[gap] = b;
+            gap = index;
+        }
     }
-    else  /*--- otherwise, steal the least-recently used block */
-    {
-        block = cache->tail;
 
-        if( block->modified_flag )
-            write_cache_block( cache, volume, block );
+    shard->hash_table[gap] = NO_BLOCK;
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : find_block_to_steal
+@INPUT      : shard
+@OUTPUT     : 
+@RETURNS    : block, or NULL
+@DESCRIPTION: Finds the first block passed by the clock hand of a shard
+              that has not been referenced since the hand last passed it,
+              and is not being loaded, clearing the references of the blocks
+              passed over.  Returns NULL if the shard has no such block.
+              The shard must be locked for writing.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  VIO_cache_block_struct  *find_block_to_steal(
+    cache_shard_struct       *shard )
+{
+    VIO_cache_block_struct  *block;
+    int                     n_passed;
 
-        /*--- remove from used list */
+    /*--- every reference is cleared on the first turn of the hand */
 
-        if( block->prev_used == NULL )
-            cache->head = block->next_used;
-        else
-            block->prev_used->next_used = block->next_used;
+    for_less( n_passed, 0, 2 * shard->max_blocks )
+    {
+        block = &shard->blocks[shard->clock_hand];
+        if( ++shard->clock_hand == shard->max_blocks )
+            shard->clock_hand = 0;
 
-        if( block->next_used == NULL )
-            cache->tail = block->prev_used;
-        else
-            block->next_used->prev_used = block->prev_used;
+        if( block->block_index == NO_BLOCK || block->loading_flag )
+            continue;
 
-        /*--- remove from hash table */
+        if( !block->referenced_flag )
+            return( block );
 
-        *block->prev_hash = block->next_hash;
-        if( block->next_hash != NULL )
-            block->next_hash->prev_hash = block->prev_hash;
+        block->referenced_flag = FALSE;
     }
 
-    block->modified_flag = FALSE;
-
-    return( block );
+    return( NULL );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
-@NAME       : hash_block_index
-@INPUT      : key
-              table_size
+@NAME       : remove_cache_block
+@INPUT      : cache
+              shard
+              volume
+              block
 @OUTPUT     : 
-@RETURNS    : hash address
-@DESCRIPTION: Hashes a block index key into a table index, using 
-              multiplicative hashing.
+@RETURNS    : 
+@DESCRIPTION: Writes out a block about to be reused or freed, if it has
+              been modified, and removes it from the hash table of its
+              shard, which must be locked for writing.
 @METHOD     : 
 @GLOBALS    : 
 @CALLS      : 
-@CREATED    : Sep. 1, 1995    David MacDonald
+@CREATED    : Oct. 16, 2026
 @MODIFIED   : 
 ---------------------------------------------------------------------------- */
 
-static  int  hash_block_index(
-    int  key,
-    int  table_size )
+static  void  remove_cache_block(
+    VIO_volume_cache_struct  *cache,
+    cache_shard_struct       *shard,
+    VIO_Volume               volume,
+    VIO_cache_block_struct   *block )
 {
-    int    index;
-    VIO_Real   v;
+    int   hash_index;
 
-    v = (VIO_Real) key * HASH_FUNCTION_CONSTANT;
-    
-    index = (int) (( v - (VIO_Real) ((int) v)) * (VIO_Real) table_size);
+    if( block->modified_flag )
+        write_cache_block( cache, volume, block );
 
-    return( index );
+    (void) find_cache_block( cache, shard, block->block_index, &hash_index );
+    remove_from_hash_table( cache, shard, hash_index );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
-@NAME       : get_cache_block_for_voxel
+@NAME       : give_up_cache_block
 @INPUT      : volume
-              x
-              y
-              z
-              t
-              v
-@OUTPUT     : offset
-@RETURNS    : pointer to cache block
-@DESCRIPTION: Finds the cache block corresponding to a given voxel, and
-              modifies the voxel indices to be block indices.  This function
-              gets called for every set or get voxel value, so it must be
-              efficient.  On return, offset contains the integer offset
-              of the voxel within the cache block.
+              held_shard  - a shard of the volume locked by the caller,
+                            or NULL
+@OUTPUT     : 
+@RETURNS    : TRUE if a block was given up
+@DESCRIPTION: Frees a block of a volume's cache, to make room for a block
+              of another volume, or of another shard.  The shards are tried
+              in turn, never waited for, and the block is chosen by the
+              clock of its shard.  The budget mutex must be held.
 @METHOD     : 
-@GLOBALS    : 
+@GLOBALS    : n_bytes_in_caches
 @CALLS      : 
-@CREATED    : Sep. 1, 1995    David MacDonald
+@CREATED    : Oct. 16, 2026
 @MODIFIED   : 
 ---------------------------------------------------------------------------- */
 
-static  VIO_cache_block_struct  *get_cache_block_for_voxel(
-    VIO_Volume   volume,
-    int      x,
-    int      y,
-    int      z,
-    int      t,
-    int      v,
-    int      *offset )
+static  VIO_BOOL  give_up_cache_block(
+    VIO_Volume               volume,
+    cache_shard_struct       *held_shard )
 {
-    VIO_cache_block_struct   *block;
-    VIO_cache_lookup_struct  *lookup0, *lookup1, *lookup2, *lookup3, *lookup4;
-    int                  block_index;
-    int                  block_start[VIO_MAX_DIMENSIONS];
-    int                  n_dims, hash_index;
     VIO_volume_cache_struct  *cache;
+    VIO_cache_block_struct   *block;
+    cache_shard_struct       *shard;
+    int                      i, s;
 
     cache = &volume->cache;
-    n_dims = cache->n_dimensions;
 
-    switch( n_dims )
+    for_less( i, 0, cache->n_shards )
     {
-    case 1:
-        lookup0 = &cache->lookup[0][x];
-        block_index = lookup0->block_index_offset;
-        *offset = lookup0->block_offset;
-        break;
+        s = (cache->next_shard_to_give_up + i) % cache->n_shards;
+        shard = &cache->shards[s];
 
-    case 2:
-        lookup0 = &cache->lookup[0][x];
-        lookup1 = &cache->lookup[1][y];
-        block_index = lookup0->block_index_offset +
-                      lookup1->block_index_offset;
-        *offset = lookup0->block_offset +
-                  lookup1->block_offset;
-        break;
+        if( shard == held_shard || !TRY_WRITE_LOCK_SHARD( shard ) )
+            continue;
 
-    case 3:
-        lookup0 = &cache->lookup[0][x];
-        lookup1 = &cache->lookup[1][y];
-        lookup2 = &cache->lookup[2][z];
-        block_index = lookup0->block_index_offset +
-                      lookup1->block_index_offset +
-                      lookup2->block_index_offset;
-        *offset = lookup0->block_offset +
-                  lookup1->block_offset +
-                  lookup2->block_offset;
-        break;
+        block = NULL;
+        if( shard->n_blocks > 0 )
+            block = find_block_to_steal( shard );
 
-    case 4:
-        lookup0 = &cache->lookup[0][x];
-        lookup1 = &cache->lookup[1][y];
-        lookup2 = &cache->lookup[2][z];
-        lookup3 = &cache->lookup[3][t];
-        block_index = lookup0->block_index_offset +
-                      lookup1->block_index_offset +
-                      lookup2->block_index_offset +
-                      lookup3->block_index_offset;
-        *offset = lookup0->block_offset +
-                  lookup1->block_offset +
-                  lookup2->block_offset +
+        if( block != NULL )
+        {
+            remove_cache_block( cache, shard, volume, block );
+            free_cache_block( shard, block );
+            COUNT_CACHE_EVENT( shard->n_evictions );
+
+            cache->n_bytes_in_cache -= cache->block_bytes;
+            n_bytes_in_caches -= cache->block_bytes;
+            cache->next_shard_to_give_up = (s + 1) % cache->n_shards;
+        }
+
+        UNLOCK_SHARD( shard );
+
+        if( block != NULL )
+            return( TRUE );
+    }
+
+    return( FALSE );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : find_least_recently_used_cache
+@INPUT      : volume
+              after     - the last use of the volume last tried
+@OUTPUT     : 
+@RETURNS    : volume, or NULL
+@DESCRIPTION: Finds the cached volume, other than the one given, that holds
+              some memory, and whose cache was least recently missed, but
+              after the given use.  The budget mutex must be held.
+@METHOD     : 
+@GLOBALS    : cached_volumes
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  VIO_Volume  find_least_recently_used_cache(
+    VIO_Volume   volume,
+    long         after )
+{
+    VIO_Volume   oldest, other;
+    int          i;
+
+    oldest = NULL;
+
+    for_less( i, 0, n_cached_volumes )
+    {
+        other = cached_volumes[i];
+        if( other != volume && other->cache.n_bytes_in_cache > 0 &&
+            other->cache.last_use > after &&
+            (oldest == NULL || other->cache.last_use < oldest->cache.last_use) )
+        {
+            oldest = other;
+        }
+    }
+
+    return( oldest );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : claim_cache_block_memory
+@INPUT      : volume
+              shard
+@OUTPUT     : 
+@RETURNS    : TRUE if a free block of the shard may be used
+@DESCRIPTION: Records a miss of a volume's cache, and decides whether the
+              shard, locked for writing, may use another block.  It may if
+              it has a free block and the memory fits in the budget, once
+              the least recently used other volumes have given up blocks,
+              or if the shard holds none, other shards of the volume.  The
+              memory is then added to the cache's.  Otherwise the shard must
+              reuse one of its own blocks.
+@METHOD     : 
+@GLOBALS    : cache_use_tick
+              n_bytes_in_caches
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  VIO_BOOL  claim_cache_block_memory(
+    VIO_Volume               volume,
+    cache_shard_struct       *shard )
+{
+    VIO_volume_cache_struct  *cache;
+    VIO_Volume               other;
+    long                     after;
+    VIO_BOOL                 fits;
+
+    cache = &volume->cache;
+
+    LOCK_CACHE_BUDGET();
+
+    cache->last_use = ++cache_use_tick;
+
+    fits = (shard->n_free_blocks > 0);
+
+    if( fits && cache_budget > 0 )
+    {
+        after = 0;
+
+        while( n_bytes_in_caches + cache->block_bytes > cache_budget &&
+               (other = find_least_recently_used_cache( volume, after ))
+                                                                   != NULL )
+        {
+            while( n_bytes_in_caches + cache->block_bytes > cache_budget &&
+                   give_up_cache_block( other, NULL ) )
+            {
+                ++other->cache.n_blocks_given_up;
+                ++cache->n_blocks_taken;
+            }
+
+            after = other->cache.last_use;
+        }
+
+        /*--- a shard holding no block has none of its own to reuse */
+
+        if( shard->n_blocks == 0 )
+        {
+            while( n_bytes_in_caches + cache->block_bytes > cache_budget )
+            {
+                if( !give_up_cache_block( volume, shard ) )
+                    break;
+            }
+        }
+
+        fits = (n_bytes_in_caches + cache->block_bytes <= cache_budget);
+    }
+
+    if( fits )
+    {
+        cache->n_bytes_in_cache += cache->block_bytes;
+        n_bytes_in_caches += cache->block_bytes;
+    }
+
+    UNLOCK_CACHE_BUDGET();
+
+    return( fits );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : appropriate_a_cache_block
+@INPUT      : cache
+              shard
+              volume
+@OUTPUT     : block
+@RETURNS    : 
+@DESCRIPTION: Finds an available cache block in a shard, either by
+              taking a free one, if the memory budget allows, or stealing
+              the first block passed by the clock hand that has not been
+              referenced since the hand last passed it, and is not being
+              loaded.  If the shard has no block to steal, a free one is
+              taken even beyond the budget.  The shard must be locked for
+              writing.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Sep. 1, 1995    David MacDonald
+@MODIFIED   : Oct. 16, 2026   - second chance replacement within a shard,
+                                memory budget shared by all volumes
+---------------------------------------------------------------------------- */
+
+static  VIO_cache_block_struct  *appropriate_a_cache_block(
+    VIO_volume_cache_struct  *cache,
+    cache_shard_struct       *shard,
+    VIO_Volume               volume )
+{
+    VIO_cache_block_struct  *block;
+
+    if( claim_cache_block_memory( volume, shard ) )
+        block = take_free_cache_block( cache, shard, volume );
+    else if( (block = find_block_to_steal( shard )) != NULL )
+    {
+        remove_cache_block( cache, shard, volume, block );
+        COUNT_CACHE_EVENT( shard->n_evictions );
+    }
+    else
+    {
+        add_cache_bytes( cache, cache->block_bytes );
+        block = take_free_cache_block( cache, shard, volume );
+    }
+
+    block->modified_flag = FALSE;
+    block->referenced_flag = TRUE;
+    block->prefetched_flag = FALSE;
+
+    return( block );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : set_block_loading
+@INPUT      : cache
+              block
+              loading
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Marks a block as being read ahead, or as read, waking any
+              thread waiting for it.  The shard of the block must be locked
+              for writing.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  set_block_loading(
+    VIO_volume_cache_struct  *cache,
+    VIO_cache_block_struct   *block,
+    VIO_BOOL                 loading )
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock( &cache->prefetch->mutex );
+#endif
+    block->loading_flag = (VIO_SCHAR) loading;
+#ifdef HAVE_PTHREAD
+    if( !loading )
+        pthread_cond_broadcast( &cache->prefetch->done_cond );
+    pthread_mutex_unlock( &cache->prefetch->mutex );
+#endif
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : prefetch_cache_block
+@INPUT      : cache
+              volume
+              block_index
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Reads a block into the cache ahead of its use, unless it is
+              there already or there is nothing to read.  The block is
+              entered in the hash table as loading, not yet referenced, so
+              that it is the first to go if it is not used, and is read with
+              its shard unlocked.  Shards of a single block are left alone,
+              so as not to steal the block in use.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  prefetch_cache_block(
+    VIO_volume_cache_struct  *cache,
+    VIO_Volume               volume,
+    int                      block_index )
+{
+    VIO_cache_block_struct  *block;
+    cache_shard_struct      *shard;
+    int                     hash_index;
+    int                     block_start[VIO_MAX_DIMENSIONS];
+    VIO_BOOL                must_read;
+
+    shard = &cache->shards[block_index % cache->n_shards];
+
+    if( shard->max_blocks < 2 )
+        return;
+
+    LOCK_CACHE_MUTEX( cache, file_mutex );
+    must_read = cache->must_read_blocks_before_use;
+    UNLOCK_CACHE_MUTEX( cache, file_mutex );
+
+    if( !must_read )
+        return;
+
+    WRITE_LOCK_SHARD( shard );
+
+    if( find_cache_block( cache, shard, block_index, &hash_index ) != NO_BLOCK )
+    {
+        UNLOCK_SHARD( shard );
+        return;
+    }
+
+    block = appropriate_a_cache_block( cache, shard, volume );
+    block->block_index = block_index;
+    block->referenced_flag = FALSE;
+    block->prefetched_flag = TRUE;
+    set_block_loading( cache, block, TRUE );
+
+    (void) find_cache_block( cache, shard, block_index, &hash_index );
+    shard->hash_table[hash_index] = (int) (block - shard->blocks);
+
+    UNLOCK_SHARD( shard );
+
+    LOCK_CACHE_MUTEX( cache, file_mutex );
+    get_block_start( cache, block_index, block_start );
+    read_cache_block( cache, volume, block, block_start );
+    UNLOCK_CACHE_MUTEX( cache, file_mutex );
+
+    WRITE_LOCK_SHARD( shard );
+    set_block_loading( cache, block, FALSE );
+    UNLOCK_SHARD( shard );
+}
+
+#ifdef HAVE_PTHREAD
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : wait_for_block_load
+@INPUT      : cache
+              shard
+              block
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Waits for a block being read ahead to be read.  The shard
+              must be locked for writing; it is unlocked while waiting, and
+              locked for writing again on return, so the caller must look
+              for the block again.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  wait_for_block_load(
+    VIO_volume_cache_struct  *cache,
+    cache_shard_struct       *shard,
+    VIO_cache_block_struct   *block )
+{
+    UNLOCK_SHARD( shard );
+
+    pthread_mutex_lock( &cache->prefetch->mutex );
+    while( block->loading_flag )
+    {
+        pthread_cond_wait( &cache->prefetch->done_cond,
+                           &cache->prefetch->mutex );
+    }
+    pthread_mutex_unlock( &cache->prefetch->mutex );
+
+    WRITE_LOCK_SHARD( shard );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : cache_prefetch_thread
+@INPUT      : arg   - the volume
+@OUTPUT     : 
+@RETURNS    : NULL
+@DESCRIPTION: Reads the blocks queued for a cached volume, one at a time,
+              until the cache is deleted.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  *cache_prefetch_thread(
+    void   *arg )
+{
+    VIO_Volume             volume;
+    cache_prefetch_struct  *prefetch;
+    int                    block_index;
+
+    volume = (VIO_Volume) arg;
+    prefetch = volume->cache.prefetch;
+
+    pthread_mutex_lock( &prefetch->mutex );
+
+    while( TRUE )
+    {
+        while( prefetch->n_queued == 0 && !prefetch->stopping )
+            pthread_cond_wait( &prefetch->work_cond, &prefetch->mutex );
+
+        if( prefetch->stopping )
+            break;
+
+        block_index = prefetch->queue[prefetch->queue_head];
+        prefetch->queue_head = (prefetch->queue_head + 1) %
+                               prefetch->queue_size;
+        --prefetch->n_queued;
+        prefetch->busy = TRUE;
+
+        pthread_mutex_unlock( &prefetch->mutex );
+
+        prefetch_cache_block( &volume->cache, volume, block_index );
+
+        pthread_mutex_lock( &prefetch->mutex );
+
+        prefetch->busy = FALSE;
+        pthread_cond_broadcast( &prefetch->done_cond );
+    }
+
+    pthread_mutex_unlock( &prefetch->mutex );
+
+    return( NULL );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : queue_cache_prefetch
+@INPUT      : cache
+              volume
+              block_index
+@OUTPUT     : 
+@RETURNS    : TRUE if the block was queued
+@DESCRIPTION: Queues a block to be read ahead, starting the prefetch thread
+              of the cache the first time.  The prefetch mutex must be held.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  VIO_BOOL  queue_cache_prefetch(
+    VIO_volume_cache_struct  *cache,
+    VIO_Volume               volume,
+    int                      block_index )
+{
+    cache_prefetch_struct  *prefetch;
+
+    prefetch = cache->prefetch;
+
+    if( prefetch->n_queued >= prefetch->queue_size )
+        return( FALSE );
+
+    if( !prefetch->thread_started )
+    {
+        if( pthread_create( &prefetch->thread, NULL, cache_prefetch_thread,
+                            (void *) volume ) != 0 )
+            return( FALSE );
+
+        prefetch->thread_started = TRUE;
+    }
+
+    prefetch->queue[(prefetch->queue_head + prefetch->n_queued) %
+                    prefetch->queue_size] = block_index;
+    ++prefetch->n_queued;
+
+    pthread_cond_signal( &prefetch->work_cond );
+
+    return( TRUE );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : note_cache_block_miss
+@INPUT      : cache
+              volume
+              block_index
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Records a block that had to be read, or the first use of a
+              block read ahead.  When two in a row are the same number of
+              blocks apart, queues the blocks following at that stride,
+              up to the read-ahead of the cache, but no more than a quarter
+              of the blocks it holds.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  note_cache_block_miss(
+    VIO_volume_cache_struct  *cache,
+    VIO_Volume               volume,
+    int                      block_index )
+{
+    cache_prefetch_struct  *prefetch;
+    int                    stride, depth, k, first, next;
+
+    prefetch = cache->prefetch;
+
+    if( prefetch->read_ahead <= 0 )
+        return;
+
+    pthread_mutex_lock( &prefetch->mutex );
+
+    stride = block_index - prefetch->last_block_index;
+
+    if( stride != 0 && stride == prefetch->stride )
+    {
+        depth = MIN( prefetch->read_ahead, cache->max_blocks / 4 );
+
+        /*--- carry on from the furthest block already queued in this run */
+
+        first = 1;
+        k = (prefetch->ahead_block_index - block_index) / stride;
+        if( k >= 1 && k <= depth &&
+            block_index + k * stride == prefetch->ahead_block_index )
+            first = k + 1;
+
+        for_inclusive( k, first, depth )
+        {
+            next = block_index + k * stride;
+            if( next < 0 || next >= prefetch->n_volume_blocks ||
+                !queue_cache_prefetch( cache, volume, next ) )
+                break;
+
+            prefetch->ahead_block_index = next;
+        }
+    }
+
+    prefetch->stride = stride;
+    prefetch->last_block_index = block_index;
+
+    pthread_mutex_unlock( &prefetch->mutex );
+}
+
+#endif
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : wait_for_cache_prefetch
+@INPUT      : cache
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Empties the prefetch queue and waits for the block being read
+              ahead, if any, so that the blocks of the cache may be changed.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  wait_for_cache_prefetch(
+    VIO_volume_cache_struct   *cache )
+{
+#ifdef HAVE_PTHREAD
+    cache_prefetch_struct  *prefetch;
+
+    prefetch = cache->prefetch;
+
+    pthread_mutex_lock( &prefetch->mutex );
+
+    prefetch->n_queued = 0;
+    while( prefetch->busy )
+        pthread_cond_wait( &prefetch->done_cond, &prefetch->mutex );
+
+    prefetch->last_block_index = NO_BLOCK;
+    prefetch->stride = 0;
+    prefetch->ahead_block_index = NO_BLOCK;
+
+    pthread_mutex_unlock( &prefetch->mutex );
+#endif
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : stop_cache_prefetch
+@INPUT      : cache
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Stops the prefetch thread of a cache, if it was started, and
+              waits for it to finish.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  stop_cache_prefetch(
+    VIO_volume_cache_struct   *cache )
+{
+#ifdef HAVE_PTHREAD
+    cache_prefetch_struct  *prefetch;
+
+    prefetch = cache->prefetch;
+
+    pthread_mutex_lock( &prefetch->mutex );
+    prefetch->stopping = TRUE;
+    prefetch->n_queued = 0;
+    pthread_cond_signal( &prefetch->work_cond );
+    pthread_mutex_unlock( &prefetch->mutex );
+
+    if( prefetch->thread_started )
+    {
+        pthread_join( prefetch->thread, NULL );
+        prefetch->thread_started = FALSE;
+    }
+#endif
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_cache_block_for_voxel
+@INPUT      : volume
+              x
+              y
+              z
+              t
+              v
+              writing
+@OUTPUT     : offset
+              shard_ptr
+@RETURNS    : pointer to cache block
+@DESCRIPTION: Finds the cache block corresponding to a given voxel, and
+              modifies the voxel indices to be block indices.  This function
+              gets called for every set or get voxel value, so it must be
+              efficient.  On return, offset contains the integer offset
+              of the voxel within the cache block, and the shard holding
+              the block is locked, for writing if writing is TRUE; the
+              caller unlocks it once done with the block.
+@METHOD     : 
+@GLOBALS    : previous_block
+@CALLS      : 
+@CREATED    : Sep. 1, 1995    David MacDonald
+@MODIFIED   : Oct. 16, 2026   - sharded, locked, per-thread previous block,
+                                read-ahead of runs of misses
+              Oct. 16, 2026   - counts hits and misses
+---------------------------------------------------------------------------- */
+
+static  VIO_cache_block_struct  *get_cache_block_for_voxel(
+    VIO_Volume   volume,
+    int      x,
+    int      y,
+    int      z,
+    int      t,
+    int      v,
+    VIO_BOOL writing,
+    int      *offset,
+    cache_shard_struct  **shard_ptr )
+{
+    VIO_cache_block_struct   *block;
+    VIO_cache_lookup_struct  *lookup0, *lookup1, *lookup2, *lookup3, *lookup4;
+    int                  block_index;
+    int                  block_start[VIO_MAX_DIMENSIONS];
+    int                  n_dims, hash_index, b;
+    VIO_volume_cache_struct  *cache;
+    cache_shard_struct   *shard;
+
+    cache = &volume->cache;
+    n_dims = cache->n_dimensions;
+
+    switch( n_dims )
+    {
+    case 1:
+        lookup0 = &cache->lookup[0][x];
+        block_index = lookup0->block_index_offset;
+        *offset = lookup0->block_offset;
+        break;
+
+    case 2:
+        lookup0 = &cache->lookup[0][x];
+        lookup1 = &cache->lookup[1][y];
+        block_index = lookup0->block_index_offset +
+                      lookup1->block_index_offset;
+        *offset = lookup0->block_offset +
+                  lookup1->block_offset;
+        break;
+
+    case 3:
+        lookup0 = &cache->lookup[0][x];
+        lookup1 = &cache->lookup[1][y];
+        lookup2 = &cache->lookup[2][z];
+        block_index = lookup0->block_index_offset +
+                      lookup1->block_index_offset +
+                      lookup2->block_index_offset;
+        *offset = lookup0->block_offset +
+                  lookup1->block_offset +
+                  lookup2->block_offset;
+        break;
+
+    case 4:
+        lookup0 = &cache->lookup[0][x];
+        lookup1 = &cache->lookup[1][y];
+        lookup2 = &cache->lookup[2][z];
+        lookup3 = &cache->lookup[3][t];
+        block_index = lookup0->block_index_offset +
+                      lookup1->block_index_offset +
+                      lookup2->block_index_offset +
+                      lookup3->block_index_offset;
+        *offset = lookup0->block_offset +
+                  lookup1->block_offset +
+                  lookup2->block_offset +
                   lookup3->block_offset;
         break;
 
@@ -1310,118 +2782,134 @@ static  VIO_cache_block_struct  *get_cache_block_for_voxel(
         break;
     }
 
-    /*--- if this is the same as the last access, just return the last
-          block accessed */
+    shard = &cache->shards[block_index % cache->n_shards];
+    *shard_ptr = shard;
+
+#ifdef USE_PREVIOUS_BLOCK
+    /*--- if this is the same as this thread's last access, just return the
+          last block accessed, unless it has since been stolen */
+
+    if( block_index == previous_block.block_index &&
+        cache->epoch == previous_block.epoch )
+    {
+        if( writing )
+            WRITE_LOCK_SHARD( shard );
+        else
+            READ_LOCK_SHARD( shard );
+
+        if( previous_block.block->block_index == block_index &&
+            !previous_block.block->loading_flag &&
+            !previous_block.block->prefetched_flag )
+        {
+            COUNT_CACHE_EVENT( shard->n_prev_hits );
+            return( previous_block.block );
+        }
+
+        UNLOCK_SHARD( shard );
+    }
+#endif
+
+    /*--- a block found and referenced since the clock hand last passed it
+          needs no change to the shard, so is read under the shared lock;
+          blocks read ahead are not referenced until first used */
+
+    if( !writing )
+    {
+        READ_LOCK_SHARD( shard );
+
+        b = find_cache_block( cache, shard, block_index, &hash_index );
 
-    if( block_index == cache->previous_block_index )
-    {
-#ifdef  CACHE_DEBUGGING
-        record_cache_prev_hit( cache );
+        if( b != NO_BLOCK && shard->blocks[b].referenced_flag )
+        {
+            COUNT_CACHE_EVENT( shard->n_hits );
+            block = &shard->blocks[b];
+#ifdef USE_PREVIOUS_BLOCK
+            previous_block.epoch = cache->epoch;
+            previous_block.block_index = block_index;
+            previous_block.block = block;
 #endif
-        return( cache->previous_block );
+            return( block );
+        }
+
+        UNLOCK_SHARD( shard );
     }
 
+    WRITE_LOCK_SHARD( shard );
+
     /*--- search the hash table for the block index */
 
-    hash_index = hash_block_index( block_index, cache->hash_table_size );
+    b = find_cache_block( cache, shard, block_index, &hash_index );
 
-    block = cache->hash_table[hash_index];
+#ifdef HAVE_PTHREAD
+    /*--- a block being read ahead is waited for */
 
-    while( block != NULL && block->block_index != block_index )
+    while( b != NO_BLOCK && shard->blocks[b].loading_flag )
     {
-        block = block->next_hash;
+        wait_for_block_load( cache, shard, &shard->blocks[b] );
+        b = find_cache_block( cache, shard, block_index, &hash_index );
     }
+#endif
 
     /*--- check if it was found in the hash table */
 
-    if( block == NULL )
+    if( b == NO_BLOCK )
     {
-#ifdef  CACHE_DEBUGGING
-        record_cache_no_hit( cache );
-#endif
+        COUNT_CACHE_EVENT( shard->n_misses );
+        if( cache->debugging_on )
+            record_cache_debug_miss( volume );
 
-        /*--- find a block to use */
+        /*--- find a block to use, which may move entries of the table */
 
-        block = appropriate_a_cache_block( cache, volume );
+        block = appropriate_a_cache_block( cache, shard, volume );
         block->block_index = block_index;
 
+#ifdef HAVE_PTHREAD
+        note_cache_block_miss( cache, volume, block_index );
+#endif
+
         /*--- check if the block must be initialized from a file */
 
+        LOCK_CACHE_MUTEX( cache, file_mutex );
+
         if( cache->must_read_blocks_before_use )
         {
             get_block_start( cache, block_index, block_start );
             read_cache_block( cache, volume, block, block_start );
         }
 
-        /*--- insert the block in cache hash table */
-
-        block->next_hash = cache->hash_table[hash_index];
-        if( block->next_hash != NULL )
-            block->next_hash->prev_hash = &block->next_hash;
-        block->prev_hash = &cache->hash_table[hash_index];
-        *block->prev_hash = block;
-
-        /*--- insert the block at the head of the used list */
+        UNLOCK_CACHE_MUTEX( cache, file_mutex );
 
-        block->prev_used = NULL;
-        block->next_used = cache->head;
+        /*--- insert the block in the shard's hash table */
 
-        if( cache->head == NULL )
-            cache->tail = block;
-        else
-            cache->head->prev_used = block;
-
-        cache->head = block;
+        (void) find_cache_block( cache, shard, block_index, &hash_index );
+        shard->hash_table[hash_index] = (int) (block - shard->blocks);
     }
     else   /*--- block was found in hash table */
     {
-#ifdef  CACHE_DEBUGGING
-        record_cache_hit( cache );
-#endif
-
-        /*--- move block to head of used list */
+        COUNT_CACHE_EVENT( shard->n_hits );
+        block = &shard->blocks[b];
+        block->referenced_flag = TRUE;
 
-        if( block != cache->head )
-        {
-            block->prev_used->next_used = block->next_used;
-            if( block->next_used != NULL )
-                block->next_used->prev_used = block->prev_used;
-            else
-                cache->tail = block->prev_used;
-
-            cache->head->prev_used = block;
-            block->prev_used = NULL;
-            block->next_used = cache->head;
-            cache->head = block;
-        }
+        /*--- the first use of a block read ahead carries on the run */
 
-        /*--- move block to beginning of hash chain, so if next access to
-              this block, we will save some time */
-
-        if( cache->hash_table[hash_index] != block )
+        if( block->prefetched_flag )
         {
-            /*--- remove it from where it is */
-
-            *block->prev_hash = block->next_hash;
-            if( block->next_hash != NULL )
-                block->next_hash->prev_hash = block->prev_hash;
-
-            /*--- place it at the front of the list */
-                
-            block->next_hash = cache->hash_table[hash_index];
-            if( block->next_hash != NULL )
-                block->next_hash->prev_hash = &block->next_hash;
-            block->prev_hash = &cache->hash_table[hash_index];
-            *block->prev_hash = block;
+            block->prefetched_flag = FALSE;
+#ifdef HAVE_PTHREAD
+            note_cache_block_miss( cache, volume, block_index );
+#endif
         }
     }
 
+#ifdef USE_PREVIOUS_BLOCK
     /*--- record so if next access is to same block, we save some time */
 
-    cache->previous_block = block;
-    cache->previous_block_index = block_index;
+    previous_block.epoch = cache->epoch;
+    previous_block.block_index = block_index;
+    previous_block.block = block;
+#endif
 
-    return( cache->previous_block );
+    return( block );
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -1439,7 +2927,7 @@ static  VIO_cache_block_struct  *get_cache_block_for_voxel(
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - recorded in the trace, if any
 ---------------------------------------------------------------------------- */
 
 VIOAPI  VIO_Real  get_cached_volume_voxel(
@@ -1453,13 +2941,20 @@ VIOAPI  VIO_Real  get_cached_volume_voxel(
     int                  offset;
     VIO_Real                 value;
     VIO_cache_block_struct   *block;
+    cache_shard_struct       *shard;
 
-    if( volume->cache.minc_file == NULL )
-        return( get_volume_voxel_min( volume ) );
+    if( volume->cache.trace != NULL )
+        record_volume_cache_access( &volume->cache, x, y, z, t, v, FALSE );
 
-    block = get_cache_block_for_voxel( volume, x, y, z, t, v, &offset );
+    block = get_cache_block_for_voxel( volume, x, y, z, t, v, FALSE,
+                                       &offset, &shard );
 
-    GET_MULTIDIM_1D( value, (VIO_Real), block->array, offset );
+    if( volume->cache.minc_file == NULL )
+        value = get_volume_voxel_min( volume );
+    else
+        GET_MULTIDIM_1D( value, (VIO_Real), block->array, offset );
+
+    UNLOCK_SHARD( shard );
 
     return( value );
 }
@@ -1480,7 +2975,7 @@ VIOAPI  VIO_Real  get_cached_volume_voxel(
 @GLOBALS    : 
 @CALLS      : 
 @CREATED    : Sep. 1, 1995    David MacDonald
-@MODIFIED   : 
+@MODIFIED   : Oct. 16, 2026   - recorded in the trace, if any
 ---------------------------------------------------------------------------- */
 
 VIOAPI  void  set_cached_volume_voxel(
@@ -1494,18 +2989,472 @@ VIOAPI  void  set_cached_volume_voxel(
 {
     int                  offset;
     VIO_cache_block_struct   *block;
+    cache_shard_struct       *shard;
+
+    if( volume->cache.trace != NULL )
+        record_volume_cache_access( &volume->cache, x, y, z, t, v, TRUE );
+
+    block = get_cache_block_for_voxel( volume, x, y, z, t, v, TRUE,
+                                       &offset, &shard );
+
+    /*--- the first write opens the output file, with no shard locked */
 
     if( !volume->cache.output_file_is_open )
     {
-        (void) open_cache_volume_output_file( &volume->cache, volume );
-        volume->cache.output_file_is_open = TRUE;
-    }
+        UNLOCK_SHARD( shard );
 
-    block = get_cache_block_for_voxel( volume, x, y, z, t, v, &offset );
+        LOCK_CACHE_MUTEX( &volume->cache, open_mutex );
+        if( !volume->cache.output_file_is_open )
+        {
+            (void) open_cache_volume_output_file( &volume->cache, volume );
+
+            lock_all_cache_shards( &volume->cache, TRUE );
+            volume->cache.output_file_is_open = TRUE;
+            lock_all_cache_shards( &volume->cache, FALSE );
+        }
+        UNLOCK_CACHE_MUTEX( &volume->cache, open_mutex );
+
+        block = get_cache_block_for_voxel( volume, x, y, z, t, v, TRUE,
+                                           &offset, &shard );
+    }
 
     block->modified_flag = TRUE;
 
     SET_MULTIDIM_1D( block->array, offset, value );
+
+    UNLOCK_SHARD( shard );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : prefetch_volume_region
+@INPUT      : volume
+              start
+              count
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Asks for the cache blocks covering a region of a cached
+              volume to be read ahead of their use, in file order, by the
+              prefetch thread of the cache, or at once if there are no
+              threads.  No more blocks than the cache holds are read, and
+              the call does nothing for a volume that is not cached.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  void  prefetch_volume_region(
+    VIO_Volume   volume,
+    int          start[],
+    int          count[] )
+{
+    VIO_volume_cache_struct  *cache;
+    int                      dim, n_dims, block_index, n_blocks;
+    int                      sizes[VIO_MAX_DIMENSIONS];
+    int                      first[VIO_MAX_DIMENSIONS];
+    int                      last[VIO_MAX_DIMENSIONS];
+    int                      voxel[VIO_MAX_DIMENSIONS];
+
+    if( !volume->is_cached_volume )
+        return;
+
+    cache = &volume->cache;
+    n_dims = cache->n_dimensions;
+    get_volume_sizes( volume, sizes );
+
+    /*--- the first voxel of the first and last blocks in each dimension */
+
+    for_less( dim, 0, n_dims )
+    {
+        first[dim] = MAX( start[dim], 0 );
+        last[dim] = MIN( start[dim] + count[dim], sizes[dim] ) - 1;
+        if( last[dim] < first[dim] )
+            return;
+
+        first[dim] -= first[dim] % cache->block_sizes[dim];
+        voxel[dim] = first[dim];
+    }
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock( &cache->prefetch->mutex );
+#endif
+
+    n_blocks = 0;
+
+    do
+    {
+        block_index = 0;
+        for_less( dim, 0, n_dims )
+            block_index += cache->lookup[dim][voxel[dim]].block_index_offset;
+
+#ifdef HAVE_PTHREAD
+        if( !queue_cache_prefetch( cache, volume, block_index ) )
+            break;
+#else
+        prefetch_cache_block( cache, volume, block_index );
+#endif
+        ++n_blocks;
+
+        /*--- step to the next block, the last dimension fastest */
+
+        for_down( dim, n_dims - 1, 0 )
+        {
+            voxel[dim] += cache->block_sizes[dim];
+            if( voxel[dim] <= last[dim] )
+                break;
+
+            voxel[dim] = first[dim];
+        }
+    }
+    while( dim >= 0 && n_blocks < cache->max_blocks );
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock( &cache->prefetch->mutex );
+#endif
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_volume_cache_stats
+@INPUT      : volume
+@OUTPUT     : stats
+@RETURNS    : 
+@DESCRIPTION: Passes back the memory held by the cache of a volume, the most
+              it may hold, the number of blocks it has given up to, and
+              taken from, other volumes sharing the memory budget, and the
+              accesses to it: the hits on the block last used by the same
+              thread, the other hits, the misses, the blocks reused or given
+              up, and the bytes read and written and the time taken to do
+              so.  The accesses are counted from the last change of the
+              block sizes or cache size.  All are zero for a volume that is
+              not cached.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  void  get_volume_cache_stats(
+    VIO_Volume               volume,
+    VIO_volume_cache_stats   *stats )
+{
+    VIO_volume_cache_struct  *cache;
+    cache_shard_struct       *shard;
+    int                      s;
+
+    (void) memset( stats, 0, sizeof( *stats ) );
+
+    if( !volume->is_cached_volume )
+        return;
+
+    cache = &volume->cache;
+
+    for_less( s, 0, cache->n_shards )
+    {
+        shard = &cache->shards[s];
+        stats->n_hits += GET_CACHE_COUNT( shard->n_hits );
+        stats->n_prev_hits += GET_CACHE_COUNT( shard->n_prev_hits );
+        stats->n_misses += GET_CACHE_COUNT( shard->n_misses );
+        stats->n_evictions += GET_CACHE_COUNT( shard->n_evictions );
+    }
+
+    LOCK_CACHE_MUTEX( cache, file_mutex );
+    stats->n_bytes_read = cache->n_bytes_read;
+    stats->n_bytes_written = cache->n_bytes_written;
+    stats->read_seconds = cache->read_seconds;
+    stats->write_seconds = cache->write_seconds;
+    UNLOCK_CACHE_MUTEX( cache, file_mutex );
+
+    LOCK_CACHE_BUDGET();
+    stats->n_bytes_in_cache = cache->n_bytes_in_cache;
+    stats->max_bytes_in_cache = (VIO_Long) cache->max_blocks *
+                                cache->block_bytes;
+    stats->n_blocks_in_cache = cache->n_bytes_in_cache / cache->block_bytes;
+    stats->n_blocks_given_up = cache->n_blocks_given_up;
+    stats->n_blocks_taken = cache->n_blocks_taken;
+    UNLOCK_CACHE_BUDGET();
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : output_json_string
+@INPUT      : file
+              str
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Writes a string as a JSON string, quoted and escaped.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  output_json_string(
+    FILE      *file,
+    VIO_STR   str )
+{
+    int   i;
+
+    (void) fputc( '"', file );
+
+    for( i = 0; str != NULL && str[i] != '\0'; ++i )
+    {
+        if( str[i] == '"' || str[i] == '\\' )
+            (void) fprintf( file, "\\%c", str[i] );
+        else if( (unsigned char) str[i] < ' ' )
+            (void) fprintf( file, "\\u%04x", (unsigned char) str[i] );
+        else
+            (void) fputc( str[i], file );
+    }
+
+    (void) fputc( '"', file );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : output_cache_stats_json
+@INPUT      : file
+              filename
+              open_flag
+              stats
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Writes the statistics of one volume's cache as a JSON object.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  output_cache_stats_json(
+    FILE                     *file,
+    VIO_STR                  filename,
+    VIO_BOOL                 open_flag,
+    VIO_volume_cache_stats   *stats )
+{
+    (void) fprintf( file, "    { \"filename\": " );
+    output_json_string( file, filename );
+    (void) fprintf( file, ", \"open\": %s,\n", open_flag ? "true" : "false" );
+    (void) fprintf( file, "      \"n_hits\": %lld, \"n_prev_hits\": %lld, "
+                    "\"n_misses\": %lld, \"n_evictions\": %lld,\n",
+                    stats->n_hits, stats->n_prev_hits, stats->n_misses,
+                    stats->n_evictions );
+    (void) fprintf( file, "      \"n_bytes_read\": %lld, "
+                    "\"n_bytes_written\": %lld, \"read_seconds\": %g, "
+                    "\"write_seconds\": %g,\n",
+                    stats->n_bytes_read, stats->n_bytes_written,
+                    stats->read_seconds, stats->write_seconds );
+    (void) fprintf( file, "      \"n_bytes_in_cache\": %lld, "
+                    "\"max_bytes_in_cache\": %lld, "
+                    "\"n_blocks_in_cache\": %lld, "
+                    "\"n_blocks_given_up\": %lld, "
+                    "\"n_blocks_taken\": %lld }",
+                    stats->n_bytes_in_cache, stats->max_bytes_in_cache,
+                    stats->n_blocks_in_cache, stats->n_blocks_given_up,
+                    stats->n_blocks_taken );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : output_volume_cache_stats
+@INPUT      : file
+@OUTPUT     : 
+@RETURNS    : VIO_OK if successful
+@DESCRIPTION: Writes the statistics of the caches of all volumes as a JSON
+              document: the memory budget, the memory held, and an object
+              for each cached volume, those deleted first, if they were kept
+              because the environment variable VOLUME_CACHE_STATS is set,
+              then those still open.  No other thread may be deleting a
+              volume meanwhile.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  VIO_Status  output_volume_cache_stats(
+    FILE   *file )
+{
+    VIO_volume_cache_stats   stats;
+    VIO_Volume               *volumes;
+    VIO_Long                 budget, n_bytes;
+    int                      i, n_volumes;
+
+    LOCK_CACHE_BUDGET();
+
+    budget = cache_budget;
+    n_bytes = n_bytes_in_caches;
+    n_volumes = n_cached_volumes;
+    volumes = NULL;
+    if( n_volumes > 0 )
+    {
+        ALLOC( volumes, n_volumes );
+        for_less( i, 0, n_volumes )
+            volumes[i] = cached_volumes[i];
+    }
+
+    (void) fprintf( file, "{\n  \"budget\": %lld,\n"
+                    "  \"n_bytes_in_caches\": %lld,\n  \"volumes\": [",
+                    budget, n_bytes );
+
+    for_less( i, 0, n_kept_cache_stats )
+    {
+        (void) fprintf( file, "%s\n", (i == 0) ? "" : "," );
+        output_cache_stats_json( file, kept_cache_stats[i].filename, FALSE,
+                                 &kept_cache_stats[i].stats );
+    }
+
+    UNLOCK_CACHE_BUDGET();
+
+    for_less( i, 0, n_volumes )
+    {
+        get_volume_cache_stats( volumes[i], &stats );
+        (void) fprintf( file, "%s\n",
+                        (i == 0 && n_kept_cache_stats == 0) ? "" : "," );
+        output_cache_stats_json( file, volumes[i]->cache.input_filename,
+                                 TRUE, &stats );
+    }
+
+    (void) fprintf( file, "\n  ]\n}\n" );
+
+    if( n_volumes > 0 )
+        FREE( volumes );
+
+    return( ferror( file ) ? VIO_ERROR : VIO_OK );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : output_cache_stats_at_exit
+@INPUT      : 
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Writes the statistics of all caches to the file named by the
+              environment variable VOLUME_CACHE_STATS, or to stderr if it is
+              empty or "-", and frees those kept.
+@METHOD     : 
+@GLOBALS    : kept_cache_stats
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  output_cache_stats_at_exit( void )
+{
+    FILE   *file;
+    int    i;
+
+    if( string_length( cache_stats_filename ) == 0 ||
+        equal_strings( cache_stats_filename, "-" ) )
+    {
+        (void) output_volume_cache_stats( stderr );
+    }
+    else if( open_file( cache_stats_filename, WRITE_FILE, ASCII_FORMAT,
+                        &file ) == VIO_OK )
+    {
+        (void) output_volume_cache_stats( file );
+        (void) close_file( file );
+    }
+
+    for_less( i, 0, n_kept_cache_stats )
+        delete_string( kept_cache_stats[i].filename );
+
+    if( n_kept_cache_stats > 0 )
+        FREE( kept_cache_stats );
+
+    n_kept_cache_stats = 0;
+    delete_string( cache_stats_filename );
+    cache_stats_filename = NULL;
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : initialize_cache_stats_output
+@INPUT      : volume
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: The first time a cache is created, arranges for the statistics
+              of all caches to be written out at exit if the environment
+              variable VOLUME_CACHE_STATS is set.  Starts recording the
+              accesses to the volume's cache if VOLUME_CACHE_TRACE is set,
+              to a file named by it followed by a number.
+@METHOD     : 
+@GLOBALS    : cache_stats_filename
+              n_cache_traces
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  initialize_cache_stats_output(
+    VIO_Volume   volume )
+{
+    VIO_STR   trace_prefix, trace_filename;
+    int       trace_number;
+
+    LOCK_CACHE_BUDGET();
+
+    if( !cache_stats_output_checked )
+    {
+        cache_stats_output_checked = TRUE;
+
+        if( getenv( "VOLUME_CACHE_STATS" ) != NULL )
+        {
+            cache_stats_filename = create_string(
+                                           getenv( "VOLUME_CACHE_STATS" ) );
+            (void) atexit( output_cache_stats_at_exit );
+        }
+    }
+
+    trace_number = n_cache_traces++;
+
+    UNLOCK_CACHE_BUDGET();
+
+    trace_prefix = getenv( "VOLUME_CACHE_TRACE" );
+
+    if( trace_prefix != NULL )
+    {
+        trace_filename = alloc_string( string_length( trace_prefix ) + 12 );
+        (void) sprintf( trace_filename, "%s.%d", trace_prefix, trace_number );
+        (void) start_volume_cache_trace( volume, trace_filename );
+        delete_string( trace_filename );
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : keep_volume_cache_stats
+@INPUT      : volume
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Keeps the statistics of a volume's cache about to be deleted,
+              to be written out at exit, if the environment asked for it.
+@METHOD     : 
+@GLOBALS    : kept_cache_stats
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  keep_volume_cache_stats(
+    VIO_Volume   volume )
+{
+    kept_cache_stats_struct   kept;
+
+    kept.filename = NULL;
+    get_volume_cache_stats( volume, &kept.stats );
+
+    LOCK_CACHE_BUDGET();
+
+    if( cache_stats_filename != NULL )
+    {
+        if( volume->cache.input_filename != NULL )
+            kept.filename = create_string( volume->cache.input_filename );
+        else
+            kept.filename = create_string( volume->cache.output_filename );
+        ADD_ELEMENT_TO_ARRAY( kept_cache_stats, n_kept_cache_stats, kept,
+                              DEFAULT_CHUNK_SIZE );
+    }
+
+    UNLOCK_CACHE_BUDGET();
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -1533,15 +3482,13 @@ VIOAPI  VIO_BOOL  volume_is_cached(
     return( volume->is_cached_volume );
 }
 
-#ifndef  CACHE_DEBUGGING
-/* ARGSUSED */
-#endif
-
 VIOAPI  void   set_volume_cache_debugging(
     VIO_Volume   volume,
     int      output_every )
 {
-#ifdef  CACHE_DEBUGGING
+    if( !volume->is_cached_volume )
+        return;
+
     if( output_every >= 1 )
     {
         volume->cache.debugging_on = TRUE;
@@ -1551,11 +3498,8 @@ VIOAPI  void   set_volume_cache_debugging(
     {
         volume->cache.debugging_on = FALSE;
     }
-#endif
 }
 
-#ifdef  CACHE_DEBUGGING
-
 static  void  initialize_cache_debug(
     VIO_volume_cache_struct  *cache )
 {
@@ -1573,57 +3517,30 @@ static  void  initialize_cache_debug(
     }
 
     cache->output_every = output_every;
-    cache->n_accesses = 0;
-    cache->n_hits = 0;
-    cache->n_prev_hits = 0;
+    cache->n_debug_misses = 0;
 }
 
-static  void  increment_n_accesses(
-    VIO_volume_cache_struct  *cache )
+static  void  record_cache_debug_miss(
+    VIO_Volume               volume )
 {
-    ++cache->n_accesses;
+    VIO_volume_cache_stats   stats;
+    VIO_Long                 n_accesses;
+    VIO_BOOL                 output;
 
-    if( cache->n_accesses >= cache->output_every )
-    {
-        print( "VIO_Volume cache:  Hit ratio: %g   Prev ratio: %g\n",
-               (VIO_Real) (cache->n_hits + cache->n_prev_hits) /
-               (VIO_Real) cache->n_accesses,
-               (VIO_Real) cache->n_prev_hits /
-               (VIO_Real) cache->n_accesses );
+    LOCK_CACHE_BUDGET();
+    ++volume->cache.n_debug_misses;
+    output = (volume->cache.n_debug_misses % volume->cache.output_every == 0);
+    UNLOCK_CACHE_BUDGET();
 
-        cache->n_accesses = 0;
-        cache->n_hits = 0;
-        cache->n_prev_hits = 0;
-    }
-}
+    if( !output )
+        return;
 
-static  void  record_cache_hit(
-    VIO_volume_cache_struct  *cache )
-{
-    if( cache->debugging_on )
-    {
-        ++cache->n_hits;
-        increment_n_accesses( cache );
-    }
-}
+    get_volume_cache_stats( volume, &stats );
 
-static  void  record_cache_prev_hit(
-    VIO_volume_cache_struct  *cache )
-{
-    if( cache->debugging_on )
-    {
-        ++cache->n_prev_hits;
-        increment_n_accesses( cache );
-    }
-}
+    n_accesses = stats.n_hits + stats.n_prev_hits + stats.n_misses;
 
-static  void  record_cache_no_hit(
-    VIO_volume_cache_struct  *cache )
-{
-    if( cache->debugging_on )
-    {
-        increment_n_accesses( cache );
-    }
+    print( "VIO_Volume cache:  Hit ratio: %g   Prev ratio: %g\n",
+           (VIO_Real) (stats.n_hits + stats.n_prev_hits) /
+           (VIO_Real) n_accesses,
+           (VIO_Real) stats.n_prev_hits / (VIO_Real) n_accesses );
 }
-
-#endif
@@ -0,0 +1,558 @@
+/**
+ * \file Recording of the voxel accesses to a cached volume, and replay of
+ * the recorded accesses through a model of the cache, to choose block and
+ * cache sizes for a program without rerunning it.
+ *
+ * A trace is a text file: a header of the lines
+ *
+ *     volume_cache_trace
+ *     dimensions N
+ *     sizes S0 .. SN-1
+ *     voxel_bytes B
+ *
+ * followed by one line for each run of accesses of the same kind to
+ * consecutive voxels along the last dimension, "r" for reads and "w" for
+ * writes, the indices of the first voxel, and the number of voxels.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /*HAVE_CONFIG_H*/
+
+#include  <internal_volume_io.h>
+
+#ifdef HAVE_PTHREAD
+#include  <pthread.h>
+#endif
+
+#define  TRACE_MAGIC    "volume_cache_trace"
+#define  NO_SLOT        -1
+
+struct  VIO_cache_trace_struct
+{
+    FILE       *file;
+    int        n_dimensions;
+
+    /*--- the run of accesses not yet written */
+
+    VIO_BOOL   writing;
+    int        start[VIO_MAX_DIMENSIONS];
+    int        count;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t  mutex;
+#endif
+};
+
+#ifdef HAVE_PTHREAD
+#define  LOCK_TRACE( trace )    pthread_mutex_lock( &(trace)->mutex )
+#define  UNLOCK_TRACE( trace )  pthread_mutex_unlock( &(trace)->mutex )
+#else
+#define  LOCK_TRACE( trace )
+#define  UNLOCK_TRACE( trace )
+#endif
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : output_trace_run
+@INPUT      : trace
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Writes out the run of accesses not yet written, if any.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  void  output_trace_run(
+    struct VIO_cache_trace_struct  *trace )
+{
+    int   dim;
+
+    if( trace->count == 0 )
+        return;
+
+    (void) fputc( trace->writing ? 'w' : 'r', trace->file );
+
+    for_less( dim, 0, trace->n_dimensions )
+        (void) fprintf( trace->file, " %d", trace->start[dim] );
+
+    (void) fprintf( trace->file, " %d\n", trace->count );
+
+    trace->count = 0;
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : start_volume_cache_trace
+@INPUT      : volume
+              filename
+@OUTPUT     : 
+@RETURNS    : VIO_OK if successful
+@DESCRIPTION: Starts recording every voxel read from or written to a cached
+              volume in the file, replacing any recording already started.
+              The recording is stopped when the volume is deleted.  It must
+              not be started while other threads are using the volume.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  VIO_Status  start_volume_cache_trace(
+    VIO_Volume   volume,
+    VIO_STR      filename )
+{
+    struct VIO_cache_trace_struct  *trace;
+    FILE                           *file;
+    int                            dim, sizes[VIO_MAX_DIMENSIONS];
+
+    if( !volume->is_cached_volume )
+    {
+        print_error( "start_volume_cache_trace: volume is not cached.\n" );
+        return( VIO_ERROR );
+    }
+
+    stop_volume_cache_trace( volume );
+
+    if( open_file( filename, WRITE_FILE, ASCII_FORMAT, &file ) != VIO_OK )
+        return( VIO_ERROR );
+
+    ALLOC( trace, 1 );
+    trace->file = file;
+    trace->n_dimensions = get_volume_n_dimensions( volume );
+    trace->writing = FALSE;
+    trace->count = 0;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init( &trace->mutex, NULL );
+#endif
+
+    get_volume_sizes( volume, sizes );
+
+    (void) fprintf( file, "%s\ndimensions %d\nsizes", TRACE_MAGIC,
+                    trace->n_dimensions );
+    for_less( dim, 0, trace->n_dimensions )
+        (void) fprintf( file, " %d", sizes[dim] );
+    (void) fprintf( file, "\nvoxel_bytes %d\n",
+                    get_type_size( get_volume_data_type( volume ) ) );
+
+    volume->cache.trace = trace;
+
+    return( VIO_OK );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : stop_volume_cache_trace
+@INPUT      : volume
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Stops recording the accesses to a cached volume, and closes
+              the file they were recorded in.  Does nothing if they were
+              not being recorded.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  void  stop_volume_cache_trace(
+    VIO_Volume   volume )
+{
+    struct VIO_cache_trace_struct  *trace;
+
+    if( !volume->is_cached_volume || volume->cache.trace == NULL )
+        return;
+
+    trace = volume->cache.trace;
+    volume->cache.trace = NULL;
+
+    output_trace_run( trace );
+    (void) close_file( trace->file );
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_destroy( &trace->mutex );
+#endif
+    FREE( trace );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : record_volume_cache_access
+@INPUT      : cache
+              x
+              y
+              z
+              t
+              v
+              writing
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Records an access to a voxel of a cached volume whose
+              accesses are being recorded, extending the current run if the
+              voxel follows it along the last dimension.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  void  record_volume_cache_access(
+    VIO_volume_cache_struct  *cache,
+    int                      x,
+    int                      y,
+    int                      z,
+    int                      t,
+    int                      v,
+    VIO_BOOL                 writing )
+{
+    struct VIO_cache_trace_struct  *trace;
+    int                            dim, last, indices[VIO_MAX_DIMENSIONS];
+
+    trace = cache->trace;
+
+    indices[0] = x;
+    indices[1] = y;
+    indices[2] = z;
+    indices[3] = t;
+    indices[4] = v;
+
+    last = trace->n_dimensions - 1;
+
+    LOCK_TRACE( trace );
+
+    if( trace->count > 0 && trace->writing == writing &&
+        indices[last] == trace->start[last] + trace->count )
+    {
+        for_less( dim, 0, last )
+        {
+            if( indices[dim] != trace->start[dim] )
+                break;
+        }
+
+        if( dim == last )
+        {
+            ++trace->count;
+            UNLOCK_TRACE( trace );
+            return;
+        }
+    }
+
+    output_trace_run( trace );
+
+    trace->writing = writing;
+    for_less( dim, 0, trace->n_dimensions )
+        trace->start[dim] = indices[dim];
+    trace->count = 1;
+
+    UNLOCK_TRACE( trace );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_block_bytes
+@INPUT      : n_dims
+              sizes
+              block_sizes
+              blocks_per_dim
+              voxel_bytes
+              block_index
+@OUTPUT     : 
+@RETURNS    : number of bytes
+@DESCRIPTION: Returns the number of bytes of the volume in a block, fewer
+              than in a whole block for blocks on the far edges.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+static  VIO_Long  get_block_bytes(
+    int        n_dims,
+    int        sizes[],
+    int        block_sizes[],
+    int        blocks_per_dim[],
+    int        voxel_bytes,
+    int        block_index )
+{
+    int        dim, start;
+    VIO_Long   n_bytes;
+
+    n_bytes = voxel_bytes;
+
+    for_down( dim, n_dims - 1, 0 )
+    {
+        start = (block_index % blocks_per_dim[dim]) * block_sizes[dim];
+        block_index /= blocks_per_dim[dim];
+        n_bytes *= MIN( block_sizes[dim], sizes[dim] - start );
+    }
+
+    return( n_bytes );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : simulate_volume_cache_trace
+@INPUT      : filename
+              block_sizes
+              max_bytes
+@OUTPUT     : stats
+@RETURNS    : VIO_OK if successful
+@DESCRIPTION: Replays the accesses recorded in a trace through a model of a
+              cache of at most max_bytes, with blocks of the given sizes,
+              non-positive sizes meaning the whole dimension, and passes
+              back the statistics the cache would have kept: the hits,
+              hits on the previous block, misses and evictions, the bytes
+              read, and the bytes written, including those of the blocks
+              still modified at the end, as if the volume were then
+              deleted.  No time is spent on reading or writing.
+@METHOD     : The blocks are spread over shards, each with its own clock,
+              as in a real cache, but the accesses are replayed as made by
+              one thread, with no blocks read ahead, so the counts for a
+              trace of several threads, or of a cache with reads ahead or
+              sharing a memory budget with other volumes, are only an
+              estimate.
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : Oct. 16, 2026
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+VIOAPI  VIO_Status  simulate_volume_cache_trace(
+    VIO_STR                  filename,
+    int                      block_sizes[],
+    VIO_Long                 max_bytes,
+    VIO_volume_cache_stats   *stats )
+{
+    FILE       *file;
+    char       word[32], kind[2];
+    int        dim, n_dims, voxel_bytes, count, end, segment_end;
+    int        sizes[VIO_MAX_DIMENSIONS], sizes_used[VIO_MAX_DIMENSIONS];
+    int        blocks_per_dim[VIO_MAX_DIMENSIONS];
+    int        start[VIO_MAX_DIMENSIONS];
+    int        n_blocks, max_blocks, n_shards, s, slot;
+    int        block_index, row_index, previous_index, stride, last;
+    int        shard_max[MAX_CACHE_SHARDS], shard_first[MAX_CACHE_SHARDS];
+    int        shard_used[MAX_CACHE_SHARDS], shard_hand[MAX_CACHE_SHARDS];
+    int        *slot_of_block, *block_of_slot;
+    VIO_BOOL   *referenced, *modified, writing;
+    VIO_Long   block_bytes, max_slots;
+    VIO_Status status;
+
+    (void) memset( stats, 0, sizeof( *stats ) );
+
+    if( open_file( filename, READ_FILE, ASCII_FORMAT, &file ) != VIO_OK )
+        return( VIO_ERROR );
+
+    if( fscanf( file, "%31s dimensions %d sizes", word, &n_dims ) != 2 ||
+        strcmp( word, TRACE_MAGIC ) != 0 || n_dims < 1 ||
+        n_dims > VIO_MAX_DIMENSIONS )
+    {
+        print_error( "simulate_volume_cache_trace: %s is not a trace.\n",
+                     filename );
+        (void) close_file( file );
+        return( VIO_ERROR );
+    }
+
+    for_less( dim, 0, n_dims )
+    {
+        if( fscanf( file, "%d", &sizes[dim] ) != 1 || sizes[dim] < 1 )
+            break;
+    }
+
+    if( dim < n_dims || fscanf( file, " voxel_bytes %d", &voxel_bytes ) != 1 )
+    {
+        print_error( "simulate_volume_cache_trace: bad header in %s.\n",
+                     filename );
+        (void) close_file( file );
+        return( VIO_ERROR );
+    }
+
+    /*--- lay out the blocks as the cache does, the last dimension fastest */
+
+    n_blocks = 1;
+    block_bytes = voxel_bytes;
+
+    for_down( dim, n_dims - 1, 0 )
+    {
+        sizes_used[dim] = block_sizes[dim];
+        if( sizes_used[dim] <= 0 || sizes_used[dim] > sizes[dim] )
+            sizes_used[dim] = sizes[dim];
+
+        blocks_per_dim[dim] = (sizes[dim] - 1) / sizes_used[dim] + 1;
+        n_blocks *= blocks_per_dim[dim];
+        block_bytes *= sizes_used[dim];
+    }
+
+    max_slots = max_bytes / block_bytes;
+    if( max_slots < 1 )
+        max_slots = 1;
+    if( max_slots > n_blocks )
+        max_slots = n_blocks;
+    max_blocks = (int) max_slots;
+
+    /*--- share the blocks among the shards as the cache does, giving each
+          shard a range of the slots */
+
+    n_shards = MIN( max_blocks, MAX_CACHE_SHARDS );
+
+    for_less( s, 0, n_shards )
+    {
+        shard_max[s] = max_blocks / n_shards;
+        if( s < max_blocks % n_shards )
+            ++shard_max[s];
+
+        shard_first[s] = (s == 0) ? 0 : shard_first[s-1] + shard_max[s-1];
+        shard_used[s] = 0;
+        shard_hand[s] = 0;
+    }
+
+    ALLOC( slot_of_block, n_blocks );
+    for_less( block_index, 0, n_blocks )
+        slot_of_block[block_index] = NO_SLOT;
+
+    ALLOC( block_of_slot, max_blocks );
+    ALLOC( referenced, max_blocks );
+    ALLOC( modified, max_blocks );
+
+    previous_index = NO_SLOT;
+    last = n_dims - 1;
+    status = VIO_OK;
+
+    while( fscanf( file, "%1s", kind ) == 1 )
+    {
+        writing = (kind[0] == 'w');
+
+        for_less( dim, 0, n_dims )
+        {
+            if( fscanf( file, "%d", &start[dim] ) != 1 ||
+                start[dim] < 0 || start[dim] >= sizes[dim] )
+                break;
+        }
+
+        if( dim < n_dims || fscanf( file, "%d", &count ) != 1 ||
+            count < 1 || start[last] + count > sizes[last] ||
+            (kind[0] != 'r' && kind[0] != 'w') )
+        {
+            print_error( "simulate_volume_cache_trace: bad record in %s.\n",
+                         filename );
+            status = VIO_ERROR;
+            break;
+        }
+
+        /*--- the index of the first block of the row the run is along */
+
+        row_index = 0;
+        stride = 1;
+        for_down( dim, last, 0 )
+        {
+            if( dim < last )
+                row_index += start[dim] / sizes_used[dim] * stride;
+            stride *= blocks_per_dim[dim];
+        }
+
+        /*--- each block the run passes through is looked up once, and the
+              rest of the run within it hits the previous block */
+
+        end = start[last] + count;
+
+        while( start[last] < end )
+        {
+            block_index = row_index + start[last] / sizes_used[last];
+            segment_end = MIN( end, (start[last] / sizes_used[last] + 1) *
+                                    sizes_used[last] );
+
+            slot = slot_of_block[block_index];
+
+            if( block_index == previous_index && slot != NO_SLOT )
+            {
+                ++stats->n_prev_hits;
+            }
+            else if( slot != NO_SLOT )
+            {
+                ++stats->n_hits;
+                referenced[slot] = TRUE;
+            }
+            else
+            {
+                ++stats->n_misses;
+
+                s = block_index % n_shards;
+
+                if( shard_used[s] < shard_max[s] )
+                    slot = shard_first[s] + shard_used[s]++;
+                else
+                {
+                    /*--- turn the shard's clock hand to a block not
+                          referenced */
+
+                    while( referenced[shard_first[s] + shard_hand[s]] )
+                    {
+                        referenced[shard_first[s] + shard_hand[s]] = FALSE;
+                        if( ++shard_hand[s] == shard_max[s] )
+                            shard_hand[s] = 0;
+                    }
+
+                    slot = shard_first[s] + shard_hand[s];
+                    if( ++shard_hand[s] == shard_max[s] )
+                        shard_hand[s] = 0;
+
+                    ++stats->n_evictions;
+                    if( modified[slot] )
+                    {
+                        stats->n_bytes_written += get_block_bytes( n_dims,
+                                 sizes, sizes_used, blocks_per_dim,
+                                 voxel_bytes, block_of_slot[slot] );
+                    }
+                    slot_of_block[block_of_slot[slot]] = NO_SLOT;
+                }
+
+                block_of_slot[slot] = block_index;
+                slot_of_block[block_index] = slot;
+                referenced[slot] = TRUE;
+                modified[slot] = FALSE;
+
+                stats->n_bytes_read += get_block_bytes( n_dims, sizes,
+                              sizes_used, blocks_per_dim, voxel_bytes,
+                              block_index );
+            }
+
+            if( writing )
+                modified[slot] = TRUE;
+
+            stats->n_prev_hits += segment_end - start[last] - 1;
+            previous_index = block_index;
+            start[last] = segment_end;
+        }
+    }
+
+    (void) close_file( file );
+
+    /*--- the blocks still modified are written out when the volume is
+          deleted */
+
+    for_less( s, 0, n_shards )
+    {
+        for_less( slot, shard_first[s], shard_first[s] + shard_used[s] )
+        {
+            if( modified[slot] )
+            {
+                stats->n_bytes_written += get_block_bytes( n_dims, sizes,
+                                 sizes_used, blocks_per_dim, voxel_bytes,
+                                 block_of_slot[slot] );
+            }
+        }
+
+        stats->n_blocks_in_cache += shard_used[s];
+    }
+
+    stats->n_bytes_in_cache = stats->n_blocks_in_cache * block_bytes;
+    stats->max_bytes_in_cache = (VIO_Long) max_blocks * block_bytes;
+
+    FREE( slot_of_block );
+    FREE( block_of_slot );
+    FREE( referenced );
+    FREE( modified );
+
+    return( status );
+}
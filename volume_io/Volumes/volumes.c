@@ -568,26 +568,22 @@ VIOAPI  VIO_BOOL  is_an_rgb_volume(
 VIOAPI  void  alloc_volume_data(
     VIO_Volume   volume )
 {
-#ifdef HAVE_MINC1
     unsigned long   data_size;
 
     data_size = (unsigned long) get_volume_total_n_voxels( volume ) *
                 (unsigned long) get_type_size( get_volume_data_type( volume ) );
 
 	if( get_n_bytes_cache_threshold() >= 0 &&
-        data_size > (unsigned long) get_n_bytes_cache_threshold() )
+        (VIO_Long) data_size > get_n_bytes_cache_threshold() )
     {
         volume->is_cached_volume = TRUE;
         initialize_volume_cache( &volume->cache, volume );
     }
     else
     {
-#endif /*HAVE_MINC1*/
         volume->is_cached_volume = FALSE;
         alloc_multidim_array( &volume->array );
-#ifdef HAVE_MINC1
     }
-#endif /*HAVE_MINC1*/
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -606,12 +602,8 @@ VIOAPI  void  alloc_volume_data(
 VIOAPI  VIO_BOOL  volume_is_alloced(
     VIO_Volume   volume )
 {
-#ifdef HAVE_MINC1
     return  ( volume->is_cached_volume && volume_cache_is_alloced( &volume->cache )) ||
             (!volume->is_cached_volume && multidim_array_is_alloced( &volume->array )) ;
-#else
-    return  multidim_array_is_alloced( &volume->array ) ;
-#endif    
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -630,11 +622,9 @@ VIOAPI  VIO_BOOL  volume_is_alloced(
 VIOAPI  void  free_volume_data(
     VIO_Volume   volume )
 {
-#ifdef HAVE_MINC1
     if( volume->is_cached_volume )
         delete_volume_cache( &volume->cache, volume );
     else 
-#endif    
       if( volume_is_alloced( volume ) )
         delete_multidim_array( &volume->array );
 }
@@ -2351,10 +2341,8 @@ VIOAPI  void  set_volume_voxel_range(
 
     if( volume->real_range_set )
         set_volume_real_range( volume, real_min, real_max );
-#ifdef HAVE_MINC1
     else
         cache_volume_range_has_changed( volume );
-#endif    
 }
 
 /* ----------------------------- MNI Header -----------------------------------
@@ -2503,10 +2491,8 @@ VIOAPI  void  set_volume_real_range(
         volume->real_range_set = TRUE;
     }
 
-#ifdef HAVE_MINC1
     if( volume->is_cached_volume )
         cache_volume_range_has_changed( volume );
-#endif
 }
 
 /* ----------------------------- MNI Header -----------------------------------